@@ -23,10 +23,29 @@ class iRecord;
 class psDBProfiles;
 class LogCSV;
 
+/**
+ * Gets the outcome of a command queued with iDataConnection::CommandPump().
+ * With the query pipeline enabled this is called in the database thread.
+ */
+class iQueryCallback
+{
+public:
+    /**
+     * The command finished. A callback used for one command only may delete
+     * itself here.
+     *
+     * @param result The number of affected rows, or QUERY_FAILED.
+     * @param error The error message if the command failed.
+     */
+    virtual void QueryDone(unsigned long result, const char* error) = 0;
+
+    virtual ~iQueryCallback() {}
+};
+
 struct iDataConnection : public virtual iBase
 {
 public:
-    SCF_INTERFACE(iDataConnection, 0, 0, 1);
+    SCF_INTERFACE(iDataConnection, 0, 2, 0);
 
     /// Returns whether this object is actually connected to the database.
     virtual int IsValid(void)=0;
@@ -61,8 +80,21 @@ public:
      * signify an error.
      */
     virtual unsigned long Command(const char *sql,...)=0;
+
+    /**
+     * Like Command(), but with the query pipeline enabled the command is
+     * queued and run by the database thread, batched with the commands
+     * queued around it. Returns 1 then, the real outcome isn't known yet:
+     * callers that act on the outcome use Command() or the callback overload.
+     */
     virtual unsigned long CommandPump(const char *sql,...) = 0;
 
+    /**
+     * Queue a command and get its outcome through a callback. Without the
+     * query pipeline the command runs and the callback is called right away.
+     */
+    virtual void CommandPump(iQueryCallback* callback, const char *sql,...) = 0;
+
     /**
      * This dynamically builds an insert sql statement
      * from the supplied table name, field name array,
@@ -106,6 +138,19 @@ public:
     
     virtual iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line) =0;
     virtual iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line) = 0;
+
+    /**
+     * Give the calling thread a connection of its own. Until DetachThread
+     * all queries of the thread go over it, so it can query while other
+     * threads do.
+     *
+     * @return false if the thread can't have its own connection, it then
+     *   must not use this connection at all.
+     */
+    virtual bool AttachThread() = 0;
+
+    /// Close the connection AttachThread opened for the calling thread.
+    virtual void DetachThread() = 0;
 };
 
 
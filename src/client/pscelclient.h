@@ -39,6 +39,7 @@
 //=============================================================================
 
 #include "net/cmdbase.h"
+#include "net/drmessages.h"
 #include "engine/linmove.h"
 
 //=============================================================================
@@ -625,6 +626,12 @@ public:
     void SetDRData(psDRMessage &drmsg);
     void StopMoving(bool worldVel = false);
 
+    /// The keyframe compact DR updates of this actor are decoded against.
+    psDRKeyframe &GetDRKeyframe()
+    {
+        return drKeyframe;
+    }
+
     psCharAppearance* CharAppearance()
     {
         return charApp;
@@ -726,6 +733,7 @@ protected:
     csString guildName;
     uint8_t  DRcounter;  ///< increments in loop to prevent out of order packet overwrites of better data
     bool DRcounter_set;
+    psDRKeyframe drKeyframe;
 
     virtual void SwitchToRealMesh(iMeshWrapper* mesh);
 
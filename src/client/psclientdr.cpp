@@ -36,6 +36,7 @@
 #include "net/message.h"
 #include "net/clientmsghandler.h"
 #include "net/connection.h"
+#include "net/drmessages.h"
 
 //=============================================================================
 // Local Includes
@@ -70,6 +71,7 @@ psClientDR::~psClientDR()
     if (msghandler)
     {
         msghandler->Unsubscribe(this,MSGTYPE_DEAD_RECKONING);
+        msghandler->Unsubscribe(this,MSGTYPE_DEAD_RECKONING_COMPACT);
         msghandler->Unsubscribe(this,MSGTYPE_FORCE_POSITION);
         msghandler->Unsubscribe(this,MSGTYPE_STATDRUPDATE);
         msghandler->Unsubscribe(this,MSGTYPE_MSGSTRINGS);
@@ -90,6 +92,7 @@ bool psClientDR::Initialize(iObjectRegistry* object_reg, psCelClient* celclient,
     msgstrings = NULL; // will get it in a MSGTYPE_MSGSTRINGS message
 
     msghandler->Subscribe(this,MSGTYPE_DEAD_RECKONING);
+    msghandler->Subscribe(this,MSGTYPE_DEAD_RECKONING_COMPACT);
     msghandler->Subscribe(this,MSGTYPE_FORCE_POSITION);
     msghandler->Subscribe(this,MSGTYPE_STATDRUPDATE);
     msghandler->Subscribe(this,MSGTYPE_MSGSTRINGS);
@@ -171,6 +174,10 @@ void psClientDR::HandleMessage (MsgEntry* me)
     {
         HandleDeadReckon( me );
     }
+    else if (me->GetType() == MSGTYPE_DEAD_RECKONING_COMPACT)
+    {
+        HandleCompactDeadReckon( me );
+    }
     else if (me->GetType() == MSGTYPE_FORCE_POSITION)
     {
         HandleForcePosition(me);
@@ -214,6 +221,34 @@ void psClientDR::HandleDeadReckon( MsgEntry* me )
         return;
     }
 
+    ApplyDeadReckon(gemActor, drmsg);
+}
+
+void psClientDR::HandleCompactDeadReckon( MsgEntry* me )
+{
+    // Deltas are decoded against the keyframe of their entity, so find it first.
+    EID entityid = me->GetUInt32();
+    me->Reset();
+    GEMClientActor* gemActor = (GEMClientActor*)celclient->FindObject( entityid );
+
+    if (!gemActor)
+    {
+        Error2("Got DR message for unknown entity %s.", ShowID(entityid));
+        return;
+    }
+
+    psDRCompactMessage drmsg(me, psengine->GetNetManager()->GetConnection()->GetAccessPointers(), gemActor->GetDRKeyframe());
+    if (!drmsg.valid)
+    {
+        // A delta that overtook its keyframe, the next update has it.
+        return;
+    }
+
+    ApplyDeadReckon(gemActor, drmsg);
+}
+
+void psClientDR::ApplyDeadReckon( GEMClientActor* gemActor, psDRMessage& drmsg )
+{
     if (!msgstrings)
     {
         Error1("msgstrings not received, cannot handle DR");
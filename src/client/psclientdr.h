@@ -40,6 +40,7 @@ class MsgEntry;
 class pawsGroupWindow;
 class pawsPetStatWindow;
 class GEMClientActor;
+class psDRMessage;
 
 class psClientDR : public psClientNetSubscriber
 {
@@ -83,6 +84,8 @@ private:
     void HandleStrings( MsgEntry* me );
     void HandleStatsUpdate( MsgEntry* me );
     void HandleDeadReckon( MsgEntry* me );
+    void HandleCompactDeadReckon( MsgEntry* me );
+    void ApplyDeadReckon( GEMClientActor* gemActor, psDRMessage& drmsg );
     void HandleForcePosition(MsgEntry *me);
     void HandleSequence( MsgEntry* me );
 };
@@ -31,6 +31,8 @@
 #include <iutil/eventq.h>
 #include <iutil/evdefs.h>
 #include <iutil/virtclk.h>
+#include <iutil/object.h>
+#include <iutil/cfgmgr.h>
 
 #include <imesh/sprite3d.h>
 #include <imesh/spritecal3d.h>
@@ -38,6 +40,8 @@
 #include <csutil/databuf.h>
 #include <csutil/plugmgr.h>
 #include <csutil/callstack.h>
+#include <csutil/csobject.h>
+#include <csutil/threading/mutex.h>
 #include <iengine/movable.h>
 #include <iengine/mesh.h>
 #include <iengine/engine.h>
@@ -53,9 +57,11 @@
 #include <igeom/path.h>
 #include <csgeom/path.h>
 #include <csgeom/math3d.h>
+#include <csgeom/box.h>
 
 #include "linmove.h"
 #include "colldet.h"
+#include "util/groundheightgrid.h"
 #include "util/strutil.h"
 #include "util/log.h"
 
@@ -141,6 +147,9 @@ psLinearMovement::psLinearMovement(iObjectRegistry* object_reg)
     zRot = 0.0f;
     hugGround = false;
 
+    csRef<iConfigManager> config = csQueryRegistry<iConfigManager> (object_reg);
+    groundGrid = !config || config->GetBool("PlaneShift.Movement.GroundHeightGrid", true);
+
     portalDisplaced = 0.0f;
 
     path = 0;
@@ -585,59 +594,130 @@ int psLinearMovement::MoveV(float delta)
     return ret;
 }
 
-void psLinearMovement::HugGround(const csVector3 &pos, iSector* sector)
+/**
+ * The ground heights of a sector, attached to the sector. Meshes added to
+ * or removed from the sector clear the heights around them.
+ */
+class psGroundHeightAttach : public scfImplementationExt2<psGroundHeightAttach,
+    csObject,
+    scfFakeInterface<psGroundHeightAttach>,
+    iSectorMeshCallback>
 {
-    csVector3 start, end;
-    csIntersectingTriangle closest_tri;
-    csVector3 isect[4];
-    csPlane3 plane;
-    bool hit[4];
+public:
+    SCF_INTERFACE(psGroundHeightAttach, 0, 0, 1);
 
-    // Set minimum base dimensions of 0.5x0.5 for good aesthetics
-    float legsXlimit = csMax(bottomSize.x / 2, 0.5f);
-    float legsZlimit = csMax(bottomSize.z / 2, 0.5f);
+    psGroundHeightAttach() : scfImplementationType(this) {}
 
-    start.y = pos.y + shift.y + 0.01;
+    virtual void NewMesh(iSector* /*sector*/, iMeshWrapper* mesh)
+    {
+        ClearMesh(mesh);
+    }
+
+    virtual void RemoveMesh(iSector* /*sector*/, iMeshWrapper* mesh)
+    {
+        ClearMesh(mesh);
+    }
+
+    GroundHeightGrid grid;
+
+private:
+    void ClearMesh(iMeshWrapper* mesh)
+    {
+        const csBox3 &box = mesh->GetWorldBoundingBox();
+        grid.ClearArea(box.Min(), box.Max());
+    }
+};
+
+/**
+ * Traces beams against the collision meshes of a sector.
+ */
+class psSectorGroundTracer : public iGroundTracer
+{
+public:
+    psSectorGroundTracer(iCollideSystem* cdsys, iSector* sector) : cdsys(cdsys), sector(sector) {}
+
+    virtual bool TraceDown(const csVector3 &start, float depth, float &height)
+    {
+        csVector3 end = start;
+        end.y -= depth;
 
-    // Assuming the bounding box is axis-aligned: (Lower-left point)
-    start.x = pos.x - legsXlimit;
-    start.z = pos.z - legsZlimit;
+        csIntersectingTriangle closest_tri;
+        csVector3 isect;
+        if(csColliderHelper::TraceBeam(cdsys, sector, start, end, false, closest_tri, isect) == -1)
+            return false;
 
-    end = start;
-    end.y -= 5;
+        height = isect.y;
+        return true;
+    }
 
-    hit[0] = csColliderHelper::TraceBeam(cdsys, sector, start, end,
-                                         false, closest_tri, isect[0]) != -1;
+private:
+    iCollideSystem* cdsys;
+    iSector* sector;
+};
 
-    // Assuming the bounding box is axis-aligned: (Upper-left point)
-    start.x = pos.x - legsXlimit;
-    start.z = pos.z + legsZlimit;
+/// Guards attaching the grids, movement may run on several threads.
+static CS::Threading::Mutex groundGridMutex;
 
-    end = start;
-    end.y -= 5;
+/**
+ * The ground height grid of a sector, attached on first use. The sector
+ * owns it.
+ */
+static GroundHeightGrid* GetGroundHeightGrid(iSector* sector)
+{
+    CS::Threading::MutexScopedLock lock(groundGridMutex);
 
-    hit[1] = csColliderHelper::TraceBeam(cdsys, sector, start, end,
-                                         false, closest_tri, isect[1]) != -1;
+    iObject* object = sector->QueryObject();
+    csRef<psGroundHeightAttach> attach(CS::GetChildObject<psGroundHeightAttach>(object));
+    if(!attach)
+    {
+        attach.AttachNew(new psGroundHeightAttach());
+        attach->SetName("GroundHeights");
+        csRef<iObject> attach_obj(scfQueryInterface<iObject>(attach));
+        object->ObjAdd(attach_obj);
+        sector->AddSectorMeshCallback(attach);
+    }
+    return &attach->grid;
+}
 
-    // Assuming the bounding box is axis-aligned: (Upper-right point)
-    start.x = pos.x + legsXlimit;
-    start.z = pos.z + legsZlimit;
+void psLinearMovement::HugGround(const csVector3 &pos, iSector* sector)
+{
+    csVector3 start;
+    csVector3 isect[4];
+    csPlane3 plane;
+    bool hit[4];
 
-    end = start;
-    end.y -= 5;
+    // Set minimum base dimensions of 0.5x0.5 for good aesthetics
+    float legsXlimit = csMax(bottomSize.x / 2, 0.5f);
+    float legsZlimit = csMax(bottomSize.z / 2, 0.5f);
 
-    hit[2] = csColliderHelper::TraceBeam(cdsys, sector, start, end,
-                                         false, closest_tri, isect[2]) != -1;
+    // The corners of the base, assuming the bounding box is axis-aligned:
+    // lower-left, upper-left, upper-right and lower-right.
+    const float corners[4][2] =
+    {
+        { -legsXlimit, -legsZlimit },
+        { -legsXlimit,  legsZlimit },
+        {  legsXlimit,  legsZlimit },
+        {  legsXlimit, -legsZlimit }
+    };
 
-    // Assuming the bounding box is axis-aligned: (Lower-right point)
-    start.x = pos.x + legsXlimit;
-    start.z = pos.z - legsZlimit;
+    // Sampled from the grid of the sector, only cells with steps or
+    // overhangs in them trace beams.
+    GroundHeightGrid* grid = groundGrid ? GetGroundHeightGrid(sector) : NULL;
+    psSectorGroundTracer tracer(cdsys, sector);
 
-    end = start;
-    end.y -= 5;
+    start.y = pos.y + shift.y + 0.01;
+    for(int i = 0; i < 4; i++)
+    {
+        start.x = pos.x + corners[i][0];
+        start.z = pos.z + corners[i][1];
 
-    hit[3] = csColliderHelper::TraceBeam(cdsys, sector, start, end,
-                                         false, closest_tri, isect[3]) != -1;
+        float height = 0.0f;
+        if(grid)
+            hit[i] = grid->GetHeight(&tracer, start, 5, height);
+        else
+            hit[i] = tracer.TraceDown(start, 5, height);
+        isect[i].Set(start.x, height, start.z);
+    }
 
     //printf("Isect (%f %f %f %f)\n",hit[0] ? isect[0].y : -999, hit[1] ? isect[1].y : -999, hit[2] ? isect[2].y: -999, hit[3] ? isect[3].y: -999);
 
@@ -1203,6 +1283,11 @@ bool psLinearMovement::IsPath() const
     return (path != 0);
 }
 
+bool psLinearMovement::IsMoving() const
+{
+    return path || !velBody.IsZero() || !velWorld.IsZero() || !angularVelocity.IsZero();
+}
+
 void psLinearMovement::SetPath(iPath* newpath)
 {
     path = newpath;
@@ -133,6 +133,8 @@ public:
 
     virtual bool IsPath() const;
 
+    /// True if extrapolating would move or turn the body.
+    bool IsMoving() const;
 
     /**
      * Returns the difference in time between now and when the last DR update
@@ -294,6 +296,8 @@ protected:
 
     /// Should the model be tilted so it's aligned with the ground
     bool hugGround;
+    /// Take the ground heights from the grid of the sector
+    bool groundGrid;
 
     float xRot;
     float zRot;
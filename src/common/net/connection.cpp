@@ -147,7 +147,7 @@ void psNetConnection::DisConnect()
     }
     
     // with proper refcounting this should kill all members of the hash
-    awaitingack.Empty();
+    ClearAwaitingAck();
 }
 
 
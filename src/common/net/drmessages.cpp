@@ -0,0 +1,414 @@
+/*
+ * drmessages.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+#include <iengine/engine.h>
+#include <iengine/sector.h>
+#include <iutil/object.h>
+
+#include "net/drmessages.h"
+
+/// The on ground bit of psDRQuantized::mode, the same as psDRMessage uses.
+#define DR_ON_GROUND_BIT 128
+
+/// Largest position offset, in steps.
+#define DR_MAX_OFFSET 32767
+
+static int16_t QuantizeVelocity(float v)
+{
+    float narrow = floorf(v * DR_VELOCITY_SCALE / DR_VELOCITY_NARROW + 0.5f);
+    if(fabsf(narrow) <= 127)
+        return (int16_t)narrow * DR_VELOCITY_NARROW;
+
+    float wide = floorf(v * DR_VELOCITY_SCALE + 0.5f);
+    return (int16_t)csClamp(wide, 32767.0f, -32767.0f);
+}
+
+static bool IsNarrow(int16_t v)
+{
+    return v % DR_VELOCITY_NARROW == 0 && abs(v / DR_VELOCITY_NARROW) <= 127;
+}
+
+static float DequantizeVelocity(int16_t v)
+{
+    return (float)v / DR_VELOCITY_SCALE;
+}
+
+//--------------------------------------------------------------------------------
+
+csString psDRUpdate::Record(csTicks ticks, EID eid, uint8_t counter) const
+{
+    csString line;
+    line.Format("%u %u %u %d %u %.4f %.4f %.4f %.4f %s %.4f %.4f %.4f %.4f %.4f %.4f %.4f",
+                ticks, eid.Unbox(), counter, on_ground ? 1 : 0, mode,
+                pos.x, pos.y, pos.z, yrot,
+                sector ? sector->QueryObject()->GetName() : sectorName.GetDataSafe(),
+                vel.x, vel.y, vel.z, worldVel.x, worldVel.y, worldVel.z, ang_vel);
+    return line;
+}
+
+bool psDRUpdate::Parse(const char* line, csTicks &ticks, EID &eid, uint8_t &counter)
+{
+    unsigned int id, count, modeValue;
+    int ground;
+    char name[256];
+    if(sscanf(line, "%u %u %u %d %u %f %f %f %f %255s %f %f %f %f %f %f %f",
+              &ticks, &id, &count, &ground, &modeValue,
+              &pos.x, &pos.y, &pos.z, &yrot, name,
+              &vel.x, &vel.y, &vel.z, &worldVel.x, &worldVel.y, &worldVel.z, &ang_vel) != 17)
+        return false;
+
+    eid = EID(id);
+    counter = (uint8_t)count;
+    on_ground = ground != 0;
+    mode = (uint8_t)modeValue;
+    sector = NULL;
+    sectorName = name;
+    return true;
+}
+
+//--------------------------------------------------------------------------------
+
+bool psDRQuantized::SameMotion(const psDRQuantized &other) const
+{
+    return mode == other.mode && yrot == other.yrot && angVel == other.angVel &&
+           vel[0] == other.vel[0] && vel[1] == other.vel[1] && vel[2] == other.vel[2] &&
+           worldVel[0] == other.worldVel[0] && worldVel[1] == other.worldVel[1] &&
+           worldVel[2] == other.worldVel[2];
+}
+
+//--------------------------------------------------------------------------------
+
+psDREncoder::psDREncoder() : active(0)
+{
+    memset(&current, 0, sizeof(current));
+    memset(&last, 0, sizeof(last));
+}
+
+bool psDREncoder::Update(const psDRUpdate &update)
+{
+    psDRQuantized q;
+    q.mode = update.mode | (update.on_ground ? DR_ON_GROUND_BIT : 0);
+    q.yrot = (uint8_t)(int)floorf(update.yrot * 256 / TWO_PI + 0.5f);
+    q.angVel = QuantizeVelocity(update.ang_vel);
+    q.vel[0] = QuantizeVelocity(update.vel.x);
+    q.vel[1] = QuantizeVelocity(update.vel.y);
+    q.vel[2] = QuantizeVelocity(update.vel.z);
+    q.worldVel[0] = QuantizeVelocity(update.worldVel.x);
+    q.worldVel[1] = QuantizeVelocity(update.worldVel.y);
+    q.worldVel[2] = QuantizeVelocity(update.worldVel.z);
+
+    bool rekey = !keyframe.valid;
+    if(!rekey)
+    {
+        if(update.sector || keyframe.sector)
+            rekey = update.sector != keyframe.sector;
+        else
+            rekey = update.sectorName != keyframe.sectorName;
+    }
+
+    csVector3 offset = (update.pos - keyframe.origin) * DR_POSITION_SCALE;
+    for(int i = 0; i < 3 && !rekey; i++)
+    {
+        // Written so that NaN starts a keyframe as well.
+        if(!(fabsf(offset[i]) <= DR_MAX_OFFSET))
+            rekey = true;
+        else
+            q.offset[i] = (int16_t)floorf(offset[i] + 0.5f);
+    }
+
+    // A motion that held for two updates will likely hold for more, so make
+    // it the base the following deltas are coded against.
+    if(!rekey && !q.SameMotion(keyframe.state) && q.SameMotion(last))
+        rekey = true;
+
+    last = q;
+    if(rekey)
+    {
+        keyframe.id++;
+        keyframe.valid = true;
+        keyframe.origin = update.pos;
+        keyframe.sector = update.sector;
+        keyframe.sectorName = update.sector ? update.sector->QueryObject()->GetName() : update.sectorName.GetDataSafe();
+        keyframe.state = q;
+        memset(keyframe.state.offset, 0, sizeof(keyframe.state.offset));
+    }
+    current = rekey ? keyframe.state : q;
+
+    // Start a new round of receivers, the last one tells who has the keyframe.
+    active ^= 1;
+    receivers[active].DeleteAll();
+    return rekey;
+}
+
+bool psDREncoder::NeedsKeyframe(uint32_t client)
+{
+    const Receiver* has = receivers[active ^ 1].GetElementPointer(client);
+    Receiver receiver;
+    receiver.keyframe = keyframe.id;
+    receiver.deltas = 0;
+    bool needsKeyframe = !has || has->keyframe != keyframe.id || has->deltas >= DR_KEYFRAME_INTERVAL;
+    if(!needsKeyframe)
+        receiver.deltas = has->deltas + 1;
+    receivers[active].PutUnique(client, receiver);
+    return needsKeyframe;
+}
+
+void psDREncoder::Keep(uint32_t client)
+{
+    const Receiver* has = receivers[active ^ 1].GetElementPointer(client);
+    if(has)
+        receivers[active].PutUnique(client, *has);
+}
+
+void psDREncoder::Forget(uint32_t client)
+{
+    receivers[active].DeleteAll(client);
+}
+
+//--------------------------------------------------------------------------------
+
+PSF_IMPLEMENT_MSG_FACTORY_ACCESS_POINTER(psDRCompactMessage,MSGTYPE_DEAD_RECKONING_COMPACT);
+
+uint8_t psDRCompactMessage::GetCompactFlags(const psDRQuantized &state, const psDRQuantized &base)
+{
+    uint8_t flags = 0;
+    bool wide = false;
+    if(state.mode != base.mode)
+        flags |= MODE;
+    if(state.yrot != base.yrot)
+        flags |= YROT;
+    if(state.angVel != base.angVel)
+    {
+        flags |= ANG_VELOCITY;
+        wide |= !IsNarrow(state.angVel);
+    }
+    if(state.vel[0] != base.vel[0] || state.vel[1] != base.vel[1] || state.vel[2] != base.vel[2])
+    {
+        flags |= VELOCITY;
+        wide |= !IsNarrow(state.vel[0]) || !IsNarrow(state.vel[1]) || !IsNarrow(state.vel[2]);
+    }
+    if(state.worldVel[0] != base.worldVel[0] || state.worldVel[1] != base.worldVel[1] ||
+       state.worldVel[2] != base.worldVel[2])
+    {
+        flags |= WORLDVEL;
+        wide |= !IsNarrow(state.worldVel[0]) || !IsNarrow(state.worldVel[1]) || !IsNarrow(state.worldVel[2]);
+    }
+    if(state.offset[0] || state.offset[1] || state.offset[2])
+        flags |= POSITION;
+    if(wide)
+        flags |= WIDE;
+    return flags;
+}
+
+static void AddVelocity(MsgEntry* msg, int16_t v, bool wide)
+{
+    if(wide)
+        msg->Add(v);
+    else
+        msg->Add((int8_t)(v / DR_VELOCITY_NARROW));
+}
+
+static int16_t GetVelocity(MsgEntry* me, bool wide)
+{
+    return wide ? me->GetInt16() : (int16_t)(me->GetInt8() * DR_VELOCITY_NARROW);
+}
+
+void psDRCompactMessage::AddFields(uint8_t flags, const psDRQuantized &state)
+{
+    bool wide = (flags & WIDE) != 0;
+    if(flags & MODE)
+        msg->Add(state.mode);
+    if(flags & YROT)
+        msg->Add(state.yrot);
+    if(flags & ANG_VELOCITY)
+        AddVelocity(msg, state.angVel, wide);
+    for(int i = 0; i < 3 && (flags & VELOCITY); i++)
+        AddVelocity(msg, state.vel[i], wide);
+    for(int i = 0; i < 3 && (flags & WORLDVEL); i++)
+        AddVelocity(msg, state.worldVel[i], wide);
+}
+
+void psDRCompactMessage::ReadFields(MsgEntry* me, uint8_t flags, psDRQuantized &state)
+{
+    bool wide = (flags & WIDE) != 0;
+    if(flags & MODE)
+        state.mode = me->GetUInt8();
+    if(flags & YROT)
+        state.yrot = me->GetUInt8();
+    if(flags & ANG_VELOCITY)
+        state.angVel = GetVelocity(me, wide);
+    for(int i = 0; i < 3 && (flags & VELOCITY); i++)
+        state.vel[i] = GetVelocity(me, wide);
+    for(int i = 0; i < 3 && (flags & WORLDVEL); i++)
+        state.worldVel[i] = GetVelocity(me, wide);
+}
+
+psDRCompactMessage::psDRCompactMessage(uint32_t client, EID mappedid, uint8_t counter,
+                                       const psDREncoder &encoder, bool keyframe,
+                                       NetBase::AccessPointers* accessPointers)
+{
+    const psDRKeyframe &key = encoder.GetKeyframe();
+    const psDRQuantized &state = encoder.GetCurrent();
+    csStringID sectorNameStrId = keyframe ? accessPointers->Request(key.sectorName) : csInvalidStringID;
+    size_t sectorNameLen = (keyframe && sectorNameStrId == csInvalidStringID) ? key.sectorName.Length() : 0;
+
+    // Header, the keyframe with its origin and sector, and a delta of all fields.
+    msg.AttachNew(new MsgEntry(sizeof(uint32_t) + 3*sizeof(uint8_t) +
+                               sizeof(uint8_t) + 16 + 3*sizeof(float) + sizeof(uint32_t) + sectorNameLen+1 +
+                               16 + 3*sizeof(int16_t)));
+    msg->SetType(MSGTYPE_DEAD_RECKONING_COMPACT);
+    msg->clientnum = client;
+
+    msg->Add(mappedid.Unbox());
+    msg->Add(counter);
+    msg->Add(key.id);
+
+    psDRQuantized zero;
+    memset(&zero, 0, sizeof(zero));
+    zero.mode = DR_ON_GROUND_BIT;
+
+    uint8_t flags = GetCompactFlags(state, key.state);
+    if(keyframe)
+        flags |= KEYFRAME;
+    msg->Add(flags);
+
+    if(keyframe)
+    {
+        uint8_t keyflags = GetCompactFlags(key.state, zero);
+        msg->Add(keyflags);
+        AddFields(keyflags, key.state);
+
+        msg->Add(key.origin.x);
+        msg->Add(key.origin.y);
+        msg->Add(key.origin.z);
+        msg->Add((uint32_t) sectorNameStrId);
+        if(sectorNameStrId == csInvalidStringID)
+            msg->Add(key.sectorName);
+    }
+
+    AddFields(flags, state);
+    for(int i = 0; i < 3 && (flags & POSITION); i++)
+        msg->Add(state.offset[i]);
+
+    msg->ClipToCurrentSize();
+
+    // Sets valid flag based on message overrun state
+    valid=!(msg->overrun);
+
+    isKeyframe = keyframe;
+    keyframeID = key.id;
+    entityid = mappedid;
+    this->counter = counter;
+}
+
+psDRCompactMessage::psDRCompactMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers, psDRKeyframe &keyframe)
+{
+    ReadCompact(me, accessPointers, keyframe);
+}
+
+psDRCompactMessage::psDRCompactMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers)
+{
+    psDRKeyframe keyframe;
+    ReadCompact(me, accessPointers, keyframe);
+}
+
+void psDRCompactMessage::ReadCompact(MsgEntry* me, NetBase::AccessPointers* accessPointers, psDRKeyframe &keyframe)
+{
+    entityid = me->GetUInt32();
+    filterNumber = entityid.Unbox(); // Set the filter number to be used when filtering this in console output
+    counter = me->GetUInt8();
+    keyframeID = me->GetUInt8();
+    uint8_t flags = me->GetUInt8();
+    isKeyframe = (flags & KEYFRAME) != 0;
+
+    psDRKeyframe received;
+    const psDRKeyframe* key = &keyframe;
+    if(isKeyframe)
+    {
+        received.id = keyframeID;
+        received.valid = true;
+        memset(&received.state, 0, sizeof(received.state));
+        received.state.mode = DR_ON_GROUND_BIT;
+        ReadFields(me, me->GetUInt8(), received.state);
+
+        received.origin.x = me->GetFloat();
+        received.origin.y = me->GetFloat();
+        received.origin.z = me->GetFloat();
+
+        csStringID sectorNameStrId = (csStringID)me->GetUInt32();
+        received.sectorName = (sectorNameStrId != csInvalidStringID) ? accessPointers->Request(sectorNameStrId) : me->GetStr();
+        received.sector = (received.sectorName.Length() && accessPointers->engine) ?
+                          accessPointers->engine->GetSectors()->FindByName(received.sectorName) : NULL;
+
+        // Reliable messages can overtake each other, keep the newest keyframe.
+        if(!me->overrun && (!keyframe.valid || (uint8_t)(keyframeID - keyframe.id) <= 127))
+            keyframe = received;
+        key = &received;
+    }
+
+    psDRQuantized state = key->state;
+    ReadFields(me, flags, state);
+    for(int i = 0; i < 3; i++)
+        state.offset[i] = (flags & POSITION) ? me->GetInt16() : 0;
+
+    mode = state.mode & ~DR_ON_GROUND_BIT;
+    on_ground = (state.mode & DR_ON_GROUND_BIT) != 0;
+    yrot = (int8_t)state.yrot;
+    yrot *= TWO_PI/256;
+    ang_vel = DequantizeVelocity(state.angVel);
+    vel = csVector3(DequantizeVelocity(state.vel[0]), DequantizeVelocity(state.vel[1]),
+                    DequantizeVelocity(state.vel[2]));
+    worldVel = csVector3(DequantizeVelocity(state.worldVel[0]), DequantizeVelocity(state.worldVel[1]),
+                         DequantizeVelocity(state.worldVel[2]));
+    pos = key->origin + csVector3(state.offset[0], state.offset[1], state.offset[2]) / DR_POSITION_SCALE;
+    sectorName = key->sectorName;
+    sector = key->sector;
+    // The sector may have been loaded since the keyframe came.
+    if(!sector && sectorName.Length() && accessPointers->engine)
+        sector = accessPointers->engine->GetSectors()->FindByName(sectorName);
+
+    // Sets valid flag based on message overrun state, a delta also needs its keyframe
+    valid = !(me->overrun) && key->valid && key->id == keyframeID;
+}
+
+csString psDRCompactMessage::ToString(NetBase::AccessPointers* /*accessPointers*/)
+{
+    csString msgtext;
+
+    msgtext.AppendFmt("EID: %d C: %d ",entityid.Unbox(),counter);
+    msgtext.AppendFmt("%s %u ", isKeyframe ? "Keyframe" : "Delta", keyframeID);
+    if(valid)
+    {
+        msgtext.AppendFmt("Sector: %s ",sectorName.GetDataSafe());
+        msgtext.AppendFmt("Pos(%.2f,%.2f,%.2f) ",pos.x,pos.y,pos.z);
+    }
+
+#ifdef FULL_DEBUG_DUMP
+    msgtext.AppendFmt("Vel(%.2f,%.2f,%.2f) ",vel.x,vel.y,vel.z);
+    msgtext.AppendFmt("WVel(%.2f,%.2f,%.2f) ",worldVel.x,worldVel.y,worldVel.z);
+    if(on_ground)
+        msgtext.Append("OnGround ");
+    else
+        msgtext.Append("Flying ");
+    msgtext.AppendFmt("yrot: %.2f ",yrot);
+    msgtext.AppendFmt("ang_vel: %.2f ",ang_vel);
+#endif
+
+    return msgtext;
+}
@@ -0,0 +1,234 @@
+/*
+ * drmessages.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef PS_DR_MESSAGES_H
+#define PS_DR_MESSAGES_H
+
+#include <csutil/hash.h>
+#include "net/messages.h"
+
+/**
+ * \addtogroup messages
+ * @{ */
+
+/// Steps per unit of the position offsets of psDRCompactMessage.
+#define DR_POSITION_SCALE 64.0f
+/// Steps per unit per second of the velocities of psDRCompactMessage.
+#define DR_VELOCITY_SCALE 256.0f
+/// Velocities that are a multiple of this many steps are sent in one byte per axis.
+#define DR_VELOCITY_NARROW 16
+/// Most deltas a client gets in a row before the keyframe is sent to it again.
+#define DR_KEYFRAME_INTERVAL 32
+
+/**
+ * One dead reckoning update as the server sends it, before it is put in a
+ * message. Also the line format of recorded DR traffic.
+ */
+struct psDRUpdate
+{
+    bool on_ground;
+    uint8_t mode;
+    csVector3 pos;
+    float yrot;
+    iSector* sector;
+    csString sectorName;
+    csVector3 vel;
+    csVector3 worldVel;
+    float ang_vel;
+
+    psDRUpdate() : on_ground(true), mode(0), pos(0), yrot(0), sector(NULL), vel(0), worldVel(0), ang_vel(0) {}
+
+    /// One line of a recording, without the newline.
+    csString Record(csTicks ticks, EID eid, uint8_t counter) const;
+
+    /// Read a line written by Record. The sector is only known by name.
+    bool Parse(const char* line, csTicks &ticks, EID &eid, uint8_t &counter);
+};
+
+/**
+ * A dead reckoning update quantized for psDRCompactMessage. Two updates with
+ * equal quantized fields are sent the same way.
+ */
+struct psDRQuantized
+{
+    uint8_t mode;          ///< Mode, with the on ground bit
+    uint8_t yrot;          ///< Rotation around Y in 1/256 of a turn
+    int16_t angVel;        ///< Angular velocity in 1/DR_VELOCITY_SCALE radians per second
+    int16_t vel[3];        ///< Body velocity in 1/DR_VELOCITY_SCALE units per second
+    int16_t worldVel[3];   ///< World velocity in 1/DR_VELOCITY_SCALE units per second
+    int16_t offset[3];     ///< Position relative to the keyframe origin, in 1/DR_POSITION_SCALE units
+
+    /// True if everything but the position is the same.
+    bool SameMotion(const psDRQuantized &other) const;
+};
+
+/**
+ * The update the deltas of an entity are coded against. The server keeps
+ * the current one, every client the last one it got.
+ */
+struct psDRKeyframe
+{
+    uint8_t id;            ///< Wraps around like the DR counter
+    bool valid;
+    csVector3 origin;      ///< Where in the sector the position offsets start
+    iSector* sector;
+    csString sectorName;
+    psDRQuantized state;   ///< Offset is always zero
+
+    psDRKeyframe() : id(0), valid(false), origin(0), sector(NULL) {}
+};
+
+/**
+ * Quantizes and delta codes the DR updates of one entity, and remembers
+ * which clients were sent its current keyframe.
+ *
+ * A new keyframe is started when the entity changes sector, moves out of
+ * range of the offsets, or when it has settled into a motion the keyframe
+ * doesn't describe, so the deltas that follow only carry the position.
+ * Clients that weren't sent the current keyframe get it in full, all others
+ * get a delta, which mostly is an offset in three 16 bit values.
+ *
+ * Clients don't acknowledge keyframes. A client that doesn't have the one a
+ * delta is coded against drops the delta, so every client is sent the
+ * keyframe again after DR_KEYFRAME_INTERVAL deltas. That bounds how long it
+ * goes without updates.
+ */
+class psDREncoder
+{
+public:
+    psDREncoder();
+
+    /**
+     * Quantize the next update.
+     *
+     * @return true if it starts a new keyframe.
+     */
+    bool Update(const psDRUpdate &update);
+
+    const psDRKeyframe &GetKeyframe() const
+    {
+        return keyframe;
+    }
+    const psDRQuantized &GetCurrent() const
+    {
+        return current;
+    }
+
+    /**
+     * Returns true if the client has to get the keyframe with this update,
+     * because it wasn't sent the current one yet or got DR_KEYFRAME_INTERVAL
+     * deltas since. Clients that are neither asked nor kept with an update
+     * are forgotten.
+     */
+    bool NeedsKeyframe(uint32_t client);
+
+    /// The client skips this update, but keeps the keyframe it has.
+    void Keep(uint32_t client);
+
+    /// Send the keyframe to the client with the next update.
+    void Forget(uint32_t client);
+
+private:
+    psDRKeyframe keyframe;
+    psDRQuantized current;
+    psDRQuantized last;
+
+    /// What a client was sent.
+    struct Receiver
+    {
+        uint8_t keyframe;   ///< Id of the last keyframe
+        uint8_t deltas;     ///< Deltas since then
+    };
+
+    /// Clients and what they were sent, by update. Swapped with each update.
+    csHash<Receiver, uint32_t> receivers[2];
+    size_t active;
+};
+
+/**
+ * Compact form of psDRMessage, for clients that announced NETCAP_COMPACT_DR.
+ *
+ * A keyframe carries the position in full together with the sector. All
+ * other updates of the entity are deltas: the position is an offset from
+ * the keyframe origin in 1/64 units and only the fields that differ from the
+ * keyframe are sent. Velocities are sent in 1/16 units per second in one
+ * byte per axis, or in two bytes when they are 8 units per second or more.
+ */
+class psDRCompactMessage : public psDRMessage
+{
+public:
+    /**
+     * Write the current update of an encoder.
+     *
+     * @param keyframe Send the keyframe instead of a delta.
+     */
+    psDRCompactMessage(uint32_t client, EID mappedid, uint8_t counter,
+                       const psDREncoder &encoder, bool keyframe,
+                       NetBase::AccessPointers* accessPointers);
+
+    /**
+     * Read an update. A keyframe replaces the given one, a delta is decoded
+     * against it. Deltas against another keyframe are not valid.
+     */
+    psDRCompactMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers, psDRKeyframe &keyframe);
+
+    /// Read an update without knowing the keyframe, as for logging.
+    psDRCompactMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers);
+
+    PSF_DECLARE_MSG_FACTORY();
+
+    /**
+     *  Converts the message into human readable string.
+     *
+     * @param accessPointers A struct to a number of access pointers.
+     * @return Return a human readable string for the message.
+     */
+    virtual csString ToString(NetBase::AccessPointers* accessPointers);
+
+    bool isKeyframe;        ///< Whether this is a keyframe or a delta
+    uint8_t keyframeID;     ///< The keyframe or the one the delta is against
+
+protected:
+    /// What a compact update carries.
+    enum CompactFlags
+    {
+        KEYFRAME     = 1 << 0,
+        MODE         = 1 << 1,
+        YROT         = 1 << 2,
+        ANG_VELOCITY = 1 << 3,
+        VELOCITY     = 1 << 4,
+        WORLDVEL     = 1 << 5,
+        POSITION     = 1 << 6,
+        WIDE         = 1 << 7  ///< Velocities take two bytes per axis
+    };
+
+    /// Which fields of state differ from base, and whether they need two bytes.
+    static uint8_t GetCompactFlags(const psDRQuantized &state, const psDRQuantized &base);
+
+    /// Write the fields of state flags asks for.
+    void AddFields(uint8_t flags, const psDRQuantized &state);
+
+    /// Read the fields flags says are there into state.
+    static void ReadFields(MsgEntry* me, uint8_t flags, psDRQuantized &state);
+
+    void ReadCompact(MsgEntry* me, NetBase::AccessPointers* accessPointers, psDRKeyframe &keyframe);
+};
+
+/** @} */
+
+#endif
@@ -154,7 +154,8 @@ csString psPreAuthenticationMessage::ToString(NetBase::AccessPointers* /*accessP
 PSF_IMPLEMENT_MSG_FACTORY(psAuthenticationMessage,MSGTYPE_AUTHENTICATE);
 
 psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
-        const char* userid,const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* password256, uint32_t version)
+        const char* userid,const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* password256, uint32_t version,
+        uint32_t capabilities)
 {
 
     if(!userid || !password)
@@ -164,7 +165,7 @@ psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
     }
 
 
-    msg.AttachNew(new MsgEntry(strlen(userid)+1+strlen(password)+1+strlen(os)+1+strlen(gfxcard)+1+strlen(gfxversion)+1+strlen(password256)+1+sizeof(uint32_t),PRIORITY_LOW));
+    msg.AttachNew(new MsgEntry(strlen(userid)+1+strlen(password)+1+strlen(os)+1+strlen(gfxcard)+1+strlen(gfxversion)+1+strlen(password256)+1+2*sizeof(uint32_t),PRIORITY_LOW));
 
     msg->SetType(MSGTYPE_AUTHENTICATE);
     msg->clientnum      = clientnum;
@@ -176,6 +177,7 @@ psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
     msg->Add(gfxcard);
     msg->Add(gfxversion);
     msg->Add(password256);
+    msg->Add(capabilities);
 
     // Sets valid flag based on message overrun state
     valid=!(msg->overrun);
@@ -196,6 +198,8 @@ psAuthenticationMessage::psAuthenticationMessage(MsgEntry* message)
     {
         sPassword256 = message->GetStr();
     }
+    // Older clients end here.
+    capabilities = message->IsEmpty() ? 0 : message->GetUInt32();
 
     // Sets valid flag based on message overrun state
     valid=!(message->overrun);
@@ -58,6 +58,19 @@ class csStringHashReversible;
 // no inadvertent overlaps.
 #define PS_NPCNETVERSION 0x1034
 
+/**
+ * Optional parts of the protocol a client announces when it authenticates.
+ * Clients that don't announce them still get the old messages, so these
+ * don't need a PS_NETVERSION change.
+ */
+enum NetCapabilities
+{
+    NETCAP_COMPACT_DR = 1 << 0  ///< Understands psDRCompactMessage
+};
+
+/// What this build of the client understands.
+#define PS_NETCAPABILITIES NETCAP_COMPACT_DR
+
 enum Slot_Containers
 {
     CONTAINER_INVENTORY_BULK      = -1,
@@ -292,7 +305,8 @@ enum MSG_TYPES
 
     MSGTYPE_ATTACK_QUEUE,
     MSGTYPE_ATTACK_BOOK,
-    MSGTYPE_SPECCOMBATEVENT
+    MSGTYPE_SPECCOMBATEVENT,
+    MSGTYPE_DEAD_RECKONING_COMPACT
 };
 
 class psMessageCracker;
@@ -588,6 +602,7 @@ class psAuthenticationMessage : public psMessageCracker
 {
 public:
     uint32_t  netversion;
+    uint32_t  capabilities;   ///< NetCapabilities of the client, 0 for older clients
     csString  sAddr;
     csString  sUser,sPassword;
     csString  sPassword256;
@@ -599,7 +614,8 @@ public:
      * creation when a user wants to log in.
      */
     psAuthenticationMessage(uint32_t clientnum,const char* userid,
-                            const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* sPassword256 = "", uint32_t version=PS_NETVERSION);
+                            const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* sPassword256 = "", uint32_t version=PS_NETVERSION,
+                            uint32_t capabilities=PS_NETCAPABILITIES);
 
     /**
      * This constructor receives a PS Message struct and cracks it apart
@@ -16,22 +16,47 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 #include <psconfig.h>
+#include <stdlib.h>
+#include <typeinfo>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+#include <csutil/sysfunc.h>
 
 #include "net/message.h"
 #include "net/messages.h"
 #include "net/netbase.h"
 #include "net/msghandler.h"
-#include "csutil/scopedlock.h"
 
 #include "net/subscriber.h"
 #include "util/psconst.h"
+#include "util/psprofile.h"
 
 class Client;
 
+/// The class name of a subscriber, for the profiles.
+static csString SubscriberName(iNetSubscriber* subscriber)
+{
+    const char* name = typeid(*subscriber).name();
+#ifdef __GNUC__
+    // GCC and clang give mangled names.
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+    if(demangled)
+    {
+        csString result(demangled);
+        free(demangled);
+        return result;
+    }
+#endif
+    return name;
+}
+
 MsgHandler::MsgHandler()
 {
     netbase = NULL;
     queue   = NULL;
+    slowestHandler = NULL;
 }
 
 MsgHandler::~MsgHandler()
@@ -54,66 +79,70 @@ bool MsgHandler::Initialize(NetBase* nb, int queuelen)
 
 void MsgHandler::Publish(MsgEntry* me)
 {
-    const int mtype = me->GetType();
-    bool handled = false;
+    const msgtype mtype = me->GetType();
     netbase->LogMessages('R',me);
 
-    csArray<Subscription> handlers;
-    {
-        CS::Threading::ScopedReadLock lock(mutex);
-        handlers = subscribers.GetAll(mtype);
-    }
+    DispatchTable<Subscription>::Snapshot handlers(subscribers, mtype);
 
+    // Handlers may publish messages themselves, so the slowest is only
+    // stored once all are done.
+    psOperProfile* slowestProfile = NULL;
+    csTicks slowest = 0;
     for(size_t i = 0; i < handlers.GetSize(); ++i)
     {
-        Subscription& sub = handlers[i];
+        const Subscription& sub = handlers[i];
         Client *client;
         me->Reset();
         // Copy the reference so we can modify it in the loop
         MsgEntry *message = me;
+        csTicks start = csGetTicks();
         if(sub.subscriber->Verify(message, sub.flags, client))
         {
             sub.subscriber->HandleMessage(message, client);
         }
-        handled = true;
+
+        csTicks taken = csGetTicks() - start;
+        if(sub.profile)
+            sub.profile->AddConsumption(taken);
+        if(!slowestProfile || taken > slowest)
+        {
+            slowestProfile = sub.profile;
+            slowest = taken;
+        }
     }
+    slowestHandler = slowestProfile;
 
-    if (!handled)
+    if (!handlers.GetSize())
     {
         Debug4(LOG_ANY,me->clientnum,"Unhandled message received 0x%04X(%d) from %d",
                me->GetType(), me->GetType(), me->clientnum);
     }
 }
 
+const char* MsgHandler::GetSlowestHandler() const
+{
+    return slowestHandler ? slowestHandler->GetDesc() : NULL;
+}
+
 void MsgHandler::Subscribe(iNetSubscriber* subscriber, msgtype type, uint32_t flags)
 {
     CS_ASSERT(subscriber);
 
-    CS::Threading::ScopedWriteLock lock(mutex);
-    subscribers.Delete(type, subscriber);
-    subscribers.Put(type, Subscription(subscriber, flags));
+    Subscription sub(subscriber, flags);
+    if(netbase)
+    {
+        // Profiles are found by name, so they are kept when a subscriber comes back.
+        sub.profile = netbase->GetProfs()->GetHandlerProfile(type, SubscriberName(subscriber));
+    }
+    subscribers.Put(type, sub);
 }
 
 bool MsgHandler::Unsubscribe(iNetSubscriber* subscriber, msgtype type)
 {
-    CS::Threading::ScopedWriteLock lock(mutex);
-    return subscribers.Delete(type, subscriber);
+    return subscribers.Delete(type, Subscription(subscriber));
 }
 
 bool MsgHandler::UnsubscribeAll(iNetSubscriber *subscriber)
 {
-    CS::Threading::ScopedWriteLock lock(mutex);
-    bool found = false;
-
-    csHash<Subscription, msgtype>::GlobalIterator iter = subscribers.GetIterator();
-    while(iter.HasNext())
-    {
-        if(iter.Next().subscriber == subscriber)
-        {
-            subscribers.DeleteElement(iter);
-            found = true;
-        }
-    }
-    return found;
+    return subscribers.DeleteAll(Subscription(subscriber));
 }
-
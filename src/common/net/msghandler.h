@@ -22,15 +22,16 @@
 #include <csutil/parray.h>
 #include <csutil/refcount.h>
 #include <csutil/threading/thread.h>
-#include <csutil/threading/rwmutex.h>
 
 #include "net/message.h"
 #include "net/netbase.h"
+#include "util/dispatchtable.h"
 
 // forward decls
 struct iNetSubscriber;
 class NetBase;
 class Client;
+class psOperProfile;
 
 /**
  * \addtogroup common_net
@@ -48,6 +49,7 @@ struct Subscription
 {
     uint32_t flags; /**< Additional flags for detecting if the subscriber should be notified */
     iNetSubscriber* subscriber; /**< The actual subscriber that wants to be notified */
+    psOperProfile* profile; /**< Time the subscriber takes for the message type, may be NULL */
 
     /**
      * Constructor without a callback
@@ -56,10 +58,16 @@ struct Subscription
      * @param nFlags      Sets \ref flags
      */
     Subscription(iNetSubscriber *nSubscriber, uint32_t nFlags = 0x01/*REQUIRE_READY_CLIENT*/)
-        : flags(nFlags), subscriber(nSubscriber)
+        : flags(nFlags), subscriber(nSubscriber), profile(NULL)
     {
     }
 
+    // a subscriber is subscribed once per message type
+    bool operator==(const Subscription& other) const
+    {
+        return subscriber == other.subscriber;
+    }
+
     // comparison operator required for usage in csHash
     bool operator<(const Subscription& other) const
     {
@@ -143,9 +151,21 @@ public:
      */
     virtual bool UnsubscribeAll(iNetSubscriber *subscriber);
 
-    /// Distribute message to all subscribers
+    /**
+     * Distribute message to all subscribers.
+     *
+     * Reads the subscribers from a snapshot of the dispatch table, without
+     * locking or copying, so subscribers may subscribe and unsubscribe
+     * while they handle the message.
+     */
     void Publish(MsgEntry *msg);
 
+    /**
+     * The subscriber that took the longest for the last published message,
+     * as "MESSAGE_TYPE-Subscriber". NULL if there was none.
+     */
+    const char* GetSlowestHandler() const;
+
     /// import the broadcasttype
     typedef NetBase::broadcasttype broadcasttype;
 
@@ -188,10 +208,12 @@ protected:
     MsgQueue                      *queue;
 
     /** 
-     * @brief Stores the hash of all subscribers and the message type they are subscribed to
+     * @brief Stores the subscribers of each message type
      */
-    csHash<Subscription, msgtype> subscribers;
-    CS::Threading::ReadWriteMutex mutex; /**< @brief Protects \ref subscribers */
+    DispatchTable<Subscription> subscribers;
+
+    /// The profile of the slowest subscriber of the last published message.
+    psOperProfile *slowestHandler;
 };
 
 /** @} */
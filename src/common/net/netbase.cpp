@@ -94,7 +94,7 @@ csStringID NetBase::AccessPointers::Request( const char* string) const
 
 
 NetBase::NetBase(int outqueuesize)
-: senders(outqueuesize)
+: senders(outqueuesize), resendWheel(csGetTicks())
 {
     randomgen = new csRandomGen;
     
@@ -114,6 +114,11 @@ NetBase::NetBase(int outqueuesize)
     totaltransferin   = 0;
     totalcountin      = 0;
     totalcountout     = 0;
+    syscallsin        = 0;
+    syscallsout       = 0;
+    payloadStats.copiedBytes = 0;
+    payloadStats.copies      = 0;
+    payloadStats.sharedBytes = 0;
     
     profs = new psNetMsgProfiles();
     
@@ -131,6 +136,10 @@ NetBase::NetBase(int outqueuesize)
     logmsgfiltersetting.send = false;
 
     input_buffer = NULL;
+#ifdef SOCK_HAVE_MMSG
+    recvBatch = NULL;
+    sendBatch = NULL;
+#endif
     for(int i=0;i < NETAVGCOUNT;i++)
     {
         sendStats[i].senders = sendStats[i].messages = sendStats[i].time = 0;
@@ -163,6 +172,72 @@ NetBase::~NetBase()
 
     if (input_buffer)
         cs_free(input_buffer);
+
+#ifdef SOCK_HAVE_MMSG
+    delete recvBatch;
+    delete sendBatch;
+#endif
+}
+
+#ifdef SOCK_HAVE_MMSG
+NetBase::DatagramBatch::DatagramBatch(size_t size)
+: size(size), count(0), next(0)
+{
+    msgs = new struct mmsghdr[size];
+    iov = new struct iovec[size];
+    addrs = new SOCKADDR_IN[size];
+    buffers = new char*[size];
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * size);
+    for (size_t i = 0; i < size; i++)
+    {
+        buffers[i] = NULL;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        iov[i].iov_base = NULL;
+        iov[i].iov_len = MAXPACKETSIZE;
+    }
+}
+
+NetBase::DatagramBatch::~DatagramBatch()
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (buffers[i])
+            cs_free(buffers[i]);
+    }
+    delete[] buffers;
+    delete[] addrs;
+    delete[] iov;
+    delete[] msgs;
+}
+#endif
+
+bool NetBase::SetBatchedIO(size_t batchSize)
+{
+#ifdef SOCK_HAVE_MMSG
+    delete recvBatch;
+    delete sendBatch;
+    recvBatch = NULL;
+    sendBatch = NULL;
+
+    if (batchSize)
+    {
+        recvBatch = new DatagramBatch(batchSize);
+        sendBatch = new DatagramBatch(batchSize);
+
+        // The receive buffers are handed to the packets, these stay.
+        for (size_t i = 0; i < batchSize; i++)
+        {
+            sendBatch->buffers[i] = (char*) cs_malloc(MAXPACKETSIZE);
+        }
+    }
+    return true;
+#else
+    return batchSize == 0;
+#endif
 }
 
 
@@ -193,6 +268,11 @@ void NetBase::ProcessNetwork (csTicks timeout)
 
 bool NetBase::CheckIn()
 {    
+#ifdef SOCK_HAVE_MMSG
+    if (recvBatch)
+        return CheckInBatched();
+#endif
+
     // check for incoming packets
     SOCKADDR_IN addr;
     memset (&addr, 0, sizeof(SOCKADDR_IN));
@@ -218,11 +298,70 @@ bool NetBase::CheckIn()
     {
         return false;
     }
+    return HandleDatagram(input_buffer, packetlen, addr);
+}
+
+
+#ifdef SOCK_HAVE_MMSG
+bool NetBase::CheckInBatched()
+{
+    CS_ASSERT(ready);
+
+    if (recvBatch->next == recvBatch->count)
+    {
+        // Replace the buffers that packets took over by the last batch.
+        for (size_t i = 0; i < recvBatch->size; i++)
+        {
+            if (!recvBatch->buffers[i])
+            {
+                recvBatch->buffers[i] = (char*) cs_malloc(MAXPACKETSIZE);
+                if (!recvBatch->buffers[i])
+                {
+                    Error2("Failed to cs_malloc %d bytes for packet buffer!\n",MAXPACKETSIZE);
+                    return false;
+                }
+            }
+            recvBatch->iov[i].iov_base = recvBatch->buffers[i];
+            recvBatch->msgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+        }
+
+        if (!WaitForInput())
+            return false;
+
+        // Take what is there, without waiting for the batch to fill.
+        int received = SOCK_RECVMMSG(mysocket, recvBatch->msgs, recvBatch->size, MSG_DONTWAIT);
+        syscallsin++;
+        if (received <= 0)
+            return false;
+
+        recvBatch->count = received;
+        recvBatch->next = 0;
+        for (int i = 0; i < received; i++)
+        {
+            totaltransferin += recvBatch->msgs[i].msg_len;
+        }
+        totalcountin += received;
+    }
+
+    size_t i = recvBatch->next++;
+    HandleDatagram(recvBatch->buffers[i], recvBatch->msgs[i].msg_len, recvBatch->addrs[i]);
+
+    // The acks for the whole batch go out together.
+    if (recvBatch->next == recvBatch->count)
+        FlushSendBatch();
+
+    return true;
+}
+#endif
+
+
+bool NetBase::HandleDatagram(char* &buffer, int packetlen, SOCKADDR_IN &addr)
+{
     // Identify the connection
     Connection* connection = GetConnByIP(&addr);
 
     // Extract the netpacket from the buffer and prep for use locally.
-    psNetPacket *bufpacket = psNetPacket::NetPacketFromBuffer(input_buffer,packetlen);
+    psNetPacket *bufpacket = psNetPacket::NetPacketFromBuffer(buffer,packetlen);
     if (bufpacket==NULL)
     {
 
@@ -260,7 +399,7 @@ bool NetBase::CheckIn()
         }
         return true; // Continue processing more packets if available
     }
-    input_buffer = NULL; //input_buffer now hold by the bufpacket pointer.
+    buffer = NULL; //buffer now hold by the bufpacket pointer.
 
     // Endian correction
     bufpacket->UnmarshallEndian();
@@ -452,7 +591,7 @@ bool NetBase::HandleAck(psNetPacketEntry* pkt, Connection* connection,
             // printf ("Ping time: %i, average: %i\n", elapsed, netInfos.GetAveragePingTicks());
 
 
-            if (!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), ack))
+            if (!RemoveAwaitingAck(ack))
             {
 #ifdef PACKETDEBUG
                 Debug2(LOG_NET,0,"No packet in ack queue :%d\n", ack->packet->pktid);
@@ -490,7 +629,7 @@ bool NetBase::HandleAck(psNetPacketEntry* pkt, Connection* connection,
                     pkt->packet->msgsize,
                     PKTSIZE_ACK,(char *)NULL));
             
-            SendFinalPacket(ack, addr);
+            SendFinalPacket(ack, addr, true);
             // ack should be unre'd here
         }
     }
@@ -528,22 +667,13 @@ bool NetBase::CheckDoublePackets(Connection* connection, psNetPacketEntry* pkt)
 
 void NetBase::CheckResendPkts()
 {
-    // NOTE: Globaliterators on csHash do not retrieve keys contiguously.
-    csHash<csRef<psNetPacketEntry> , PacketKey>::GlobalIterator it(awaitingack.GetIterator());
     csRef<psNetPacketEntry> pkt;
     csArray<csRef<psNetPacketEntry> > pkts;
-    csArray<Connection*> resentConnections;
 
     csTicks currenttime = csGetTicks();
     unsigned int resentCount = 0;
 
-    while(it.HasNext())
-    {
-        pkt = it.Next();
-        // Check the connection packet timeout
-        if (pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO) < currenttime)
-            pkts.Push(pkt);
-    }
+    GetExpiredPackets(currenttime, pkts);
     for (size_t i = 0; i < pkts.GetSize(); i++)
     {
         pkt = pkts.Get(i);
@@ -553,9 +683,6 @@ void NetBase::CheckResendPkts()
         Connection* connection = GetConnByNum(pkt->clientnum);
         if (connection)
         {
-            if (resentConnections.Find(connection) == csArrayItemNotFound)
-                resentConnections.Push(connection);
-
             // This indicates a bug in the netcode.
             if (pkt->RTO == 0)
             {
@@ -577,7 +704,7 @@ void NetBase::CheckResendPkts()
             //printf("pkt=%p, pkt->packet=%p\n",pkt,pkt->packet);
             // take out of awaiting ack pool.
             // This does NOT delete the pkt mem block itself.
-            if (!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt))
+            if (!RemoveAwaitingAck(pkt))
             {
 #ifdef PACKETDEBUG
                 Debug2(LOG_NET,0,"No packet in ack queue :%d\n", pkt->packet->pktid);
@@ -588,6 +715,11 @@ void NetBase::CheckResendPkts()
                 connection->RemoveFromWindow(pkt->packet->GetPacketSize());
             }
         }
+        else
+        {
+            // Try again once the new timeout expired.
+            ScheduleResend(pkt);
+        }
     }
 
     if(resentCount > 0)
@@ -623,6 +755,53 @@ void NetBase::CheckResendPkts()
 }
     
 
+void NetBase::AddAwaitingAck(psNetPacketEntry* pkt)
+{
+    awaitingack.Put(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+    ScheduleResend(pkt);
+}
+
+bool NetBase::RemoveAwaitingAck(psNetPacketEntry* pkt)
+{
+    // Out of the wheel first, the hash may hold the last reference.
+    if (TimingWheel<psNetPacketEntry>::Contains(pkt))
+    {
+        resendWheel.Remove(pkt);
+    }
+
+    return awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+}
+
+void NetBase::ScheduleResend(psNetPacketEntry* pkt)
+{
+    if (TimingWheel<psNetPacketEntry>::Contains(pkt))
+    {
+        resendWheel.Remove(pkt);
+    }
+
+    // The packet is resent once the time is past its timeout.
+    pkt->triggerticks = pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO) + 1;
+    resendWheel.Insert(pkt);
+}
+
+void NetBase::GetExpiredPackets(csTicks now, csArray<csRef<psNetPacketEntry> > &pkts)
+{
+    // The wheel doesn't hold references, awaitingack keeps the packets alive.
+    psNetPacketEntry* pkt;
+    while ((pkt = resendWheel.DeleteDue(now)) != NULL)
+    {
+        pkts.Push(pkt);
+    }
+}
+
+void NetBase::ClearAwaitingAck()
+{
+    while (resendWheel.DeleteAny())
+        ;
+    awaitingack.Empty();
+}
+
+
 bool NetBase::SendMergedPackets(NetPacketQueue *q)
 {
     csRef<psNetPacketEntry> queueget;
@@ -683,7 +862,7 @@ bool NetBase::SendMergedPackets(NetPacketQueue *q)
 
 bool NetBase::SendSinglePacket(psNetPacketEntry* pkt)
 {
-    if (!SendFinalPacket (pkt))
+    if (!SendFinalPacket (pkt, true))
     {
         return false;
     }
@@ -707,7 +886,7 @@ bool NetBase::SendSinglePacket(psNetPacketEntry* pkt)
             connection->sends++;
             // Set timeout for resending.
             pkt->RTO = connection->RTO;
-            awaitingack.Put(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+            AddAwaitingAck(pkt);
         }
     }
 
@@ -715,7 +894,7 @@ bool NetBase::SendSinglePacket(psNetPacketEntry* pkt)
 }
 
 
-bool NetBase::SendFinalPacket(psNetPacketEntry* pkt)
+bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, bool batched)
 {
     Connection* connection = GetConnByNum(pkt->clientnum);
     if (!connection)
@@ -731,12 +910,12 @@ bool NetBase::SendFinalPacket(psNetPacketEntry* pkt)
     {
         pkt->packet->pktid = connection->GetNextPacketID();
     }
-    return SendFinalPacket(pkt,&(connection->addr));
+    return SendFinalPacket(pkt,&(connection->addr),batched);
     
 }
 
 
-bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr)
+bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr, bool batched)
 {
     // send packet...
 #ifdef PACKETDEBUG
@@ -747,23 +926,95 @@ bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr)
     // printf("Sending packet sequence %d, length %d on the wire.\n", pkt->packet->GetSequence(),pkt->packet->GetPacketSize() );
 
     uint16_t size = (uint16_t)pkt->packet->GetPacketSize();
-    void *data = pkt->GetData();
+    int err;
+
+#ifdef SOCK_HAVE_MMSG
+    if (batched && sendBatch)
+    {
+        if (sendBatch->count == sendBatch->size)
+            FlushSendBatch();
+
+        // Copied, as the packet may change before the batch is sent.
+        size_t i = sendBatch->count++;
+        pkt->CopyMarshalled(sendBatch->buffers[i]);
+        sendBatch->iov[i].iov_base = sendBatch->buffers[i];
+        sendBatch->iov[i].iov_len = size;
+        sendBatch->addrs[i] = *addr;
+        return true;
+    }
+#endif
+
+    if (pkt->IsShared())
+    {
+        // Header and payload are stored apart, gather them into one datagram.
+        char buffer[MAXPACKETSIZE];
+        pkt->CopyMarshalled(buffer);
+        err = SendTo (addr, buffer, size);
+    }
+    else
+    {
+        void *data = pkt->GetData();
 
-    pkt->packet->MarshallEndian();
+        pkt->packet->MarshallEndian();
+        err = SendTo (addr, data, size);
+        pkt->packet->UnmarshallEndian();
+    }
 
-    int err = SendTo (addr, data, size);
     if (err != (int)size )
     {
         Error4("Send error %d: %d bytes sent and %d bytes expected to be sent.\n", errno,err,size);
-        pkt->packet->UnmarshallEndian();
         return false;
     }
 
-    pkt->packet->UnmarshallEndian();
     return true;
 }
 
 
+void NetBase::FlushSendBatch()
+{
+#ifdef SOCK_HAVE_MMSG
+    if (!sendBatch || !sendBatch->count)
+        return;
+
+    size_t sent = 0;
+    int retries = 0;
+    while (sent < sendBatch->count)
+    {
+        int result = SOCK_SENDMMSG(mysocket, sendBatch->msgs + sent, sendBatch->count - sent, 0);
+        syscallsout++;
+
+        if (result > 0)
+        {
+            for (int i = 0; i < result; i++)
+            {
+                totaltransferout += sendBatch->msgs[sent + i].msg_len;
+            }
+            totalcountout += result;
+            sent += result;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            if (retries++ >= SENDTO_MAX_RETRIES)
+            {
+                Error3("NetBase::FlushSendBatch() gave up trying to send %zu packets with errno=%d.",
+                       sendBatch->count - sent, errno);
+                break;
+            }
+            WaitForWrite();
+        }
+        else
+        {
+            // Only the first datagram failed, the rest may still go out.
+            Error3("Send error %d: %u bytes not sent.\n", errno, (unsigned int)sendBatch->iov[sent].iov_len);
+            sent++;
+        }
+    }
+
+    sendBatch->count = 0;
+#endif
+}
+
+
 bool NetBase::SendOut()
 {
     bool sent_anything = false;
@@ -799,6 +1050,8 @@ bool NetBase::SendOut()
     for(size_t i = 0; i < readd.GetSize(); i++)
         senders.Add(readd[i]);
 
+    FlushSendBatch();
+
     // Statistics updating
     csTicks timeTaken = csGetTicks() - begin;
     sendStats[avgIndex].senders = senderCount;
@@ -951,6 +1204,22 @@ bool NetBase::Bind (const IN_ADDR &addr, int port)
 }
 
 
+bool NetBase::SetReusePort()
+{
+#ifdef SOCK_HAVE_REUSEPORT
+    int on = 1;
+    if (setsockopt(mysocket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+    {
+        Error2("setsockopt(SO_REUSEPORT) failed with errno=%d.", errno);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 void NetBase::Close(bool force)
 {
     if (ready || force)
@@ -1199,6 +1468,18 @@ bool NetBase::SendMessage(MsgEntry* me)
 
 
 bool NetBase::SendMessage(MsgEntry* me,NetPacketQueueRefCount *queue)
+{
+    return QueuePackets(me, queue, false);
+}
+
+
+bool NetBase::SendSharedMessage(MsgEntry* me,NetPacketQueueRefCount *queue)
+{
+    return QueuePackets(me, queue, true);
+}
+
+
+bool NetBase::QueuePackets(MsgEntry* me, NetPacketQueueRefCount *queue, bool shared)
 {
     profs->AddSentMsg(me);
 
@@ -1222,8 +1503,19 @@ bool NetBase::SendMessage(MsgEntry* me,NetPacketQueueRefCount *queue)
         size_t pktlen = csMin(MAXPACKETSIZE-sizeof(struct psNetPacket), bytesleft);
         
         csRef<psNetPacketEntry> pNewPkt;
-        pNewPkt.AttachNew(new psNetPacketEntry(me->priority, me->clientnum, id, (uint16_t)offset,
-          (uint16_t)me->bytes->GetTotalSize(), (uint16_t)pktlen, me->bytes));
+        if (shared)
+        {
+            pNewPkt.AttachNew(new psNetPacketEntry(me->priority, me->clientnum, id, (uint16_t)offset,
+              (uint16_t)me->bytes->GetTotalSize(), (uint16_t)pktlen, me));
+            payloadStats.sharedBytes += pktlen;
+        }
+        else
+        {
+            pNewPkt.AttachNew(new psNetPacketEntry(me->priority, me->clientnum, id, (uint16_t)offset,
+              (uint16_t)me->bytes->GetTotalSize(), (uint16_t)pktlen, me->bytes));
+            payloadStats.copiedBytes += pktlen;
+            payloadStats.copies++;
+        }
 
         //if (me->GetSequenceNumber())
         //  printf("Just created packet with sequence number %d.\n", me->GetSequenceNumber());
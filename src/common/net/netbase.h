@@ -160,10 +160,10 @@ public:
      * These queues are for reading off.
      * Selection of the messages is done by a minimum and maximum ObjID
      */
-    bool AddMsgQueue (MsgQueue *,objID minID=0,objID maxID=0xffffffff);
+    virtual bool AddMsgQueue (MsgQueue *,objID minID=0,objID maxID=0xffffffff);
 
     /** this removes a queue */
-    void RemoveMsgQueue(MsgQueue *);
+    virtual void RemoveMsgQueue(MsgQueue *);
 
     /**
      * Put a message into the outgoing queue
@@ -171,6 +171,15 @@ public:
     virtual bool SendMessage (MsgEntry* me);
     virtual bool SendMessage (MsgEntry* me,NetPacketQueueRefCount *queue);
 
+    /**
+     * Put a message into the given outgoing queue without copying its payload.
+     *
+     * The packets reference the bytes of the message, so the message must not
+     * be changed after this call. This is meant for messages that are sent to
+     * many clients, where each recipient only needs its own packet headers.
+     */
+    bool SendSharedMessage (MsgEntry* me,NetPacketQueueRefCount *queue);
+
     /**
      * Broadcast a message, DON'T USE this function, it's only for MsgHandler!
      */
@@ -219,6 +228,18 @@ public:
     /** this receives an Incoming Packet and analyses it */
     bool CheckIn(void);
 
+    /**
+     * Read and write up to batchSize datagrams per system call, using
+     * recvmmsg() and sendmmsg(). The packets sent while SendOut() runs, and
+     * the acks for a batch of received packets, go out together at the end.
+     * Only the thread calling ProcessNetwork() may send through the batch,
+     * so this is meant for the server. Call it before Bind().
+     *
+     * @param batchSize Datagrams per call, 0 goes back to one call per packet.
+     * @return False if the platform has no such calls, nothing changes then.
+     */
+    bool SetBatchedIO(size_t batchSize);
+
     /**
      * Flush all messages in given queue.
      *
@@ -353,10 +374,8 @@ protected:
      */
     int SendTo (LPSOCKADDR_IN addr, const void *data, unsigned int size)
     {
-        struct timeval timeout;
         int sentbytes;
         int retries=0;
-        fd_set wfds;
 
         #ifdef DEBUG
             if (!addr || !data)
@@ -394,6 +413,7 @@ protected:
 
         // Try and send the data, if we fail we wait for the status to change
         sentbytes=SOCK_SENDTO(mysocket, data, size, 0, (LPSOCKADDR) addr, sizeof (SOCKADDR_IN) );
+        syscallsout++;
 
 
         /* Call select() to wait until precisely the time of the change, but have a timeout.
@@ -404,23 +424,11 @@ protected:
         {
             printf("In while loop on EAGAIN... retry #%d.\n", retries);
 
-            // Clear the file descriptor set
-            FD_ZERO(&wfds);
-            // Set the socket's FD in this set
-            FD_SET(mysocket,&wfds);
-
-            // Zero out the timeout value to start
-            memset(&timeout,0,sizeof(struct timeval));
-            timeout.tv_sec=SENDTO_SELECT_TIMEOUT_SEC;
-            timeout.tv_usec=SENDTO_SELECT_TIMEOUT_USEC;
-
-            /* Wait for the descriptor to change.  Note that it's possible that the status
-             * has already cleared, so we'll try to send again after this anyway.
-             */
-            SOCK_SELECT(mysocket+1,NULL,&wfds,NULL,&timeout);
+            WaitForWrite();
 
             // Try and send again.
             sentbytes=SOCK_SENDTO(mysocket, data, size, 0, (LPSOCKADDR) addr, sizeof (SOCKADDR_IN) );
+            syscallsout++;
         }
 
         if (sentbytes>0)
@@ -437,16 +445,36 @@ protected:
     }
 
     /**
-     * small inliner for receiving packets... This just
-     * encapsulates the lowlevel socket funcs
+     * Wait until the socket can take more data, or for the send select
+     * timeout. Note that it's possible that the status has already cleared,
+     * so try to send again after this anyway.
      */
-    int RecvFrom (LPSOCKADDR_IN addr, socklen_t *socklen, void *buf,
-        unsigned int maxsize)
+    void WaitForWrite()
+    {
+        struct timeval timeout;
+        fd_set wfds;
+
+        // Clear the file descriptor set
+        FD_ZERO(&wfds);
+        // Set the socket's FD in this set
+        FD_SET(mysocket,&wfds);
+
+        // Zero out the timeout value to start
+        memset(&timeout,0,sizeof(struct timeval));
+        timeout.tv_sec=SENDTO_SELECT_TIMEOUT_SEC;
+        timeout.tv_usec=SENDTO_SELECT_TIMEOUT_USEC;
+
+        SOCK_SELECT(mysocket+1,NULL,&wfds,NULL,&timeout);
+    }
+
+    /**
+     * Wait for incoming data for up to timeout. Wakes up early if something
+     * was written to the pipe.
+     *
+     * @return True if the socket can be read.
+     */
+    bool WaitForInput()
     {
-        #ifdef DEBUG
-        if (!addr || !buf)
-            Error1("wrong args");
-        #endif
         fd_set set;
 
         /* Initialize the file descriptor set. */
@@ -464,7 +492,7 @@ protected:
         if (SOCK_SELECT(csMax(mysocket, pipe_fd[0]) + 1, &set, NULL, NULL, &timeout) < 1)
         {
             timeout = prevTimeout;
-            return 0;
+            return false;
         }
 
 #ifndef CS_PLATFORM_WIN32
@@ -480,11 +508,27 @@ protected:
 
         timeout = prevTimeout;
 
-        if(!FD_ISSET(mysocket, &set))
+        return FD_ISSET(mysocket, &set) != 0;
+    }
+
+    /**
+     * small inliner for receiving packets... This just
+     * encapsulates the lowlevel socket funcs
+     */
+    int RecvFrom (LPSOCKADDR_IN addr, socklen_t *socklen, void *buf,
+        unsigned int maxsize)
+    {
+        #ifdef DEBUG
+        if (!addr || !buf)
+            Error1("wrong args");
+        #endif
+
+        if (!WaitForInput())
             return 0;
 
         int err = SOCK_RECVFROM (mysocket, buf, maxsize, 0,
             (LPSOCKADDR) addr, socklen);
+        syscallsin++;
         if (err>=0)
         {
             totaltransferin += err;
@@ -494,6 +538,15 @@ protected:
     }
 
 
+    /**
+     * Let further sockets bind to the port of this one. The kernel spreads
+     * the senders over them and keeps each sender on the same socket. Call
+     * before Bind().
+     *
+     * @return False if the platform can't do this.
+     */
+    bool SetReusePort();
+
     /**
      * some helper functions... the getConnBy functions should be reimplemented
      * in the client/server classes.
@@ -526,12 +579,41 @@ protected:
     bool HandleAck(psNetPacketEntry* pkt, Connection* connection, LPSOCKADDR_IN addr);
 
     /**
-     * This cycles through set of pkts awaiting ack and resends old ones.
+     * This resends the pkts awaiting ack whose timeout expired.
      * This function must be called periodically by an outside agent, such
      * as NetManager.
      */
     void CheckResendPkts(void);
 
+    /**
+     * Add a packet to the packets awaiting ack and schedule its resend at
+     * its timestamp plus its RTO.
+     */
+    void AddAwaitingAck(psNetPacketEntry* pkt);
+
+    /**
+     * Take a packet out of the packets awaiting ack.
+     *
+     * @return false if the packet wasn't awaiting an ack.
+     */
+    bool RemoveAwaitingAck(psNetPacketEntry* pkt);
+
+    /**
+     * Schedule the resend of a packet again after it was returned by
+     * GetExpiredPackets() but stays awaiting ack.
+     */
+    void ScheduleResend(psNetPacketEntry* pkt);
+
+    /**
+     * Get the packets awaiting ack whose timeout expired. They stay awaiting
+     * ack but aren't scheduled anymore, so each has to be removed or
+     * rescheduled.
+     */
+    void GetExpiredPackets(csTicks now, csArray<csRef<psNetPacketEntry> > &pkts);
+
+    /** Drop all packets awaiting ack. */
+    void ClearAwaitingAck();
+
     /**
      * This takes incoming packets and rebuilds psMessages from them. If/when a
      * complete message is reassembled, it calls HandleCompletedMessage().
@@ -582,13 +664,19 @@ protected:
 
     /**
      * Send packet to the clientnum given by clientnum in psNetPacketEntry
+     *
+     * @param batched Let the packet join the batch of the current pass if
+     *                batched I/O is on. Only the network thread may set this.
      */
-    bool SendFinalPacket(psNetPacketEntry* pkt);
+    bool SendFinalPacket(psNetPacketEntry* pkt, bool batched = false);
 
     /**
      * This only sends out a packet
      */
-    bool SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr);
+    bool SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr, bool batched = false);
+
+    /** Send the datagrams batched by SendFinalPacket(), if any */
+    void FlushSendBatch();
 
     /** Outgoing message queue */
     csRef<NetPacketQueueRefCount> NetworkQueue;
@@ -602,6 +690,9 @@ protected:
     /** Packets Awaiting Ack pool */
     csHash<csRef<psNetPacketEntry>, PacketKey> awaitingack;
 
+    /** The packets of awaitingack by when they have to be resent */
+    TimingWheel<psNetPacketEntry> resendWheel;
+
     /** System Socket lib initialized? */
     static int socklibrefcount;
 
@@ -612,6 +703,18 @@ protected:
     long totaltransferin, totaltransferout;
     /** total packages transferred by this object */
     long totalcountin, totalcountout;
+    /** system calls that read or wrote packets */
+    long syscallsin, syscallsout;
+
+    /** Payload bytes queued for sending, either copied or shared. Written by
+     * the threads queueing messages, so the numbers are approximate.
+     */
+    struct
+    {
+        long copiedBytes;
+        long copies;
+        long sharedBytes;
+    } payloadStats;
 
     /** Moving averages */
     typedef struct {
@@ -630,6 +733,42 @@ protected:
     psNetMsgProfiles * profs;
 
 private:
+    /**
+     * Split a message into packets and add them to the queue. If shared is
+     * set the packets reference the payload of the message instead of a copy.
+     */
+    bool QueuePackets(MsgEntry* me, NetPacketQueueRefCount *queue, bool shared);
+
+    /**
+     * Take a received datagram apart and hand its messages on.
+     *
+     * @param buffer Holds the datagram. Set to NULL if a packet took it over.
+     */
+    bool HandleDatagram(char* &buffer, int packetlen, SOCKADDR_IN &addr);
+
+#ifdef SOCK_HAVE_MMSG
+    /** Datagrams and headers for one recvmmsg() or sendmmsg() call. */
+    struct DatagramBatch
+    {
+        DatagramBatch(size_t size);
+        ~DatagramBatch();
+
+        size_t size;
+        size_t count;           ///< Datagrams received, or queued for sending.
+        size_t next;            ///< Next received datagram to handle.
+        struct mmsghdr* msgs;
+        struct iovec* iov;
+        SOCKADDR_IN* addrs;
+        char** buffers;         ///< MAXPACKETSIZE each, NULL once a packet took it over.
+    };
+
+    /** Handle the next datagram of recvBatch, reading a new batch if needed */
+    bool CheckInBatched();
+
+    DatagramBatch* recvBatch;
+    DatagramBatch* sendBatch;
+#endif
+
     /** my socket */
     SOCKET mysocket;
 
@@ -33,6 +33,7 @@ psNetPacketEntry::psNetPacketEntry (psNetPacket* packet, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    triggerticks = 0;
 }
 
 
@@ -53,6 +54,7 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    triggerticks = 0;
     if (msg && sz && sz != PKTSIZE_ACK)
         memcpy(packet->data, ((char *)msg) + off, sz);
 }
@@ -73,15 +75,63 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    triggerticks = 0;
     if (bytes && sz && sz != PKTSIZE_ACK)
     memcpy(packet->data, bytes, sz);
 }
 
 
+psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
+    uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
+    MsgEntry *shared)
+    : payload(shared)
+{
+    CS_ASSERT(shared != NULL);
+    packet = (psNetPacket*) header;
+    clientnum = cnum;
+    packet->flags = pri;
+    packet->pktid = id;
+    packet->offset = off;
+    packet->pktsize = sz;
+    packet->msgsize = totalsize;
+    timestamp = csGetTicks();
+    retransmitted = false;
+    RTO = 0;
+    triggerticks = 0;
+}
+
+
 psNetPacketEntry::~psNetPacketEntry()
 {
-    if (packet)
+    FreePacket();
+}
+
+
+void psNetPacketEntry::FreePacket()
+{
+    // The header of a shared packet lives in this entry, only the
+    // reference to the payload has to go.
+    if (payload)
+        payload = NULL;
+    else if (packet)
         cs_free(packet);
+    packet = NULL;
+}
+
+
+size_t psNetPacketEntry::CopyMarshalled(void *dest)
+{
+    size_t size = packet->GetPacketSize();
+    const char *data = GetPayload();
+
+    packet->MarshallEndian();
+    memcpy(dest, packet, sizeof(psNetPacket));
+    packet->UnmarshallEndian();
+
+    if (size > sizeof(psNetPacket))
+        memcpy(((char *)dest) + sizeof(psNetPacket), data, size - sizeof(psNetPacket));
+
+    return size;
 }
 
 
@@ -138,12 +188,9 @@ bool psNetPacketEntry::Append(psNetPacketEntry* next)
         * After marshalling for network, copy entire first packet, with header, into data section
         * of new packet.
         */
-        uint16_t size = (uint16_t)packet->GetPacketSize();
-        packet->MarshallEndian();
-        memcpy(merge->data, packet, size);
-        packet->UnmarshallEndian();
+        CopyMarshalled(merge->data);
 
-        cs_free(packet);   // done with old packet
+        FreePacket();   // done with old packet
         packet = merge;
     }
     else
@@ -159,14 +206,10 @@ bool psNetPacketEntry::Append(psNetPacketEntry* next)
     if (next->packet->GetPriority() == PRIORITY_HIGH)
         packet->flags = PRIORITY_HIGH | FLAG_MULTIPACKET; // HIGH overrides LOW but not vice versa
 
-    /* Copy size information temporarily, and pack the next packet for transmission.
-    * Do not reference the next->packet after MarshallEndian() has been called.
-    * copy the entire 2nd packet into 1st packet after existing data
+    /* Pack the next packet for transmission and copy the entire 2nd packet
+    * into 1st packet after existing data
     */
-    uint16_t nextSize = (uint16_t)next->packet->GetPacketSize();
-    next->packet->MarshallEndian();
-    memcpy(packet->data+packet->pktsize, next->packet, nextSize);
-    next->packet->UnmarshallEndian();
+    uint16_t nextSize = (uint16_t)next->CopyMarshalled(packet->data+packet->pktsize);
 
     /**
     * now update length of outer packet
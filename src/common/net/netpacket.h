@@ -21,10 +21,12 @@
 
 #include <csutil/csendian.h>
 #include <csutil/refcount.h>
+#include <csutil/ref.h>
 #include <csutil/hash.h>
 
 #include "net/packing.h"
 #include "net/message.h"
+#include "util/timingwheel.h"
 
 /**
  * \addtogroup common_net
@@ -189,6 +191,12 @@ public:
     /** timeout */
     csTicks RTO;
 
+    /** When the packet is resent if it isn't acked by then */
+    csTicks triggerticks;
+
+    /** Links the packet into the resend wheel while it awaits an ack */
+    TimingWheelNode<psNetPacketEntry> wheelNode;
+
     /** The Packet like it is returned from reading UDP socket / will be
      * written to socket
      */
@@ -209,6 +217,15 @@ public:
                       uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
                       const char *bytes);
 
+    /** construct a new PacketEntry for a single or partial message without
+     * copying it. The payload is referenced from the given message, which
+     * must not be changed anymore once it has been queued. Only the packet
+     * header is stored in the entry itself.
+     */
+    psNetPacketEntry (uint8_t pri, uint32_t cnum, uint32_t id,
+                      uint32_t off, uint32_t totalsize, uint16_t sz,
+                      MsgEntry *shared);
+
     psNetPacketEntry (psNetPacketEntry* )
     {
         CS_ASSERT(false);
@@ -225,6 +242,27 @@ public:
         return packet;
     }
 
+    /// Is the payload of this packet referenced from a shared message?
+    bool IsShared() const
+    {
+        return payload.IsValid();
+    }
+
+    /// Get the payload of this packet, wherever it is stored.
+    const char* GetPayload() const
+    {
+        if (payload)
+            return ((const char*)payload->bytes) + packet->offset;
+        return packet->data;
+    }
+
+    /**
+     * Copy the header in network byte order followed by the payload into
+     * the given buffer, which must hold at least GetPacketSize() bytes.
+     * @return The number of bytes written.
+     */
+    size_t CopyMarshalled(void *dest);
+
     bool operator < (const psNetPacketEntry& other) const
     {
         if (clientnum < other.clientnum)
@@ -250,6 +288,18 @@ public:
     {   }
     bool GetPending()
     { return false; }
+
+private:
+    /// Releases the current packet memory, if it is owned by this entry.
+    void FreePacket();
+
+    /** Message the payload is referenced from, NULL if the payload is stored
+     * behind the header in packet.
+     */
+    csRef<MsgEntry> payload;
+
+    /// Storage for the header of packets with a shared payload.
+    char header[sizeof(psNetPacket)];
 };
 
 
@@ -18,6 +18,7 @@
  */
 
 #include <psconfig.h>
+#include <csutil/sysfunc.h>
 #include "netprofile.h"
 #include "messages.h"
 
@@ -41,28 +42,68 @@ void psNetMsgProfiles::AddEnoughRecords(csArray<psOperProfile*> & arr, int neede
 
 void psNetMsgProfiles::AddSentMsg(MsgEntry * me)
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     AddEnoughRecords(sentProfs, me->bytes->type, "sent");
     sentProfs[me->bytes->type]->AddConsumption(me->bytes->size);
 }
 
 void psNetMsgProfiles::AddReceivedMsg(MsgEntry * me)
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     AddEnoughRecords(recvProfs, me->bytes->type, "recv");
     recvProfs[me->bytes->type]->AddConsumption(me->bytes->size);
 }
 
+psOperProfile* psNetMsgProfiles::GetHandlerProfile(msgtype type, const char* handler)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return handlerProfs.Get(type, handler);
+}
+
 csString psNetMsgProfiles::Dump()
 {
     csStringFast<50> header, list;
-    
+
+    CS::Threading::MutexScopedLock lock(mutex);
     psOperProfileSet::Dump("byte", header, list);
-    return "=================\nBandwidth profile\n=================\n" + header + list;
+    return "=================\nBandwidth profile\n=================\n" + header + list + "\n" + handlerProfs.Dump();
 }
 
 void psNetMsgProfiles::Reset()
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     recvProfs.DeleteAll();
     sentProfs.DeleteAll();
+    handlerProfs.Reset();
     
     psOperProfileSet::Reset();
 }
+
+psOperProfile* psMsgHandlerProfiles::Get(msgtype type, const char* handler)
+{
+    csString name = GetMsgTypeName(type) + "-" + handler;
+    psOperProfile* prof = byName.Get(name, NULL);
+    if (!prof)
+    {
+        prof = new psOperProfile(name);
+        byName.Put(name, prof);
+        profs.Push(prof);
+    }
+    return prof;
+}
+
+csString psMsgHandlerProfiles::Dump()
+{
+    csStringFast<50> header, list;
+
+    psOperProfileSet::Dump("msec", header, list);
+    return "===============\nHandler profile\n===============\n" + header + list;
+}
+
+void psMsgHandlerProfiles::Reset()
+{
+    // The handler keeps pointers to the profiles.
+    profStart = csGetTicks();
+    for (size_t i = 0; i < profs.GetSize(); i++)
+        profs[i]->Reset();
+}
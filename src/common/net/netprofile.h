@@ -20,7 +20,9 @@
 #ifndef __NETPROFILE_H__
 #define __NETPROFILE_H__
 
+#include <csutil/hash.h>
 #include <csutil/parray.h>
+#include <csutil/threading/mutex.h>
 
 #include "message.h"
 #include "util/psprofile.h"
@@ -29,6 +31,25 @@
  * \addtogroup common_net
  * @{ */
 
+/**
+ * Statistics of the time each subscriber takes to handle a message type,
+ * in milliseconds.
+ *
+ * The profiles are kept until the set is destroyed, Reset only zeroes them,
+ * so the message handler can keep pointers to them and add to them without
+ * locking. They are only added to from the thread that publishes messages.
+ */
+class psMsgHandlerProfiles : public psOperProfileSet
+{
+public:
+    /// The profile of a subscriber for a message type, made if it is new.
+    psOperProfile* Get(msgtype type, const char* handler);
+    csString Dump();
+    void Reset();
+protected:
+    csHash<psOperProfile*, csString> byName;
+};
+
 /**
  * Statistics of receiving or sending of network messages.
  */
@@ -37,6 +58,16 @@ class psNetMsgProfiles : public psOperProfileSet
 public:
     void AddSentMsg(MsgEntry * me);
     void AddReceivedMsg(MsgEntry * me);
+
+    /**
+     * The profile the message handler adds the time a subscriber takes
+     * for a message type to.
+     *
+     * @param type The message type.
+     * @param handler The name of the subscriber.
+     */
+    psOperProfile* GetHandlerProfile(msgtype type, const char* handler);
+
     csString Dump();
     void Reset();
 protected:
@@ -46,6 +77,12 @@ protected:
      * Statistics for receiving and sending of different message types.
      */
     csArray<psOperProfile*> recvProfs, sentProfs;
+
+    /// Time taken by the subscribers of each message type.
+    psMsgHandlerProfiles handlerProfs;
+
+    /// Messages are sent and received from several threads.
+    CS::Threading::Mutex mutex;
 };
 
 /** @} */
@@ -79,6 +79,18 @@
 
 #define INVALID_SOCKET    -1
 
+/* Linux can move many datagrams with one call */
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#define SOCK_HAVE_MMSG
+#define SOCK_RECVMMSG(a,b,c,d)                          recvmmsg(a,b,c,d,NULL)
+#define SOCK_SENDMMSG(a,b,c,d)                          sendmmsg(a,b,c,d)
+#endif
+
+/* Linux spreads the datagrams of a port over the sockets bound to it */
+#if defined(__linux__) && defined(SO_REUSEPORT)
+#define SOCK_HAVE_REUSEPORT
+#endif
+
 static inline int initSocket()
 {
     /* we don't need to init sockets in unix... */
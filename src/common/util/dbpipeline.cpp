@@ -0,0 +1,272 @@
+/*
+ * dbpipeline.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+#include <csutil/threading/atomicops.h>
+
+#include "util/consoleout.h"
+
+#include "dbpipeline.h"
+
+using CS::Threading::AtomicOperations;
+
+/// How long the pipeline thread sleeps before it looks at the queue again.
+#define DBPIPELINE_IDLE_WAIT 100
+
+DBPipeline::DBPipeline(iDBPipelineBackend* backend, size_t maxBatch)
+    : backend(backend), maxBatch(csMax(maxBatch, (size_t)1)), sleeping(0), stop(0),
+      connecting(false), connected(false), queued(0), executed(0), failed(0), batches(0), maxBatchSeen(0)
+{
+    stub.next = NULL;
+    stub.callback = NULL;
+    stub.queued = 0;
+    head = &stub;
+    tail = &stub;
+}
+
+DBPipeline::~DBPipeline()
+{
+    if(thread)
+    {
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            AtomicOperations::Set(&stop, 1);
+            condition.NotifyAll();
+        }
+        thread->Wait();
+    }
+
+    // Only left over if the thread never ran.
+    Node* node;
+    while((node = Pop()) != NULL)
+    {
+        delete node;
+    }
+    delete backend;
+}
+
+bool DBPipeline::Start()
+{
+    csRef<Runner> runner;
+    runner.AttachNew(new Runner(this));
+    thread.AttachNew(new CS::Threading::Thread(runner));
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    connecting = true;
+    thread->Start();
+    while(connecting)
+    {
+        condition.Wait(mutex);
+    }
+
+    if(!connected)
+    {
+        thread->Wait();
+        thread.Invalidate();
+    }
+    return connected;
+}
+
+void DBPipeline::Link(Node* node)
+{
+    AtomicOperations::Set((void**)&node->next, NULL);
+    Node* prev = (Node*)AtomicOperations::Set((void**)&head, node);
+    // Between the swap and this the consumer sees the queue cut short at prev.
+    AtomicOperations::Set((void**)&prev->next, node);
+}
+
+DBPipeline::Node* DBPipeline::Pop()
+{
+    Node* first = tail;
+    Node* next = (Node*)AtomicOperations::Read((void**)&first->next);
+
+    if(first == &stub)
+    {
+        if(!next)
+            return NULL;
+        tail = next;
+        first = next;
+        next = (Node*)AtomicOperations::Read((void**)&next->next);
+    }
+
+    if(next)
+    {
+        tail = next;
+        return first;
+    }
+
+    // first is the last node. Take it only if no push is half done, and put
+    // the stub behind it so the queue never runs empty.
+    if(first != (Node*)AtomicOperations::Read((void**)&head))
+        return NULL;
+
+    Link(&stub);
+    next = (Node*)AtomicOperations::Read((void**)&first->next);
+    if(next)
+    {
+        tail = next;
+        return first;
+    }
+    return NULL;
+}
+
+void DBPipeline::Push(const csString &sql, iQueryCallback* callback)
+{
+    Node* node = new Node;
+    node->sql = sql;
+    node->callback = callback;
+    node->queued = csGetTicks();
+
+    AtomicOperations::Increment(&queued);
+    Link(node);
+
+    // Only take the lock when the thread may be sleeping. It sets the flag
+    // before it looks at the queue a last time, so either it sees this node
+    // or we see the flag.
+    if(AtomicOperations::Read(&sleeping))
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        condition.NotifyOne();
+    }
+}
+
+void DBPipeline::Runner::Run()
+{
+    pipeline->RunPipeline();
+}
+
+void DBPipeline::RunPipeline()
+{
+    bool ok = backend->Connect();
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        connecting = false;
+        connected = ok;
+        condition.NotifyAll();
+    }
+    if(!ok)
+        return;
+
+    csArray<Node*> batch;
+    while(true)
+    {
+        Node* node;
+        while(batch.GetSize() < maxBatch && (node = Pop()) != NULL)
+        {
+            batch.Push(node);
+        }
+
+        if(!batch.IsEmpty())
+        {
+            RunBatch(batch);
+            continue;
+        }
+
+        CS::Threading::MutexScopedLock lock(mutex);
+        AtomicOperations::Set(&sleeping, 1);
+        if(AtomicOperations::Read((void**)&tail->next) || tail != (Node*)AtomicOperations::Read((void**)&head))
+        {
+            AtomicOperations::Set(&sleeping, 0);
+            continue;
+        }
+        if(AtomicOperations::Read(&stop))
+            break;
+
+        condition.Wait(mutex, DBPIPELINE_IDLE_WAIT);
+        AtomicOperations::Set(&sleeping, 0);
+    }
+
+    backend->Disconnect();
+}
+
+void DBPipeline::RunBatch(csArray<Node*> &batch)
+{
+    csArray<csString> statements;
+    for(size_t i = 0; i < batch.GetSize(); i++)
+    {
+        statements.Push(batch[i]->sql);
+    }
+
+    csArray<unsigned long> results;
+    csString error;
+    backend->Execute(statements, results, error);
+    csTicks now = csGetTicks();
+
+    // A backend that ran nothing failed on the first statement.
+    size_t done = results.GetSize();
+    if(!done)
+    {
+        results.Push(QUERY_FAILED);
+        done = 1;
+    }
+
+    {
+        CS::Threading::MutexScopedLock lock(profileMutex);
+        batches++;
+        maxBatchSeen = csMax(maxBatchSeen, done);
+        for(size_t i = 0; i < done; i++)
+        {
+            // The latency as the caller sees it, from queuing to completion.
+            profs.AddSQLTime(batch[i]->sql, now - batch[i]->queued);
+            if(results[i] == QUERY_FAILED)
+                failed++;
+            else
+                executed++;
+        }
+    }
+
+    for(size_t i = 0; i < done; i++)
+    {
+        if(results[i] == QUERY_FAILED)
+        {
+            csString status;
+            status.Format("Pipelined query failed: %s\nQuery: %s\n", error.GetData(), batch[i]->sql.GetData());
+            CPrintf(CON_ERROR, "%s", status.GetData());
+        }
+        if(batch[i]->callback)
+            batch[i]->callback->QueryDone(results[i], results[i] == QUERY_FAILED ? error.GetData() : NULL);
+        delete batch[i];
+    }
+
+    // The statements the backend left out go again, in front of the rest.
+    for(size_t i = done; i < batch.GetSize(); i++)
+    {
+        batch[i - done] = batch[i];
+    }
+    batch.Truncate(batch.GetSize() - done);
+}
+
+csString DBPipeline::DumpProfile()
+{
+    CS::Threading::MutexScopedLock lock(profileMutex);
+
+    csString dump;
+    dump.Format("=================\nQuery pipeline\n=================\n"
+                "%zu queued, %zu pending, %zu done, %zu failed in %zu batches (avg %.1f, max %zu)\n",
+                (size_t)AtomicOperations::Read(&queued),
+                (size_t)AtomicOperations::Read(&queued) - executed - failed, executed, failed, batches,
+                batches ? (float)(executed + failed) / (float)batches : 0.0f, maxBatchSeen);
+    dump += profs.Dump();
+    return dump;
+}
+
+void DBPipeline::ResetProfile()
+{
+    CS::Threading::MutexScopedLock lock(profileMutex);
+    profs.Reset();
+}
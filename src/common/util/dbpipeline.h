@@ -0,0 +1,177 @@
+/*
+ * dbpipeline.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __DBPIPELINE_H__
+#define __DBPIPELINE_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/threading/thread.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/condition.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>
+#include "util/dbprofile.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * The database specific part of a DBPipeline. Every database plugin brings
+ * its own, using a connection of its own.
+ */
+class iDBPipelineBackend
+{
+public:
+    virtual ~iDBPipelineBackend() {}
+
+    /// Open the connection. Called in the pipeline thread.
+    virtual bool Connect() = 0;
+
+    /**
+     * Run statements in as few round trips as the database allows.
+     *
+     * @param statements The statements, in order.
+     * @param results Gets the affected rows, or QUERY_FAILED, of every
+     *                statement that ran. Statements after a failed one may be
+     *                left out, they are passed again with the next call.
+     * @param error Gets the error message of a failed statement.
+     */
+    virtual void Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error) = 0;
+
+    /// Close the connection. Called in the pipeline thread.
+    virtual void Disconnect() = 0;
+};
+
+/**
+ * Runs the commands of iDataConnection::CommandPump() in a thread of their
+ * own.
+ *
+ * Commands are queued in an unbounded lock free queue, any number of threads
+ * can queue without ever waiting for the database or for each other. The
+ * pipeline thread takes up to a batch of commands at a time and hands them to
+ * the backend, which sends them in one go where the database supports it.
+ * Commands run in the order they were queued.
+ */
+class DBPipeline
+{
+public:
+    /**
+     * @param backend The database part, deleted with the pipeline.
+     * @param maxBatch Most commands handed to the backend at once.
+     */
+    DBPipeline(iDBPipelineBackend* backend, size_t maxBatch);
+
+    /// Runs all queued commands before it returns.
+    ~DBPipeline();
+
+    /**
+     * Start the thread and connect.
+     *
+     * @return false if the backend couldn't connect.
+     */
+    bool Start();
+
+    /**
+     * Queue a command.
+     *
+     * @param callback Gets the outcome in the pipeline thread, may be NULL.
+     */
+    void Push(const csString &sql, iQueryCallback* callback = NULL);
+
+    /// Queue and batch statistics and the latency of the commands per table.
+    csString DumpProfile();
+    void ResetProfile();
+
+private:
+    /// A queued command.
+    struct Node
+    {
+        Node* next;
+        csString sql;
+        iQueryCallback* callback;
+        csTicks queued;
+    };
+
+    class Runner : public CS::Threading::Runnable
+    {
+    public:
+        Runner(DBPipeline* pipeline) : pipeline(pipeline) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "DBPipeline";
+        }
+
+    private:
+        DBPipeline* pipeline;
+    };
+
+    /// Link a node at the head. Safe to call from any thread.
+    void Link(Node* node);
+
+    /// Take the node at the tail, NULL if none. Only called by the pipeline thread.
+    Node* Pop();
+
+    /// Run a batch of commands and call their callbacks.
+    void RunBatch(csArray<Node*> &batch);
+
+    /// Body of the pipeline thread.
+    void RunPipeline();
+
+    iDBPipelineBackend* backend;
+    size_t maxBatch;
+
+    // Multiple producer, single consumer queue. Producers swap themselves in
+    // at the head, the pipeline thread takes from the tail. The stub node
+    // keeps the queue from ever being empty.
+    Node* head;
+    Node* tail;
+    Node stub;
+
+    // Lets the pipeline thread sleep while the queue is empty.
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+    int32 sleeping;
+    int32 stop;
+    bool connecting;
+    bool connected;
+    csRef<CS::Threading::Thread> thread;
+
+    // Statistics, protected by profileMutex.
+    CS::Threading::Mutex profileMutex;
+    psDBProfiles profs;
+    int32 queued;
+    size_t executed;
+    size_t failed;
+    size_t batches;
+    size_t maxBatchSeen;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * dbpipeline_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/threading/thread.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/dbpipeline.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+/// Records what it runs. Statements starting with FAIL fail and end the batch.
+class TestBackend : public iDBPipelineBackend
+{
+public:
+    TestBackend(csArray<csString> &ran, csArray<size_t> &batchSizes)
+        : ran(ran), batchSizes(batchSizes) {}
+
+    virtual bool Connect()
+    {
+        return true;
+    }
+
+    virtual void Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error)
+    {
+        batchSizes.Push(statements.GetSize());
+        for(size_t i = 0; i < statements.GetSize(); i++)
+        {
+            ran.Push(statements[i]);
+            if(statements[i].StartsWith("FAIL"))
+            {
+                results.Push(QUERY_FAILED);
+                error = "failed";
+                return;
+            }
+            results.Push(1);
+        }
+    }
+
+    virtual void Disconnect() {}
+
+private:
+    csArray<csString> &ran;
+    csArray<size_t> &batchSizes;
+};
+
+class TestCallback : public iQueryCallback
+{
+public:
+    TestCallback() : calls(0), result(0) {}
+
+    virtual void QueryDone(unsigned long result, const char* /*error*/)
+    {
+        calls++;
+        this->result = result;
+    }
+
+    int calls;
+    unsigned long result;
+};
+
+class PushRunner : public CS::Threading::Runnable
+{
+public:
+    PushRunner(DBPipeline* pipeline, int thread) : pipeline(pipeline), thread(thread) {}
+
+    virtual void Run()
+    {
+        for(int i = 0; i < 1000; i++)
+        {
+            csString sql;
+            sql.Format("UPDATE t%d SET n=%d", thread, i);
+            pipeline->Push(sql);
+        }
+    }
+
+private:
+    DBPipeline* pipeline;
+    int thread;
+};
+
+TEST(DBPipelineTest, RunsInOrderInBatches)
+{
+    csArray<csString> ran;
+    csArray<size_t> batchSizes;
+    TestCallback ok, failed, retried;
+    {
+        DBPipeline pipeline(new TestBackend(ran, batchSizes), 4);
+        pipeline.Push("UPDATE a SET x=1", &ok);
+        pipeline.Push("UPDATE a SET x=2");
+        pipeline.Push("FAIL b", &failed);
+        pipeline.Push("UPDATE a SET x=3", &retried);
+        pipeline.Push("UPDATE a SET x=4");
+        pipeline.Push("UPDATE a SET x=5");
+        ASSERT_TRUE(pipeline.Start());
+    }
+
+    ASSERT_EQ(6u, ran.GetSize());
+    EXPECT_STREQ("UPDATE a SET x=1", ran[0]);
+    EXPECT_STREQ("FAIL b", ran[2]);
+    EXPECT_STREQ("UPDATE a SET x=5", ran[5]);
+
+    // The batch stopped at the failure, the rest was run by the next one.
+    ASSERT_EQ(2u, batchSizes.GetSize());
+    EXPECT_EQ(4u, batchSizes[0]);
+    EXPECT_EQ(3u, batchSizes[1]);
+
+    EXPECT_EQ(1, ok.calls);
+    EXPECT_EQ(1u, ok.result);
+    EXPECT_EQ(1, failed.calls);
+    EXPECT_EQ(QUERY_FAILED, failed.result);
+    EXPECT_EQ(1, retried.calls);
+    EXPECT_EQ(1u, retried.result);
+}
+
+TEST(DBPipelineTest, ManyProducers)
+{
+    csArray<csString> ran;
+    csArray<size_t> batchSizes;
+    {
+        DBPipeline pipeline(new TestBackend(ran, batchSizes), 32);
+        ASSERT_TRUE(pipeline.Start());
+
+        csArray<csRef<CS::Threading::Thread> > threads;
+        for(int t = 0; t < 4; t++)
+        {
+            csRef<PushRunner> runner;
+            runner.AttachNew(new PushRunner(&pipeline, t));
+            threads.Push(csPtr<CS::Threading::Thread>(new CS::Threading::Thread(runner)));
+            threads.Top()->Start();
+        }
+        for(size_t t = 0; t < threads.GetSize(); t++)
+        {
+            threads[t]->Wait();
+        }
+    }
+
+    ASSERT_EQ(4000u, ran.GetSize());
+
+    // Every producer's statements run in the order it queued them.
+    int next[4] = { 0, 0, 0, 0 };
+    for(size_t i = 0; i < ran.GetSize(); i++)
+    {
+        int thread, n;
+        ASSERT_EQ(2, sscanf(ran[i], "UPDATE t%d SET n=%d", &thread, &n));
+        EXPECT_EQ(next[thread], n);
+        next[thread] = n + 1;
+    }
+    for(size_t i = 0; i < batchSizes.GetSize(); i++)
+    {
+        EXPECT_GE(32u, batchSizes[i]);
+    }
+}
+
+TEST(DBPipelineTest, TableNames)
+{
+    EXPECT_STREQ("item_instances", psDBProfiles::GetTableName("UPDATE item_instances SET x=1 WHERE id=2"));
+    EXPECT_STREQ("characters", psDBProfiles::GetTableName("insert into `characters`(id, name) values (1, 'a')"));
+    EXPECT_STREQ("accounts", psDBProfiles::GetTableName("SELECT id FROM accounts WHERE name='update into'"));
+    EXPECT_STREQ("?", psDBProfiles::GetTableName("SHOW TABLES"));
+}
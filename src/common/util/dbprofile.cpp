@@ -18,6 +18,7 @@
  */
 
 #include <psconfig.h>
+#include <csutil/util.h>
 #include "util/psstring.h"
 #include "dbprofile.h"
 #include "util/log.h"
@@ -47,6 +48,8 @@ void psDBProfiles::StripConstantsFromSQL(psString & sql)
     }
 }
 
+const csTicks psDBProfiles::bucketLimits[DBPROFILE_BUCKETS - 1] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+
 void psDBProfiles::AddSQLTime(const csString & sql, csTicks time)
 {
     psString strippedSQL(sql.GetData());
@@ -55,10 +58,96 @@ void psDBProfiles::AddSQLTime(const csString & sql, csTicks time)
     StripConstantsFromSQL(strippedSQL);
     
     AddCons(strippedSQL.GetData(), time);
+
+    csString table = GetTableName(sql);
+    TableLatency* latency = tables.GetElementPointer(table);
+    if (!latency)
+    {
+        TableLatency empty;
+        memset(&empty, 0, sizeof(empty));
+        latency = &tables.Put(table, empty);
+    }
+
+    size_t bucket = 0;
+    while (bucket < DBPROFILE_BUCKETS - 1 && time > bucketLimits[bucket])
+        bucket++;
+
+    latency->buckets[bucket]++;
+    latency->count++;
+    latency->total += time;
+    latency->max = csMax(latency->max, time);
+}
+
+csString psDBProfiles::GetTableName(const char* sql)
+{
+    // The table follows UPDATE, or the first INTO or FROM.
+    bool first = true;
+    bool next = false;
+    const char* pos = sql;
+    while (*pos)
+    {
+        while (*pos && isspace((unsigned char)*pos))
+            pos++;
+        const char* word = pos;
+        while (*pos && !isspace((unsigned char)*pos))
+            pos++;
+        size_t len = pos - word;
+        if (!len)
+            break;
+
+        if (next)
+        {
+            // Strip quoting and anything glued to the name, like "items(id,".
+            while (len && (*word == '`' || *word == '"'))
+            {
+                word++;
+                len--;
+            }
+            size_t nameLen = 0;
+            while (nameLen < len && (isalnum((unsigned char)word[nameLen]) || word[nameLen] == '_' || word[nameLen] == '.'))
+                nameLen++;
+            if (!nameLen)
+                break;
+
+            csString table(word, nameLen);
+            table.Downcase();
+            return table;
+        }
+
+        next = (first && len == 6 && !csStrNCaseCmp(word, "update", 6)) ||
+               (len == 4 && (!csStrNCaseCmp(word, "into", 4) || !csStrNCaseCmp(word, "from", 4)));
+        first = false;
+    }
+    return "?";
 }
 
 csString psDBProfiles::Dump()
 {
-    return psNamedProfiles::Dump("msec", "Database profile");
+    csString dump = psNamedProfiles::Dump("msec", "Database profile");
+
+    dump += "=================\nLatency per table (statements per msec bucket)\n=================\n";
+    dump += csString().Format("%-24s %7s %7s %7s ", "table", "count", "avg", "max");
+    for (size_t i = 0; i < DBPROFILE_BUCKETS - 1; i++)
+        dump += csString().Format("%6s", csString().Format("<=%u", bucketLimits[i]).GetData());
+    dump += csString().Format("%6s\n", csString().Format(">%u", bucketLimits[DBPROFILE_BUCKETS - 2]).GetData());
+
+    csHash<TableLatency, csString>::GlobalIterator it(tables.GetIterator());
+    while (it.HasNext())
+    {
+        csString table;
+        const TableLatency &latency = it.Next(table);
+        dump += csString().Format("%-24s %7zu %7.1f %7u ", table.GetData(), latency.count,
+                                  (float)latency.total / (float)latency.count, latency.max);
+        for (size_t i = 0; i < DBPROFILE_BUCKETS; i++)
+            dump += csString().Format("%6zu", latency.buckets[i]);
+        dump += "\n";
+    }
+    return dump;
+}
+
+void psDBProfiles::Reset()
+{
+    tables.DeleteAll();
+    psNamedProfiles::Reset();
 }
 
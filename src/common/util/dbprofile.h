@@ -29,6 +29,8 @@ class psString;
  * \addtogroup common_util
  * @{ */
 
+#define DBPROFILE_BUCKETS 11   ///< Latency buckets, see psDBProfiles::bucketLimits.
+
 /**  Statistics of time consumed by SQL statements */
 class psDBProfiles : public psNamedProfiles
 {
@@ -36,11 +38,29 @@ public:
 
     virtual void AddSQLTime(const csString & sql, csTicks time);
     csString Dump();
-    
+    void Reset();
+
+    /** Get the table a statement works on, "?" if it can't be told. For
+      * joins this is the first table. */
+    static csString GetTableName(const char* sql);
+
 protected:
 
     void StripConstantsFromSQL(psString & sql);
 
+    /** Latency histogram of the statements on one table */
+    struct TableLatency
+    {
+        size_t buckets[DBPROFILE_BUCKETS];
+        size_t count;
+        csTicks total;
+        csTicks max;
+    };
+
+    /** Upper limits in msec of all but the last bucket */
+    static const csTicks bucketLimits[DBPROFILE_BUCKETS - 1];
+
+    csHash<TableLatency, csString> tables;
 };
 
 /** @} */
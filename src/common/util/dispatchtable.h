@@ -0,0 +1,280 @@
+/*
+ * dispatchtable.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * Description : Lists of values by a one byte key, such as the subscribers
+ *               of a message type, that are read without locking.
+ *
+ */
+
+#ifndef __DISPATCHTABLE_H__
+#define __DISPATCHTABLE_H__
+
+#include <string.h>
+#include <csutil/array.h>
+#include <csutil/threading/atomicops.h>
+#include <csutil/threading/mutex.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Number of keys of a dispatch table, one for each value of a byte.
+#define DISPATCHTABLE_SIZE 256
+
+/**
+ * Lists of values by a one byte key, for lists that are read all the time
+ * and changed rarely, as the subscribers of each message type are.
+ *
+ * A list is never changed once it is in the table. Changes copy the list of
+ * the key and swap the copy in. Readers take a Snapshot of a key, which
+ * neither locks nor allocates, and may keep iterating over it while the key
+ * is changed, even by the code they call. Lists swapped out are deleted
+ * once no snapshot of the table is left.
+ *
+ * T must be comparable with ==, values are kept in the order they were added.
+ */
+template <class T>
+class DispatchTable
+{
+public:
+    typedef csArray<T> List;
+
+    /**
+     * The list of one key as it was when the snapshot was taken, valid
+     * while the snapshot is in scope.
+     */
+    class Snapshot
+    {
+    public:
+        Snapshot(DispatchTable &table, uint8_t key) : table(table)
+        {
+            list = table.Acquire(key);
+        }
+        ~Snapshot()
+        {
+            table.Release();
+        }
+
+        size_t GetSize() const
+        {
+            return list ? list->GetSize() : 0;
+        }
+        const T &operator[](size_t n) const
+        {
+            return (*list)[n];
+        }
+
+    private:
+        DispatchTable &table;
+        const List* list;
+    };
+
+    DispatchTable() : readers(0), retiredCount(0)
+    {
+        memset(lists, 0, sizeof(lists));
+    }
+
+    /// There may be no snapshots left when the table is destroyed.
+    ~DispatchTable()
+    {
+        CS_ASSERT(readers == 0);
+        for(size_t i = 0; i < DISPATCHTABLE_SIZE; i++)
+        {
+            delete lists[i];
+        }
+        for(size_t i = 0; i < retired.GetSize(); i++)
+        {
+            delete retired[i];
+        }
+    }
+
+    /// True if the key has any values.
+    bool Contains(uint8_t key)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        return lists[key] != NULL;
+    }
+
+    /// Add a value to the end of the key's list, taking the place of an equal value.
+    void Put(uint8_t key, const T &value)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        List* list = new List;
+        if(lists[key])
+        {
+            list->SetCapacity(lists[key]->GetSize() + 1);
+            for(size_t i = 0; i < lists[key]->GetSize(); i++)
+            {
+                if(!((*lists[key])[i] == value))
+                    list->Push((*lists[key])[i]);
+            }
+        }
+        list->Push(value);
+        Swap(key, list);
+    }
+
+    /**
+     * Remove a value from the key's list.
+     *
+     * @return True if the value was there.
+     */
+    bool Delete(uint8_t key, const T &value)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        return DeleteValue(key, value);
+    }
+
+    /**
+     * Remove a value from the lists of all keys.
+     *
+     * @return True if the value was in any of them.
+     */
+    bool DeleteAll(const T &value)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        bool found = false;
+        for(size_t key = 0; key < DISPATCHTABLE_SIZE; key++)
+        {
+            if(DeleteValue((uint8_t)key, value))
+                found = true;
+        }
+        return found;
+    }
+
+    /**
+     * Remove all values of a key.
+     *
+     * @return True if the key had any.
+     */
+    bool DeleteKey(uint8_t key)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        if(!lists[key])
+            return false;
+        Swap(key, NULL);
+        return true;
+    }
+
+    /// Remove all values of all keys.
+    void Empty()
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        for(size_t key = 0; key < DISPATCHTABLE_SIZE; key++)
+        {
+            if(lists[key])
+                Swap((uint8_t)key, NULL);
+        }
+    }
+
+    /// Number of lists swapped out that still wait for snapshots to end.
+    size_t GetRetiredCount()
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        return retired.GetSize();
+    }
+
+private:
+    const List* Acquire(uint8_t key)
+    {
+        // Count the reader first, lists swapped out after this are kept.
+        CS::Threading::AtomicOperations::Increment(&readers);
+        return (const List*)CS::Threading::AtomicOperations::Read((void**)&lists[key]);
+    }
+
+    void Release()
+    {
+        if(CS::Threading::AtomicOperations::Decrement(&readers) == 0 &&
+           CS::Threading::AtomicOperations::Read(&retiredCount) != 0)
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            Reclaim();
+        }
+    }
+
+    /// Called with the mutex held.
+    bool DeleteValue(uint8_t key, const T &value)
+    {
+        if(!lists[key])
+            return false;
+
+        List* list = new List;
+        for(size_t i = 0; i < lists[key]->GetSize(); i++)
+        {
+            if(!((*lists[key])[i] == value))
+                list->Push((*lists[key])[i]);
+        }
+        if(list->GetSize() == lists[key]->GetSize())
+        {
+            delete list;
+            return false;
+        }
+
+        if(list->IsEmpty())
+        {
+            delete list;
+            list = NULL;
+        }
+        Swap(key, list);
+        return true;
+    }
+
+    /// Put a list in the table, called with the mutex held.
+    void Swap(uint8_t key, List* list)
+    {
+        List* old = (List*)CS::Threading::AtomicOperations::Set((void**)&lists[key], list);
+        if(old)
+        {
+            retired.Push(old);
+            CS::Threading::AtomicOperations::Set(&retiredCount, (int32)retired.GetSize());
+        }
+        Reclaim();
+    }
+
+    /**
+     * Delete the lists swapped out if there are no readers. Readers that
+     * start after the check only see the lists in the table. Called with
+     * the mutex held.
+     */
+    void Reclaim()
+    {
+        if(retired.IsEmpty() || CS::Threading::AtomicOperations::Read(&readers) != 0)
+            return;
+
+        for(size_t i = 0; i < retired.GetSize(); i++)
+        {
+            delete retired[i];
+        }
+        retired.Empty();
+        CS::Threading::AtomicOperations::Set(&retiredCount, 0);
+    }
+
+    List* lists[DISPATCHTABLE_SIZE];
+
+    /// Snapshots that are in scope.
+    int32 readers;
+
+    /// Lists swapped out while there were readers.
+    csArray<List*> retired;
+    int32 retiredCount;
+
+    /// Serializes the changes.
+    CS::Threading::Mutex mutex;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * dispatchtable_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/dispatchtable.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+TEST(DispatchTableTest, PutAndDelete)
+{
+    DispatchTable<int> table;
+    table.Put(3, 10);
+    table.Put(3, 20);
+    table.Put(7, 10);
+
+    {
+        DispatchTable<int>::Snapshot list(table, 3);
+        ASSERT_EQ(2u, list.GetSize());
+        EXPECT_EQ(10, list[0]);
+        EXPECT_EQ(20, list[1]);
+    }
+
+    // An equal value takes the place of the old one at the end.
+    table.Put(3, 10);
+    {
+        DispatchTable<int>::Snapshot list(table, 3);
+        ASSERT_EQ(2u, list.GetSize());
+        EXPECT_EQ(20, list[0]);
+        EXPECT_EQ(10, list[1]);
+    }
+
+    EXPECT_TRUE(table.Delete(3, 20));
+    EXPECT_FALSE(table.Delete(3, 20));
+    EXPECT_TRUE(table.DeleteAll(10));
+    EXPECT_FALSE(table.Contains(3));
+    EXPECT_FALSE(table.Contains(7));
+
+    DispatchTable<int>::Snapshot empty(table, 3);
+    EXPECT_EQ(0u, empty.GetSize());
+}
+
+TEST(DispatchTableTest, SnapshotOutlivesChanges)
+{
+    DispatchTable<int> table;
+    table.Put(1, 5);
+    table.Put(1, 6);
+
+    {
+        DispatchTable<int>::Snapshot list(table, 1);
+
+        // As a handler unsubscribing while it is called would.
+        table.Delete(1, 5);
+        table.DeleteKey(1);
+        table.Put(1, 7);
+        EXPECT_EQ(2u, table.GetRetiredCount());
+
+        ASSERT_EQ(2u, list.GetSize());
+        EXPECT_EQ(5, list[0]);
+        EXPECT_EQ(6, list[1]);
+
+        DispatchTable<int>::Snapshot current(table, 1);
+        ASSERT_EQ(1u, current.GetSize());
+        EXPECT_EQ(7, current[0]);
+    }
+
+    // Deleted with the last snapshot.
+    EXPECT_EQ(0u, table.GetRetiredCount());
+
+    // Without snapshots changes are deleted at once.
+    table.Put(1, 8);
+    EXPECT_EQ(0u, table.GetRetiredCount());
+}
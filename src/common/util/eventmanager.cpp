@@ -19,6 +19,7 @@
 #include <psconfig.h>
 
 #include "gameevent.h"
+#include "eventworkerpool.h"
 #include "util/consoleout.h"
 
 #include "net/messages.h"
@@ -29,7 +30,8 @@
 
 /*---------------------------------------------------------------------------*/
 
-EventManager::EventManager()
+EventManager::EventManager(bool timingWheel)
+    : eventwheel(csGetTicks()), useTimingWheel(timingWheel), workers(NULL), cancelCount(0)
 {
     // Setting up the static pointer in psGameEvent. Used so
     // that an event can be fired without needing to look up 
@@ -41,11 +43,39 @@ EventManager::EventManager()
 
 EventManager::~EventManager()
 {
+    // Stop the workers first, they delete the events they still have
+    delete workers;
+
     // Clean up the event queue
     while (eventqueue.Length())
     {
         delete eventqueue.DeleteMin();
     }
+    while (eventwheel.Length())
+    {
+        delete eventwheel.DeleteAny();
+    }
+    for (size_t i = 0; i < cancelled.GetSize(); i++)
+    {
+        delete cancelled[i];
+    }
+}
+
+void EventManager::StartWorkers(size_t count)
+{
+    CS_ASSERT(!workers);
+    if (count)
+    {
+        workers = new EventWorkerPool(count);
+    }
+}
+
+csString EventManager::GetWorkerStats()
+{
+    if (!workers)
+        return "none, all events are triggered by the main game thread";
+
+    return workers->GetStats();
 }
 
 void EventManager::Push(psGameEvent *event)
@@ -53,7 +83,10 @@ void EventManager::Push(psGameEvent *event)
     CS::Threading::MutexScopedLock lock(mutex);
 
     // This inserts the event into the priority queue, sorted by timestamp
-    eventqueue.Insert(event);
+    if (useTimingWheel)
+        eventwheel.Insert(event);
+    else
+        eventqueue.Insert(event);
 
     /*check if events are inserted late*/
     if (event->triggerticks < lastTick)
@@ -67,6 +100,22 @@ void EventManager::Push(psGameEvent *event)
     }
 }
 
+void EventManager::Cancel(psGameEvent *event)
+{
+    if (!useTimingWheel)
+        return;
+
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    // Not queued, e.g. it is being triggered right now.
+    if (!eventwheel.Contains(event))
+        return;
+
+    eventwheel.Remove(event);
+    cancelled.Push(event);
+    cancelCount++;
+}
+
 // Process events at least every 250 tick
 #define PROCESS_EVENT   250
 
@@ -80,20 +129,51 @@ csTicks EventManager::ProcessEventQueue()
     int events = 0;
     int count = 0;
 
+    if (useTimingWheel)
+    {
+        // Delete the events cancelled since the last run. The ones
+        // that were made valid again go back into the queue.
+        csArray<psGameEvent*> purge;
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            purge = cancelled;
+            cancelled.Empty();
+        }
+        for (size_t i = 0; i < purge.GetSize(); i++)
+        {
+            if (purge[i]->valid)
+                Push(purge[i]);
+            else
+                delete purge[i];
+        }
+    }
+
     while (true)
     {
 
         {
             CS::Threading::MutexScopedLock lock(mutex);
 
-            event = eventqueue.FindMin();
-
-            if (!event || event->triggerticks > now)
+            if (useTimingWheel)
             {
-                // Empty event queue or not time for event yet
-                break;
+                event = eventwheel.DeleteDue(now);
+                if (!event)
+                {
+                    // Nothing due yet
+                    break;
+                }
+            }
+            else
+            {
+                event = eventqueue.FindMin();
+
+                if (!event || event->triggerticks > now)
+                {
+                    // Empty event queue or not time for event yet
+                    break;
+                }
+                eventqueue.DeleteMin();
             }
-            eventqueue.DeleteMin();
 
             /*check if events arrive in order*/
             if (event->triggerticks < lastTick)
@@ -116,6 +196,15 @@ csTicks EventManager::ProcessEventQueue()
         
 
         events++;
+
+        if (workers && event->GetAffinity() != EVENT_AFFINITY_MAIN)
+        {
+            // The worker triggers and deletes it.
+            workers->Push(event);
+            event = NULL;
+            continue;
+        }
+
         csTicks start = csGetTicks();
 
         if (event->CheckTrigger())
@@ -152,6 +241,12 @@ csTicks EventManager::ProcessEventQueue()
         delete event;
     }
 
+    if (useTimingWheel)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        return csMin(eventwheel.GetNextTicks(), PROCESS_EVENT + now);
+    }
+
     if (event)
     {
         // We have a event so report when we would like to be
@@ -162,6 +257,22 @@ csTicks EventManager::ProcessEventQueue()
     return PROCESS_EVENT; // Process events at least every PROCESS_EVENT ticks
 }
 
+csString EventManager::GetQueueStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    csString stats;
+    if (useTimingWheel)
+    {
+        stats.Format("timing wheel, %zu pending, %zu cancelled early", eventwheel.Length(), cancelCount);
+    }
+    else
+    {
+        stats.Format("heap, %zu pending", eventqueue.Length());
+    }
+    return stats;
+}
+
 void EventManager::TrackEventTimes(csTicks timeTaken,MsgEntry *msg)
 {
 	static bool filled = false;
@@ -181,7 +292,8 @@ void EventManager::TrackEventTimes(csTicks timeTaken,MsgEntry *msg)
 	// Done this way to prevent a division operator
 	if(filled && timeTaken > 500 && (timeTaken * EVENT_AVERAGETIME_COUNT > 2 * eventtimesTotal || eventtimesTotal > EVENT_AVERAGETIME_COUNT * 1000))
 	{
-		status.Format("Message type %s has taken %u time to process, average time of events is %u", (const char *) GetMsgTypeName(msg->GetType()), timeTaken, eventtimesTotal / EVENT_AVERAGETIME_COUNT);
+		const char* handler = GetSlowestHandler();
+		status.Format("Message type %s has taken %u time to process, most of it in %s, average time of events is %u", (const char *) GetMsgTypeName(msg->GetType()), timeTaken, handler ? handler : "no handler", eventtimesTotal / EVENT_AVERAGETIME_COUNT);
 		CPrintf(CON_WARNING, "%s\n", status.GetData());
 		if(LogCSV::GetSingletonPtr())
 			LogCSV::GetSingleton().Write(CSV_STATUS, status);
@@ -261,6 +373,11 @@ public:
         str.Format("Delayed message of type : %d", myMsg->GetType());
         return str;
     }
+    virtual uint32 GetAffinity() const
+    {
+        // Queueing is thread-safe, keep the messages of a client in order.
+        return myMsg->clientnum;
+    }
     
 
 private:
@@ -21,10 +21,12 @@
 #define __EVENTMANAGER_H__
 
 #include "util/heap.h"
+#include "util/timingwheel.h"
 #include "net/msghandler.h"
 
 class psGameEvent;
 class MsgHandler;
+class EventWorkerPool;
 
 /**
  * \addtogroup common_util
@@ -36,12 +38,26 @@ class MsgHandler;
  * It maintains a queue ordered by trigger time and is polled by the engine
  * periodically to clear any queued events with trigger times less than the
  * current ticks time.
+ *
+ * The queue is either a heap or a timing wheel. The timing wheel inserts
+ * in constant time and takes events out of the queue as soon as they are
+ * invalidated with psGameEvent::SetValid(false), instead of keeping them
+ * until they expire.
  */
 class EventManager : public MsgHandler, public Singleton<EventManager>
 {
 protected:
     CS::Threading::Mutex mutex;
     Heap<psGameEvent> eventqueue;
+    TimingWheel<psGameEvent> eventwheel;
+    bool useTimingWheel;
+
+    /// Triggers the events that don't need the main game thread.
+    EventWorkerPool* workers;
+
+    /// Events taken out of the wheel, deleted by the event thread.
+    csArray<psGameEvent*> cancelled;
+    size_t cancelCount;
 
     csTicks lastTick;
 
@@ -52,7 +68,10 @@ protected:
 	void TrackEventTimes(csTicks timeTaken,MsgEntry *msg);
 
 public:
-    EventManager();
+    /**
+     * @param timingWheel Queue events in a timing wheel instead of a heap.
+     */
+    EventManager(bool timingWheel = false);
     virtual ~EventManager();
 
     // Thread main loop, handling timed events and inbound messages
@@ -61,12 +80,35 @@ public:
     // Called by external threads to make the Run() loop stop.
     void Stop() { stop = true; }
 
+    /**
+     * Start worker threads for the events that have an affinity.
+     *
+     * Must be called before the event thread is started.
+     *
+     * @param count The number of workers, 0 triggers every event in the main game thread.
+     */
+    void StartWorkers(size_t count);
+
+    /// Get the state of the event workers for the server console.
+    csString GetWorkerStats();
+
     /// Add new event to scheduler queue.
     void Push(psGameEvent *event);
 
+    /**
+     * Take an invalidated event out of the queue.
+     *
+     * Only the timing wheel supports this, the heap keeps the event
+     * until it expires. The event is deleted by the event thread later.
+     */
+    void Cancel(psGameEvent *event);
+
     /// Check Event Queue for scheduled events which are due
     csTicks ProcessEventQueue();
 
+    /// Get a line about the state of the queue for the server console.
+    csString GetQueueStats();
+
     /// Allows sending of a message not immediately, but after a short delay
     virtual void SendMessageDelayed(MsgEntry *msg,csTicks msecDelay);
 };
@@ -0,0 +1,161 @@
+/*
+ * eventworkerpool.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "gameevent.h"
+#include "eventworkerpool.h"
+
+EventWorkerPool::EventWorkerPool(size_t threadCount)
+{
+    stop = false;
+    sharedQueued = 0;
+    states.SetSize(threadCount);
+
+    for(size_t i = 0; i < threadCount; i++)
+    {
+        csRef<Worker> worker;
+        worker.AttachNew(new Worker(this, i));
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        threads.Push(thread);
+    }
+}
+
+EventWorkerPool::~EventWorkerPool()
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        condition.NotifyAll();
+    }
+
+    for(size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+
+    for(size_t i = 0; i < states.GetSize(); i++)
+    {
+        while(!states[i].queue.IsEmpty())
+        {
+            delete states[i].queue.Front().event;
+            states[i].queue.PopFront();
+        }
+    }
+    while(!shared.IsEmpty())
+    {
+        delete shared.Front().event;
+        shared.PopFront();
+    }
+}
+
+void EventWorkerPool::Push(psGameEvent* event)
+{
+    Entry entry;
+    entry.event = event;
+    entry.queued = csGetTicks();
+
+    uint32 affinity = event->GetAffinity();
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(affinity == EVENT_AFFINITY_ANY)
+    {
+        shared.PushBack(entry);
+        sharedQueued++;
+        condition.NotifyOne();
+    }
+    else
+    {
+        WorkerState &state = states[affinity % states.GetSize()];
+        state.queue.PushBack(entry);
+        state.queued++;
+
+        // The worker may be the one not woken by NotifyOne.
+        condition.NotifyAll();
+    }
+}
+
+bool EventWorkerPool::Take(size_t index, Entry &entry)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    WorkerState &state = states[index];
+    while(!stop)
+    {
+        // Own events first, they can't be run by anyone else.
+        csList<Entry>* from = NULL;
+        if(!state.queue.IsEmpty())
+        {
+            from = &state.queue;
+            state.queued--;
+        }
+        else if(!shared.IsEmpty())
+        {
+            from = &shared;
+            sharedQueued--;
+        }
+
+        if(from)
+        {
+            entry = from->Front();
+            from->PopFront();
+
+            csTicks latency = csGetTicks() - entry.queued;
+            state.triggered++;
+            state.totalLatency += latency;
+            state.maxLatency = csMax(state.maxLatency, latency);
+            return true;
+        }
+
+        condition.Wait(mutex);
+    }
+    return false;
+}
+
+void EventWorkerPool::Worker::Run()
+{
+    Entry entry;
+    while(pool->Take(index, entry))
+    {
+        if(entry.event->CheckTrigger())
+        {
+            entry.event->Trigger();
+        }
+        delete entry.event;
+    }
+}
+
+csString EventWorkerPool::GetStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    csString stats;
+    stats.Format("%zu workers, %zu shared queued", states.GetSize(), sharedQueued);
+    for(size_t i = 0; i < states.GetSize(); i++)
+    {
+        const WorkerState &state = states[i];
+        stats.AppendFmt("\n  worker %zu: %zu queued, %zu triggered, latency avg %.1f max %u ms",
+                        i, state.queued, state.triggered,
+                        state.triggered ? (float)state.totalLatency / (float)state.triggered : 0.0f,
+                        state.maxLatency);
+    }
+    return stats;
+}
@@ -0,0 +1,124 @@
+/*
+ * eventworkerpool.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __EVENTWORKERPOOL_H__
+#define __EVENTWORKERPOOL_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/list.h>
+#include <csutil/csstring.h>
+#include <csutil/threading/thread.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/condition.h>
+
+class psGameEvent;
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * Worker threads that trigger due events which don't need the main game
+ * thread, see psGameEvent::GetAffinity().
+ *
+ * Every worker has its own queue. Events with an affinity key always go to
+ * the same worker, so events of one key are triggered in the order they
+ * became due. Events with EVENT_AFFINITY_ANY go to a shared queue that idle
+ * workers take work from.
+ */
+class EventWorkerPool
+{
+public:
+    /**
+     * Start the worker threads.
+     *
+     * @param threads The number of workers.
+     */
+    EventWorkerPool(size_t threads);
+
+    /// Stops the workers, events that weren't triggered yet are deleted.
+    ~EventWorkerPool();
+
+    /**
+     * Queue a due event. The worker that triggers it also deletes it.
+     */
+    void Push(psGameEvent* event);
+
+    /// Get the queue depth and latency of each worker for the server console.
+    csString GetStats();
+
+private:
+    /// A queued event with the time it was queued at.
+    struct Entry
+    {
+        psGameEvent* event;
+        csTicks queued;
+    };
+
+    class Worker : public CS::Threading::Runnable
+    {
+    public:
+        Worker(EventWorkerPool* pool, size_t index) : pool(pool), index(index) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "EventWorker";
+        }
+
+    private:
+        EventWorkerPool* pool;
+        size_t index;
+    };
+
+    /// Statistics and queue of one worker.
+    struct WorkerState
+    {
+        csList<Entry> queue;
+        size_t queued;
+        size_t triggered;
+        uint64 totalLatency;
+        csTicks maxLatency;
+
+        WorkerState() : queued(0), triggered(0), totalLatency(0), maxLatency(0) {}
+    };
+
+    /**
+     * Wait for the next event of a worker.
+     *
+     * @return false when the pool is stopping.
+     */
+    bool Take(size_t index, Entry &entry);
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+    bool stop;
+
+    csArray<WorkerState> states;
+    csList<Entry> shared;       ///< Events any worker may take.
+    size_t sharedQueued;
+    csArray<csRef<CS::Threading::Thread> > threads;
+};
+
+/** @} */
+
+#endif
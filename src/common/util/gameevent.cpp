@@ -56,3 +56,11 @@ void psGameEvent::QueueEvent()
 {
     eventmanager->Push(this);
 }
+
+void psGameEvent::SetValid(bool valid)
+{
+    this->valid = valid;
+
+    if(!valid && eventmanager)
+        eventmanager->Cancel(this);
+}
@@ -22,12 +22,19 @@
 
 #include <csutil/csstring.h>
 
+#include "util/timingwheel.h"
+
 class EventManager;
 
 /**
  * \addtogroup common_util
  * @{ */
 
+/// Events with this affinity are triggered by the main game thread.
+#define EVENT_AFFINITY_MAIN 0
+/// Events with this affinity may be triggered by any event worker.
+#define EVENT_AFFINITY_ANY  0xFFFFFFFF
+
 /**
  * All scheduled events must inherit from this class.  These events are
  * queued by the EventManager and are passed to the various subscribed
@@ -45,6 +52,8 @@ public:
     static int nextid;      ///< id counter sequence
     bool valid;             ///< Set this to false if the trigger should not be fired.
 
+    TimingWheelNode<psGameEvent> wheelNode; ///< Used by the EventManager when queued in a timing wheel.
+
     /**
      * Construct a new game event. Set ticks to 0 if the event should
      * be fired at offset ticks from current time.
@@ -71,6 +80,24 @@ public:
         return valid;
     };
 
+    /**
+     * Get the affinity key of this event.
+     *
+     * Events that only work on the state of one actor or client can return
+     * a key for it, e.g. the EID or client number. When the event manager
+     * has event workers such events are triggered by the worker of that key,
+     * in order with the other events of the same key. Events that are
+     * thread-safe on their own can return EVENT_AFFINITY_ANY. All other
+     * events are triggered by the main game thread.
+     *
+     * Events with an affinity are deleted by the worker, so nothing else may
+     * keep a pointer to them once they are queued.
+     */
+    virtual uint32 GetAffinity() const
+    {
+        return EVENT_AFFINITY_MAIN;
+    }
+
     /**
      * Abstract event processing function
      *
@@ -83,14 +110,13 @@ public:
      * Set the valid flag.
      *
      * Setting of valid to false will if the CheckTrigger isn't overridden
-     * cause the Trigger not to be called.
+     * cause the Trigger not to be called. When the event manager uses a
+     * timing wheel the event is also taken out of the queue right away and
+     * deleted by the event thread, so it must not be used afterwards.
      *
      * @param valid The new value of the valid flag.
      */
-    virtual void SetValid(bool valid)
-    {
-        this->valid = valid;
-    }
+    virtual void SetValid(bool valid);
 
     /**
      * Return the valid flag.
@@ -0,0 +1,225 @@
+/*
+ * groundheightgrid.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+#include <math.h>
+#include <string.h>
+
+#include "util/groundheightgrid.h"
+
+GroundHeightGrid::GroundHeightGrid(float spacing, float bandHeight, float reach,
+                                   float maxStep, size_t maxSamples)
+    : spacing(spacing), bandHeight(bandHeight), reach(reach), maxStep(maxStep), maxSamples(maxSamples)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool GroundHeightGrid::Trace(iGroundTracer* tracer, const csVector3 &start, float depth, float &height)
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stats.traces++;
+        stats.complex++;
+    }
+    return tracer->TraceDown(start, depth, height);
+}
+
+bool GroundHeightGrid::GetHeight(iGroundTracer* tracer, const csVector3 &start, float depth, float &height)
+{
+    int band = (int)floorf(start.y / bandHeight);
+    float fx = start.x / spacing;
+    float fz = start.z / spacing;
+    int x = (int)floorf(fx);
+    int z = (int)floorf(fz);
+    GroundHeightGridKey cell(x, z, band);
+    GroundHeightGridKey vertex[4] =
+    {
+        GroundHeightGridKey(x, z, band),
+        GroundHeightGridKey(x + 1, z, band),
+        GroundHeightGridKey(x, z + 1, band),
+        GroundHeightGridKey(x + 1, z + 1, band)
+    };
+    Sample corner[4];
+    bool missing[4];
+
+    mutex.Lock();
+    stats.queries++;
+
+    // The samples reach at least reach below the start.
+    if(depth > reach || complexCells.In(cell))
+    {
+        mutex.Unlock();
+        return Trace(tracer, start, depth, height);
+    }
+
+    for(int i = 0; i < 4; i++)
+    {
+        const Sample* sample = samples.GetElementPointer(vertex[i]);
+        missing[i] = (sample == NULL);
+        if(sample)
+            corner[i] = *sample;
+    }
+    mutex.Unlock();
+
+    // Another thread may trace the same vertex meanwhile, both get the same.
+    // Samples start a spacing above the band, to find slopes rising past it.
+    size_t traced = 0;
+    float sampleTop = (band + 1) * bandHeight + spacing;
+    for(int i = 0; i < 4; i++)
+    {
+        if(!missing[i])
+            continue;
+
+        csVector3 point(vertex[i].x * spacing, sampleTop, vertex[i].z * spacing);
+        corner[i].hit = tracer->TraceDown(point, spacing + bandHeight + reach, corner[i].height);
+        traced++;
+    }
+
+    int hits = 0;
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    for(int i = 0; i < 4; i++)
+    {
+        if(!corner[i].hit)
+            continue;
+        if(!hits || corner[i].height < lowest)
+            lowest = corner[i].height;
+        if(!hits || corner[i].height > highest)
+            highest = corner[i].height;
+        hits++;
+    }
+    bool isComplex = (hits != 0 && hits != 4) || highest - lowest > maxStep;
+
+    mutex.Lock();
+    stats.traces += traced;
+    if(traced && samples.GetSize() + traced > maxSamples)
+    {
+        samples.Empty();
+        complexCells.Empty();
+    }
+    for(int i = 0; i < 4; i++)
+    {
+        if(missing[i])
+            samples.PutUnique(vertex[i], corner[i]);
+    }
+    if(isComplex)
+        complexCells.PutUnique(cell, true);
+    else
+        stats.cached++;
+    mutex.Unlock();
+
+    if(isComplex)
+        return Trace(tracer, start, depth, height);
+
+    if(!hits)
+        return false;
+
+    float tx = fx - x;
+    float tz = fz - z;
+    height = (corner[0].height * (1.0f - tx) + corner[1].height * tx) * (1.0f - tz)
+             + (corner[2].height * (1.0f - tx) + corner[3].height * tx) * tz;
+
+    // The beam would start below this ground and find whatever is under it.
+    if(height > start.y)
+    {
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            stats.cached--;
+        }
+        return Trace(tracer, start, depth, height);
+    }
+    return height >= start.y - depth;
+}
+
+void GroundHeightGrid::Clear()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    samples.Empty();
+    complexCells.Empty();
+}
+
+void GroundHeightGrid::ClearArea(const csVector3 &min, const csVector3 &max)
+{
+    // Vertex samples are beams from a spacing above their band down to
+    // reach below it. Cells touching the area are resampled.
+    int minX = (int)floorf(min.x / spacing) - 1;
+    int maxX = (int)floorf(max.x / spacing) + 1;
+    int minZ = (int)floorf(min.z / spacing) - 1;
+    int maxZ = (int)floorf(max.z / spacing) + 1;
+    int minBand = (int)floorf((min.y - spacing) / bandHeight) - 1;
+    int maxBand = (int)floorf((max.y + reach) / bandHeight) + 1;
+
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    size_t keys = (size_t)(maxX - minX + 1) * (size_t)(maxZ - minZ + 1) * (size_t)(maxBand - minBand + 1);
+    if(keys <= samples.GetSize() + complexCells.GetSize())
+    {
+        for(int band = minBand; band <= maxBand; band++)
+        {
+            for(int x = minX; x <= maxX; x++)
+            {
+                for(int z = minZ; z <= maxZ; z++)
+                {
+                    GroundHeightGridKey key(x, z, band);
+                    samples.DeleteAll(key);
+                    complexCells.DeleteAll(key);
+                }
+            }
+        }
+        return;
+    }
+
+    // Large areas, like terrains, look at all samples instead.
+    csArray<GroundHeightGridKey> dropped;
+    csHash<Sample, GroundHeightGridKey>::GlobalIterator it(samples.GetIterator());
+    while(it.HasNext())
+    {
+        GroundHeightGridKey key;
+        it.Next(key);
+        if(key.x >= minX && key.x <= maxX && key.z >= minZ && key.z <= maxZ &&
+                key.band >= minBand && key.band <= maxBand)
+            dropped.Push(key);
+    }
+    for(size_t i = 0; i < dropped.GetSize(); i++)
+    {
+        samples.DeleteAll(dropped[i]);
+    }
+
+    dropped.Empty();
+    csHash<bool, GroundHeightGridKey>::GlobalIterator cit(complexCells.GetIterator());
+    while(cit.HasNext())
+    {
+        GroundHeightGridKey key;
+        cit.Next(key);
+        if(key.x >= minX && key.x <= maxX && key.z >= minZ && key.z <= maxZ &&
+                key.band >= minBand && key.band <= maxBand)
+            dropped.Push(key);
+    }
+    for(size_t i = 0; i < dropped.GetSize(); i++)
+    {
+        complexCells.DeleteAll(dropped[i]);
+    }
+}
+
+GroundHeightGrid::Stats GroundHeightGrid::GetStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    Stats result = stats;
+    result.samples = samples.GetSize();
+    return result;
+}
@@ -0,0 +1,179 @@
+/*
+ * groundheightgrid.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * Description : A lazily filled grid of ground heights, so that entities
+ *               hugging the ground don't have to trace beams every frame.
+ *
+ */
+
+#ifndef __GROUNDHEIGHTGRID_H__
+#define __GROUNDHEIGHTGRID_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csgeom/vector3.h>
+#include <csutil/array.h>
+#include <csutil/hash.h>
+#include <csutil/threading/mutex.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * Finds the ground below a point, usually by tracing a beam against the
+ * collision meshes of a sector.
+ */
+class iGroundTracer
+{
+public:
+    virtual ~iGroundTracer() {}
+
+    /**
+     * Find the first surface straight below a point.
+     *
+     * @param start Where to start looking.
+     * @param depth How far down to look.
+     * @param height Set to the height of the surface found.
+     * @return false if there is no surface within depth.
+     */
+    virtual bool TraceDown(const csVector3 &start, float depth, float &height) = 0;
+};
+
+/**
+ * Key of one vertex or cell of the grid, in one height band.
+ */
+struct GroundHeightGridKey
+{
+    int x;
+    int z;
+    int band;
+
+    GroundHeightGridKey() : x(0), z(0), band(0) {}
+    GroundHeightGridKey(int x, int z, int band) : x(x), z(z), band(band) {}
+
+    bool operator == (const GroundHeightGridKey &other) const
+    {
+        return x == other.x && z == other.z && band == other.band;
+    }
+
+    bool operator < (const GroundHeightGridKey &other) const
+    {
+        if(band != other.band)
+            return band < other.band;
+        if(x != other.x)
+            return x < other.x;
+        return z < other.z;
+    }
+};
+
+template<> class csHashComputer<GroundHeightGridKey>
+{
+public:
+    static uint ComputeHash(const GroundHeightGridKey &key)
+    {
+        return (uint)(key.x * 73856093) ^ (uint)(key.z * 19349663) ^ (uint)(key.band * 83492791);
+    }
+};
+
+/**
+ * Ground heights of one sector, sampled on a regular grid as they are asked for.
+ *
+ * The world is cut into horizontal bands, so floors of a building above each
+ * other get samples of their own. A vertex sample is the first surface below
+ * a grid spacing above the top of its band, which finds slopes of up to 45
+ * degrees rising out of it. A query takes the band holding its start and
+ * interpolates the four vertices around it. Cells whose vertices are far
+ * apart in height, or where only some of them found ground, are marked
+ * complex: stairs, walls and ledges are traced for each query as before. So
+ * is ground interpolated above the start, a beam from the start wouldn't
+ * find it.
+ *
+ * The samples only hold while the geometry stays where it is. Whoever adds
+ * or removes meshes has to clear their area.
+ *
+ * Safe to use from several threads. Beams are traced without the lock held.
+ */
+class GroundHeightGrid
+{
+public:
+    /// Counters of the work done, for benchmarks and the console.
+    struct Stats
+    {
+        size_t queries;     ///< Heights asked for
+        size_t cached;      ///< Answered from the samples
+        size_t traces;      ///< Beams traced, for samples and for complex cells
+        size_t complex;     ///< Answered by tracing, because the samples couldn't tell
+        size_t samples;     ///< Vertex samples held
+    };
+
+    /**
+     * @param spacing Distance between the vertices of the grid.
+     * @param bandHeight Height of one band.
+     * @param reach How far below its band a vertex sample looks for ground.
+     *   Queries deeper than this are always traced.
+     * @param maxStep Highest difference between the vertices of a smooth cell.
+     * @param maxSamples The samples are dropped when there would be more.
+     */
+    GroundHeightGrid(float spacing = 1.0f, float bandHeight = 1.0f, float reach = 6.0f,
+                     float maxStep = 0.5f, size_t maxSamples = 262144);
+
+    /**
+     * Find the ground below a point, the same as tracing a beam down from it.
+     *
+     * @param tracer Traces the beams for missing samples and complex cells.
+     * @param start The point.
+     * @param depth How far below the point to look.
+     * @param height Set to the height of the ground.
+     * @return false if there is no ground.
+     */
+    bool GetHeight(iGroundTracer* tracer, const csVector3 &start, float depth, float &height);
+
+    /// Drop all samples, for example when the geometry changed.
+    void Clear();
+
+    /// Drop the samples that may have seen geometry within a box.
+    void ClearArea(const csVector3 &min, const csVector3 &max);
+
+    Stats GetStats();
+
+private:
+    struct Sample
+    {
+        bool hit;
+        float height;
+    };
+
+    /// The ground by tracing a beam, when the samples can't tell.
+    bool Trace(iGroundTracer* tracer, const csVector3 &start, float depth, float &height);
+
+    float spacing;
+    float bandHeight;
+    float reach;
+    float maxStep;
+    size_t maxSamples;
+
+    CS::Threading::Mutex mutex;
+    csHash<Sample, GroundHeightGridKey> samples;
+    csHash<bool, GroundHeightGridKey> complexCells;
+    Stats stats;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * groundheightgrid_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+#include <math.h>
+#include <stdio.h>
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/sysfunc.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/groundheightgrid.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+/**
+ * Rolling hills with a raised platform, a ledge of 2, and a bridge at 5
+ * over a valley.
+ */
+class TestTerrain : public iGroundTracer
+{
+public:
+    TestTerrain() : crate(false), traces(0) {}
+
+    static float Hills(float x, float z)
+    {
+        return 2.0f * sinf(x * 0.05f) * cosf(z * 0.07f);
+    }
+
+    static bool OnPlatform(float x, float z)
+    {
+        return x >= 20.0f && x <= 30.0f && z >= 20.0f && z <= 30.0f;
+    }
+
+    static bool UnderBridge(float x, float z)
+    {
+        return x >= 40.0f && x <= 50.0f && z >= -5.0f && z <= 5.0f;
+    }
+
+    /// A crate of 1 on the hills, while there is one.
+    bool OnCrate(float x, float z)
+    {
+        return crate && x >= -2.0f && x <= 2.0f && z >= -2.0f && z <= 2.0f;
+    }
+
+    virtual bool TraceDown(const csVector3 &start, float depth, float &height)
+    {
+        traces++;
+
+        float surfaces[2];
+        int count = 0;
+        surfaces[count++] = Hills(start.x, start.z) + (OnPlatform(start.x, start.z) ? 2.0f : 0.0f) +
+                            (OnCrate(start.x, start.z) ? 1.0f : 0.0f);
+        if(UnderBridge(start.x, start.z))
+            surfaces[count++] = 5.0f;
+
+        bool hit = false;
+        for(int i = 0; i < count; i++)
+        {
+            if(surfaces[i] > start.y || surfaces[i] < start.y - depth)
+                continue;
+            if(!hit || surfaces[i] > height)
+                height = surfaces[i];
+            hit = true;
+        }
+        return hit;
+    }
+
+    bool crate;
+    size_t traces;
+};
+
+static const float DEPTH = 5.0f;
+
+
+TEST(GroundHeightGridTest, SmoothTerrain)
+{
+    TestTerrain terrain;
+    GroundHeightGrid grid;
+
+    for(float x = -10.0f; x < 10.0f; x += 0.37f)
+    {
+        for(float z = -10.0f; z < 10.0f; z += 0.41f)
+        {
+            csVector3 start(x, TestTerrain::Hills(x, z) + 0.01f, z);
+            float height;
+            ASSERT_TRUE(grid.GetHeight(&terrain, start, DEPTH, height));
+            EXPECT_NEAR(TestTerrain::Hills(x, z), height, 0.01f);
+        }
+    }
+
+    GroundHeightGrid::Stats stats = grid.GetStats();
+    EXPECT_EQ(stats.queries, stats.cached);
+    EXPECT_EQ(0u, stats.complex);
+}
+
+TEST(GroundHeightGridTest, LedgesAreTraced)
+{
+    TestTerrain terrain;
+    GroundHeightGrid grid;
+
+    // Walk over the edge of the platform, along z = 25.
+    for(float x = 15.0f; x < 35.0f; x += 0.1f)
+    {
+        float ground = TestTerrain::Hills(x, 25.0f) + (TestTerrain::OnPlatform(x, 25.0f) ? 2.0f : 0.0f);
+        csVector3 start(x, ground + 0.01f, 25.0f);
+
+        float exact, height;
+        bool exactHit = terrain.TraceDown(start, DEPTH, exact);
+        ASSERT_EQ(exactHit, grid.GetHeight(&terrain, start, DEPTH, height));
+        if(exactHit)
+            EXPECT_NEAR(exact, height, 0.01f);
+    }
+
+    EXPECT_GT(grid.GetStats().complex, 0u);
+}
+
+TEST(GroundHeightGridTest, FloorsAboveEachOther)
+{
+    TestTerrain terrain;
+    GroundHeightGrid grid;
+
+    for(float x = 42.0f; x < 48.0f; x += 0.5f)
+    {
+        float height;
+        csVector3 below(x, TestTerrain::Hills(x, 0.0f) + 0.01f, 0.0f);
+        ASSERT_TRUE(grid.GetHeight(&terrain, below, DEPTH, height));
+        EXPECT_NEAR(TestTerrain::Hills(x, 0.0f), height, 0.01f);
+
+        csVector3 above(x, 5.01f, 0.0f);
+        ASSERT_TRUE(grid.GetHeight(&terrain, above, DEPTH, height));
+        EXPECT_NEAR(5.0f, height, 0.01f);
+    }
+}
+
+TEST(GroundHeightGridTest, ClearedArea)
+{
+    TestTerrain terrain;
+    GroundHeightGrid grid;
+
+    float height;
+    csVector3 start(0.5f, 3.0f, 0.5f);
+    csVector3 away(8.5f, 3.0f, 8.5f);
+    ASSERT_TRUE(grid.GetHeight(&terrain, start, DEPTH, height));
+    EXPECT_NEAR(TestTerrain::Hills(0.5f, 0.5f), height, 0.01f);
+    ASSERT_TRUE(grid.GetHeight(&terrain, away, DEPTH, height));
+
+    // The samples still hold the ground without the crate.
+    terrain.crate = true;
+    ASSERT_TRUE(grid.GetHeight(&terrain, start, DEPTH, height));
+    EXPECT_NEAR(TestTerrain::Hills(0.5f, 0.5f), height, 0.01f);
+
+    grid.ClearArea(csVector3(-2.0f, -1.0f, -2.0f), csVector3(2.0f, 2.0f, 2.0f));
+    ASSERT_TRUE(grid.GetHeight(&terrain, start, DEPTH, height));
+    EXPECT_NEAR(TestTerrain::Hills(0.5f, 0.5f) + 1.0f, height, 0.01f);
+
+    // Cells away from it keep their samples.
+    size_t traces = terrain.traces;
+    ASSERT_TRUE(grid.GetHeight(&terrain, away, DEPTH, height));
+    EXPECT_EQ(traces, terrain.traces);
+}
+
+/**
+ * Entities walking in circles, hugging the ground at the four corners of
+ * their feet each tick as psLinearMovement does. Counts the beams traced
+ * with and without the grid. The times are printed for comparison only,
+ * they depend on the machine.
+ */
+TEST(GroundHeightGridTest, Benchmark)
+{
+    const int entities = 50;
+    const int ticks = 1000;
+    const float legs = 0.5f;
+    const float offsets[4][2] = { { -legs, -legs }, { -legs, legs }, { legs, legs }, { legs, -legs } };
+
+    // The corners of the feet of all entities in all ticks.
+    TestTerrain locate;
+    csArray<csVector3> starts;
+    for(int tick = 0; tick < ticks; tick++)
+    {
+        for(int e = 0; e < entities; e++)
+        {
+            // Circles of 5 to 14 around points spread over the platform and bridge.
+            float angle = tick * 0.01f + e;
+            float radius = 5.0f + (e % 10);
+            float x = (e % 7) * 10.0f + radius * cosf(angle);
+            float z = (e / 7) * 10.0f - 20.0f + radius * sinf(angle);
+
+            float ground;
+            ASSERT_TRUE(locate.TraceDown(csVector3(x, 10.0f, z), 20.0f, ground));
+            for(int i = 0; i < 4; i++)
+            {
+                starts.Push(csVector3(x + offsets[i][0], ground + 0.01f, z + offsets[i][1]));
+            }
+        }
+    }
+
+    TestTerrain direct;
+    csArray<float> exact;
+    csArray<bool> exactHit;
+    csTicks begin = csGetTicks();
+    for(size_t i = 0; i < starts.GetSize(); i++)
+    {
+        float height = 0.0f;
+        exactHit.Push(direct.TraceDown(starts[i], DEPTH, height));
+        exact.Push(height);
+    }
+    csTicks directTime = csGetTicks() - begin;
+
+    TestTerrain cached;
+    GroundHeightGrid grid;
+    csArray<float> heights;
+    csArray<bool> hits;
+    begin = csGetTicks();
+    for(size_t i = 0; i < starts.GetSize(); i++)
+    {
+        float height = 0.0f;
+        hits.Push(grid.GetHeight(&cached, starts[i], DEPTH, height));
+        heights.Push(height);
+    }
+    csTicks cachedTime = csGetTicks() - begin;
+
+    // The beams of uphill corners start below the slope and miss it. The
+    // grid does too, unless the interpolation puts the slope just below the
+    // start.
+    float maxError = 0.0f;
+    size_t differ = 0;
+    for(size_t i = 0; i < starts.GetSize(); i++)
+    {
+        if(exactHit[i] != hits[i] || (hits[i] && fabsf(exact[i] - heights[i]) > 0.01f))
+        {
+            float ground;
+            csVector3 above(starts[i].x, starts[i].y + 10.0f, starts[i].z);
+            ASSERT_TRUE(locate.TraceDown(above, 20.0f, ground));
+            EXPECT_NEAR(starts[i].y, ground, 0.01f);
+            differ++;
+            continue;
+        }
+        if(exactHit[i])
+            maxError = csMax(maxError, fabsf(exact[i] - heights[i]));
+    }
+
+    GroundHeightGrid::Stats stats = grid.GetStats();
+    printf("Ground heights: %zu queries, %zu beams without the grid in %u ms, "
+           "%zu with it in %u ms (%zu complex, %zu samples), max error %.4f, %zu at the start\n",
+           stats.queries, direct.traces, directTime, cached.traces, cachedTime,
+           stats.complex, stats.samples, maxError, differ);
+
+    EXPECT_EQ(starts.GetSize(), direct.traces);
+    EXPECT_EQ(stats.traces, cached.traces);
+    // Half the corners are uphill on the hills and still traced.
+    EXPECT_LT(cached.traces * 3, direct.traces * 2);
+    EXPECT_LT(maxError, 0.01f);
+}
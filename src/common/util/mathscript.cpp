@@ -33,6 +33,7 @@
 #include "util/log.h"
 #include <csutil/randomgen.h>
 #include <csutil/xmltiny.h>
+#include <csutil/threading/mutex.h>
 
 #include "psdatabase.h"
 
@@ -139,12 +140,12 @@ void MathEnvironment::Init()
     // don't use Define here as it'd check the parent
     MathVar* env = new MathVar(this);
     env->SetValue(converter.value);
-    variables.Put("environment", env);
+    variables.Put(MathScriptEngine::GetVariableID("environment"), env);
 }
 
 MathEnvironment::~MathEnvironment()
 {
-    csHash<MathVar*, csString>::GlobalIterator it(variables.GetIterator());
+    csHash<MathVar*, uint32>::GlobalIterator it(variables.GetIterator());
     while (it.HasNext())
     {
         delete it.Next();
@@ -158,32 +159,48 @@ MathEnvironment::~MathEnvironment()
 
 MathVar* MathEnvironment::Lookup(const char *name) const
 {
-    MathVar *var = variables.Get(name, NULL);
-    if (!var && parent)
-        var = parent->Lookup(name);
+    // don't hand out IDs for names nobody defined
+    if (!MathScriptEngine::HasVariableID(name))
+        return NULL;
 
-    return var;
+    return Lookup(MathScriptEngine::GetVariableID(name));
+}
+
+MathVar* MathEnvironment::Lookup(uint32 id) const
+{
+    for (const MathEnvironment* env = this; env; env = env->parent)
+    {
+        MathVar *var = env->variables.Get(id, NULL);
+        if (var)
+            return var;
+    }
+    return NULL;
 }
 
 MathVar* MathEnvironment::GetVar(const char* name)
 {
-    MathVar *var = Lookup(name);
+    return GetVar(MathScriptEngine::GetVariableID(name));
+}
+
+MathVar* MathEnvironment::GetVar(uint32 id)
+{
+    MathVar *var = Lookup(id);
     if (!var)
     {
         var = new MathVar(this);
-        variables.Put(name,var);
+        variables.Put(id,var);
     }
     return var;
 }
 
 void MathEnvironment::DumpAllVars() const
 {
-    csString name;
-    csHash<MathVar*, csString>::ConstGlobalIterator it(variables.GetIterator());
+    uint32 id;
+    csHash<MathVar*, uint32>::ConstGlobalIterator it(variables.GetIterator());
     while (it.HasNext())
     {
-        MathVar *var = it.Next(name);
-        CPrintf(CON_DEBUG, "%25s = %s\n", name.GetData(), var->Dump().GetData());
+        MathVar *var = it.Next(id);
+        CPrintf(CON_DEBUG, "%25s = %s\n", MathScriptEngine::GetVariableName(id), var->Dump().GetData());
     }
 }
 
@@ -227,6 +244,12 @@ void MathEnvironment::Define(const char *name, const char* str)
     var->SetString(str);
 }
 
+void MathEnvironment::Define(uint32 id, double value)
+{
+    MathVar* var = GetVar(id);
+    var->SetValue(value);
+}
+
 bool MathEnvironment::HasString(const char* p) const
 {
     bool result = false;
@@ -384,8 +407,16 @@ double MathEnvironment::GetValue(iScriptableVar* p)
 
 //----------------------------------------------------------------------------
 
+/**
+ * Held while parsing, the names of variables, properties and string literals
+ * are shared by all scripts. Recursive as scripts parse their statements.
+ */
+static CS::Threading::RecursiveMutex parseMutex;
+
 MathStatement* MathStatement::Create(const csString & line, const char *name)
 {
+    CS::Threading::RecursiveMutexScopedLock lock(parseMutex);
+
     size_t assignAt = line.FindFirst('=');
     if (assignAt == SIZET_NOT_FOUND || assignAt == 0 || assignAt == line.Length())
         return NULL;
@@ -418,6 +449,7 @@ MathStatement* MathStatement::Create(const csString & line, const char *name)
         return NULL;
     }
 
+    stmt->assigneeID = MathScriptEngine::GetVariableID(assignee);
     stmt->opcode |= MATH_ASSIGN;
     return stmt;
 }
@@ -425,6 +457,13 @@ MathStatement* MathStatement::Create(const csString & line, const char *name)
 double MathStatement::Evaluate(MathEnvironment *env) const
 {
     double result = MathExpression::Evaluate(env);
+    env->Define(assigneeID, result);
+    return result;
+}
+
+double MathStatement::EvaluateByName(MathEnvironment *env) const
+{
+    double result = MathExpression::EvaluateByName(env);
     env->Define(assignee, result);
     return result;
 }
@@ -433,6 +472,8 @@ double MathStatement::Evaluate(MathEnvironment *env) const
 
 MathScript* MathScript::Create(const char *name, const csString & script)
 {
+    CS::Threading::RecursiveMutexScopedLock lock(parseMutex);
+
     MathScript* s = new MathScript(name);
 
     size_t start = 0;
@@ -638,9 +679,9 @@ void MathScript::CopyAndDestroy(MathScript* other)
     delete other;
 }
 
-double MathScript::Evaluate(MathEnvironment *env) const
+double MathScript::Run(MathEnvironment *env, bool byName) const
 {
-    MathVar *exitsignal = env->Lookup("exit");
+    MathVar *exitsignal = byName ? env->Lookup("exit") : env->Lookup(exitID);
     if (exitsignal)
     {
         exitsignal->SetValue(0); // clear exit condition before running
@@ -648,8 +689,11 @@ double MathScript::Evaluate(MathEnvironment *env) const
     else
     {
         // create exit signal if it doesn't exist
-        env->Define("exit",0.f);
-        exitsignal = env->Lookup("exit");
+        if (byName)
+            env->Define("exit",0.f);
+        else
+            env->Define(exitID,0.f);
+        exitsignal = byName ? env->Lookup("exit") : env->Lookup(exitID);
     }
 
     for (size_t i = 0; i < scriptLines.GetSize(); i++)
@@ -661,11 +705,11 @@ double MathScript::Evaluate(MathEnvironment *env) const
         if(op & MATH_LOOP)
         {
             MathExpression* l = scriptLines[i+1];
-            while(!(op & MATH_EXP) || s->Evaluate(env))
+            while(!(op & MATH_EXP) || EvaluateLine(s, env, byName))
             {
                 // code blocks(MathScript) shall return a value < 0 to
                 // signal an error/break
-                if (l->Evaluate(env) < 0)
+                if (EvaluateLine(l, env, byName) < 0)
                 {
                     break;
                 }
@@ -681,7 +725,7 @@ double MathScript::Evaluate(MathEnvironment *env) const
         // handle "return x;"
         else if(op & MATH_BREAK)
         {
-            return s->Evaluate(env);
+            return EvaluateLine(s, env, byName);
         }
         // handle "if { } [ else { } ]"
         else if(op == MATH_IF)
@@ -694,13 +738,13 @@ double MathScript::Evaluate(MathEnvironment *env) const
             }
 
             double result = 0;
-            if (s->Evaluate(env))
+            if (EvaluateLine(s, env, byName))
             {
-                result = scriptLines[i+1]->Evaluate(env);
+                result = EvaluateLine(scriptLines[i+1], env, byName);
             }
             else if (nextOp == MATH_ELSE)
             {
-                result = scriptLines[i+3]->Evaluate(env);
+                result = EvaluateLine(scriptLines[i+3], env, byName);
             }
             if(result < 0)
             {
@@ -721,7 +765,7 @@ double MathScript::Evaluate(MathEnvironment *env) const
         // handle regular expressions, e.g. assignments
         else if(op & MATH_EXP)
         {
-            s->Evaluate(env);
+            EvaluateLine(s, env, byName);
         }
 
         if(exitsignal && exitsignal->GetValue() != 0.0)
@@ -817,6 +861,48 @@ void MathScriptEngine::ReloadScripts(iDataConnection* db)
 csRandomGen MathScriptEngine::rng;
 csStringSet MathScriptEngine::customCompoundFunctions;
 csStringSet MathScriptEngine::stringLiterals;
+csStringSet MathScriptEngine::variableNames;
+csStringSet MathScriptEngine::propertyNames;
+csArray<PropertyID> MathScriptEngine::foldedProperties;
+
+PropertyID MathScriptEngine::GetPropertyID(const char* name)
+{
+    PropertyID id = propertyNames.Request(name);
+    if (id < foldedProperties.GetSize() && foldedProperties[id] != (PropertyID)~0)
+        return id;
+
+    // first time we see this name, record it's lower case spelling as well
+    csString folded(name);
+    folded.Downcase();
+    PropertyID foldedID = propertyNames.Request(folded);
+
+    size_t size = csMax(id, foldedID) + 1;
+    while (foldedProperties.GetSize() < size)
+        foldedProperties.Push((PropertyID)~0);
+    foldedProperties[id] = foldedID;
+    foldedProperties[foldedID] = foldedID;
+    return id;
+}
+
+MathPropertyIndex::MathPropertyIndex(const char* const* names, size_t count, bool caseSensitive)
+    : caseSensitive(caseSensitive)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        PropertyID id = MathScriptEngine::GetPropertyID(names[i]);
+        if (!caseSensitive)
+            id = MathScriptEngine::GetFoldedPropertyID(id);
+
+        while (index.GetSize() <= id)
+            index.Push(SIZET_NOT_FOUND);
+        index[id] = i;
+    }
+}
+
+double iScriptableVar::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    return GetProperty(env, MathScriptEngine::GetPropertyName(id));
+}
 
 double MathScriptEngine::RandomGen(const double *limit)
 {
@@ -900,6 +986,8 @@ MathExpression::MathExpression() : opcode(MATH_EXP)
 
 MathExpression* MathExpression::Create(const char *expression, const char *name)
 {
+    CS::Threading::RecursiveMutexScopedLock lock(parseMutex);
+
     MathExpression* exp = new MathExpression;
     exp->name = name;
 
@@ -1146,58 +1234,133 @@ bool MathExpression::Parse(const char *exp)
 
     if(!stringCount)
         fp.Optimize();
+
+    Compile();
     return true;
 }
 
-double MathExpression::Evaluate(MathEnvironment *env) const
+void MathExpression::Compile()
 {
-    double *values = new double [requiredVars.GetSize() + propertyRefs.GetSize()];
-    size_t i = 0;
-
-    // retrieve the values of all required variables
+    // same order as the variables were passed to the parser
+    csHash<size_t, csString> slots;
     csSet<csString>::GlobalIterator it(requiredVars.GetIterator());
     while (it.HasNext())
     {
         const csString & varName = it.Next();
-        MathVar *var = env->Lookup(varName);
+        slots.Put(varName, varIDs.GetSize());
+        varIDs.Push(MathScriptEngine::GetVariableID(varName));
+    }
+
+    csHash<size_t, csString> objects;
+    it = requiredObjs.GetIterator();
+    while (it.HasNext())
+    {
+        const csString & objName = it.Next();
+        objects.Put(objName, objSlots.GetSize());
+        objSlots.Push(slots.Get(objName, 0));
+    }
+
+    csSet<PropertyRef>::GlobalIterator propIt(propertyRefs.GetIterator());
+    while (propIt.HasNext())
+    {
+        const PropertyRef& ref = propIt.Next();
+        PropertySlot slot = {objects.Get(ref.object, 0), MathScriptEngine::GetPropertyID(ref.property)};
+        propertySlots.Push(slot);
+    }
+}
+
+double MathExpression::Evaluate(MathEnvironment *env) const
+{
+    size_t varCount = varIDs.GetSize();
+    CS_ALLOC_STACK_ARRAY(double, values, varCount + propertySlots.GetSize());
+    CS_ALLOC_STACK_ARRAY(MathVar*, vars, varCount);
+
+    // retrieve the values of all required variables
+    for (size_t i = 0; i < varCount; i++)
+    {
+        MathVar *var = env->Lookup(varIDs[i]);
 
         if (!var) // invalid variable
         {
             csString msg;
-            msg.Format("Error in >%s<: Required variable >%s< not supplied in environment.", name, varName.GetData());
+            msg.Format("Error in >%s<: Required variable >%s< not supplied in environment.", name, MathScriptEngine::GetVariableName(varIDs[i]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
-            delete [] values;
             return 0.0;
         }
-        values[i++] = var->GetValue();
+        vars[i] = var;
+        values[i] = var->GetValue();
     }
 
     // retrieve the objects requried to retrieve
     // calculated values or properties
-    it = requiredObjs.GetIterator();
-    while (it.HasNext())
+    CS_ALLOC_STACK_ARRAY(iScriptableVar*, objects, objSlots.GetSize() + 1);
+    for (size_t i = 0; i < objSlots.GetSize(); i++)
     {
-        const csString & objName = it.Next();
-        MathVar *var = env->Lookup(objName);
-
-        CS_ASSERT(var); // checked as part of requiredVars
+        MathVar *var = vars[objSlots[i]];
 
         if (var->Type() != VARTYPE_OBJ) // invalid type
         {
             csString msg;
-            msg.Format("Error in >%s<: Type inference requires >%s< to be an iScriptableVar, but it isn't.", name, objName.GetData());
+            msg.Format("Error in >%s<: Type inference requires >%s< to be an iScriptableVar, but it isn't.", name, MathScriptEngine::GetVariableName(varIDs[objSlots[i]]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
-            delete [] values;
             return 0.0;
         }
-        else if (!var->GetObject()) // invalid object
+
+        objects[i] = var->GetObject();
+        if (!objects[i]) // invalid object
         {
             csString msg;
-            msg.Format("Error in >%s<: Given a NULL iScriptableVar* for >%s<.", name, objName.GetData());
+            msg.Format("Error in >%s<: Given a NULL iScriptableVar* for >%s<.", name, MathScriptEngine::GetVariableName(varIDs[objSlots[i]]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
+            return 0.0;
+        }
+    }
+
+    // retrieve the required properties
+    for (size_t i = 0; i < propertySlots.GetSize(); i++)
+    {
+        const PropertySlot& slot = propertySlots[i];
+        values[varCount + i] = objects[slot.object]->GetPropertyByID(env, slot.property);
+    }
+
+    return fp.Eval(values);
+}
+
+double MathExpression::EvaluateByName(MathEnvironment *env) const
+{
+    double *values = new double [requiredVars.GetSize() + propertyRefs.GetSize()];
+    size_t i = 0;
+
+    // retrieve the values of all required variables
+    csSet<csString>::GlobalIterator it(requiredVars.GetIterator());
+    while (it.HasNext())
+    {
+        const csString & varName = it.Next();
+        MathVar *var = env->Lookup(varName);
+
+        if (!var) // invalid variable
+        {
+            Error3("Error in >%s<: Required variable >%s< not supplied in environment.", name, varName.GetData());
+            delete [] values;
+            return 0.0;
+        }
+        values[i++] = var->GetValue();
+    }
+
+    // retrieve the objects requried to retrieve
+    // calculated values or properties
+    it = requiredObjs.GetIterator();
+    while (it.HasNext())
+    {
+        const csString & objName = it.Next();
+        MathVar *var = env->Lookup(objName);
+
+        if (var->Type() != VARTYPE_OBJ || !var->GetObject()) // invalid type or object
+        {
+            Error3("Error in >%s<: >%s< is not a valid iScriptableVar.", name, objName.GetData());
             delete [] values;
             return 0.0;
         }
@@ -1208,13 +1371,7 @@ double MathExpression::Evaluate(MathEnvironment *env) const
     while (propIt.HasNext())
     {
         const PropertyRef& ref = propIt.Next();
-
-        MathVar *var = env->Lookup(ref.object);
-        CS_ASSERT(var); // checked as part of requiredVars
-
-        iScriptableVar *obj = var->GetObject();
-        CS_ASSERT(obj); // checked as part of requiredObjs
-
+        iScriptableVar *obj = env->Lookup(ref.object)->GetObject();
         values[i++] = obj->GetProperty(env,ref.property.GetData());
     }
 
@@ -1222,4 +1379,3 @@ double MathExpression::Evaluate(MathEnvironment *env) const
     delete [] values;
     return ret;
 }
-
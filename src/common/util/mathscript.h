@@ -56,6 +56,10 @@ protected:
 
     static csStringSet stringLiterals;
     static csStringSet customCompoundFunctions;
+    static csStringSet variableNames;
+    static csStringSet propertyNames;
+    /// ID of the lower case spelling of every property ID
+    static csArray<PropertyID> foldedProperties;
 
 
     csString mathScriptTable;
@@ -110,6 +114,42 @@ public:
         return customCompoundFunctions.Request(name);
     }
 
+    /**
+     * retrieve the ID of a variable name. Variables are stored and looked
+     * up by this ID, expressions resolve it once when they are parsed.
+     */
+    static uint32 GetVariableID(const char* name)
+    {
+        return variableNames.Request(name);
+    }
+
+    /// check whether a variable name ever got an ID.
+    static bool HasVariableID(const char* name)
+    {
+        return variableNames.Contains(name);
+    }
+
+    /// obtain a variable name based on it's ID
+    static const char* GetVariableName(uint32 ID)
+    {
+        return variableNames.Request(ID);
+    }
+
+    /// retrieve the ID of a property name, see iScriptableVar::GetPropertyByID.
+    static PropertyID GetPropertyID(const char* name);
+
+    /// retrieve the ID of the lower case spelling of a property, for case insensitive matching.
+    static PropertyID GetFoldedPropertyID(PropertyID ID)
+    {
+        return foldedProperties[ID];
+    }
+
+    /// obtain a property name based on it's ID
+    static const char* GetPropertyName(PropertyID ID)
+    {
+        return propertyNames.Request(ID);
+    }
+
     /// obtain a string literal based on it's actual ID
     static const char* Request(uint32 ID)
     {
@@ -180,6 +220,40 @@ public:
     static csString FormatMessage(const csString& formatString, size_t arg_count, const double* parms);
 };
 
+/// Expands to an enum value of a property for a MathPropertyIndex list.
+#define MATH_PROPERTY_ENUM(name) PROP_##name,
+/// Expands to the name of a property for a MathPropertyIndex list.
+#define MATH_PROPERTY_NAME(name) #name,
+
+/**
+ * Dispatch table for iScriptableVar::GetPropertyByID.
+ *
+ * A class lists its properties once, as a macro taking a macro:
+ * \code
+ * #define FOO_PROPERTIES(PROPERTY) PROPERTY(HP) PROPERTY(Mana)
+ * enum { FOO_PROPERTIES(MATH_PROPERTY_ENUM) };
+ * static const char* fooProperties[] = { FOO_PROPERTIES(MATH_PROPERTY_NAME) };
+ * \endcode
+ * and switches over the enum with the index returned by Find().
+ */
+class MathPropertyIndex
+{
+public:
+    MathPropertyIndex(const char* const* names, size_t count, bool caseSensitive = true);
+
+    /// get the position of a property in the list, SIZET_NOT_FOUND if it's not in it.
+    size_t Find(PropertyID id) const
+    {
+        if (!caseSensitive)
+            id = MathScriptEngine::GetFoldedPropertyID(id);
+        return id < index.GetSize() ? index[id] : SIZET_NOT_FOUND;
+    }
+
+private:
+    csArray<size_t> index; ///< position in the list of every property ID
+    bool caseSensitive;
+};
+
 /**
  * A specific MathEnvironment to be used in a MathScript.
  * This holds all currently defined variables in that environment
@@ -201,7 +275,10 @@ private:
     csStringSet stringLiterals;
 
     const MathEnvironment *parent;
-    csHash<MathVar*, csString> variables;
+    /// variables keyed by MathScriptEngine::GetVariableID()
+    csHash<MathVar*, uint32> variables;
+
+    MathVar* GetVar(uint32 id);
 
     void Init();
 
@@ -229,6 +306,9 @@ public:
     /// define a string variable in the environment
     void Define(const char *name, const char* str);
 
+    /// define a regular variable given the ID of it's name
+    void Define(uint32 id, double value);
+
     /// test whether we have an ID for a string.
     bool HasString(const char* p) const;
 
@@ -248,6 +328,9 @@ public:
     double GetValue(const char* p);
 
     MathVar* Lookup(const char *name) const;
+
+    /// look up a variable given the ID of it's name
+    MathVar* Lookup(uint32 id) const;
     void DumpAllVars() const;
 
     /// Perform string interpolation, i.e. replacing ${...} with the appropriate variable.
@@ -374,6 +457,25 @@ protected:
     csSet<PropertyRef> propertyRefs; ///< properties that have to be resolved prior to evaluation
     mutable FunctionParser fp;
 
+    /**
+     * The above resolved to slots when the expression is parsed, so evaluation
+     * doesn't need any string operations.
+     * The values passed to the parser are the variables in varIDs order,
+     * followed by the properties in propertySlots order.
+     */
+    struct PropertySlot
+    {
+        size_t object; ///< index in objSlots of the object to ask
+        PropertyID property;
+    };
+
+    csArray<uint32> varIDs; ///< IDs of the required variables
+    csArray<size_t> objSlots; ///< indices in varIDs of the variables that must be objects
+    csArray<PropertySlot> propertySlots;
+
+    /// Resolve the required variables and properties to slots.
+    void Compile();
+
     const char *name; // used for debugging
 
 public:
@@ -382,6 +484,13 @@ public:
     
     virtual double Evaluate(MathEnvironment *env) const;
 
+    /**
+     * Evaluate looking every variable and property up by name, as expressions
+     * did before they were resolved to slots. Only kept so the mathbench tool
+     * can time both paths in one run.
+     */
+    virtual double EvaluateByName(MathEnvironment *env) const;
+
     size_t GetOpcode() const
     {
         return opcode;
@@ -407,10 +516,12 @@ protected:
     MathStatement() { } // may only be constructed via MathStatement::Create
 
     csString assignee; ///< variable the result will be assinged to
+    uint32 assigneeID; ///< ID of the assignee's name
 
 public:
     static MathStatement* Create(const csString & expression, const char *name);
     double Evaluate(MathEnvironment *env) const;
+    double EvaluateByName(MathEnvironment *env) const;
 };
 
 /**
@@ -429,6 +540,11 @@ public:
     {
         return 0;
     }
+
+    double EvaluateByName(MathEnvironment* /*env*/) const
+    {
+        return 0;
+    }
 };
 
 
@@ -442,10 +558,20 @@ public:
 class MathScript : private MathExpression
 {
 protected:
-    MathScript(const char *name) : name(name) { } // may only be constructed using MathScript::Create
+    // may only be constructed using MathScript::Create
+    MathScript(const char *name) : name(name), exitID(MathScriptEngine::GetVariableID("exit")) { }
     csString name;
+    uint32 exitID;
     csArray<MathExpression*> scriptLines;
 
+    /// Run the lines, by name as MathExpression::EvaluateByName() or through the slots.
+    double Run(MathEnvironment *env, bool byName) const;
+
+    static double EvaluateLine(const MathExpression* line, MathEnvironment *env, bool byName)
+    {
+        return byName ? line->EvaluateByName(env) : line->Evaluate(env);
+    }
+
 public:
     static MathScript* Create(const char *name, const csString & script);
     static void Destroy(MathScript* &mathScript);
@@ -459,7 +585,16 @@ public:
 
     void CopyAndDestroy(MathScript* other);
 
-    double Evaluate(MathEnvironment *env) const;
+    double Evaluate(MathEnvironment *env) const
+    {
+        return Run(env, false);
+    }
+
+    /// see MathExpression::EvaluateByName()
+    double EvaluateByName(MathEnvironment *env) const
+    {
+        return Run(env, true);
+    }
 };
 
 /** @} */
@@ -75,21 +75,21 @@ TEST(MathScriptTest, BasicScript)
 class Foo : public iScriptableVar
 {
 public:
-    virtual double GetProperty(const char *prop)
+    virtual double GetProperty(MathEnvironment* /*env*/, const char *prop)
     {
         if (strcmp(prop, "TheAnswer") == 0)
             return 42;
 
         return 0.0;
     }
-    virtual double CalcFunction(const char *function, const double *params)
+    virtual double CalcFunction(MathEnvironment* env, const char *function, const double *params)
     {
         if (strcmp(function, "Multiply") == 0)
             return params[0]*params[1];
 
         if (strcmp(function, "GetSkillRank") == 0)
         {
-            csString skill(MathScriptEngine::GetString(params[0]));
+            csString skill(env->GetString(params[0]));
             if (skill == "Lah'ar")
                 return 77;
             if (skill == "Sword")
@@ -121,6 +121,73 @@ TEST(MathScriptTest, BasicProperty)
     EXPECT_EQ(42, exp->Evaluate(&env));
 }
 
+/// Answers TheAnswer through the property ID instead of the name.
+class FooByID : public Foo
+{
+public:
+    virtual double GetPropertyByID(MathEnvironment* /*env*/, PropertyID id)
+    {
+        if (id == MathScriptEngine::GetPropertyID("TheAnswer"))
+            return 43;
+
+        return 0.0;
+    }
+};
+
+TEST(MathScriptTest, PropertyByID)
+{
+    FooByID foo;
+    MathExpression *exp = MathExpression::Create("Quux:TheAnswer");
+    MathEnvironment env;
+    ASSERT_NE(exp, NULL);
+    env.Define("Quux", &foo);
+    EXPECT_EQ(43, exp->Evaluate(&env));
+}
+
+TEST(MathScriptTest, EvaluateByName)
+{
+    Foo foo;
+    MathScript *script = MathScript::Create("ByName", "C = (F - 32) * 5/9; A = Quux:TheAnswer + C");
+    ASSERT_NE(script, NULL);
+    MathEnvironment env;
+    env.Define("F", 212.0);
+    env.Define("Quux", &foo);
+    script->EvaluateByName(&env);
+    EXPECT_EQ(142.0, env.Lookup("A")->GetValue());
+    env.Define("F", 32.0);
+    script->Evaluate(&env);
+    EXPECT_EQ(42.0, env.Lookup("A")->GetValue());
+    MathScript::Destroy(script);
+}
+
+TEST(MathScriptTest, PropertyIndex)
+{
+    static const char* names[] = { "HP", "MaxHP", "combatstance" };
+    MathPropertyIndex exact(names, 3);
+    MathPropertyIndex folded(names, 3, false);
+
+    EXPECT_EQ(1u, exact.Find(MathScriptEngine::GetPropertyID("MaxHP")));
+    EXPECT_EQ(SIZET_NOT_FOUND, exact.Find(MathScriptEngine::GetPropertyID("maxhp")));
+    EXPECT_EQ(SIZET_NOT_FOUND, exact.Find(MathScriptEngine::GetPropertyID("Mana")));
+    EXPECT_EQ(2u, folded.Find(MathScriptEngine::GetPropertyID("CombatStance")));
+    EXPECT_EQ(0u, folded.Find(MathScriptEngine::GetPropertyID("hp")));
+    EXPECT_STREQ("CombatStance", MathScriptEngine::GetPropertyName(MathScriptEngine::GetPropertyID("CombatStance")));
+}
+
+TEST(MathScriptTest, ParentEnvironment)
+{
+    MathExpression *exp = MathExpression::Create("X + Y");
+    ASSERT_NE(exp, NULL);
+    MathEnvironment parent;
+    parent.Define("X", 2);
+    parent.Define("Y", 3);
+    MathEnvironment env(&parent);
+    env.Define("Y", 5);
+    EXPECT_EQ(7, exp->Evaluate(&env));
+    EXPECT_EQ(5, exp->Evaluate(&parent));
+    EXPECT_EQ(NULL, env.Lookup("NeverDefined"));
+}
+
 TEST(MathScriptTest, BasicMethod)
 {
     Foo foo;
@@ -111,5 +111,17 @@ void psDatabase::Close()
     db = NULL;
 }
 
+DBCommandCheck::DBCommandCheck(const char* what, unsigned long rows)
+    : what(what), rows(rows)
+{
+}
 
+void DBCommandCheck::QueryDone(unsigned long result, const char* error)
+{
+    if (result == QUERY_FAILED)
+        Error3("%s\nError returned was <%s>", what.GetData(), error ? error : "");
+    else if (rows != QUERY_FAILED && result != rows)
+        Error3("%s\n%lu rows affected", what.GetData(), result);
 
+    delete this;
+}
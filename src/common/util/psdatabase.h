@@ -23,6 +23,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <csutil/csstring.h>
+
 #include <idal.h>      // Database Abstraction Layer Interface
 
 struct iObjectRegistry;
@@ -153,6 +155,28 @@ struct Result
     unsigned long Count(void) { return rs->Count(); }
 };
 
+/**
+ * Reports a command queued with iDataConnection::CommandPump() that failed,
+ * or didn't affect the rows expected, for callers that only log the outcome.
+ * Deletes itself when the command is done.
+ */
+class DBCommandCheck : public iQueryCallback
+{
+public:
+    /**
+     * @param what   The error to log, usually with the command in it.
+     * @param rows   The rows the command should affect, QUERY_FAILED to only
+     *               report failed commands.
+     */
+    DBCommandCheck(const char* what, unsigned long rows = QUERY_FAILED);
+
+    virtual void QueryDone(unsigned long result, const char* error);
+
+private:
+    csString what;
+    unsigned long rows;
+};
+
 
 
 /** @} */
@@ -132,7 +132,7 @@ bool psPathPoint::Create(iDataConnection * db, int pathID)
 
 bool psPathPoint::Remove(iDataConnection * db)
 {
-    int result = db->CommandPump("DELETE from sc_path_points WHERE id=%d",id);
+    int result = db->Command("DELETE from sc_path_points WHERE id=%d",id);
 
     return (result == 1);
 }
@@ -144,7 +144,7 @@ bool psPathPoint::UpdatePrevPointId(iDataConnection * db, int prevPointId)
     {
         SetPrevious(prevPointId);
         
-        int result = db->CommandPump("UPDATE sc_path_points SET prev_point=%d WHERE id=%d",
+        int result = db->Command("UPDATE sc_path_points SET prev_point=%d WHERE id=%d",
                                  this->prevPointId,id);
 
         return (result == 1);
@@ -157,9 +157,9 @@ bool psPathPoint::UpdatePrevPointId(iDataConnection * db, int prevPointId)
 
 bool psPathPoint::Adjust(iDataConnection * db, csVector3 & pos, csString sector)
 {
-    int result = db->CommandPump("UPDATE sc_path_points SET x=%.2f,y=%.2f,z=%.2f,"
-                                 "loc_sector_id=(select id from sectors where name='%s') WHERE id=%d",
-                                 pos.x,pos.y,pos.z,sector.GetDataSafe(),id);
+    int result = db->Command("UPDATE sc_path_points SET x=%.2f,y=%.2f,z=%.2f,"
+                             "loc_sector_id=(select id from sectors where name='%s') WHERE id=%d",
+                             pos.x,pos.y,pos.z,sector.GetDataSafe(),id);
 
     Adjust(pos,sector);
 
@@ -776,8 +776,8 @@ bool psPath::SetFlag(iDataConnection * db, const csString &flagstr, bool enable)
         return false;
     }
 
-    int result = db->CommandPump("UPDATE sc_waypoint_links SET flags='%s' WHERE id=%d",
-                                 GetFlags().GetDataSafe(), id);
+    int result = db->Command("UPDATE sc_waypoint_links SET flags='%s' WHERE id=%d",
+                             GetFlags().GetDataSafe(), id);
     if (result != 1)
     {
         Error2("Sql failed: %s\n",db->GetLastError());
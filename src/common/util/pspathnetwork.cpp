@@ -42,6 +42,180 @@
 //====================================================================================
 #include "pspathnetwork.h"
 
+/// Number of cached routes at which the routes that weren't used again are dropped.
+#define ROUTE_CACHE_SIZE 4096
+
+static int CompareWaypointX(Waypoint* const &a, Waypoint* const &b)
+{
+    if (a->loc.pos.x < b->loc.pos.x)
+        return -1;
+    if (a->loc.pos.x > b->loc.pos.x)
+        return 1;
+    return 0;
+}
+
+/**
+ * Get the index of the first waypoint at or past x in waypoints sorted by x.
+ */
+static size_t LowerBoundX(const csArray<Waypoint*>& waypoints, float x)
+{
+    size_t low = 0;
+    size_t high = waypoints.GetSize();
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (waypoints[mid]->loc.pos.x < x)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static inline void CheckNearest(Waypoint* wp, float dist, Waypoint*& min_wp, float& min_range)
+{
+    if (min_range < 0 || dist < min_range)
+    {
+        min_range = dist;
+        min_wp = wp;
+    }
+}
+
+/**
+ * The open set of a route search. A binary heap ordered by the distance from
+ * the start plus the estimate to the end. Every waypoint knows its place in
+ * the heap, so a shorter distance found later moves it up instead of adding
+ * it again.
+ */
+class WaypointHeap
+{
+public:
+    bool IsEmpty() const
+    {
+        return heap.IsEmpty();
+    }
+
+    /// Add a waypoint, or move it up if its distance got shorter.
+    void Push(Waypoint* wp)
+    {
+        if (wp->heapIndex == csArrayItemNotFound)
+        {
+            wp->heapIndex = heap.Push(wp);
+        }
+        Up(wp->heapIndex);
+    }
+
+    Waypoint* Pop()
+    {
+        Waypoint* top = heap[0];
+        Waypoint* last = heap.Pop();
+        if (!heap.IsEmpty())
+        {
+            heap[0] = last;
+            last->heapIndex = 0;
+            Down(0);
+        }
+        top->heapIndex = csArrayItemNotFound;
+        return top;
+    }
+
+private:
+    static float Key(const Waypoint* wp)
+    {
+        return wp->distance + wp->estimate;
+    }
+
+    void Place(Waypoint* wp, size_t index)
+    {
+        heap[index] = wp;
+        wp->heapIndex = index;
+    }
+
+    void Up(size_t index)
+    {
+        Waypoint* wp = heap[index];
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (Key(heap[parent]) <= Key(wp))
+                break;
+            Place(heap[parent], index);
+            index = parent;
+        }
+        Place(wp, index);
+    }
+
+    void Down(size_t index)
+    {
+        Waypoint* wp = heap[index];
+        size_t size = heap.GetSize();
+        while (true)
+        {
+            size_t child = index * 2 + 1;
+            if (child >= size)
+                break;
+            if (child + 1 < size && Key(heap[child + 1]) < Key(heap[child]))
+                child++;
+            if (Key(wp) <= Key(heap[child]))
+                break;
+            Place(heap[child], index);
+            index = child;
+        }
+        Place(wp, index);
+    }
+
+    csArray<Waypoint*> heap;
+};
+
+psPathNetwork::SectorIndex::~SectorIndex()
+{
+    Clear();
+}
+
+void psPathNetwork::SectorIndex::Clear()
+{
+    csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(sectors.GetIterator());
+    while (it.HasNext())
+    {
+        delete it.Next();
+    }
+    sectors.DeleteAll();
+    count = 0;
+}
+
+void psPathNetwork::SectorIndex::Add(Waypoint* wp, iEngine* engine)
+{
+    iSector* sector = wp->GetSector(engine);
+    SectorWaypoints* wps = sectors.Get(sector, NULL);
+    if (!wps)
+    {
+        wps = new SectorWaypoints;
+        wps->maxRadius = 0.0;
+        sectors.Put(sector, wps);
+    }
+    wps->waypoints.Push(wp);
+    wps->maxRadius = csMax(wps->maxRadius, wp->loc.radius);
+    count++;
+}
+
+void psPathNetwork::SectorIndex::Sort()
+{
+    csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(sectors.GetIterator());
+    while (it.HasNext())
+    {
+        it.Next()->waypoints.Sort(CompareWaypointX);
+    }
+}
+
+psPathNetwork::psPathNetwork()
+    : world(NULL), indexValid(false), unresolved(0), cacheHits(0), cacheMisses(0)
+{
+}
+
 bool psPathNetwork::Load(iEngine *engine, iDataConnection *db,psWorld * world)
 {
     // First initialize pointers to some importent classes
@@ -140,6 +314,7 @@ bool psPathNetwork::Load(iEngine *engine, iDataConnection *db,psWorld * world)
         }
     }
     
+    Invalidate();
     
     return true;
 }
@@ -156,6 +331,7 @@ size_t psPathNetwork::AddWaypointToGroup(csString group, Waypoint * wp)
     }
 
     waypointGroups[index].PushBack(wp);
+    indexValid = false;
     
     return index;
 }
@@ -163,6 +339,18 @@ size_t psPathNetwork::AddWaypointToGroup(csString group, Waypoint * wp)
 
 Waypoint *psPathNetwork::FindWaypoint(int id)
 {
+    if (!indexValid)
+    {
+        BuildIndex();
+    }
+
+    Waypoint *found = waypointsByID.Get(id, NULL);
+    if (found && found->loc.id == id)
+    {
+        return found;
+    }
+
+    // The id may have been set after the waypoint was indexed.
     csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
     Waypoint *wp;
 
@@ -219,17 +407,45 @@ Waypoint *psPathNetwork::FindWaypoint(const char * name, WaypointAlias** alias)
 
 Waypoint *psPathNetwork::FindWaypoint(const csVector3& v, iSector *sector)
 {
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
+    SectorIndex* index = GetIndex();
 
-    while (iter.HasNext())
+    // No waypoint of the sector is further away along x than the largest radius.
+    SectorWaypoints* wps = index->Get(sector);
+    if (wps)
     {
-        Waypoint *wp = iter.Next();
+        for (size_t i = LowerBoundX(wps->waypoints, v.x - wps->maxRadius); i < wps->waypoints.GetSize(); i++)
+        {
+            Waypoint *wp = wps->waypoints[i];
+            if (wp->loc.pos.x > v.x + wps->maxRadius)
+            {
+                break;
+            }
+            if ((wp->loc.pos - v).Norm() < wp->loc.radius)
+            {
+                return wp;
+            }
+        }
+    }
 
-        float dist = world->Distance(v,sector,wp->loc.pos,wp->GetSector(engine));
-        
-        if (dist < wp->loc.radius)
+    // Waypoints of sectors connected through a warp portal.
+    csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(index->sectors.GetIterator());
+    while (it.HasNext())
+    {
+        csPtrKey<iSector> key;
+        wps = it.Next(key);
+        iSector* other = key;
+        if (other == sector || !world->Connected(other, sector))
         {
-            return wp;
+            continue;
+        }
+
+        for (size_t i = 0; i < wps->waypoints.GetSize(); i++)
+        {
+            Waypoint *wp = wps->waypoints[i];
+            if (world->Distance(v,sector,wp->loc.pos,other) < wp->loc.radius)
+            {
+                return wp;
+            }
         }
     }
 
@@ -238,48 +454,171 @@ Waypoint *psPathNetwork::FindWaypoint(const csVector3& v, iSector *sector)
 
 Waypoint *psPathNetwork::FindNearestWaypoint(const csVector3& v,iSector *sector, float range, float * found_range)
 {
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
-    Waypoint *wp;
+    return FindNearestWaypoint(GetIndex(), v, sector, range, found_range);
+}
+
+Waypoint *psPathNetwork::FindRandomWaypoint(const csVector3& v,iSector *sector, float range, float * found_range)
+{
+    return FindRandomWaypoint(GetIndex(), v, sector, range, found_range);
+}
+
+Waypoint *psPathNetwork::FindNearestWaypoint(int group, const csVector3& v,iSector *sector, float range, float * found_range)
+{
+    return FindNearestWaypoint(GetIndex(group), v, sector, range, found_range);
+}
+
+Waypoint *psPathNetwork::FindRandomWaypoint(int group, const csVector3& v,iSector *sector, float range, float * found_range)
+{
+    return FindRandomWaypoint(GetIndex(group), v, sector, range, found_range);
+}
 
+Waypoint *psPathNetwork::FindNearestWaypoint(SectorIndex* index, const csVector3& v, iSector *sector, float range, float * found_range)
+{
     float min_range = range;
 
     Waypoint *min_wp = NULL;
 
-    while (iter.HasNext())
+    // Walk away from v.x in both directions. A direction is done once the
+    // distance along x alone is out of range.
+    SectorWaypoints* wps = index->Get(sector);
+    if (wps)
     {
-        wp = iter.Next();
+        const csArray<Waypoint*>& list = wps->waypoints;
+        size_t up = LowerBoundX(list, v.x);
+        size_t down = up;
+        while (up < list.GetSize() || down > 0)
+        {
+            if (up < list.GetSize())
+            {
+                Waypoint *wp = list[up++];
+                if (min_range >= 0 && wp->loc.pos.x - v.x >= min_range)
+                {
+                    up = list.GetSize();
+                }
+                else
+                {
+                    CheckNearest(wp, (wp->loc.pos - v).Norm(), min_wp, min_range);
+                }
+            }
+            if (down > 0)
+            {
+                Waypoint *wp = list[--down];
+                if (min_range >= 0 && v.x - wp->loc.pos.x >= min_range)
+                {
+                    down = 0;
+                }
+                else
+                {
+                    CheckNearest(wp, (wp->loc.pos - v).Norm(), min_wp, min_range);
+                }
+            }
+        }
+    }
 
-        float dist2 = world->Distance(v,sector,wp->loc.pos,wp->GetSector(engine));
-        
-        if (min_range < 0 || dist2 < min_range)
+    // Waypoints of sectors connected through a warp portal.
+    csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(index->sectors.GetIterator());
+    while (it.HasNext())
+    {
+        csPtrKey<iSector> key;
+        wps = it.Next(key);
+        iSector* other = key;
+        if (other == sector || !world->Connected(other, sector))
         {
-            min_range = dist2;
-            min_wp = wp;
+            continue;
+        }
+
+        for (size_t i = 0; i < wps->waypoints.GetSize(); i++)
+        {
+            Waypoint *wp = wps->waypoints[i];
+            CheckNearest(wp, world->Distance(v,sector,wp->loc.pos,other), min_wp, min_range);
         }
     }
+
+    // Without a range any waypoint will do, even one at an unknown distance.
+    if (!min_wp && range < 0 && index->count)
+    {
+        csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator first(index->sectors.GetIterator());
+        min_wp = first.Next()->waypoints[0];
+        min_range = INFINITY_DISTANCE;
+    }
+
     if (min_wp && found_range) *found_range = min_range;
 
     return min_wp;
 }
 
-Waypoint *psPathNetwork::FindRandomWaypoint(const csVector3& v,iSector *sector, float range, float * found_range)
+Waypoint *psPathNetwork::FindRandomWaypoint(SectorIndex* index, const csVector3& v, iSector *sector, float range, float * found_range)
 {
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
-    Waypoint *wp;
+    if (range < 0)
+    {
+        // Every waypoint is a candidate, only the picked one needs a distance.
+        if (!index->count)
+        {
+            return NULL;
+        }
+
+        size_t pick = psGetRandom((uint32)index->count);
+
+        csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(index->sectors.GetIterator());
+        while (it.HasNext())
+        {
+            csPtrKey<iSector> key;
+            SectorWaypoints* wps = it.Next(key);
+            if (pick < wps->waypoints.GetSize())
+            {
+                Waypoint *wp = wps->waypoints[pick];
+                if (found_range) *found_range = sqrt(world->Distance(v,sector,wp->loc.pos,key));
+                return wp;
+            }
+            pick -= wps->waypoints.GetSize();
+        }
+        return NULL;
+    }
 
     csArray<Waypoint*> nearby;
     csArray<float> dist;
- 
-    while (iter.HasNext())
+
+    SectorWaypoints* wps = index->Get(sector);
+    if (wps)
     {
-        wp = iter.Next();
+        for (size_t i = LowerBoundX(wps->waypoints, v.x - range); i < wps->waypoints.GetSize(); i++)
+        {
+            Waypoint *wp = wps->waypoints[i];
+            if (wp->loc.pos.x > v.x + range)
+            {
+                break;
+            }
 
-        float dist2 = world->Distance(v,sector,wp->loc.pos,wp->GetSector(engine));
-        
-        if (range < 0 || dist2 < range)
+            float dist2 = (wp->loc.pos - v).Norm();
+            if (dist2 < range)
+            {
+                nearby.Push(wp);
+                dist.Push(dist2);
+            }
+        }
+    }
+
+    // Waypoints of sectors connected through a warp portal.
+    csHash<SectorWaypoints*, csPtrKey<iSector> >::GlobalIterator it(index->sectors.GetIterator());
+    while (it.HasNext())
+    {
+        csPtrKey<iSector> key;
+        wps = it.Next(key);
+        iSector* other = key;
+        if (other == sector || !world->Connected(other, sector))
         {
-            nearby.Push(wp);
-            dist.Push(dist2);
+            continue;
+        }
+
+        for (size_t i = 0; i < wps->waypoints.GetSize(); i++)
+        {
+            Waypoint *wp = wps->waypoints[i];
+            float dist2 = world->Distance(v,sector,wp->loc.pos,other);
+            if (dist2 < range)
+            {
+                nearby.Push(wp);
+                dist.Push(dist2);
+            }
         }
     }
 
@@ -296,64 +635,65 @@ Waypoint *psPathNetwork::FindRandomWaypoint(const csVector3& v,iSector *sector,
     return NULL;
 }
 
-Waypoint *psPathNetwork::FindNearestWaypoint(int group, const csVector3& v,iSector *sector, float range, float * found_range)
+psPathNetwork::SectorIndex* psPathNetwork::GetIndex(int group)
 {
-    csList<Waypoint*>::Iterator iter(waypointGroups[group]);
-    Waypoint *wp;
-
-    float min_range = range;
-
-    Waypoint *min_wp = NULL;
-
-    while (iter.HasNext())
+    if (indexValid && unresolved)
     {
-        wp = iter.Next();
-
-        float dist2 = world->Distance(v,sector,wp->loc.pos,wp->GetSector(engine));
-        
-        if (min_range < 0 || dist2 < min_range)
+        // Sectors that weren't loaded when the waypoints were indexed may be by now.
+        SectorWaypoints* wps = allIndex.Get(NULL);
+        for (size_t i = 0; wps && i < wps->waypoints.GetSize(); i++)
         {
-            min_range = dist2;
-            min_wp = wp;
+            if (wps->waypoints[i]->GetSector(engine))
+            {
+                indexValid = false;
+                break;
+            }
         }
     }
-    if (min_wp && found_range) *found_range = min_range;
 
-    return min_wp;
+    if (!indexValid)
+    {
+        BuildIndex();
+    }
+
+    return group < 0 ? &allIndex : groupIndex[group];
 }
 
-Waypoint *psPathNetwork::FindRandomWaypoint(int group, const csVector3& v,iSector *sector, float range, float * found_range)
+void psPathNetwork::BuildIndex()
 {
-    csList<Waypoint*>::Iterator iter(waypointGroups[group]);
-    Waypoint *wp;
+    allIndex.Clear();
+    groupIndex.DeleteAll();
+    waypointsByID.DeleteAll();
 
-    csArray<Waypoint*> nearby;
-    csArray<float> dist;
- 
-    while (iter.HasNext())
+    // Backwards, so the first of waypoints with the same id is found by id.
+    for (size_t i = waypoints.GetSize(); i-- > 0;)
     {
-        wp = iter.Next();
-
-        float dist2 = world->Distance(v,sector,wp->loc.pos,wp->GetSector(engine));
-        
-        if (range < 0 || dist2 < range)
-        {
-            nearby.Push(wp);
-            dist.Push(dist2);
-        }
+        waypointsByID.PutUnique(waypoints[i]->loc.id, waypoints[i]);
+        allIndex.Add(waypoints[i], engine);
     }
+    allIndex.Sort();
 
-    if (nearby.GetSize()>0)  // found one or more closer than range
+    for (size_t i = 0; i < waypointGroups.GetSize(); i++)
     {
-        size_t pick = psGetRandom((uint32)nearby.GetSize());
-        
-        if (found_range) *found_range = sqrt(dist[pick]);
-        
-        return nearby[pick];
+        SectorIndex* index = new SectorIndex;
+        csList<Waypoint*>::Iterator iter(waypointGroups[i]);
+        while (iter.HasNext())
+        {
+            index->Add(iter.Next(), engine);
+        }
+        index->Sort();
+        groupIndex.Push(index);
     }
 
+    SectorWaypoints* wps = allIndex.Get(NULL);
+    unresolved = wps ? wps->waypoints.GetSize() : 0;
+    indexValid = true;
+}
 
-    return NULL;
+void psPathNetwork::Invalidate()
+{
+    indexValid = false;
+    routeCache.DeleteAll();
 }
 
 int psPathNetwork::FindWaypointGroup(const char * groupName)
@@ -480,81 +820,84 @@ psPath *psPathNetwork::FindNearestPoint(const csVector3& v,iSector *sector, floa
 csList<Waypoint*> psPathNetwork::FindWaypointRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
 {
     csList<Waypoint*> waypoint_list;
-    csList<Waypoint*> priority; // Should have been a priority queue
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
-    Waypoint *wp;
-    
-    // Using Dijkstra's algorithm to find shortest way
 
-    // Initialize
-    while (iter.HasNext())
+    if (start == end)
     {
-        wp = iter.Next();
+        return waypoint_list;
+    }
 
-        // Filter the waypoints with exception of the start and end point.
-        if ((wp != start) && (wp != end) && routeFilter->Filter(wp))
-        {
-            wp->excluded = true;
-            continue; // No need to think more about this waypoint
-        }
-        else    
+    uint32 filterKey = 0;
+    bool cacheable = !routeFilter || routeFilter->GetCacheKey(filterKey);
+    uint64 key = ((uint64)(uint32)start->GetID() << 32) | (uint32)end->GetID();
+    if (cacheable)
+    {
+        csHash<CachedRoute, uint64>::Iterator cached(routeCache.GetIterator(key));
+        while (cached.HasNext())
         {
-            wp->excluded = false;
+            CachedRoute& entry = cached.Next();
+            if (entry.start == start && entry.end == end &&
+                entry.filtered == (routeFilter != NULL) && entry.filterKey == filterKey)
+            {
+                entry.hits++;
+                cacheHits++;
+                for (size_t i = 0; i < entry.route.GetSize(); i++)
+                {
+                    waypoint_list.PushBack(entry.route[i]);
+                }
+                return waypoint_list;
+            }
         }
-
-        wp->distance = INFINITY_DISTANCE;
-        wp->pi = NULL;
-        
-        // Insert WP into priority queue
-        priority.PushBack(wp);
+        cacheMisses++;
     }
+
+    // Using A* to find the shortest way. The straight line distance to the
+    // end is never longer than the paths still to go, so once the end is
+    // taken from the open set its route is the shortest.
+    int check = GetNextWaypointCheck();
+    iSector* endSector = end->GetSector(engine);
+    WaypointHeap open;
+
+    StartVisit(start, start, end, endSector, routeFilter, check);
     start->distance = 0;
+    open.Push(start);
 
-    while (!priority.IsEmpty())
+    while (!open.IsEmpty())
     {
-        Waypoint *wp_u = NULL;
-        Waypoint *pri_wp = NULL;
-
-        // Extract min from priority queue
-        csList<Waypoint*>::Iterator pri(priority);
-        csList<Waypoint*>::Iterator pri_loc;
-        while (pri.HasNext())
+        Waypoint *wp_u = open.Pop();
+        if (wp_u == end)
         {
-            pri_wp = pri.Next();
-
-            if (!wp_u || pri_wp->distance < wp_u->distance)
-            {
-                wp_u = pri_wp;
-                pri_loc = pri;
-            }
+            break;
         }
-        priority.Delete(pri_loc);
-        size_t v;
-        for (v = 0; v < wp_u->links.GetSize(); v++)
+
+        for (size_t v = 0; v < wp_u->links.GetSize(); v++)
         {
             Waypoint * wp_v = wp_u->links[v];
 
+            // Waypoints are only initialized and filtered once they are reached.
+            StartVisit(wp_v, start, end, endSector, routeFilter, check);
+
             // Is the target waypoint excluded, in that case continue on.
             if (wp_v->excluded)
             {
                 continue;
             }
 
-            // Relax
-            if (wp_v->distance > wp_u->distance + wp_u->dists[v])
+            // Relax. A waypoint taken from the open set already goes back in
+            // if the estimates were off, like for a waypoint moved after its
+            // path lengths were calculated.
+            float distance = wp_u->distance + wp_u->dists[v];
+            if (distance < wp_v->distance)
             {
-                wp_v->distance = wp_u->distance + wp_u->dists[v];
+                wp_v->distance = distance;
                 wp_v->pi = wp_u;
+                open.Push(wp_v);
             }
         }
-        // if wp == end, we should be done!!!!!!
     }
 
-    wp = end;
-
-    if (end->pi)
+    if (end->check == check && end->pi)
     {
-        wp = end;
+        Waypoint *wp = end;
         while (wp)
         {
             waypoint_list.PushFront(wp);
@@ -562,9 +905,88 @@ csList<Waypoint*> psPathNetwork::FindWaypointRoute(Waypoint * start, Waypoint *
         }
     }
 
+    if (cacheable)
+    {
+        CacheRoute(key, start, end, routeFilter, filterKey, waypoint_list);
+    }
+
     return waypoint_list;
 }
 
+void psPathNetwork::StartVisit(Waypoint* wp, Waypoint* start, Waypoint* end, iSector* endSector, const RouteFilter* routeFilter, int check)
+{
+    if (wp->check == check)
+    {
+        return;
+    }
+
+    wp->check = check;
+    wp->distance = INFINITY_DISTANCE;
+    wp->pi = NULL;
+    wp->heapIndex = csArrayItemNotFound;
+    wp->estimate = 0.0;
+
+    // Filter the waypoints with exception of the start and end point.
+    wp->excluded = (wp != start) && (wp != end) && routeFilter && routeFilter->Filter(wp);
+    if (wp->excluded)
+    {
+        return;
+    }
+
+    // Without a known warp to the end sector the estimate stays 0, which is
+    // never too long.
+    float estimate = world->Distance(end->loc.pos,endSector,wp->loc.pos,wp->GetSector(engine));
+    if (estimate < INFINITY_DISTANCE)
+    {
+        wp->estimate = estimate;
+    }
+}
+
+void psPathNetwork::CacheRoute(uint64 key, Waypoint* start, Waypoint* end, const RouteFilter* routeFilter, uint32 filterKey, const csList<Waypoint*>& route)
+{
+    if (routeCache.GetSize() >= ROUTE_CACHE_SIZE)
+    {
+        // Keep the routes that were used again since the cache was last full.
+        csArray<uint64> keys;
+        csArray<CachedRoute> used;
+        csHash<CachedRoute, uint64>::GlobalIterator it(routeCache.GetIterator());
+        while (it.HasNext())
+        {
+            uint64 usedKey;
+            const CachedRoute& entry = it.Next(usedKey);
+            if (entry.hits)
+            {
+                keys.Push(usedKey);
+                used.Push(entry);
+            }
+        }
+
+        routeCache.DeleteAll();
+        if (used.GetSize() < ROUTE_CACHE_SIZE)
+        {
+            for (size_t i = 0; i < used.GetSize(); i++)
+            {
+                used[i].hits = 0;
+                routeCache.Put(keys[i], used[i]);
+            }
+        }
+    }
+
+    CachedRoute entry;
+    entry.start = start;
+    entry.end = end;
+    entry.filtered = routeFilter != NULL;
+    entry.filterKey = filterKey;
+    entry.hits = 0;
+
+    csList<Waypoint*>::Iterator iter(route);
+    while (iter.HasNext())
+    {
+        entry.route.Push(iter.Next());
+    }
+
+    routeCache.Put(key, entry);
+}
 
 csList<Edge*> psPathNetwork::FindEdgeRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
 {
@@ -630,7 +1052,9 @@ void psPathNetwork::ListWaypoints(const char * pattern)
         }
         CPrintf(CON_CMDOUTPUT,"\n");
     }
-    
+
+    CPrintf(CON_CMDOUTPUT, "Route cache: %zu routes, %zu hits, %zu misses\n",
+            routeCache.GetSize(), cacheHits, cacheMisses);
 }
 
 
@@ -648,22 +1072,17 @@ size_t psPathNetwork::FindPointsInSector(iSector *sector, csList<psPathPoint*>&
 
 size_t psPathNetwork::FindWaypointsInSector(iSector *sector, csList<Waypoint*>& list)
 {
-    size_t count = 0;
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
-    Waypoint *wp;
-
-    // Initialize
-    while (iter.HasNext())
+    SectorWaypoints* wps = GetIndex()->Get(sector);
+    if (!wps)
     {
-        wp = iter.Next();
+        return 0;
+    }
 
-	if ( wp->GetSector(engine) == sector )
-        {
-           list.PushBack(wp);
-           count++;
-        }
+    for (size_t i = 0; i < wps->waypoints.GetSize(); i++)
+    {
+        list.PushBack(wps->waypoints[i]);
     }
-    return count;
+    return wps->waypoints.GetSize();
 }
 
 void psPathNetwork::ListPaths(const char* /*name*/)
@@ -759,6 +1178,7 @@ Waypoint* psPathNetwork::CreateWaypoint(csString& name,
     Waypoint *wp = new Waypoint(name,pos,sectorName,radius,flags);
 
     waypoints.Push(wp);
+    Invalidate();
 
     return wp;
 }
@@ -782,6 +1202,7 @@ psPath* psPathNetwork::CreatePath(psPath * path)
     {
         path->end->AddLink(path,path->start,psPath::REVERSE,dist); // bi-directional link is implied
     }
+    Invalidate();
 
     return path;
 }
@@ -853,6 +1274,7 @@ bool psPathNetwork::Delete(psPath * path)
         }
     }
     
+    Invalidate();
 
     return true;
 }
@@ -21,6 +21,7 @@
 
 #include <csutil/array.h>
 #include <csutil/list.h>
+#include <csutil/hash.h>
 
 #include <idal.h>
 
@@ -53,6 +54,15 @@ public:
         * Called to check if a waypoint should be filters.
         */
         virtual bool Filter(const Waypoint* wp) const = 0;
+
+       /**
+        * Get a key for the waypoints this filter lets through. Routes found
+        * with filters that give the same key are shared in the route cache,
+        * so two such filters must filter the same waypoints.
+        *
+        * @return False if routes found with this filter can't be cached.
+        */
+        virtual bool GetCacheKey(uint32 &key) const { return false; }
     };
 
 
@@ -66,6 +76,7 @@ public:
     csWeakRef<iDataConnection> db;
     psWorld * world;
     
+    psPathNetwork();
     
     /**
      * Load all waypoins and paths from db
@@ -203,6 +214,9 @@ public:
     
     /**
      * Find the shortest route between waypoint start and stop.
+     *
+     * Routes are cached until the network is changed, unless the filter
+     * doesn't give a cache key.
      */
     csList<Waypoint*> FindWaypointRoute(Waypoint * start, Waypoint * end, const RouteFilter* routeFilter);
 
@@ -282,6 +296,88 @@ public:
      * Delete the given path from the db.
      */
     bool Delete(psPath * path);
+
+    /**
+     * Tell the network that waypoints or paths were changed behind its back,
+     * like a waypoint that was moved or got other flags or another radius.
+     * Drops all cached routes and indexes the waypoints again.
+     */
+    void Invalidate();
+
+private:
+    /**
+     * The waypoints of a sector sorted by x, so the waypoints close to a
+     * position are found with a binary search.
+     */
+    struct SectorWaypoints
+    {
+        csArray<Waypoint*> waypoints;
+        float maxRadius;                ///< Largest radius of the waypoints.
+    };
+
+    /// A set of waypoints by sector.
+    class SectorIndex
+    {
+    public:
+        SectorIndex() : count(0) {}
+        ~SectorIndex();
+
+        /// Remove all waypoints.
+        void Clear();
+
+        void Add(Waypoint* wp, iEngine* engine);
+
+        /// Sort the waypoints of every sector, call after adding.
+        void Sort();
+
+        SectorWaypoints* Get(iSector* sector)
+        {
+            return sectors.Get(sector, NULL);
+        }
+
+        csHash<SectorWaypoints*, csPtrKey<iSector> > sectors;
+        size_t count;                   ///< Number of waypoints.
+    };
+
+    /// A route in the route cache.
+    struct CachedRoute
+    {
+        Waypoint* start;
+        Waypoint* end;
+        bool filtered;                  ///< The route was found with a filter.
+        uint32 filterKey;               ///< Key of the filter.
+        csArray<Waypoint*> route;       ///< Empty if there is no route.
+        size_t hits;                    ///< Uses since the cache was last full.
+    };
+
+    /// Get the index of all waypoints, or of a group, indexing them if needed.
+    SectorIndex* GetIndex(int group = -1);
+
+    /// Index all waypoints and groups by sector and by id.
+    void BuildIndex();
+
+    /// Find the nearest waypoint of an index, see FindNearestWaypoint().
+    Waypoint* FindNearestWaypoint(SectorIndex* index, const csVector3& v, iSector* sector, float range, float* found_range);
+
+    /// Find a random waypoint of an index, see FindRandomWaypoint().
+    Waypoint* FindRandomWaypoint(SectorIndex* index, const csVector3& v, iSector* sector, float range, float* found_range);
+
+    /// Reset the search data of a waypoint the first time a route search reaches it.
+    void StartVisit(Waypoint* wp, Waypoint* start, Waypoint* end, iSector* endSector, const RouteFilter* routeFilter, int check);
+
+    /// Put a route in the cache, making room if it is full.
+    void CacheRoute(uint64 key, Waypoint* start, Waypoint* end, const RouteFilter* routeFilter, uint32 filterKey, const csList<Waypoint*>& route);
+
+    SectorIndex allIndex;               ///< Every waypoint.
+    csPDelArray<SectorIndex> groupIndex;///< The waypoints of each group.
+    csHash<Waypoint*, int> waypointsByID;
+    bool indexValid;
+    size_t unresolved;                  ///< Waypoints in the index whose sector wasn't found.
+
+    /// Routes keyed by the ids of the start and end waypoint.
+    csHash<CachedRoute, uint64> routeCache;
+    size_t cacheHits;
+    size_t cacheMisses;
 };
 
 /** @} */
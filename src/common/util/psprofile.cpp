@@ -76,6 +76,11 @@ double psOperProfile::GetConsumption()
     return consumption;
 }
 
+const char* psOperProfile::GetDesc() const
+{
+    return desc.GetData();
+}
+
 int psOperProfile::cmpProfs(const void * a, const void * b)
 {
     psOperProfile * pA = *((psOperProfile**)a);
@@ -62,6 +62,9 @@ public:
     csString Dump(double totalConsumption, const csString & unitName);
     
     double GetConsumption();
+
+    /** The description the profile was made with */
+    const char* GetDesc() const;
     
     /** Sorting */
     static int cmpProfs(const void * a, const void * b);
@@ -20,6 +20,7 @@
 #include <psconfig.h>
 #include <csutil/sysfunc.h>
 #include <csutil/randomgen.h>
+#include <csutil/threading/mutex.h>
 
 #include "psutil.h"
 #include "util/consoleout.h"
@@ -82,14 +83,18 @@ csTicks ScopedTimer::TimeUsed() const
 
 
 csRandomGen psrandomGen;
+/// The npcclient draws numbers from its brain threads too.
+static CS::Threading::Mutex psrandomMutex;
 
 float psGetRandom()
 { 
+    CS::Threading::MutexScopedLock lock(psrandomMutex);
     return psrandomGen.Get();
 }
 
 uint32 psGetRandom(uint32 limit)
 {
+    CS::Threading::MutexScopedLock lock(psrandomMutex);
     return psrandomGen.Get(limit);
 }
 
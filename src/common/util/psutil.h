@@ -168,13 +168,13 @@ public:
     csTicks TimeUsed() const;
 };
 
-/** Returns a random number.
+/** Returns a random number. Safe to call from several threads.
  *
  * @return Returns a random number between 0.0 and 1.0.
  */
 float psGetRandom();
 
-/** Returns a random number with a limit.
+/** Returns a random number with a limit. Safe to call from several threads.
  *
  * @return Returns a random number between 0 and limit.
  */
@@ -21,6 +21,9 @@
 
 class MathEnvironment;
 
+/// ID of a property name, see MathScriptEngine::GetPropertyID().
+typedef uint32 PropertyID;
+
 /**
  * \addtogroup common_util
  * @{ */
@@ -29,6 +32,13 @@ class iScriptableVar
 {
 public:
     virtual double GetProperty(MathEnvironment*, const char *ptr)=0;
+
+    /**
+     * Retrieve a property by the ID of it's name. MathScripts resolve the
+     * names they use when they are parsed and call this. The default looks
+     * the name up again and calls GetProperty().
+     */
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment*, const char * functionName, const double * params) = 0;
     virtual const char* ToString() = 0;
     virtual ~iScriptableVar() {};
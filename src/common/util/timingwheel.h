@@ -0,0 +1,364 @@
+/*
+ * timingwheel.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * Description : This is a hierarchical timing wheel. (a priority queue keyed
+ *               by ticks with O(1) insert and remove)
+ *
+ */
+
+#ifndef __TIMINGWHEEL_H__
+#define __TIMINGWHEEL_H__
+
+#include <cstypes.h>
+#include <string.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+#define TIMINGWHEEL_ROOT_BITS   8   ///< The root level has one slot per tick.
+#define TIMINGWHEEL_LEVEL_BITS  6
+#define TIMINGWHEEL_LEVELS      3   ///< Levels above the root, together covering 2^26 ticks.
+
+#define TIMINGWHEEL_ROOT_SIZE   (1 << TIMINGWHEEL_ROOT_BITS)
+#define TIMINGWHEEL_ROOT_MASK   (TIMINGWHEEL_ROOT_SIZE - 1)
+#define TIMINGWHEEL_LEVEL_SIZE  (1 << TIMINGWHEEL_LEVEL_BITS)
+#define TIMINGWHEEL_LEVEL_MASK  (TIMINGWHEEL_LEVEL_SIZE - 1)
+
+/**
+ * Bookkeeping a timing wheel needs inside each of its elements.
+ */
+template <class T>
+struct TimingWheelNode
+{
+    T*  next;
+    T*  prev;       ///< The head of a slot points to the tail of the slot.
+    T** slot;       ///< Slot the element is linked into, NULL if not in a wheel.
+    int level;
+
+    TimingWheelNode() : next(NULL), prev(NULL), slot(NULL), level(0) {}
+};
+
+/**
+ * Hierarchical timing wheel of elements ordered by their trigger ticks.
+ *
+ * T must have a public csTicks member triggerticks and a public
+ * TimingWheelNode<T> member wheelNode. The wheel doesn't own the elements.
+ *
+ * The root level has a slot for each of the next 256 ticks, each higher
+ * level has 64 slots each spanning the whole level below it. Elements are
+ * moved one level down when the time reaches their slot, elements beyond
+ * the reach of the highest level wait in an overflow list. Insert and
+ * Remove are O(1), DeleteDue is O(1) per element plus one step per tick.
+ */
+template <class T>
+class TimingWheel
+{
+public:
+    TimingWheel(csTicks now = 0)
+        : overflow(NULL), current(now), cascadePending(false), count(0)
+    {
+        memset(root, 0, sizeof(root));
+        memset(levels, 0, sizeof(levels));
+        memset(levelCount, 0, sizeof(levelCount));
+    }
+
+    size_t Length() const
+    {
+        return count;
+    }
+
+    /// Check if the element is currently in a wheel.
+    static bool Contains(const T* what)
+    {
+        return what->wheelNode.slot != NULL;
+    }
+
+    void Insert(T* what)
+    {
+        int level;
+        T** slot = GetSlot(what->triggerticks, level);
+        Link(what, slot, level);
+        count++;
+    }
+
+    /// Remove an element that is in this wheel.
+    void Remove(T* what)
+    {
+        CS_ASSERT(Contains(what));
+        Unlink(what);
+        count--;
+    }
+
+    /**
+     * Remove and return the next element that is due at now, in order of
+     * trigger ticks. Returns NULL when nothing more is due.
+     */
+    T* DeleteDue(csTicks now)
+    {
+        if(!count)
+        {
+            // Nothing to cascade, just catch up with the time.
+            if((int)(now - current) >= 0)
+            {
+                current = now + 1;
+                cascadePending = false;
+            }
+            return NULL;
+        }
+
+        while((int)(now - current) >= 0)
+        {
+            if(cascadePending)
+            {
+                Cascade();
+                cascadePending = false;
+            }
+
+            T* head = root[current & TIMINGWHEEL_ROOT_MASK];
+            if(head)
+            {
+                Remove(head);
+                return head;
+            }
+
+            if(!levelCount[0])
+            {
+                // Nothing in the root level, skip ahead to the next cascade.
+                csTicks next = (current | TIMINGWHEEL_ROOT_MASK) + 1;
+                if((int)(next - now) > 0)
+                {
+                    current = now + 1;
+                    cascadePending = (current & TIMINGWHEEL_ROOT_MASK) == 0;
+                    return NULL;
+                }
+                current = next;
+                cascadePending = true;
+                continue;
+            }
+
+            current++;
+            cascadePending = (current & TIMINGWHEEL_ROOT_MASK) == 0;
+        }
+        return NULL;
+    }
+
+    /**
+     * Get the first tick at which DeleteDue may return an element. This is
+     * either the tick of the first element in the root level or the time of
+     * the next cascade of a higher level.
+     */
+    csTicks GetNextTicks() const
+    {
+        if(cascadePending)
+            return current;
+
+        csTicks end = (current | TIMINGWHEEL_ROOT_MASK) + 1;
+        if(levelCount[0])
+        {
+            for(csTicks t = current; t != end; t++)
+            {
+                if(root[t & TIMINGWHEEL_ROOT_MASK])
+                    return t;
+            }
+        }
+        return end;
+    }
+
+    /// Remove and return any element, NULL when empty. Used to clean up.
+    T* DeleteAny()
+    {
+        if(!count)
+            return NULL;
+
+        for(int i = 0; i < TIMINGWHEEL_ROOT_SIZE; i++)
+        {
+            if(root[i])
+                return DeleteHead(root[i]);
+        }
+        for(int l = 0; l < TIMINGWHEEL_LEVELS; l++)
+        {
+            for(int i = 0; i < TIMINGWHEEL_LEVEL_SIZE; i++)
+            {
+                if(levels[l][i])
+                    return DeleteHead(levels[l][i]);
+            }
+        }
+        return DeleteHead(overflow);
+    }
+
+private:
+    T* DeleteHead(T* head)
+    {
+        Remove(head);
+        return head;
+    }
+
+    T** GetSlot(csTicks ticks, int &level)
+    {
+        csTicks delta = ticks - current;
+
+        // Late elements go to the slot that is processed next.
+        if((int)delta < 0)
+        {
+            level = 0;
+            return &root[current & TIMINGWHEEL_ROOT_MASK];
+        }
+        if(delta < TIMINGWHEEL_ROOT_SIZE)
+        {
+            level = 0;
+            return &root[ticks & TIMINGWHEEL_ROOT_MASK];
+        }
+        for(int l = 0; l < TIMINGWHEEL_LEVELS; l++)
+        {
+            int shift = TIMINGWHEEL_ROOT_BITS + l * TIMINGWHEEL_LEVEL_BITS;
+            if(delta < ((csTicks)1 << (shift + TIMINGWHEEL_LEVEL_BITS)))
+            {
+                level = l + 1;
+                return &levels[l][(ticks >> shift) & TIMINGWHEEL_LEVEL_MASK];
+            }
+        }
+        level = TIMINGWHEEL_LEVELS + 1;
+        return &overflow;
+    }
+
+    /// Link into a slot, keeping the slot sorted by trigger ticks.
+    void Link(T* what, T** slot, int level)
+    {
+        TimingWheelNode<T> &node = what->wheelNode;
+        node.slot = slot;
+        node.level = level;
+        levelCount[level]++;
+
+        T* head = *slot;
+        if(!head)
+        {
+            node.next = NULL;
+            node.prev = what;
+            *slot = what;
+            return;
+        }
+
+        // The common case is appending. Only late elements in the root level
+        // and elements of higher levels need to walk the slot.
+        T* tail = head->wheelNode.prev;
+        if((int)(what->triggerticks - tail->triggerticks) >= 0)
+        {
+            tail->wheelNode.next = what;
+            node.prev = tail;
+            node.next = NULL;
+            head->wheelNode.prev = what;
+            return;
+        }
+
+        T* at = head;
+        while((int)(what->triggerticks - at->triggerticks) >= 0)
+            at = at->wheelNode.next;
+
+        // Insert before at, which is never NULL as the tail is later than what.
+        node.next = at;
+        node.prev = at->wheelNode.prev;
+        if(at == head)
+            *slot = what;
+        else
+            node.prev->wheelNode.next = what;
+        at->wheelNode.prev = what;
+    }
+
+    void Unlink(T* what)
+    {
+        TimingWheelNode<T> &node = what->wheelNode;
+        T** slot = node.slot;
+        T* head = *slot;
+
+        if(what == head)
+        {
+            *slot = node.next;
+            if(node.next)
+                node.next->wheelNode.prev = node.prev;
+        }
+        else
+        {
+            node.prev->wheelNode.next = node.next;
+            if(node.next)
+                node.next->wheelNode.prev = node.prev;
+            else
+                head->wheelNode.prev = node.prev;
+        }
+
+        levelCount[node.level]--;
+        node.next = NULL;
+        node.prev = NULL;
+        node.slot = NULL;
+    }
+
+    /// Move the elements of a slot to wherever they belong at the current time.
+    void Redistribute(T** slot)
+    {
+        // Detach the whole list first, elements may go back into the same slot.
+        T* list = *slot;
+        *slot = NULL;
+        while(list)
+        {
+            T* what = list;
+            list = what->wheelNode.next;
+            levelCount[what->wheelNode.level]--;
+
+            int level;
+            T** to = GetSlot(what->triggerticks, level);
+            Link(what, to, level);
+        }
+    }
+
+    /// Called when the time reaches the start of a root level round.
+    void Cascade()
+    {
+        // A level reaches the border of its slot when all levels below it
+        // are at their first slot.
+        int top;
+        for(top = 0; top < TIMINGWHEEL_LEVELS; top++)
+        {
+            if((current >> (TIMINGWHEEL_ROOT_BITS + top * TIMINGWHEEL_LEVEL_BITS)) & TIMINGWHEEL_LEVEL_MASK)
+                break;
+        }
+
+        // Higher levels first, they may refill the slots of lower levels.
+        if(top == TIMINGWHEEL_LEVELS)
+        {
+            Redistribute(&overflow);
+            top--;
+        }
+        for(int l = top; l >= 0; l--)
+        {
+            int shift = TIMINGWHEEL_ROOT_BITS + l * TIMINGWHEEL_LEVEL_BITS;
+            Redistribute(&levels[l][(current >> shift) & TIMINGWHEEL_LEVEL_MASK]);
+        }
+    }
+
+    T* root[TIMINGWHEEL_ROOT_SIZE];
+    T* levels[TIMINGWHEEL_LEVELS][TIMINGWHEEL_LEVEL_SIZE];
+    T* overflow;
+    size_t levelCount[TIMINGWHEEL_LEVELS + 2];  ///< Elements per level, the last one is the overflow.
+
+    csTicks current;            ///< Tick of the root slot processed next.
+    bool cascadePending;        ///< Set when current reached a new round that wasn't cascaded yet.
+    size_t count;
+};
+
+/** @} */
+
+#endif
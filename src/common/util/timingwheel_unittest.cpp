@@ -0,0 +1,133 @@
+/*
+ * timingwheel_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/randomgen.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/heap.h"
+#include "util/timingwheel.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+struct WheelTestEvent
+{
+    csTicks triggerticks;
+    int id;
+    TimingWheelNode<WheelTestEvent> wheelNode;
+
+    WheelTestEvent(csTicks ticks, int id) : triggerticks(ticks), id(id) {}
+
+    bool operator<(const WheelTestEvent &other) const
+    {
+        return triggerticks < other.triggerticks ||
+               (triggerticks == other.triggerticks && id < other.id);
+    }
+    bool operator>(const WheelTestEvent &other) const
+    {
+        return other < *this;
+    }
+};
+
+TEST(TimingWheelTest, DueInOrder)
+{
+    TimingWheel<WheelTestEvent> wheel(1000);
+    WheelTestEvent a(1300, 1), b(1005, 2), c(1005, 3), d(90000, 4);
+
+    wheel.Insert(&a);
+    wheel.Insert(&b);
+    wheel.Insert(&d);
+    wheel.Insert(&c);
+    EXPECT_EQ(4u, wheel.Length());
+
+    EXPECT_TRUE(wheel.DeleteDue(1004) == NULL);
+    EXPECT_EQ(&b, wheel.DeleteDue(1005));
+    EXPECT_EQ(&c, wheel.DeleteDue(1005));
+    EXPECT_TRUE(wheel.DeleteDue(1299) == NULL);
+    EXPECT_EQ(&a, wheel.DeleteDue(5000));
+    EXPECT_TRUE(wheel.DeleteDue(89999) == NULL);
+    EXPECT_EQ(&d, wheel.DeleteDue(90000));
+    EXPECT_EQ(0u, wheel.Length());
+}
+
+TEST(TimingWheelTest, RemoveAndLateInsert)
+{
+    TimingWheel<WheelTestEvent> wheel(0);
+    WheelTestEvent a(100, 1), b(200, 2), late(50, 3);
+
+    wheel.Insert(&a);
+    wheel.Insert(&b);
+    wheel.Remove(&a);
+    EXPECT_FALSE(TimingWheel<WheelTestEvent>::Contains(&a));
+    EXPECT_EQ(1u, wheel.Length());
+
+    EXPECT_TRUE(wheel.DeleteDue(150) == NULL);
+
+    // Inserted after its time has passed, due right away.
+    wheel.Insert(&late);
+    EXPECT_EQ(&late, wheel.DeleteDue(151));
+    EXPECT_EQ(&b, wheel.DeleteDue(300));
+    EXPECT_EQ(0u, wheel.Length());
+}
+
+TEST(TimingWheelTest, MatchesHeap)
+{
+    csRandomGen rng(42);
+    TimingWheel<WheelTestEvent> wheel(0);
+    Heap<WheelTestEvent> heap;
+    csArray<WheelTestEvent*> events;
+
+    // A mix of short combat delays, longer spell and NPC timers and
+    // respawns far beyond the reach of the highest wheel level.
+    const csTicks ranges[] = { 300, 20000, 2000000, 200000000 };
+    for(int i = 0; i < 5000; i++)
+    {
+        csTicks ticks = rng.Get(ranges[i % 4]);
+        events.Push(new WheelTestEvent(ticks, i));
+        wheel.Insert(events.Top());
+        heap.Insert(events.Top());
+    }
+
+    csTicks now = 0;
+    while(heap.Length())
+    {
+        now += rng.Get(50000);
+        while(heap.FindMin() && heap.FindMin()->triggerticks <= now)
+        {
+            WheelTestEvent* expected = heap.DeleteMin();
+            WheelTestEvent* got = wheel.DeleteDue(now);
+            ASSERT_TRUE(got != NULL);
+            EXPECT_EQ(expected->triggerticks, got->triggerticks);
+        }
+        EXPECT_TRUE(wheel.DeleteDue(now) == NULL);
+        EXPECT_EQ(heap.Length(), wheel.Length());
+    }
+
+    for(size_t i = 0; i < events.GetSize(); i++)
+        delete events[i];
+}
@@ -92,6 +92,9 @@ Waypoint::Waypoint()
 {
     distance = 0.0;
     pi = NULL;
+    estimate = 0.0;
+    heapIndex = csArrayItemNotFound;
+    check = 0;
     loc.id = -1;
 }
 
@@ -100,6 +103,9 @@ Waypoint::Waypoint(const char* name)
 {
     distance = 0.0;
     pi = NULL;
+    estimate = 0.0;
+    heapIndex = csArrayItemNotFound;
+    check = 0;
     loc.id = -1;
     loc.name = name;
 }
@@ -111,6 +117,9 @@ Waypoint::Waypoint(csString& name,
 {
     distance = 0.0;
     pi = NULL;
+    estimate = 0.0;
+    heapIndex = csArrayItemNotFound;
+    check = 0;
     loc.id = -1;
     loc.name = name;
     loc.pos = pos;
@@ -301,8 +310,8 @@ bool Waypoint::SetFlag(iDataConnection * db, const csString &flagstr, bool enabl
         return false;
     }
 
-    int result = db->CommandPump("UPDATE sc_waypoints SET flags='%s' WHERE id=%d",
-                                 GetFlags().GetDataSafe(), loc.id);
+    int result = db->Command("UPDATE sc_waypoints SET flags='%s' WHERE id=%d",
+                             GetFlags().GetDataSafe(), loc.id);
     if (result != 1)
     {
         Error2("Sql failed: %s\n",db->GetLastError());
@@ -609,9 +618,9 @@ void Waypoint::SetID(int id)
 
 bool Waypoint::Adjust(iDataConnection * db, csVector3 & pos, csString sector)
 {
-    int result = db->CommandPump("UPDATE sc_waypoints SET x=%.2f,y=%.2f,z=%.2f,"
-                                 "loc_sector_id=(select id from sectors where name='%s') WHERE id=%d",
-                                 pos.x,pos.y,pos.z,sector.GetDataSafe(),loc.id);
+    int result = db->Command("UPDATE sc_waypoints SET x=%.2f,y=%.2f,z=%.2f,"
+                             "loc_sector_id=(select id from sectors where name='%s') WHERE id=%d",
+                             pos.x,pos.y,pos.z,sector.GetDataSafe(),loc.id);
 
     Adjust(pos, sector);
     return (result == 1);
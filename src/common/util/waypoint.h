@@ -215,10 +215,13 @@ public:
      */
     uint32_t GetEffectID(iEffectIDAllocator* allocator);
 
-    /// Data used in the dijkstra's algorithm to find waypoint path
-    float distance; /// Hold current shortest distance to the start WP.
-    Waypoint * pi;  /// Predecessor WP to track shortest way back to start.
-    bool excluded;  /// Set to true if the waypoint is filtered out.
+    /// Data used in the A* search to find waypoint path
+    float distance;   /// Hold current shortest distance to the start WP.
+    Waypoint * pi;    /// Predecessor WP to track shortest way back to start.
+    bool excluded;    /// Set to true if the waypoint is filtered out.
+    float estimate;   /// Straight line distance to the end WP.
+    size_t heapIndex; /// Place in the open set, csArrayItemNotFound if not in it.
+    int check;        /// The search that set the data above.
 
 };
 
@@ -0,0 +1,391 @@
+/*
+ * brainpool.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/sysfunc.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/gameevent.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "brainpool.h"
+#include "globals.h"
+#include "npc.h"
+#include "npcclient.h"
+#include "perceptions.h"
+#include "tribe.h"
+
+extern bool running;
+
+/**
+ * Ticks all brains every NPC_BRAIN_TICK.
+ */
+class psBrainPoolTick : public psGameEvent
+{
+public:
+    psBrainPoolTick(BrainPool* pool) : psGameEvent(0, NPC_BRAIN_TICK, "psBrainPoolTick"), pool(pool) {}
+
+    virtual void Trigger()
+    {
+        if(!running)
+            return;
+
+        psBrainPoolTick* tick = new psBrainPoolTick(pool);
+        tick->QueueEvent();
+
+        pool->Tick();
+    }
+
+    virtual csString ToString() const
+    {
+        return "psBrainPoolTick";
+    }
+
+private:
+    BrainPool* pool;
+};
+
+static int TribeOf(NPC* npc)
+{
+    Tribe* tribe = npc->GetTribe();
+    return tribe ? tribe->GetID() : 0;
+}
+
+/// Orders the brains by tribe, then by id.
+static int CompareBrains(NPC* const &a, NPC* const &b)
+{
+    int tribeA = TribeOf(a);
+    int tribeB = TribeOf(b);
+    if(tribeA != tribeB)
+        return tribeA < tribeB ? -1 : 1;
+
+    uint32 pidA = a->GetPID().Unbox();
+    uint32 pidB = b->GetPID().Unbox();
+    if(pidA != pidB)
+        return pidA < pidB ? -1 : 1;
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+BrainPool::BrainPool(NetworkManager* network)
+    : network(network), ticking(false), now(0), starting(0), generation(0), running(0), stop(false),
+      ticks(0), brains(0), deferred(0), maxTime(0), totalTime(0)
+{
+}
+
+BrainPool::~BrainPool()
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        condition.NotifyAll();
+    }
+
+    for(size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+    threads.Empty();
+
+    for(size_t i = 0; i < npcs.GetSize(); i++)
+    {
+        npcs[i]->brainIndex = SIZET_NOT_FOUND;
+    }
+}
+
+void BrainPool::Start(size_t count)
+{
+    CS_ASSERT(threads.IsEmpty());
+
+    slices.SetSize(count + 1);
+    for(size_t i = 0; i < slices.GetSize(); i++)
+    {
+        slices[i].begin = 0;
+        slices[i].end = 0;
+        slices[i].commands = NULL;
+        slices[i].time = 0;
+        slices[i].totalTime = 0;
+    }
+    slices[0].commands = network->AddCommandBuffer();
+    threadSlices.Put(CS::Threading::Thread::GetThreadID(), 0);
+
+    mutex.Lock();
+    starting = count;
+    for(size_t i = 1; i <= count; i++)
+    {
+        csRef<Worker> worker;
+        worker.AttachNew(new Worker(this, i));
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        threads.Push(thread);
+    }
+
+    // Wait for the workers to get their command buffers.
+    while(starting)
+    {
+        condition.Wait(mutex);
+    }
+    mutex.Unlock();
+
+    psBrainPoolTick* tick = new psBrainPoolTick(this);
+    tick->QueueEvent();
+}
+
+void BrainPool::Add(NPC* npc)
+{
+    if(npc->brainIndex != SIZET_NOT_FOUND)
+        return;
+
+    npc->brainIndex = npcs.Push(npc);
+}
+
+void BrainPool::Remove(NPC* npc)
+{
+    size_t index = npc->brainIndex;
+    if(index == SIZET_NOT_FOUND)
+        return;
+
+    NPC* last = npcs.Pop();
+    if(last != npc)
+    {
+        npcs[index] = last;
+        last->brainIndex = index;
+    }
+    npc->brainIndex = SIZET_NOT_FOUND;
+}
+
+void BrainPool::MakeSlices()
+{
+    batch.Empty();
+    for(size_t i = 0; i < npcs.GetSize();)
+    {
+        // Disabled NPCs stop ticking until they are enabled again.
+        if(npcs[i]->IsDisabled())
+        {
+            Remove(npcs[i]);
+            continue;
+        }
+        batch.Push(npcs[i]);
+        i++;
+    }
+    batch.Sort(CompareBrains);
+
+    size_t count = slices.GetSize();
+    size_t begin = 0;
+    for(size_t s = 0; s < count; s++)
+    {
+        size_t end = (s + 1 == count) ? batch.GetSize() : csMax(begin, batch.GetSize() * (s + 1) / count);
+
+        // Keep the members of a tribe together.
+        while(end > begin && end < batch.GetSize() &&
+                TribeOf(batch[end]) && TribeOf(batch[end]) == TribeOf(batch[end - 1]))
+        {
+            end++;
+        }
+
+        slices[s].begin = begin;
+        slices[s].end = end;
+        for(size_t i = begin; i < end; i++)
+        {
+            batch[i]->brainSlice = s;
+        }
+        begin = end;
+    }
+}
+
+void BrainPool::Tick()
+{
+    csTicks start = csGetTicks();
+    now = start;
+    MakeSlices();
+
+    network->SetBufferCommands(true);
+    mutex.Lock();
+    ticking = true;
+    running = slices.GetSize() - 1;
+    generation++;
+    condition.NotifyAll();
+    mutex.Unlock();
+
+    RunSlice(0);
+
+    mutex.Lock();
+    while(running)
+    {
+        condition.Wait(mutex);
+    }
+    ticking = false;
+    mutex.Unlock();
+    network->SetBufferCommands(false);
+
+    // In slice order, the same however the threads ran.
+    for(size_t s = 0; s < slices.GetSize(); s++)
+    {
+        network->MergeCommands(slices[s].commands);
+    }
+
+    for(size_t s = 0; s < slices.GetSize(); s++)
+    {
+        csArray<DeferredPerception> &perceptions = slices[s].perceptions;
+        for(size_t i = 0; i < perceptions.GetSize(); i++)
+        {
+            DeferredPerception &p = perceptions[i];
+            csVector3* basePos = p.hasBase ? &p.basePos : NULL;
+            if(p.target)
+                p.target->TriggerEvent(p.pcpt, p.maxRange, basePos, p.baseSector, p.sameSector);
+            else
+                npcclient->TriggerEvent(p.pcpt, p.maxRange, basePos, p.baseSector, p.sameSector);
+            delete p.pcpt;
+        }
+        deferred += perceptions.GetSize();
+        perceptions.Empty();
+    }
+
+    for(size_t i = 0; i < batch.GetSize(); i++)
+    {
+        batch[i]->brainSlice = SIZET_NOT_FOUND;
+    }
+    brains += batch.GetSize();
+    batch.Empty();
+
+    csTicks time = csGetTicks() - start;
+    ticks++;
+    totalTime += time;
+    maxTime = csMax(maxTime, time);
+}
+
+void BrainPool::RunSlice(size_t s)
+{
+    Slice &slice = slices[s];
+    csTicks start = csGetTicks();
+
+    for(size_t i = slice.begin; i < slice.end; i++)
+    {
+        batch[i]->Think(now);
+    }
+
+    slice.time = csGetTicks() - start;
+    slice.totalTime += slice.time;
+}
+
+size_t BrainPool::CurrentSlice()
+{
+    // Not changed after Start, so no need to lock.
+    return threadSlices.Get(CS::Threading::Thread::GetThreadID(), 0);
+}
+
+bool BrainPool::Defer(NPC* target, Perception* pcpt, float maxRange,
+                      csVector3* basePos, iSector* baseSector, bool sameSector)
+{
+    if(!ticking)
+        return false;
+
+    size_t slice = CurrentSlice();
+    if(target && target->brainSlice == slice)
+        return false;
+
+    DeferredPerception p;
+    p.target = target;
+    p.pcpt = pcpt->MakeCopy();
+    p.maxRange = maxRange;
+    p.hasBase = (basePos != NULL);
+    if(basePos)
+        p.basePos = *basePos;
+    p.baseSector = baseSector;
+    p.sameSector = sameSector;
+    slices[slice].perceptions.Push(p);
+    return true;
+}
+
+void BrainPool::Worker::Run()
+{
+    pool->RunWorker(slice);
+}
+
+void BrainPool::RunWorker(size_t slice)
+{
+    NetworkManager::CommandBuffer* commands = network->AddCommandBuffer();
+
+    mutex.Lock();
+    threadSlices.Put(CS::Threading::Thread::GetThreadID(), slice);
+    slices[slice].commands = commands;
+    starting--;
+    condition.NotifyAll();
+
+    size_t done = generation;
+    while(true)
+    {
+        while(!stop && generation == done)
+        {
+            condition.Wait(mutex);
+        }
+        if(stop)
+            break;
+        done = generation;
+        mutex.Unlock();
+
+        RunSlice(slice);
+
+        mutex.Lock();
+        running--;
+        condition.NotifyAll();
+    }
+    mutex.Unlock();
+}
+
+csString BrainPool::GetStats()
+{
+    csString result;
+    result.Format("%zu brains on %zu threads, %zu ticks avg %.1f max %u ms, %zu brains ticked, %zu perceptions held back; slices",
+                  npcs.GetSize(), slices.GetSize(), ticks, ticks ? (float)totalTime / (float)ticks : 0.0f, maxTime,
+                  brains, deferred);
+    for(size_t s = 0; s < slices.GetSize(); s++)
+    {
+        result.AppendFmt(" %zu: last %u avg %.1f ms", s, slices[s].time,
+                         ticks ? (float)slices[s].totalTime / (float)ticks : 0.0f);
+    }
+    return result;
+}
+
+WorldLock::WorldLock(bool needed)
+    : mutex(NULL)
+{
+    if(needed && npcclient->GetBrainPool())
+    {
+        mutex = &npcclient->GetWorldMutex();
+        mutex->Lock();
+    }
+}
+
+WorldLock::~WorldLock()
+{
+    if(mutex)
+    {
+        mutex->Unlock();
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * brainpool.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __BRAINPOOL_H__
+#define __BRAINPOOL_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csgeom/vector3.h>
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/hash.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "networkmgr.h"
+
+class NPC;
+class Perception;
+struct iSector;
+
+/**
+ * \addtogroup npcclient
+ * @{ */
+
+/**
+ * Ticks the brains of all NPCs together, spread over a pool of threads.
+ *
+ * Every NPC_BRAIN_TICK the NPCs are ordered by tribe and id and cut into
+ * one slice for each thread, the main thread taking the first. The members
+ * of a tribe stay in one slice, so a tribe is only touched by one thread.
+ * The main thread waits until all slices are done, so nothing else changes
+ * the world while the brains run.
+ *
+ * Commands the brains queue go to a buffer for each slice, and perceptions
+ * for NPCs of other slices are held back. Once all are done the buffers are
+ * merged and the perceptions delivered in slice order, so the server gets
+ * the commands in the same order however the threads were scheduled. Brain
+ * operations that use the engine or the path network hold the world lock
+ * of the NPC client, see ScriptOperation::UsesWorld().
+ */
+class BrainPool
+{
+public:
+    BrainPool(NetworkManager* network);
+
+    /// Stops the workers.
+    ~BrainPool();
+
+    /**
+     * Start the workers and the brain tick.
+     *
+     * @param threads The number of workers besides the main thread.
+     */
+    void Start(size_t threads);
+
+    /// Let the brain of an NPC be ticked, until it is disabled or removed.
+    void Add(NPC* npc);
+
+    /// Stop ticking the brain of an NPC.
+    void Remove(NPC* npc);
+
+    /// Tick all brains. Called by the main thread.
+    void Tick();
+
+    /**
+     * Hold back a perception for an NPC of another slice, to deliver it
+     * once all slices are done.
+     *
+     * @param target The NPC, or NULL for a perception to all NPCs.
+     * @return true if the perception was held back.
+     */
+    bool Defer(NPC* target, Perception* pcpt, float maxRange,
+               csVector3* basePos, iSector* baseSector, bool sameSector);
+
+    /// Number of brains and the times of the slices, for the console.
+    csString GetStats();
+
+private:
+    struct DeferredPerception
+    {
+        NPC* target;
+        Perception* pcpt;               ///< A copy, owned
+        float maxRange;
+        bool hasBase;
+        csVector3 basePos;
+        iSector* baseSector;
+        bool sameSector;
+    };
+
+    /// The NPCs one thread ticks, and what they left for the main thread.
+    struct Slice
+    {
+        size_t begin;
+        size_t end;
+        NetworkManager::CommandBuffer* commands;
+        csArray<DeferredPerception> perceptions;
+        csTicks time;                   ///< Time of the last tick
+        csTicks totalTime;
+    };
+
+    class Worker : public CS::Threading::Runnable
+    {
+    public:
+        Worker(BrainPool* pool, size_t slice) : pool(pool), slice(slice) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "BrainWorker";
+        }
+
+    private:
+        BrainPool* pool;
+        size_t slice;
+    };
+
+    /// Body of the worker threads.
+    void RunWorker(size_t slice);
+
+    /// Tick the NPCs of a slice.
+    void RunSlice(size_t slice);
+
+    /// Order the NPCs and cut them into slices.
+    void MakeSlices();
+
+    /// The slice of the calling thread.
+    size_t CurrentSlice();
+
+    NetworkManager* network;
+
+    csArray<NPC*> npcs;                 ///< Added, in no particular order
+    csArray<NPC*> batch;                ///< Ticked in this tick, ordered
+    csArray<Slice> slices;
+    csHash<size_t, CS::Threading::ThreadID> threadSlices;
+    bool ticking;                       ///< Slices are running
+    csTicks now;
+
+    csArray<csRef<CS::Threading::Thread> > threads;
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+    size_t starting;                    ///< Workers that didn't register yet
+    size_t generation;                  ///< Counts the ticks, workers wait for the next one
+    size_t running;                     ///< Slices of workers not done yet
+    bool stop;
+
+    size_t ticks;
+    size_t brains;                      ///< Brains ticked in all ticks
+    size_t deferred;                    ///< Perceptions held back in all ticks
+    csTicks maxTime;
+    csTicks totalTime;
+};
+
+/**
+ * Holds the world lock of the NPC client while in scope, if brains are
+ * ticked by a pool. The lock is recursive, so nested users are fine.
+ */
+class WorldLock
+{
+public:
+    WorldLock(bool needed = true);
+    ~WorldLock();
+
+private:
+    CS::Threading::RecursiveMutex* mutex;
+};
+
+/** @} */
+
+#endif
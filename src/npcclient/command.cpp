@@ -54,6 +54,8 @@
 #include "net/connection.h"
 
 #include "npcclient.h"
+#include "brainpool.h"
+#include "perceptionindex.h"
 #include "npc.h"
 #include "networkmgr.h"
 #include "globals.h"
@@ -494,6 +496,11 @@ int com_status(const char*)
 {
     CPrintf(CON_CMDOUTPUT,"Amount of loaded npcs: %d\n", npcclient->GetNpcListAmount());
     CPrintf(CON_CMDOUTPUT,"Tick counter         : %d\n", npcclient->GetTickCounter());
+    if(npcclient->GetBrainPool())
+    {
+        CPrintf(CON_CMDOUTPUT,"Brain pool           : %s\n", npcclient->GetBrainPool()->GetStats().GetDataSafe());
+    }
+    CPrintf(CON_CMDOUTPUT,"Perception index     : %s\n", npcclient->GetPerceptionIndex()->GetStats().GetDataSafe());
     return 0;
 }
 
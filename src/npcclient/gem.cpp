@@ -262,43 +262,44 @@ bool gemNPCActor::SetWithinTribe(Tribe* tribe, Tribe** oldTribe)
     return result;
 }
 
+// Properties scripts can read, see GetPropertyByID().
+#define GEMNPCACTOR_PROPERTIES(PROPERTY) \
+    PROPERTY(HP) PROPERTY(MaxHP) PROPERTY(Mana) PROPERTY(MaxMana) \
+    PROPERTY(PStamina) PROPERTY(MaxPStamina) PROPERTY(MStamina) PROPERTY(MaxMStamina)
+
+enum { GEMNPCACTOR_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* gemNPCActorProperties[] = { GEMNPCACTOR_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double gemNPCActor::GetProperty(MathEnvironment* env, const char* ptr)
 {
-    csString property(ptr);
-    if(property == "HP")
-    {
-        return GetHP();
-    }
-    if(property == "MaxHP")
-    {
-        return GetMaxHP();
-    }
-    if(property == "Mana")
-    {
-        return GetMana();
-    }
-    if(property == "MaxMana")
-    {
-        return GetMaxMana();
-    }
-    if(property == "PStamina")
-    {
-        return GetPysStamina();
-    }
-    if(property == "MaxPStamina")
-    {
-        return GetMaxPysStamina();
-    }
-    if(property == "MStamina")
-    {
-        return GetMenStamina();
-    }
-    if(property == "MaxMStamina")
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(ptr));
+}
+
+double gemNPCActor::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(gemNPCActorProperties, sizeof(gemNPCActorProperties)/sizeof(gemNPCActorProperties[0]));
+
+    switch(properties.Find(id))
     {
-        return GetMaxMenStamina();
+        case PROP_HP:
+            return GetHP();
+        case PROP_MaxHP:
+            return GetMaxHP();
+        case PROP_Mana:
+            return GetMana();
+        case PROP_MaxMana:
+            return GetMaxMana();
+        case PROP_PStamina:
+            return GetPysStamina();
+        case PROP_MaxPStamina:
+            return GetMaxPysStamina();
+        case PROP_MStamina:
+            return GetMenStamina();
+        case PROP_MaxMStamina:
+            return GetMaxMenStamina();
     }
 
-    Error2("Requested gemNPCActor property not found '%s'", ptr);
+    Error2("Requested gemNPCActor property not found '%s'", MathScriptEngine::GetPropertyName(id));
     return 0.0;
 }
 
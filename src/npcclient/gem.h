@@ -358,6 +358,7 @@ private:
      */
     ///@{
     virtual double GetProperty(MathEnvironment* env, const char* ptr);
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     virtual const char* ToString();
     ///@}
@@ -61,8 +61,25 @@
 
 extern bool running;
 
+/// Size of a command message, one byte of it is kept for the terminator when buffered.
+#define NPC_COMMANDS_SIZE 30000
+
+NetworkManager::CommandBuffer::CommandBuffer()
+    : outbound(new psNPCCommandsMessage(0,NPC_COMMANDS_SIZE-1)), count(0)
+{
+}
+
+NetworkManager::CommandBuffer::~CommandBuffer()
+{
+    for(size_t i = 0; i < full.GetSize(); i++)
+    {
+        delete full[i];
+    }
+    delete outbound;
+}
+
 NetworkManager::NetworkManager(MsgHandler* mh,psNetConnection* conn, iEngine* engine)
-    : port(0),reconnect(false)
+    : bufferCommands(false),port(0),reconnect(false)
 {
     msghandler = mh;
     this->engine = engine;
@@ -119,8 +136,11 @@ NetworkManager::~NetworkManager()
         msghandler->Unsubscribe(this,MSGTYPE_HIRED_NPC_SCRIPT);
     }
 
-    delete outbound;
-    outbound = NULL;
+    csHash<CommandBuffer*,CS::Threading::ThreadID>::GlobalIterator it(threadCommands.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
 }
 
 void NetworkManager::Authenticate(csString &host,int port,csString &user,csString &pass)
@@ -154,6 +174,7 @@ const char* NetworkManager::GetCommonString(uint32_t cstr_id)
 
 uint32_t NetworkManager::GetCommonStringID(const char* string)
 {
+    CS::Threading::MutexScopedLock lock(stringsMutex);
     return connection->GetAccessPointers()->Request(string).GetHash();
 }
 
@@ -741,6 +762,9 @@ void NetworkManager::HandlePathNetwork(MsgEntry* me)
         }
         break;
     }
+
+    // Cached routes and the waypoint index may no longer be right.
+    pathNetwork->Invalidate();
 }
 
 void NetworkManager::HandleLocation(MsgEntry* me)
@@ -1982,8 +2006,9 @@ void NetworkManager::HandleNpcDeleted(MsgEntry* me)
 
 void NetworkManager::PrepareCommandMessage()
 {
-    outbound = new psNPCCommandsMessage(0,30000);
-    cmd_count = 0;
+    delete commands.outbound;
+    commands.outbound = new psNPCCommandsMessage(0,NPC_COMMANDS_SIZE);
+    commands.count = 0;
 }
 
 void NetworkManager::QueueDRData(NPC* npc)
@@ -2000,19 +2025,120 @@ void NetworkManager::QueueDRData2(NPC* npc)
     // When a NPC is dead, this may still be called by Behavior::Interrupt
     if(!npc->IsAlive())
         return;
+
+    CommandBuffer* buffer = GetCommandBuffer();
+    if(buffer)
+    {
+        buffer->drQueued.PutUnique(npc->GetPID(), npc);
+        return;
+    }
     cmd_dr_outbound.PutUnique(npc->GetPID(), npc);
 }
 
 void NetworkManager::DequeueDRData(NPC* npc)
 {
     NPCDebug(npc, 15, "Dequeuing DR Data...");
+
+    CommandBuffer* buffer = GetCommandBuffer();
+    if(buffer)
+    {
+        buffer->drQueued.DeleteAll(npc->GetPID());
+        buffer->drDequeued.Push(npc->GetPID());
+        return;
+    }
     cmd_dr_outbound.DeleteAll(npc->GetPID());
 }
 
-void NetworkManager::CheckCommandsOverrun(size_t neededSize)
+NetworkManager::CommandBuffer* NetworkManager::GetCommandBuffer()
 {
-    if(outbound->msg->current + neededSize > outbound->msg->bytes->GetSize())
-        SendAllCommands();
+    if(!bufferCommands)
+        return NULL;
+
+    // Not changed while buffering, so no need to lock.
+    return threadCommands.Get(CS::Threading::Thread::GetThreadID(), NULL);
+}
+
+NetworkManager::CommandBuffer &NetworkManager::CheckCommandsOverrun(size_t neededSize)
+{
+    CommandBuffer* buffer = GetCommandBuffer();
+    if(!buffer)
+    {
+        if(commands.outbound->msg->current + neededSize > commands.outbound->msg->bytes->GetSize())
+            SendAllCommands();
+        return commands;
+    }
+
+    // Sent when the buffer is merged.
+    if(buffer->outbound->msg->current + neededSize > buffer->outbound->msg->bytes->GetSize())
+    {
+        buffer->full.Push(buffer->outbound);
+        buffer->fullCount.Push(buffer->count);
+        buffer->outbound = new psNPCCommandsMessage(0,NPC_COMMANDS_SIZE-1);
+        buffer->count = 0;
+    }
+    return *buffer;
+}
+
+NetworkManager::CommandBuffer* NetworkManager::AddCommandBuffer()
+{
+    CS_ASSERT(!bufferCommands);
+
+    CS::Threading::MutexScopedLock lock(buffersMutex);
+    CommandBuffer* buffer = threadCommands.Get(CS::Threading::Thread::GetThreadID(), NULL);
+    if(!buffer)
+    {
+        buffer = new CommandBuffer;
+        threadCommands.Put(CS::Threading::Thread::GetThreadID(), buffer);
+    }
+    return buffer;
+}
+
+void NetworkManager::SetBufferCommands(bool buffer)
+{
+    bufferCommands = buffer;
+}
+
+void NetworkManager::MergeCommands(CommandBuffer* buffer)
+{
+    CS_ASSERT(!bufferCommands);
+
+    buffer->full.Push(buffer->outbound);
+    buffer->fullCount.Push(buffer->count);
+
+    for(size_t i = 0; i < buffer->full.GetSize(); i++)
+    {
+        MsgEntry* part = buffer->full[i]->msg;
+        size_t size = part->current;
+        if(size)
+        {
+            // The commands are complete, so they are copied as they are.
+            CheckCommandsOverrun(size);
+            MsgEntry* msg = commands.outbound->msg;
+            memcpy(msg->bytes->payload + msg->current, part->bytes->payload, size);
+            msg->current += size;
+            commands.count += buffer->fullCount[i];
+        }
+        delete buffer->full[i];
+    }
+    buffer->full.Empty();
+    buffer->fullCount.Empty();
+    buffer->outbound = new psNPCCommandsMessage(0,NPC_COMMANDS_SIZE-1);
+    buffer->count = 0;
+
+    for(size_t i = 0; i < buffer->drDequeued.GetSize(); i++)
+    {
+        cmd_dr_outbound.DeleteAll(buffer->drDequeued[i]);
+    }
+    buffer->drDequeued.Empty();
+
+    csHash<NPC*,PID>::GlobalIterator it(buffer->drQueued.GetIterator());
+    while(it.HasNext())
+    {
+        PID pid;
+        NPC* npc = it.Next(pid);
+        cmd_dr_outbound.PutUnique(pid, npc);
+    }
+    buffer->drQueued.DeleteAll();
 }
 
 void NetworkManager::QueueDRDataCommand(NPC* npc)
@@ -2024,7 +2150,7 @@ void NetworkManager::QueueDRDataCommand(NPC* npc)
     //      DequeueDRData should be supposed to remove all queued data but the iterator
     //      in SendAllCommands still "catches them"
 
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
     psLinearMovement* linmove = npc->GetLinMove();
     bool onGround;
@@ -2046,374 +2172,374 @@ void NetworkManager::QueueDRDataCommand(NPC* npc)
               mySector->QueryObject()->GetName(), vel.x, vel.y, vel.z, worldVel.x, worldVel.y, worldVel.z, angVel);
     }
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DRDATA);
-    outbound->msg->Add(drmsg.msg->bytes->payload,(uint32_t)drmsg.msg->bytes->GetTotalSize());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DRDATA);
+    cmds.outbound->msg->Add(drmsg.msg->bytes->payload,(uint32_t)drmsg.msg->bytes->GetTotalSize());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueDRData put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueAttackCommand(gemNPCActor* attacker, gemNPCActor* target, const char* stance)
 {
 
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_ATTACK);
-    outbound->msg->Add(attacker->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_ATTACK);
+    cmds.outbound->msg->Add(attacker->GetEID().Unbox());
 
     if(target)
     {
-        outbound->msg->Add(target->GetEID().Unbox());
+        cmds.outbound->msg->Add(target->GetEID().Unbox());
     }
     else
     {
-        outbound->msg->Add((uint32_t) 0);    // 0 target means stop attack
+        cmds.outbound->msg->Add((uint32_t) 0);    // 0 target means stop attack
     }
 
-    outbound->msg->Add(GetCommonStringID(stance));
+    cmds.outbound->msg->Add(GetCommonStringID(stance));
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueAttackCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueScriptCommand(gemNPCActor* npc, gemNPCObject* target, const csString &scriptName)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SCRIPT);
-    outbound->msg->Add(npc->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SCRIPT);
+    cmds.outbound->msg->Add(npc->GetEID().Unbox());
     if(target)
     {
-        outbound->msg->Add(target->GetEID().Unbox());
+        cmds.outbound->msg->Add(target->GetEID().Unbox());
     }
     else
     {
-        outbound->msg->Add((uint32_t)0);
+        cmds.outbound->msg->Add((uint32_t)0);
     }
-    outbound->msg->Add(scriptName);
+    cmds.outbound->msg->Add(scriptName);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueScriptCommand put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueSitCommand(gemNPCActor* npc, gemNPCObject* target, bool sit)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SIT);
-    outbound->msg->Add(npc->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SIT);
+    cmds.outbound->msg->Add(npc->GetEID().Unbox());
     if(target)
     {
-        outbound->msg->Add(target->GetEID().Unbox());
+        cmds.outbound->msg->Add(target->GetEID().Unbox());
     }
     else
     {
-        outbound->msg->Add((uint32_t)0);
+        cmds.outbound->msg->Add((uint32_t)0);
     }
-    outbound->msg->Add(sit);
+    cmds.outbound->msg->Add(sit);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueSitCommand put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueSpawnCommand(gemNPCActor* mother, gemNPCActor* father, const csString &tribeMemberType)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SPAWN);
-    outbound->msg->Add(mother->GetEID().Unbox());
-    outbound->msg->Add(father->GetEID().Unbox());
-    outbound->msg->Add(tribeMemberType);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SPAWN);
+    cmds.outbound->msg->Add(mother->GetEID().Unbox());
+    cmds.outbound->msg->Add(father->GetEID().Unbox());
+    cmds.outbound->msg->Add(tribeMemberType);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueSpawnCommand put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueSpawnBuildingCommand(gemNPCActor* spawner, csVector3 where, iSector* sector, const char* buildingName, int tribeID, bool pickupable)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SPAWN_BUILDING);
-    outbound->msg->Add(spawner->GetEID().Unbox());
-    outbound->msg->Add(where);
-    outbound->msg->Add(sector->QueryObject()->GetName());
-    outbound->msg->Add(buildingName);
-    outbound->msg->Add(pickupable);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SPAWN_BUILDING);
+    cmds.outbound->msg->Add(spawner->GetEID().Unbox());
+    cmds.outbound->msg->Add(where);
+    cmds.outbound->msg->Add(sector->QueryObject()->GetName());
+    cmds.outbound->msg->Add(buildingName);
+    cmds.outbound->msg->Add(pickupable);
 
-    outbound->msg->Add(tribeID);
+    cmds.outbound->msg->Add(tribeID);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueSpawnBuildingCommand put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueUnbuildCommand(gemNPCActor* unbuilder, gemNPCItem* building)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_UNBUILD);
-    outbound->msg->Add(unbuilder->GetEID().Unbox());
-    outbound->msg->Add(building->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_UNBUILD);
+    cmds.outbound->msg->Add(unbuilder->GetEID().Unbox());
+    cmds.outbound->msg->Add(building->GetEID().Unbox());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueUnbuildingCommand put message in overrun state!\n");
     }
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueTalkCommand(gemNPCActor* speaker, gemNPCActor* target, psNPCCommandsMessage::PerceptionTalkType talkType, bool publicTalk, const char* text)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TALK);
-    outbound->msg->Add(speaker->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TALK);
+    cmds.outbound->msg->Add(speaker->GetEID().Unbox());
     if(target)
     {
-        outbound->msg->Add(target->GetEID().Unbox());
+        cmds.outbound->msg->Add(target->GetEID().Unbox());
     }
     else
     {
-        outbound->msg->Add((uint32_t)0);
+        cmds.outbound->msg->Add((uint32_t)0);
     }
-    outbound->msg->Add((uint32_t) talkType);
-    outbound->msg->Add(publicTalk);
-    outbound->msg->Add(text);
+    cmds.outbound->msg->Add((uint32_t) talkType);
+    cmds.outbound->msg->Add(publicTalk);
+    cmds.outbound->msg->Add(text);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueTalkCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueVisibilityCommand(gemNPCActor* entity, bool status)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_VISIBILITY);
-    outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_VISIBILITY);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
 
-    outbound->msg->Add(status);
-    if(outbound->msg->overrun)
+    cmds.outbound->msg->Add(status);
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueVisibleCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueuePickupCommand(gemNPCActor* entity, gemNPCObject* item, int count)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_PICKUP);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(item->GetEID().Unbox());
-    outbound->msg->Add((int16_t) count);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_PICKUP);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(item->GetEID().Unbox());
+    cmds.outbound->msg->Add((int16_t) count);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueuePickupCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueEmoteCommand(gemNPCActor* npc, gemNPCObject* target,  const csString &cmd)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_EMOTE);
-    outbound->msg->Add(npc->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_EMOTE);
+    cmds.outbound->msg->Add(npc->GetEID().Unbox());
     if(target)
     {
-        outbound->msg->Add(target->GetEID().Unbox());
+        cmds.outbound->msg->Add(target->GetEID().Unbox());
     }
     else
     {
-        outbound->msg->Add((uint32_t)0);
+        cmds.outbound->msg->Add((uint32_t)0);
     }
-    outbound->msg->Add(cmd);
+    cmds.outbound->msg->Add(cmd);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueEmoteCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 
 void NetworkManager::QueueEquipCommand(gemNPCActor* entity, csString item, csString slot, int count)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_EQUIP);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(item);
-    outbound->msg->Add(slot);
-    outbound->msg->Add((int16_t) count);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_EQUIP);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(item);
+    cmds.outbound->msg->Add(slot);
+    cmds.outbound->msg->Add((int16_t) count);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueEquipCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueDequipCommand(gemNPCActor* entity, csString slot)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DEQUIP);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(slot);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DEQUIP);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(slot);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueDequipCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueWorkCommand(gemNPCActor* entity, const csString &type, const csString &resource)
 {
-    CheckCommandsOverrun(sizeof(uint8_t) + sizeof(uint32_t) + (type.Length()+1) + (resource.Length()+1));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(uint8_t) + sizeof(uint32_t) + (type.Length()+1) + (resource.Length()+1));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_WORK);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(type);
-    outbound->msg->Add(resource);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_WORK);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(type);
+    cmds.outbound->msg->Add(resource);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueWorkCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueTransferCommand(gemNPCActor* entity, csString item, int count, csString target)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TRANSFER);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(item);
-    outbound->msg->Add((int8_t)count);
-    outbound->msg->Add(target);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TRANSFER);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(item);
+    cmds.outbound->msg->Add((int8_t)count);
+    cmds.outbound->msg->Add(target);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueTransferCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueDeleteNPCCommand(NPC* npc)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DELETE_NPC);
-    outbound->msg->Add(npc->GetPID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DELETE_NPC);
+    cmds.outbound->msg->Add(npc->GetPID().Unbox());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueDeleteNPCCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueDropCommand(gemNPCActor* entity, csString slot)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DROP);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(slot);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_DROP);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(slot);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueDropCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 
 void NetworkManager::QueueResurrectCommand(csVector3 where, float rot, iSector* sector, PID character_id)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_RESURRECT);
-    outbound->msg->Add(character_id.Unbox());
-    outbound->msg->Add((float)rot);
-    outbound->msg->Add(where);
-    outbound->msg->Add(sector, 0, GetMsgStrings());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_RESURRECT);
+    cmds.outbound->msg->Add(character_id.Unbox());
+    cmds.outbound->msg->Add((float)rot);
+    cmds.outbound->msg->Add(where);
+    cmds.outbound->msg->Add(sector, 0, GetMsgStrings());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueResurrectCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueSequenceCommand(csString name, int cmd, int count)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SEQUENCE);
-    outbound->msg->Add(name);
-    outbound->msg->Add((int8_t) cmd);
-    outbound->msg->Add((int32_t) count);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_SEQUENCE);
+    cmds.outbound->msg->Add(name);
+    cmds.outbound->msg->Add((int8_t) cmd);
+    cmds.outbound->msg->Add((int32_t) count);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueSequenceCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueTemporarilyImperviousCommand(gemNPCActor* entity, bool impervious)
 {
-    CheckCommandsOverrun(100);
+    CommandBuffer &cmds = CheckCommandsOverrun(100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TEMPORARILY_IMPERVIOUS);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add((bool) impervious);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TEMPORARILY_IMPERVIOUS);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add((bool) impervious);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueTemporarilyImperviousCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueSystemInfoCommand(uint32_t clientNum, const char* reply, ...)
@@ -2427,108 +2553,108 @@ void NetworkManager::QueueSystemInfoCommand(uint32_t clientNum, const char* repl
 
     // Queue the System Info
 
-    CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+(str.Length()+1));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+(str.Length()+1));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_INFO_REPLY);
-    outbound->msg->Add(clientNum);
-    outbound->msg->Add(str.GetDataSafe());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_INFO_REPLY);
+    cmds.outbound->msg->Add(clientNum);
+    cmds.outbound->msg->Add(str.GetDataSafe());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueSystemInfoCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueAssessCommand(gemNPCActor* entity, gemNPCObject* target, const csString &physicalAssessmentPerception,
                                         const csString &magicalAssessmentPerception,  const csString &overallAssessmentPerception)
 {
-    CheckCommandsOverrun(sizeof(int8_t)+2*sizeof(uint32_t)+(physicalAssessmentPerception.Length()+1)+
-                         (magicalAssessmentPerception.Length()+1)+(overallAssessmentPerception.Length()+1));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(int8_t)+2*sizeof(uint32_t)+(physicalAssessmentPerception.Length()+1)+
+                                               (magicalAssessmentPerception.Length()+1)+(overallAssessmentPerception.Length()+1));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_ASSESS);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(target->GetEID().Unbox());
-    outbound->msg->Add(physicalAssessmentPerception);
-    outbound->msg->Add(magicalAssessmentPerception);
-    outbound->msg->Add(overallAssessmentPerception);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_ASSESS);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(target->GetEID().Unbox());
+    cmds.outbound->msg->Add(physicalAssessmentPerception);
+    cmds.outbound->msg->Add(magicalAssessmentPerception);
+    cmds.outbound->msg->Add(overallAssessmentPerception);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueAssessCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueCastCommand(gemNPCActor* entity, gemNPCObject* target, const csString &spell, float kFactor)
 {
-    CheckCommandsOverrun(sizeof(int8_t)+2*sizeof(uint32_t)+(spell.Length()+1)+sizeof(float));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(int8_t)+2*sizeof(uint32_t)+(spell.Length()+1)+sizeof(float));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_CAST);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(target->GetEID().Unbox());
-    outbound->msg->Add(spell);
-    outbound->msg->Add(kFactor);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_CAST);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(target->GetEID().Unbox());
+    cmds.outbound->msg->Add(spell);
+    cmds.outbound->msg->Add(kFactor);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueCastCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueBusyCommand(gemNPCActor* entity, bool busy)
 {
-    CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+sizeof(bool));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+sizeof(bool));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_BUSY);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(busy);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_BUSY);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(busy);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueBusyCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueControlCommand(gemNPCActor* controllingEntity, gemNPCActor* controlledEntity)
 {
-    CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+100);
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(int8_t)+sizeof(uint32_t)+100);
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_CONTROL);
-    outbound->msg->Add(controllingEntity->GetEID().Unbox());
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_CONTROL);
+    cmds.outbound->msg->Add(controllingEntity->GetEID().Unbox());
 
     psDRMessage drmsg(0,controlledEntity->GetEID(),0,connection->GetAccessPointers(),controlledEntity->pcmove);
-    outbound->msg->Add(drmsg.msg->bytes->payload,(uint32_t)drmsg.msg->bytes->GetTotalSize());
+    cmds.outbound->msg->Add(drmsg.msg->bytes->payload,(uint32_t)drmsg.msg->bytes->GetTotalSize());
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueControlCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::QueueLootCommand(gemNPCActor* entity, EID targetEID, const csString &type)
 {
-    CheckCommandsOverrun(sizeof(uint8_t) + sizeof(uint32_t) + (type.Length()+1));
+    CommandBuffer &cmds = CheckCommandsOverrun(sizeof(uint8_t) + sizeof(uint32_t) + (type.Length()+1));
 
-    outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_LOOT);
-    outbound->msg->Add(entity->GetEID().Unbox());
-    outbound->msg->Add(targetEID.Unbox());
-    outbound->msg->Add(type);
+    cmds.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_LOOT);
+    cmds.outbound->msg->Add(entity->GetEID().Unbox());
+    cmds.outbound->msg->Add(targetEID.Unbox());
+    cmds.outbound->msg->Add(type);
 
-    if(outbound->msg->overrun)
+    if(cmds.outbound->msg->overrun)
     {
         CS_ASSERT(!"NetworkManager::QueueLootCommand put message in overrun state!\n");
     }
 
-    cmd_count++;
+    cmds.count++;
 }
 
 void NetworkManager::SendAllCommands(bool final)
@@ -2563,14 +2689,13 @@ void NetworkManager::SendAllCommands(bool final)
         cmd_dr_outbound.DeleteAll();
     }
 
-    if(cmd_count)
+    if(commands.count)
     {
-        outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TERMINATOR);
-        outbound->msg->ClipToCurrentSize();
+        commands.outbound->msg->Add((int8_t) psNPCCommandsMessage::CMD_TERMINATOR);
+        commands.outbound->msg->ClipToCurrentSize();
 
-        msghandler->SendMessage(outbound->msg);
+        msghandler->SendMessage(commands.outbound->msg);
 
-        delete outbound;
         PrepareCommandMessage();
     }
 }
@@ -22,6 +22,8 @@
 // Crystal Space Includes
 //=============================================================================
 #include <csutil/csstring.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
 
 //=============================================================================
 // Library Includes
@@ -55,6 +57,24 @@ class gemNPCItem;
  */
 class NetworkManager : public psClientNetSubscriber
 {
+public:
+    /**
+     * Commands queued by one thread while commands are buffered, see
+     * SetBufferCommands(). Filled messages are kept until the buffer is merged.
+     */
+    struct CommandBuffer
+    {
+        psNPCCommandsMessage* outbound;
+        int count;                              ///< Number of commands in outbound
+        csArray<psNPCCommandsMessage*> full;    ///< Filled messages, in order
+        csArray<int> fullCount;                 ///< Number of commands in each of them
+        csHash<NPC*,PID> drQueued;              ///< Entities queued for sending of DR.
+        csArray<PID> drDequeued;                ///< Entities taken out of the DR queue.
+
+        CommandBuffer();
+        ~CommandBuffer();
+    };
+
 protected:
     MsgHandler* msghandler;
     psNetConnection* connection;
@@ -62,9 +82,17 @@ protected:
     bool connected;
 
     // Command Message Queue
-    psNPCCommandsMessage* outbound;
+    CommandBuffer         commands;        /// Commands of the main thread, or when not buffered.
     csHash<NPC*,PID>      cmd_dr_outbound; /// Entities queued for sending of DR.
-    int                   cmd_count;       /// Number of command messages queued
+
+    // Command buffers of the threads
+    csHash<CommandBuffer*,CS::Threading::ThreadID> threadCommands;
+    bool                  bufferCommands;  /// Commands go to the buffer of the calling thread.
+    CS::Threading::Mutex  buffersMutex;    /// Guards threadCommands while buffers are added.
+    CS::Threading::Mutex  stringsMutex;    /// Guards the common strings, commands can be queued by several threads.
+
+    /// Get the buffer of the calling thread, NULL if commands aren't buffered.
+    CommandBuffer* GetCommandBuffer();
 
     void RequestAllObjects();
 
@@ -233,10 +261,33 @@ public:
     /**
      * Checks if the npc command message could overrun if the neededSize is tried to be added.
      *
-     * Automatically sends the message in case it could overrun.
+     * Automatically sends the message in case it could overrun. A buffered
+     * message is put aside and a new one started instead.
      * @param neededSize The size of data we are going to attempt to add to the npc commands message.
+     * @return The commands of the calling thread to add to.
+     */
+    CommandBuffer &CheckCommandsOverrun(size_t neededSize);
+
+    /**
+     * Give the calling thread a command buffer of its own. Buffers must be
+     * added while commands aren't buffered.
+     *
+     * @return The buffer, owned by the network manager.
+     */
+    CommandBuffer* AddCommandBuffer();
+
+    /**
+     * Turn buffering of commands on or off. While on, commands are queued to
+     * the buffer of the calling thread, or as usual by threads without one.
+     * Only turn it off once no other thread queues commands anymore.
+     */
+    void SetBufferCommands(bool buffer);
+
+    /**
+     * Append the commands of a buffer to the commands to send and empty it.
+     * Called by the main thread while commands aren't buffered.
      */
-    void CheckCommandsOverrun(size_t neededSize);
+    void MergeCommands(CommandBuffer* buffer);
 
 private:
 
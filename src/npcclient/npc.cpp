@@ -51,6 +51,8 @@
 //=============================================================================
 // Local Space Includes
 //=============================================================================
+#include "brainpool.h"
+#include "perceptionindex.h"
 #include "networkmgr.h"
 #include "npc.h"
 #include "npcclient.h"
@@ -127,7 +129,9 @@ NPC::NPC(psNPCClient* npcclient, NetworkManager* networkmanager, psWorld* world,
       spawnSector(NULL),
       checked(false),
       hatelist(npcclient, engine, world),
-      tick(NULL)
+      tick(NULL),
+      brainIndex(SIZET_NOT_FOUND),
+      brainSlice(SIZET_NOT_FOUND)
 {
     oldbrain=NULL;
     brain=NULL;
@@ -191,6 +195,16 @@ NPC::~NPC()
     {
         tick->Remove();
     }
+
+    if(npcclient->GetBrainPool())
+    {
+        npcclient->GetBrainPool()->Remove(this);
+    }
+
+    if(npcclient->GetPerceptionIndex())
+    {
+        npcclient->GetPerceptionIndex()->Remove(this);
+    }
 }
 
 void NPC::Tick()
@@ -199,11 +213,25 @@ void NPC::Tick()
     if(disabled)
         return;
 
+    // The pool ticks all its brains together.
+    BrainPool* pool = npcclient->GetBrainPool();
+    if(pool)
+    {
+        pool->Add(this);
+        return;
+    }
+
     // Ensure NPC only has one tick at a time.
     CS_ASSERT(tick == NULL);
 
-    csTicks now = csGetTicks();
+    Think(csGetTicks());
+
+    tick = new psNPCTick(NPC_BRAIN_TICK, this);
+    tick->QueueEvent();
+}
 
+void NPC::Think(csTicks now)
+{
     if(npcclient->IsReady())
     {
         ScopedTimer st(200, this); // Calls the ScopedTimerCallback on timeout
@@ -212,9 +240,6 @@ void NPC::Tick()
     }
 
     TickPostProcess(now);
-
-    tick = new psNPCTick(NPC_BRAIN_TICK, this);
-    tick->QueueEvent();
 }
 
 void NPC::TickPostProcess(csTicks when)
@@ -228,6 +253,8 @@ void NPC::TickPostProcess(csTicks when)
     iSector* mySector;
     linmove->GetDRData(onGround,myPos,myYRot,mySector,myVel,worldVel,myAngVel);
 
+    npcclient->GetPerceptionIndex()->Update(this, mySector, myPos);
+
     float distance = npcclient->GetWorld()->Distance(myPos, mySector, lastDrPosition, lastDrSector);
 
 
@@ -601,6 +628,14 @@ void NPC::TriggerEvent(Perception* pcpt, float maxRange,
         return;
     }
 
+    // An NPC ticked by another thread gets it once the brains are done.
+    BrainPool* pool = npcclient->GetBrainPool();
+    if(pool && pool->Defer(this, pcpt, maxRange, basePos, baseSector, sameSector))
+        return;
+
+    // Perceptions look at the world and may interrupt operations.
+    WorldLock lock;
+
     if(maxRange > 0.0)
     {
         // This is a range based perception
@@ -1541,6 +1576,9 @@ void NPC::UpdateControlled()
         return;
     }
 
+    // Moves other actors
+    WorldLock lock;
+
     csVector3 pos,vel;
     float yrot;
     iSector* sector;
@@ -1665,75 +1703,73 @@ Tribe::Asset* NPC::GetBuildingSpot()
     return buildingSpot;
 }
 
+// Properties scripts can read, see GetPropertyByID().
+#define NPC_PROPERTIES(PROPERTY) \
+    PROPERTY(InsideTribeHome) PROPERTY(InsideRegion) PROPERTY(Hate) PROPERTY(HasTarget) \
+    PROPERTY(HP) PROPERTY(MaxHP) PROPERTY(Mana) PROPERTY(MaxMana) \
+    PROPERTY(PStamina) PROPERTY(MaxPStamina) PROPERTY(MStamina) PROPERTY(MaxMStamina)
+
+enum { NPC_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* npcProperties[] = { NPC_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double NPC::GetProperty(MathEnvironment* env, const char* ptr)
 {
-    csString property(ptr);
-    if(property == "InsideTribeHome")
-    {
-        return insideTribeHome?1.0:0.0;
-    }
-    if(property == "InsideRegion")
-    {
-        return insideRegion?1.0:0.0;
-    }
-    if(property == "Hate")
-    {
-        gemNPCActor* target = dynamic_cast<gemNPCActor*>(GetTarget());
-        if(target)
-        {
-            return GetEntityHate(target);
-        }
-        else
-        {
-            return 0.0;
-        }
-    }
-    if(property == "HasTarget")
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(ptr));
+}
+
+double NPC::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(npcProperties, sizeof(npcProperties)/sizeof(npcProperties[0]));
+
+    switch(properties.Find(id))
     {
-        gemNPCActor* target = dynamic_cast<gemNPCActor*>(GetTarget());
-        if(target)
+        case PROP_InsideTribeHome:
+            return insideTribeHome?1.0:0.0;
+        case PROP_InsideRegion:
+            return insideRegion?1.0:0.0;
+        case PROP_Hate:
         {
-            return 1.0;
+            gemNPCActor* target = dynamic_cast<gemNPCActor*>(GetTarget());
+            if(target)
+            {
+                return GetEntityHate(target);
+            }
+            else
+            {
+                return 0.0;
+            }
         }
-        else
+        case PROP_HasTarget:
         {
-            return 0.0;
+            gemNPCActor* target = dynamic_cast<gemNPCActor*>(GetTarget());
+            if(target)
+            {
+                return 1.0;
+            }
+            else
+            {
+                return 0.0;
+            }
         }
-    }
-    if(property == "HP")
-    {
-        return GetHP();
-    }
-    if(property == "MaxHP")
-    {
-        return GetMaxHP();
-    }
-    if(property == "Mana")
-    {
-        return GetMana();
-    }
-    if(property == "MaxMana")
-    {
-        return GetMaxMana();
-    }
-    if(property == "PStamina")
-    {
-        return GetPysStamina();
-    }
-    if(property == "MaxPStamina")
-    {
-        return GetMaxPysStamina();
-    }
-    if(property == "MStamina")
-    {
-        return GetMenStamina();
-    }
-    if(property == "MaxMStamina")
-    {
-        return GetMaxMenStamina();
-    }
-
-    Error2("Requested NPC property not found '%s'", ptr);
+        case PROP_HP:
+            return GetHP();
+        case PROP_MaxHP:
+            return GetMaxHP();
+        case PROP_Mana:
+            return GetMana();
+        case PROP_MaxMana:
+            return GetMaxMana();
+        case PROP_PStamina:
+            return GetPysStamina();
+        case PROP_MaxPStamina:
+            return GetMaxPysStamina();
+        case PROP_MStamina:
+            return GetMenStamina();
+        case PROP_MaxMStamina:
+            return GetMaxMenStamina();
+    }
+
+    Error2("Requested NPC property not found '%s'", MathScriptEngine::GetPropertyName(id));
     return 0.0;
 }
 
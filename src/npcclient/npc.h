@@ -233,8 +233,18 @@ public:
     virtual ~NPC();
 
 
+    /**
+     * Tick the brain now and schedule the next tick, or leave it to the
+     * brain pool when there is one.
+     */
     void Tick();
 
+    /**
+     * Advance the brain and queue the DR data. Called by Tick, or by a
+     * thread of the brain pool.
+     */
+    void Think(csTicks now);
+
     PID                   GetPID()
     {
         return pid;
@@ -870,6 +880,7 @@ private:
      */
     ///@{
     virtual double GetProperty(MathEnvironment* env, const char* ptr);
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     virtual const char* ToString();
     ///@}
@@ -885,7 +896,11 @@ private:
     Tribe::Memory*    bufferMemory;     ///< Used to store location data
     Tribe::Asset*     buildingSpot;     ///< Used to store current building spot.
 
+    size_t            brainIndex;       ///< Index in the brain pool, or SIZET_NOT_FOUND
+    size_t            brainSlice;       ///< Slice of the brain pool ticking this NPC
+
     friend class psNPCTick;
+    friend class BrainPool;
 
 };
 
@@ -50,6 +50,8 @@
 //=============================================================================
 // Local Includes
 //=============================================================================
+#include "brainpool.h"
+#include "perceptionindex.h"
 #include "npcoperations.h"
 #include "npcbehave.h"
 #include "npc.h"
@@ -1375,6 +1377,8 @@ Behavior::BehaviorResult Behavior::Advance(float delta, NPC* npc)
     Behavior::BehaviorResult behaviorResult = BEHAVIOR_FAILED;
     ScriptOperation::OperationResult result;
 
+    WorldLock lock(sequence[current_step]->UsesWorld());
+
     if(sequence[current_step]->GetState() == ScriptOperation::READY_TO_RUN ||
             sequence[current_step]->GetState() == ScriptOperation::INTERRUPTED)
     {
@@ -1626,7 +1630,10 @@ void Behavior::InterruptScript(NPC* npc)
         npc->TriggerEvent(&perception);
     }
 
-    sequence[current_step]->InterruptOperation(npc);
+    {
+        WorldLock lock(sequence[current_step]->UsesWorld());
+        sequence[current_step]->InterruptOperation(npc);
+    }
     interrupted = true;
 
     if(sequence[current_step]->GetState() == ScriptOperation::RUNNING)
@@ -1735,6 +1742,15 @@ void psGameObject::SetPosition(gemNPCObject* object, const csVector3 &pos, iSect
 {
     npcMesh* pcmesh = object->pcmesh;
     pcmesh->MoveMesh(sector,pos);
+
+    NPC* npc = object->GetNPC();
+    if(npc)
+    {
+        iSector* newSector = NULL;
+        csVector3 newPos(0.0f);
+        GetPosition(object, newPos, newSector);
+        npcclient->GetPerceptionIndex()->Update(npc, newSector, newPos);
+    }
 }
 
 void psGameObject::SetRotationAngle(gemNPCObject* object, float angle)
@@ -63,6 +63,8 @@
 // Local Includes
 //=============================================================================
 #include "npcclient.h"
+#include "brainpool.h"
+#include "perceptionindex.h"
 #include "pathfind.h"
 #include "networkmgr.h"
 #include "npcbehave.h"
@@ -103,6 +105,8 @@ psNPCClient::psNPCClient() : serverconsole(NULL)
     running       = true;
     database      = NULL;
     network       = NULL;
+    brainPool     = NULL;
+    perceptionIndex = new PerceptionIndex;
     tick_counter  = 0;
     current_long_range_perception_index = 0;
     current_long_range_perception_loc_index = 0;
@@ -122,6 +126,10 @@ psNPCClient::~psNPCClient()
     delete mathScriptEngine;
 
     running = false;
+    delete brainPool;
+    brainPool = NULL;
+    delete perceptionIndex;
+    perceptionIndex = NULL;
     delete connection;
     delete network;
     delete serverconsole;
@@ -213,6 +221,15 @@ bool psNPCClient::Initialize(iObjectRegistry* object_reg,const char* _host, cons
     }
     network = new NetworkManager(msghandler,connection, engine);
 
+    // Tick the brains on a pool of threads, if asked to.
+    int brainWorkers = configmanager->GetInt("PlaneShift.NPCClient.BrainWorkers", 0);
+    if(brainWorkers > 0)
+    {
+        CPrintf(CON_DEBUG, "Starting %d brain workers...\n", brainWorkers);
+        brainPool = new BrainPool(network);
+        brainPool->Start(brainWorkers);
+    }
+
     vfs =  csQueryRegistry<iVFS> (object_reg);
     if(!vfs)
     {
@@ -806,30 +823,37 @@ NPC* psNPCClient::ReadMasteredNPC(PID char_id, PID master_id)
 }
 
 // iScriptableVar interface for MathScripts
+// Properties scripts can read, see GetPropertyByID().
+#define PSNPCCLIENT_PROPERTIES(PROPERTY) \
+    PROPERTY(gameYear) PROPERTY(gameMonth) PROPERTY(gameHour) PROPERTY(gameMinute)
+
+enum { PSNPCCLIENT_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* psNPCClientProperties[] = { PSNPCCLIENT_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double psNPCClient::GetProperty(MathEnvironment* env, const char* ptr)
 {
-    csString property(ptr);
-    if(property == "gameYear")
-    {
-        return gameYear;
-    }
-    if(property == "gameMonth")
-    {
-        return gameMonth;
-    }
-    if(property == "gameHour")
-    {
-        return gameHour;
-    }
-    if(property == "gameMinute")
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(ptr));
+}
+
+double psNPCClient::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(psNPCClientProperties, sizeof(psNPCClientProperties)/sizeof(psNPCClientProperties[0]));
+
+    switch(properties.Find(id))
     {
-        return gameMinute;
+        case PROP_gameYear:
+            return gameYear;
+        case PROP_gameMonth:
+            return gameMonth;
+        case PROP_gameHour:
+            return gameHour;
+        case PROP_gameMinute:
+            return gameMinute;
     }
-    Error2("Requested psNPCClient property not found '%s'", ptr);
+    Error2("Requested psNPCClient property not found '%s'", MathScriptEngine::GetPropertyName(id));
     return 0.0;
 }
 
-// iScriptableVar interface for MathScripts
 double psNPCClient::CalcFunction(MathEnvironment* env, const char* functionName, const double* params)
 {
     csString function(functionName);
@@ -1160,27 +1184,52 @@ psPath* psNPCClient::FindPath(const char* name)
 
 void psNPCClient::RegisterReaction(NPC* npc, Reaction* reaction)
 {
+    // Brains may change while others run
+    WorldLock lock;
     allReactions.Put(reaction->GetEventType(), npc);
+    perceptionIndex->Add(npc, reaction->GetEventType());
 }
 
 void psNPCClient::TriggerEvent(Perception* pcpt, float maxRange,
                                csVector3* basePos, iSector* baseSector,
                                bool sameSector)
 {
+    // Delivered by the main thread once the brains are done.
+    if(brainPool && brainPool->Defer(NULL, pcpt, maxRange, basePos, baseSector, sameSector))
+        return;
+
     bool foundUser = false;
 
-    // Only trigger NPCs that have this percpetion type registered as a reaction.
-    csHash<NPC*,csString>::Iterator iter(allReactions.GetIterator(pcpt->GetName()));
-    while(iter.HasNext())
+    // Only the NPCs near enough can get a range based perception.
+    if(maxRange > 0.0 && basePos && baseSector)
     {
-        NPC* npc = iter.Next();
+        csArray<NPC*> nearby;
+        perceptionIndex->FindNearby(world, pcpt->GetName(), baseSector, *basePos, maxRange, sameSector, nearby);
+        for(size_t i = 0; i < nearby.GetSize(); i++)
+        {
+            // skip disabled NPCs
+            if(nearby[i]->IsDisabled())
+                continue;
 
-        // skip disabled NPCs
-        if(npc->IsDisabled())
-            continue;
+            nearby[i]->TriggerEvent(pcpt, maxRange, basePos, baseSector, sameSector);
+        }
+        foundUser = allReactions.Contains(pcpt->GetName());
+    }
+    else
+    {
+        // Only trigger NPCs that have this percpetion type registered as a reaction.
+        csHash<NPC*,csString>::Iterator iter(allReactions.GetIterator(pcpt->GetName()));
+        while(iter.HasNext())
+        {
+            NPC* npc = iter.Next();
+
+            // skip disabled NPCs
+            if(npc->IsDisabled())
+                continue;
 
-        npc->TriggerEvent(pcpt, maxRange, basePos, baseSector, sameSector);
-        foundUser = true;
+            npc->TriggerEvent(pcpt, maxRange, basePos, baseSector, sameSector);
+            foundUser = true;
+        }
     }
     if(!foundUser)
     {
@@ -1237,6 +1286,9 @@ void psNPCClient::Tick()
 
     csTicks when = csGetTicks();
 
+    // Catch NPCs moved since they were last placed
+    UpdatePerceptionIndex();
+
     // Advance tribes
     for(size_t j=0; j<tribes.GetSize(); j++)
     {
@@ -1979,31 +2031,7 @@ void psNPCClient::PerceptProximityItems()
         check_count = size;
     }
 
-    csList<NPC*> npcList;
-    {
-        csHash<NPC*,csString>::Iterator iter(allReactions.GetIterator("item sensed"));
-        while(iter.HasNext())
-        {
-            NPC* npc = iter.Next();
-            npcList.PushBack(npc);
-        }
-    }
-    {
-        csHash<NPC*,csString>::Iterator iter(allReactions.GetIterator("item adjacent"));
-        while(iter.HasNext())
-        {
-            NPC* npc = iter.Next();
-            npcList.PushBack(npc);
-        }
-    }
-    {
-        csHash<NPC*,csString>::Iterator iter(allReactions.GetIterator("item nearby"));
-        while(iter.HasNext())
-        {
-            NPC* npc = iter.Next();
-            npcList.PushBack(npc);
-        }
-    }
+    static const char* itemReactions[] = { "item sensed", "item adjacent", "item nearby" };
 
     while(check_count--)
     {
@@ -2033,10 +2061,17 @@ void psNPCClient::PerceptProximityItems()
             bboxPersonal.AddBoundingVertex(item_pos-csVector3(PERSONAL_RANGE_PERCEPTION));
             bboxPersonal.AddBoundingVertexSmart(item_pos+csVector3(PERSONAL_RANGE_PERCEPTION));
 
-            csList<NPC*>::Iterator iter(npcList);
-            while(iter.HasNext())
+            // The NPCs reacting to items that may be within the long range box.
+            csArray<NPC*> npcList;
+            for(size_t r = 0; r < sizeof(itemReactions)/sizeof(itemReactions[0]); r++)
             {
-                NPC* npc = iter.Next();
+                perceptionIndex->FindNearby(world, itemReactions[r], item_sector, item_pos,
+                                            LONG_RANGE_PERCEPTION, true, npcList);
+            }
+
+            for(size_t i = 0; i < npcList.GetSize(); i++)
+            {
+                NPC* npc = npcList[i];
 
                 // skip disabled NPCs
                 if(npc->IsDisabled())
@@ -2079,6 +2114,21 @@ void psNPCClient::PerceptProximityItems()
     }
 }
 
+void psNPCClient::UpdatePerceptionIndex()
+{
+    for(size_t i = 0; i < npcs.GetSize(); i++)
+    {
+        NPC* npc = npcs[i];
+        csVector3 pos(0.0f);
+        iSector* sector = NULL;
+        if(npc->GetActor())
+        {
+            psGameObject::GetPosition(npc->GetActor(), pos, sector);
+        }
+        perceptionIndex->Update(npc, sector, pos);
+    }
+}
+
 void psNPCClient::PerceptProximityLocations()
 {
 
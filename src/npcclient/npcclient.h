@@ -25,6 +25,7 @@
 #include <csutil/hash.h>
 #include <csutil/ref.h>
 #include <csutil/list.h>
+#include <csutil/threading/mutex.h>
 #include <iutil/vfs.h>
 
 struct iObjectRegistry;
@@ -71,6 +72,8 @@ class  LocationManager;
 class  Waypoint;
 //class  psPFMaps;
 class  Tribe;
+class  BrainPool;
+class  PerceptionIndex;
 class  psPath;
 class  psPathNetwork;
 struct iCelHNavStruct;
@@ -510,6 +513,32 @@ public:
         return cdsys;
     }
 
+    /**
+     * Returns the pool ticking the brains, or NULL if they are ticked
+     * one by one by the main thread.
+     */
+    BrainPool* GetBrainPool()
+    {
+        return brainPool;
+    }
+
+    /**
+     * Lock held while brains use the engine, the collision system or the
+     * path network. Use WorldLock rather than this.
+     */
+    CS::Threading::RecursiveMutex &GetWorldMutex()
+    {
+        return worldMutex;
+    }
+
+    /**
+     * Returns the index of the NPCs reacting to each perception by position.
+     */
+    PerceptionIndex* GetPerceptionIndex()
+    {
+        return perceptionIndex;
+    }
+
     NPC* ReadSingleNPC(PID char_id, PID master_id = 0);
 
     /**
@@ -725,6 +754,7 @@ public:
      */
     ///@{
     virtual double GetProperty(MathEnvironment* env, const char* ptr);
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     virtual const char* ToString();
     ///@}
@@ -762,6 +792,11 @@ protected:
      */
     void PerceptProximityTribeHome();
 
+    /**
+     * Place all NPCs at their current position in the perception index.
+     */
+    void UpdatePerceptionIndex();
+
 public:
     static psNPCClient*             npcclient;
 protected:
@@ -774,6 +809,8 @@ protected:
     EventManager*                   eventmanager;
     RecipeManager*                  recipemanager;
     NetworkManager*                 network;
+    BrainPool*                      brainPool;        ///< Ticks the brains, if configured with workers
+    CS::Threading::RecursiveMutex   worldMutex;       ///< See GetWorldMutex()
     psDatabase*                     database;
     csRef<iVFS>                     vfs;
 
@@ -794,6 +831,7 @@ protected:
     csHash<psNPCRaceListMessage::NPCRaceInfo_t,csString>     raceInfos; ///< Information about all the races.
 
     csHash<NPC*,csString>           allReactions;     ///< Hash of all registered reactions.
+    PerceptionIndex*                perceptionIndex;  ///< The registered reactions by position.
     csArray<csString>               notUsedReactions; ///< List of not matched reactions.
 
     csRef<iCollideSystem>           cdsys;
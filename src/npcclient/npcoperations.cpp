@@ -5421,6 +5421,27 @@ bool WanderOperation::WanderRouteFilter::Filter(const Waypoint* waypoint) const
               (!parent->groundValid || waypoint->ground == parent->ground)));
 }
 
+bool WanderOperation::WanderRouteFilter::GetCacheKey(uint32 &key) const
+{
+    // Two bits for each flag, whether it is checked and the wanted value.
+    bool flags[] = { parent->undergroundValid, parent->underground, parent->underwaterValid, parent->underwater,
+                     parent->privValid, parent->priv, parent->pubValid, parent->pub,
+                     parent->cityValid, parent->city, parent->indoorValid, parent->indoor,
+                     parent->pathValid, parent->path, parent->roadValid, parent->road,
+                     parent->groundValid, parent->ground
+                   };
+
+    key = 0;
+    for(size_t i = 0; i < sizeof(flags)/sizeof(flags[0]); i += 2)
+    {
+        if(flags[i])
+        {
+            key |= (flags[i + 1] ? 3 : 1) << i;
+        }
+    }
+    return true;
+}
+
 bool WanderOperation::StartMoveTo(NPC* npc, psPathPoint* point)
 {
     float dummyAngle;
@@ -152,6 +152,18 @@ public:
     virtual OperationResult Advance(float timedelta,NPC* npc);
 
     virtual void InterruptOperation(NPC* npc);
+
+    /**
+     * Whether the operation uses the engine, the collision system or the path
+     * network. Such operations hold the world lock when the brains are ticked
+     * by a pool, the others run alongside each other. Those may only use
+     * what is safe from several threads, like psGetRandom().
+     */
+    virtual bool UsesWorld() const
+    {
+        return true;
+    }
+
     virtual bool AtInterruptedPosition(const csVector3 &pos, const iSector* sector);
     virtual bool AtInterruptedAngle(const csVector3 &pos, const iSector* sector, float angle);
     virtual bool AtInterruptedPosition(NPC* npc);
@@ -406,6 +418,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -759,6 +775,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -778,6 +798,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -871,6 +895,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -895,6 +923,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -946,6 +978,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1008,6 +1044,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1035,6 +1075,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1090,6 +1134,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1208,6 +1256,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1425,6 +1477,10 @@ public:
     virtual ~VelSourceOperation() { }
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
     virtual OperationResult Run(NPC* npc,bool interrupted);
 };
 
@@ -1481,6 +1537,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1508,6 +1568,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1555,6 +1619,10 @@ public:
     virtual bool Load(iDocumentNode* node);
     virtual OperationResult Advance(float timedelta,NPC* npc);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1581,6 +1649,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1673,6 +1745,10 @@ public:
     virtual OperationResult Run(NPC* npc,bool interrupted);
     virtual bool Load(iDocumentNode* node);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1704,6 +1780,10 @@ public:
     virtual bool Load(iDocumentNode* node);
     virtual OperationResult Advance(float timedelta,NPC* npc);
     virtual ScriptOperation* MakeCopy();
+    virtual bool UsesWorld() const
+    {
+        return false;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -1723,6 +1803,7 @@ protected:
     public:
         WanderRouteFilter(WanderOperation*  parent):parent(parent) {};
         virtual bool Filter(const Waypoint* waypoint) const;
+        virtual bool GetCacheKey(uint32 &key) const;
     protected:
         WanderOperation*  parent;
     };
@@ -0,0 +1,243 @@
+/*
+ * perceptionindex.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+#include <math.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "engine/psworld.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "perceptionindex.h"
+
+
+PerceptionIndex::ReactionIndex::~ReactionIndex()
+{
+    csHash<SectorCells*, csPtrKey<iSector> >::GlobalIterator it(sectors.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
+}
+
+PerceptionIndex::PerceptionIndex(float cellSize)
+    : cellSize(cellSize), queries(0), visited(0), listening(0)
+{
+}
+
+PerceptionIndex::~PerceptionIndex()
+{
+    csHash<ReactionIndex*, csString>::GlobalIterator it(reactions.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
+}
+
+PerceptionIndexCellKey PerceptionIndex::GetKey(const csVector3 &pos) const
+{
+    return PerceptionIndexCellKey((int)floorf(pos.x / cellSize), (int)floorf(pos.z / cellSize));
+}
+
+void PerceptionIndex::Place(NPC* npc, ReactionIndex* reaction, iSector* sector, const PerceptionIndexCellKey &key)
+{
+    SectorCells* sectorCells = reaction->sectors.Get(sector, NULL);
+    if(!sectorCells)
+    {
+        sectorCells = new SectorCells;
+        reaction->sectors.Put(sector, sectorCells);
+    }
+
+    csArray<NPC*>* cell = sectorCells->cells.GetElementPointer(key);
+    if(!cell)
+    {
+        sectorCells->cells.Put(key, csArray<NPC*>());
+        cell = sectorCells->cells.GetElementPointer(key);
+    }
+    cell->Push(npc);
+}
+
+void PerceptionIndex::Unplace(NPC* npc, ReactionIndex* reaction, iSector* sector, const PerceptionIndexCellKey &key)
+{
+    SectorCells* sectorCells = reaction->sectors.Get(sector, NULL);
+    if(!sectorCells)
+        return;
+
+    csArray<NPC*>* cell = sectorCells->cells.GetElementPointer(key);
+    if(!cell)
+        return;
+
+    size_t index = cell->Find(npc);
+    if(index != csArrayItemNotFound)
+        cell->DeleteIndexFast(index);
+    if(cell->IsEmpty())
+        sectorCells->cells.DeleteAll(key);
+}
+
+void PerceptionIndex::Add(NPC* npc, const csString &reaction)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    ReactionIndex* reactionIndex = reactions.Get(reaction, NULL);
+    if(!reactionIndex)
+    {
+        reactionIndex = new ReactionIndex;
+        reactions.Put(reaction, reactionIndex);
+    }
+
+    Entry* entry = entries.GetElementPointer(npc);
+    if(!entry)
+    {
+        Entry newEntry;
+        newEntry.sector = NULL;
+        entries.Put(npc, newEntry);
+        entry = entries.GetElementPointer(npc);
+    }
+
+    // Added as often as the reaction is registered, so the NPC is found as
+    // many times as it is in allReactions.
+    entry->reactions.Push(reactionIndex);
+    reactionIndex->listeners++;
+    if(entry->sector)
+        Place(npc, reactionIndex, entry->sector, entry->key);
+}
+
+void PerceptionIndex::Update(NPC* npc, iSector* sector, const csVector3 &pos)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    Entry* entry = entries.GetElementPointer(npc);
+    if(!entry)
+        return; // Doesn't react to anything
+
+    PerceptionIndexCellKey key = GetKey(pos);
+    if(entry->sector == sector && (!sector || entry->key == key))
+        return;
+
+    for(size_t i = 0; i < entry->reactions.GetSize(); i++)
+    {
+        if(entry->sector)
+            Unplace(npc, entry->reactions[i], entry->sector, entry->key);
+        if(sector)
+            Place(npc, entry->reactions[i], sector, key);
+    }
+    entry->sector = sector;
+    entry->key = key;
+}
+
+void PerceptionIndex::Remove(NPC* npc)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    Entry* entry = entries.GetElementPointer(npc);
+    if(!entry)
+        return;
+
+    for(size_t i = 0; i < entry->reactions.GetSize(); i++)
+    {
+        if(entry->sector)
+            Unplace(npc, entry->reactions[i], entry->sector, entry->key);
+        entry->reactions[i]->listeners--;
+    }
+    entries.DeleteAll(npc);
+}
+
+void PerceptionIndex::CollectCells(SectorCells* sectorCells, const csVector3 &pos, float radius, csArray<NPC*> &list)
+{
+    PerceptionIndexCellKey min = GetKey(pos - csVector3(radius));
+    PerceptionIndexCellKey max = GetKey(pos + csVector3(radius));
+
+    size_t cellCount = (size_t)(max.x - min.x + 1) * (size_t)(max.z - min.z + 1);
+    if(cellCount > PERCEPTION_INDEX_MAX_QUERY_CELLS || cellCount > sectorCells->cells.GetSize())
+    {
+        // Cheaper to take every cell of the sector than probe them one by one.
+        csHash<csArray<NPC*>, PerceptionIndexCellKey>::GlobalIterator it(sectorCells->cells.GetIterator());
+        while(it.HasNext())
+        {
+            PerceptionIndexCellKey key;
+            const csArray<NPC*> &cell = it.Next(key);
+            if(key.x >= min.x && key.x <= max.x && key.z >= min.z && key.z <= max.z)
+                list.Merge(cell);
+        }
+        return;
+    }
+
+    for(int x = min.x; x <= max.x; x++)
+    {
+        for(int z = min.z; z <= max.z; z++)
+        {
+            const csArray<NPC*>* cell = sectorCells->cells.GetElementPointer(PerceptionIndexCellKey(x, z));
+            if(cell)
+                list.Merge(*cell);
+        }
+    }
+}
+
+void PerceptionIndex::FindNearby(psWorld* world, const csString &reaction, iSector* sector, const csVector3 &pos,
+                                 float radius, bool sameSector, csArray<NPC*> &list)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    ReactionIndex* reactionIndex = reactions.Get(reaction, NULL);
+    if(!reactionIndex)
+        return;
+
+    size_t found = list.GetSize();
+    radius += PERCEPTION_INDEX_MARGIN;
+
+    SectorCells* sectorCells = reactionIndex->sectors.Get(sector, NULL);
+    if(sectorCells)
+        CollectCells(sectorCells, pos, radius, list);
+
+    if(!sameSector)
+    {
+        // The same as psWorld::Distance, sectors without a way to warp into are out of range.
+        csHash<SectorCells*, csPtrKey<iSector> >::GlobalIterator it(reactionIndex->sectors.GetIterator());
+        while(it.HasNext())
+        {
+            csPtrKey<iSector> other;
+            SectorCells* otherCells = it.Next(other);
+            if((iSector*)other == sector)
+                continue;
+
+            csVector3 warped = pos;
+            if(world->WarpSpace(sector, other, warped))
+                CollectCells(otherCells, warped, radius, list);
+        }
+    }
+
+    queries++;
+    visited += list.GetSize() - found;
+    listening += reactionIndex->listeners;
+}
+
+csString PerceptionIndex::GetStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    csString result;
+    result.Format("%zu NPCs in %zu reactions, %zu ranged perceptions visited %.1f NPCs each of %.1f listening",
+                  entries.GetSize(), reactions.GetSize(), queries,
+                  queries ? (float)visited / (float)queries : 0.0f,
+                  queries ? (float)listening / (float)queries : 0.0f);
+    return result;
+}
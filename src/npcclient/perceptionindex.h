@@ -0,0 +1,189 @@
+/*
+ * perceptionindex.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __PERCEPTIONINDEX_H__
+#define __PERCEPTIONINDEX_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csgeom/vector3.h>
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/hash.h>
+#include <csutil/threading/mutex.h>
+
+class NPC;
+class psWorld;
+struct iSector;
+
+/**
+ * \addtogroup npcclient
+ * @{ */
+
+/// Edge length of one cell of the perception index in meters.
+#define PERCEPTION_INDEX_CELL_SIZE 16.0f
+
+/**
+ * How far an NPC may have moved since it was last placed in the index.
+ * Added to the radius of all queries.
+ */
+#define PERCEPTION_INDEX_MARGIN 5.0f
+
+/**
+ * Queries covering more cells than this walk all cells of the sector instead.
+ */
+#define PERCEPTION_INDEX_MAX_QUERY_CELLS 256
+
+/**
+ * Key of one cell of the perception index.
+ */
+struct PerceptionIndexCellKey
+{
+    int x;
+    int z;
+
+    PerceptionIndexCellKey() : x(0), z(0) {}
+    PerceptionIndexCellKey(int x, int z) : x(x), z(z) {}
+
+    bool operator == (const PerceptionIndexCellKey &other) const
+    {
+        return x == other.x && z == other.z;
+    }
+
+    bool operator < (const PerceptionIndexCellKey &other) const
+    {
+        if(x != other.x)
+            return x < other.x;
+        return z < other.z;
+    }
+};
+
+template<> class csHashComputer<PerceptionIndexCellKey>
+{
+public:
+    static uint ComputeHash(const PerceptionIndexCellKey &key)
+    {
+        return (uint)(key.x * 73856093) ^ (uint)(key.z * 19349663);
+    }
+};
+
+/**
+ * The NPCs reacting to each perception, on a grid per sector.
+ *
+ * Range limited perceptions only need to go to the NPCs near them. The
+ * index keeps, for each reaction, the NPCs reacting to it in cells of the
+ * x/z plane of the sectors they are in, so those are found without
+ * looking at every NPC listening for the perception. The NPCs found are
+ * candidates only: whoever asked still checks the exact range.
+ *
+ * NPCs are placed again whenever they are seen to have moved, at the end
+ * of their brain tick, when the server moves them, and by a sweep of all
+ * NPCs every client tick. Queries add PERCEPTION_INDEX_MARGIN to cover the
+ * distance walked in between.
+ *
+ * Safe to use from several threads, the brain pool places NPCs as they
+ * are ticked.
+ */
+class PerceptionIndex
+{
+public:
+    PerceptionIndex(float cellSize = PERCEPTION_INDEX_CELL_SIZE);
+    ~PerceptionIndex();
+
+    /**
+     * Let an NPC be found for a reaction. The NPC isn't placed in the
+     * world until Update is called. An NPC added several times for the
+     * same reaction is found as many times, like the unranged perceptions
+     * reach it once per registration.
+     */
+    void Add(NPC* npc, const csString &reaction);
+
+    /**
+     * Place an NPC at its position.
+     *
+     * @param sector The sector of the NPC, NULL if it has no actor.
+     */
+    void Update(NPC* npc, iSector* sector, const csVector3 &pos);
+
+    /// Forget an NPC, for example when it is deleted.
+    void Remove(NPC* npc);
+
+    /**
+     * Add the NPCs reacting to a perception that may be within range of a
+     * position to list. These are the NPCs in cells overlapping the square
+     * of radius around the position.
+     *
+     * @param world      Used to find positions in sectors connected to sector.
+     * @param reaction   The name of the perception.
+     * @param sector     The sector of the position.
+     * @param pos        The position.
+     * @param radius     The range of the perception.
+     * @param sameSector Only look in the sector of the position.
+     * @param list       The NPCs found are appended here.
+     */
+    void FindNearby(psWorld* world, const csString &reaction, iSector* sector, const csVector3 &pos,
+                    float radius, bool sameSector, csArray<NPC*> &list);
+
+    /// Number of NPCs visited per perception, for the console.
+    csString GetStats();
+
+private:
+    /// The cells of the NPCs of one reaction in one sector.
+    struct SectorCells
+    {
+        csHash<csArray<NPC*>, PerceptionIndexCellKey> cells;
+    };
+
+    /// All NPCs reacting to one perception.
+    struct ReactionIndex
+    {
+        csHash<SectorCells*, csPtrKey<iSector> > sectors;
+        size_t listeners;
+
+        ReactionIndex() : listeners(0) {}
+        ~ReactionIndex();
+    };
+
+    /// The reactions of an NPC and where it is placed.
+    struct Entry
+    {
+        csArray<ReactionIndex*> reactions;
+        iSector* sector;                    ///< NULL if not placed
+        PerceptionIndexCellKey key;
+    };
+
+    PerceptionIndexCellKey GetKey(const csVector3 &pos) const;
+    void Place(NPC* npc, ReactionIndex* reaction, iSector* sector, const PerceptionIndexCellKey &key);
+    void Unplace(NPC* npc, ReactionIndex* reaction, iSector* sector, const PerceptionIndexCellKey &key);
+    void CollectCells(SectorCells* sectorCells, const csVector3 &pos, float radius, csArray<NPC*> &list);
+
+    float cellSize;
+    CS::Threading::Mutex mutex;
+    csHash<ReactionIndex*, csString> reactions;
+    csHash<Entry, csPtrKey<NPC> > entries;
+
+    /// Statistics
+    size_t queries;
+    size_t visited;         ///< NPCs found by queries
+    size_t listening;       ///< NPCs a query would have visited without the index
+};
+
+/** @} */
+
+#endif
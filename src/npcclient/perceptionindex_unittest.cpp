@@ -0,0 +1,145 @@
+/*
+ * perceptionindex_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+#include "perceptionindex.h"
+
+// This requires googletest to be installed
+#include <gtest/gtest.h>
+
+/**
+ * The index never looks into NPCs or sectors, so the tests use addresses
+ * of plain bytes for them.
+ */
+static char npcStorage[100];
+static char sectorStorage[2];
+
+static NPC* TestNPC(size_t i)
+{
+    return reinterpret_cast<NPC*>(&npcStorage[i]);
+}
+
+static iSector* TestSector(size_t i)
+{
+    return reinterpret_cast<iSector*>(&sectorStorage[i]);
+}
+
+/// 100 NPCs listening for talk, 10 apart along x.
+class PerceptionIndexTest : public testing::Test
+{
+protected:
+    PerceptionIndexTest()
+    {
+        for(size_t i = 0; i < 100; i++)
+        {
+            index.Add(TestNPC(i), "talk");
+            index.Update(TestNPC(i), TestSector(0), csVector3(i * 10.0f, 0.0f, 0.0f));
+        }
+    }
+
+    bool Found(const csArray<NPC*> &list, size_t i)
+    {
+        return list.Find(TestNPC(i)) != csArrayItemNotFound;
+    }
+
+    PerceptionIndex index;
+};
+
+TEST_F(PerceptionIndexTest, OnlyNearbyNPCs)
+{
+    csArray<NPC*> list;
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(500.0f, 0.0f, 0.0f), 30.0f, true, list);
+
+    // All within range are found, but not many more.
+    for(size_t i = 47; i <= 53; i++)
+    {
+        EXPECT_TRUE(Found(list, i)) << "NPC " << i;
+    }
+    EXPECT_LT(list.GetSize(), 15u);
+    EXPECT_FALSE(Found(list, 0));
+    EXPECT_FALSE(Found(list, 99));
+}
+
+TEST_F(PerceptionIndexTest, MovedNPCs)
+{
+    index.Update(TestNPC(0), TestSector(0), csVector3(500.0f, 0.0f, 5.0f));
+
+    csArray<NPC*> list;
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(500.0f, 0.0f, 0.0f), 10.0f, true, list);
+    EXPECT_TRUE(Found(list, 0));
+
+    list.Empty();
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(0.0f, 0.0f, 0.0f), 10.0f, true, list);
+    EXPECT_FALSE(Found(list, 0));
+    EXPECT_TRUE(Found(list, 1));
+}
+
+TEST_F(PerceptionIndexTest, OtherReactionsAndSectors)
+{
+    index.Add(TestNPC(50), "attack");
+    index.Update(TestNPC(51), TestSector(1), csVector3(510.0f, 0.0f, 0.0f));
+    index.Update(TestNPC(52), NULL, csVector3(0.0f));
+
+    csArray<NPC*> list;
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(510.0f, 0.0f, 0.0f), 10.0f, true, list);
+    EXPECT_TRUE(Found(list, 50));
+    EXPECT_FALSE(Found(list, 51));
+    EXPECT_FALSE(Found(list, 52));
+
+    list.Empty();
+    index.FindNearby(NULL, "attack", TestSector(0), csVector3(510.0f, 0.0f, 0.0f), 10.0f, true, list);
+    ASSERT_EQ(1u, list.GetSize());
+    EXPECT_EQ(TestNPC(50), list[0]);
+
+    list.Empty();
+    index.FindNearby(NULL, "shout", TestSector(0), csVector3(510.0f, 0.0f, 0.0f), 10.0f, true, list);
+    EXPECT_EQ(0u, list.GetSize());
+}
+
+TEST_F(PerceptionIndexTest, RemovedNPCs)
+{
+    index.Remove(TestNPC(50));
+    index.Update(TestNPC(50), TestSector(0), csVector3(500.0f, 0.0f, 0.0f));
+
+    csArray<NPC*> list;
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(500.0f, 0.0f, 0.0f), 10.0f, true, list);
+    EXPECT_FALSE(Found(list, 50));
+    EXPECT_TRUE(Found(list, 49));
+}
+
+TEST_F(PerceptionIndexTest, AddedTwice)
+{
+    index.Add(TestNPC(50), "talk");
+
+    csArray<NPC*> list;
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(500.0f, 0.0f, 0.0f), 1.0f, true, list);
+    size_t count = 0;
+    for(size_t i = 0; i < list.GetSize(); i++)
+    {
+        if(list[i] == TestNPC(50))
+            count++;
+    }
+    EXPECT_EQ(2u, count);
+
+    index.Remove(TestNPC(50));
+    list.Empty();
+    index.FindNearby(NULL, "talk", TestSector(0), csVector3(500.0f, 0.0f, 0.0f), 1.0f, true, list);
+    EXPECT_FALSE(Found(list, 50));
+}
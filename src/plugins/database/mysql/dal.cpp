@@ -20,6 +20,8 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/objreg.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
@@ -39,10 +41,16 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
     psMysqlConnection::psMysqlConnection(iBase *iParent) : scfImplementationType(this, iParent)
     {
         conn = NULL;
+        objectReg = NULL;
+        pipeline = NULL;
+        logcsv = NULL;
+        port = 0;
+        attachedThreads = 0;
     }
 
     psMysqlConnection::~psMysqlConnection()
     {
+        delete pipeline;
         mysql_close(conn);
         conn = NULL;
     }
@@ -60,6 +68,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                                   const char *user, const char *pwd, LogCSV* logcsv)
     {
         this->logcsv = logcsv;
+        // Kept for the connections of attached threads.
+        this->host = host;
+        this->port = port;
+        this->database = database;
+        this->user = user;
+        this->pwd = pwd;
+
         // Create a mydb
         mysql_library_init(0, NULL, NULL);
         mysql_thread_init();
@@ -75,28 +90,31 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         mysql_options(conn_check, MYSQL_OPT_RECONNECT, &my_true);
     #endif
 
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        csRef<iConfigManager> config = objectReg ? csQueryRegistry<iConfigManager>(objectReg) : 0;
+        if(config && config->GetBool("Planeshift.Database.Pipeline", false))
+        {
+            pipeline = new DBPipeline(new MysqlPipelineBackend(host, port, database, user, pwd),
+                                      config->GetInt("Planeshift.Database.PipelineBatch", 32));
+            if(!pipeline->Start())
+            {
+                CPrintf(CON_ERROR, "Couldn't connect the query pipeline, CommandPump() runs right away.\n");
+                delete pipeline;
+                pipeline = NULL;
+            }
+        }
 
         return (conn == conn_check);
     }
 
     bool psMysqlConnection::Close()
     {
+        // Runs what is still queued.
+        delete pipeline;
+        pipeline = NULL;
+
         mysql_close(conn);
         conn = NULL;
 
-    #ifdef USE_DELAY_QUERY
-        mysql_thread_end();
-
-        dqm->Stop();
-        dqmThread->Stop();
-    #endif
-
         mysql_library_end();
         return true;
     }
@@ -109,7 +127,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     const char *psMysqlConnection::GetLastError()
     {
-        return mysql_error(conn);
+        return mysql_error(GetConn());
     }
 
     // Sets *to to the escaped value
@@ -125,17 +143,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
-
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
-
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -144,11 +151,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         querystr.FormatV(sql, args);
         va_end(args);
 
-        lastquery = querystr;
+        if(pipeline)
+        {
+            pipeline->Push(querystr);
+            return 1;
+        }
+
+        GetLastQueryString() = querystr;
 
 
         timer.Start();
-        if (!mysql_query(conn, querystr))
+        if (!mysql_query(GetConn(), querystr))
         {
             if(timer.Stop() > 1000)
             {
@@ -160,13 +173,31 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
             //csString status;
             //status.Format("%s, %d", querystr.GetData(), timer.Stop());
             //logcsv->Write(CSV_SQL, status);
-            profs.AddSQLTime(querystr, timer.Stop());
-            return (unsigned long) mysql_affected_rows(conn);
+            AddSQLTime(querystr, timer.Stop());
+            return (unsigned long) mysql_affected_rows(GetConn());
         }
         else
             return QUERY_FAILED;
+    }
 
-    #endif
+    void psMysqlConnection::CommandPump(iQueryCallback* callback, const char *sql,...)
+    {
+        csString querystr;
+        va_list args;
+
+        va_start(args, sql);
+        querystr.FormatV(sql, args);
+        va_end(args);
+
+        if(pipeline)
+        {
+            pipeline->Push(querystr, callback);
+            return;
+        }
+
+        unsigned long result = Command("%s", querystr.GetData());
+        if(callback)
+            callback->QueryDone(result, result == QUERY_FAILED ? GetLastError() : NULL);
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -179,10 +210,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         querystr.FormatV(sql, args);
         va_end(args);
 
-        lastquery = querystr;
+        GetLastQueryString() = querystr;
 
         timer.Start();
-        if (!mysql_query(conn, querystr))
+        if (!mysql_query(GetConn(), querystr))
         {
             if(timer.Stop() > 1000)
             {
@@ -191,8 +222,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
-            return (unsigned long) mysql_affected_rows(conn);
+            AddSQLTime(querystr, timer.Stop());
+            return (unsigned long) mysql_affected_rows(GetConn());
         }
         else
             return QUERY_FAILED;
@@ -208,10 +239,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         querystr.FormatV(sql, args);
         va_end(args);
 
-        lastquery = querystr;
+        GetLastQueryString() = querystr;
 
         timer.Start();
-        if (!mysql_query(conn, querystr))
+        if (!mysql_query(GetConn(), querystr))
         {
             if(timer.Stop() > 1000)
             {
@@ -220,8 +251,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
-            iResultSet *rs = new psResultSet(conn);
+            AddSQLTime(querystr, timer.Stop());
+            iResultSet *rs = new psResultSet(GetConn());
             return rs;
         }
         else
@@ -238,10 +269,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         querystr.FormatV(sql, args);
         va_end(args);
 
-        lastquery = querystr;
+        GetLastQueryString() = querystr;
 
         timer.Start();
-        if (!mysql_query(conn, querystr))
+        if (!mysql_query(GetConn(), querystr))
         {
             if(timer.Stop() > 1000)
             {
@@ -250,8 +281,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
-            psResultSet *rs = new psResultSet(conn);
+            AddSQLTime(querystr, timer.Stop());
+            psResultSet *rs = new psResultSet(GetConn());
 
             if (rs->Count())
             {
@@ -270,7 +301,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     uint64 psMysqlConnection::GetLastInsertID()
     {
-        return mysql_insert_id(conn);
+        return mysql_insert_id(GetConn());
     }
 
     uint64 psMysqlConnection::GenericInsertWithID(const char *table,const char **fieldnames,psStringArray& fieldvalues)
@@ -341,7 +372,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
         //printf("%s\n",command.GetData());
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -389,7 +420,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
         //printf("%s\n",command.GetData());
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -411,24 +442,101 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     const char* psMysqlConnection::DumpProfile()
     {
+        MutexScopedLock lock(profsMutex);
         profileDump = profs.Dump();
+        if(pipeline)
+            profileDump += pipeline->DumpProfile();
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
+        MutexScopedLock lock(profsMutex);
         profs.Reset();
+        if(pipeline)
+            pipeline->ResetProfile();
         profileDump.Empty();
     }
 
     iRecord* psMysqlConnection::NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line)
     {
-        return new dbUpdate(conn, table, idfield, count, logcsv, file, line);
+        return new dbUpdate(GetConn(), table, idfield, count, logcsv, file, line);
     }
 
     iRecord* psMysqlConnection::NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line)
     {
-        return new dbInsert(conn, table, count, logcsv, file, line);
+        return new dbInsert(GetConn(), table, count, logcsv, file, line);
+    }
+
+    bool psMysqlConnection::AttachThread()
+    {
+        mysql_thread_init();
+        MYSQL* threadConn = mysql_init(NULL);
+        if(!mysql_real_connect(threadConn, host, user, pwd, database, port, NULL, CLIENT_FOUND_ROWS))
+        {
+            CPrintf(CON_ERROR, "Couldn't connect a thread to the database: %s\n", mysql_error(threadConn));
+            mysql_close(threadConn);
+            mysql_thread_end();
+            return false;
+        }
+        my_bool my_true = true;
+
+    #if MYSQL_VERSION_ID >= 50000
+        mysql_options(threadConn, MYSQL_OPT_RECONNECT, &my_true);
+    #endif
+
+        ThreadConnection* thread = new ThreadConnection;
+        thread->conn = threadConn;
+
+        MutexScopedLock lock(threadMutex);
+        threadConns.PutUnique(Thread::GetThreadID(), thread);
+        AtomicOperations::Increment(&attachedThreads);
+        return true;
+    }
+
+    void psMysqlConnection::DetachThread()
+    {
+        ThreadConnection* thread;
+        {
+            MutexScopedLock lock(threadMutex);
+            thread = threadConns.Get(Thread::GetThreadID(), NULL);
+            if(!thread)
+                return;
+            threadConns.DeleteAll(Thread::GetThreadID());
+            AtomicOperations::Decrement(&attachedThreads);
+        }
+
+        mysql_close(thread->conn);
+        delete thread;
+        mysql_thread_end();
+    }
+
+    psMysqlConnection::ThreadConnection* psMysqlConnection::GetThreadConnection()
+    {
+        // Nothing to look up while no thread is attached, as is the case after startup.
+        if(!AtomicOperations::Read(&attachedThreads))
+            return NULL;
+
+        MutexScopedLock lock(threadMutex);
+        return threadConns.Get(Thread::GetThreadID(), NULL);
+    }
+
+    MYSQL* psMysqlConnection::GetConn()
+    {
+        ThreadConnection* thread = GetThreadConnection();
+        return thread ? thread->conn : conn;
+    }
+
+    csString& psMysqlConnection::GetLastQueryString()
+    {
+        ThreadConnection* thread = GetThreadConnection();
+        return thread ? thread->lastquery : lastquery;
+    }
+
+    void psMysqlConnection::AddSQLTime(const csString &query, csTicks time)
+    {
+        MutexScopedLock lock(profsMutex);
+        profs.AddSQLTime(query, time);
     }
 
     psResultSet::psResultSet(MYSQL *conn)
@@ -744,81 +852,75 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
     }
 
 
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
-    {
-        start=end=0;
-        m_Close = false;
-        m_host = csString(host);
-        m_port = port;
-        m_db = csString(database);
-        m_user = csString(user);
-        m_pwd = csString(pwd);
-    }
-
-    void DelayedQueryManager::Stop()
+    MysqlPipelineBackend::MysqlPipelineBackend(const char *host, unsigned int port, const char *database,
+                                               const char *user, const char *pwd)
+        : conn(NULL), host(host), port(port), database(database), user(user), pwd(pwd)
     {
-        m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();
     }
 
-    void DelayedQueryManager::Run()
+    bool MysqlPipelineBackend::Connect()
     {
         mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
+        MYSQL* init = mysql_init(NULL);
+        conn = mysql_real_connect(init, host, user, pwd, database, port, NULL,
+                                  CLIENT_FOUND_ROWS | CLIENT_MULTI_STATEMENTS);
+        if (!conn)
         {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
+            CPrintf(CON_ERROR, "Failed to connect the query pipeline to the database: %s\n", mysql_error(init));
+            mysql_close(init);
+            mysql_thread_end();
+            return false;
         }
 
         my_bool my_true = true;
 
     #if MYSQL_VERSION_ID >= 50000
-        mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
+        mysql_options(conn, MYSQL_OPT_RECONNECT, &my_true);
     #endif
 
-        psStopWatch timer;
-        while(!m_Close)
-        {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
-            {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
-            }
-        }
-        mysql_close(m_conn);
-        mysql_thread_end();
+        return true;
     }
 
-    void DelayedQueryManager::Push(csString query)
+    void MysqlPipelineBackend::Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error)
     {
+        csString batch;
+        for (size_t i = 0; i < statements.GetSize(); i++)
         {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
-            {
-                return;
-            }
-            arr[start] = query;
-            start = tstart;
+            // An empty statement between two semicolons would fail.
+            csString statement = statements[i];
+            statement.RTrim();
+            while (statement.Length() && statement.GetAt(statement.Length() - 1) == ';')
+                statement.Truncate(statement.Length() - 1);
+
+            if (i)
+                batch.Append(';');
+            batch.Append(statement);
+        }
+
+        // The server stops at the first failing statement, the statements
+        // after it are left out of results and run again.
+        int status = mysql_real_query(conn, batch, (unsigned long)batch.Length());
+        while (!status)
+        {
+            MYSQL_RES* rs = mysql_store_result(conn);
+            if (rs)
+                mysql_free_result(rs);
+            results.Push((unsigned long) mysql_affected_rows(conn));
+            status = mysql_next_result(conn);
+        }
+
+        if (status > 0)
+        {
+            results.Push(QUERY_FAILED);
+            error = mysql_error(conn);
         }
-        datacondition.NotifyOne();
     }
-    #endif
+
+    void MysqlPipelineBackend::Disconnect()
+    {
+        mysql_close(conn);
+        conn = NULL;
+        mysql_thread_end();
+    }
 }
 CS_PLUGIN_NAMESPACE_END(dbmysql)
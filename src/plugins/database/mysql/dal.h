@@ -11,6 +11,8 @@
 
 #include <csutil/scf.h>
 #include <csutil/scf_implementation.h>
+#include <csutil/hash.h>
+#include <csutil/threading/atomicops.h>
 #include <csutil/threading/thread.h>
 
 #include "iutil/comp.h"
@@ -22,6 +24,7 @@
 #include <csutil/csstring.h>
 #include "util/stringarray.h"
 #include "util/dbprofile.h"
+#include "util/dbpipeline.h"
 
 using namespace CS::Threading;
 
@@ -29,33 +32,28 @@ struct iObjectRegistry;
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 {
-    #ifdef USE_DELAY_QUERY
-    #define THREADED_BUFFER_SIZE 300
-    class DelayedQueryManager : public CS::Threading::Runnable
+    /**
+     * Runs pipelined commands on a connection of its own. The connection
+     * allows multiple statements, so a batch goes out in one round trip.
+     */
+    class MysqlPipelineBackend : public iDBPipelineBackend
     {
     public:
-        DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd);
+        MysqlPipelineBackend(const char *host, unsigned int port, const char *database,
+                             const char *user, const char *pwd);
+
+        virtual bool Connect();
+        virtual void Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error);
+        virtual void Disconnect();
 
-        virtual void Run ();
-        void Push(csString query);
-        void Stop();
     private:
-        MYSQL* m_conn;
-        csString arr[THREADED_BUFFER_SIZE];
-        size_t start, end;
-        CS::Threading::Mutex mutex;
-        CS::Threading::RecursiveMutex mutexArray;
-        CS::Threading::Condition datacondition;
-        bool m_Close;
-        psDBProfiles profs;
-        csString m_host;
-        unsigned int m_port;
-        csString m_db;
-        csString m_user;
-        csString m_pwd;
+        MYSQL* conn;
+        csString host;
+        unsigned int port;
+        csString database;
+        csString user;
+        csString pwd;
     };
-    #endif
 
     class psMysqlConnection : public scfImplementation2<psMysqlConnection, iComponent, iDataConnection>
     {
@@ -65,9 +63,38 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         csString lastquery;
         iObjectRegistry *objectReg;
         psDBProfiles profs;
+        CS::Threading::Mutex profsMutex;    ///< Attached threads query at the same time.
         csString profileDump;
         LogCSV* logcsv;
 
+        /// Where and as whom to connect attached threads.
+        csString host;
+        unsigned int port;
+        csString database;
+        csString user;
+        csString pwd;
+
+        /// The connection of a thread that called AttachThread.
+        struct ThreadConnection
+        {
+            MYSQL* conn;
+            csString lastquery;
+        };
+        csHash<ThreadConnection*, CS::Threading::ThreadID> threadConns;
+        int32 attachedThreads;
+        CS::Threading::Mutex threadMutex;
+
+        /// The connection of the calling thread, NULL if it isn't attached.
+        ThreadConnection* GetThreadConnection();
+
+        /// The connection the calling thread queries over.
+        MYSQL* GetConn();
+
+        /// The last query of the calling thread.
+        csString& GetLastQueryString();
+
+        void AddSQLTime(const csString &query, csTicks time);
+
     public:
         psMysqlConnection(iBase *iParent);
         virtual ~psMysqlConnection();
@@ -89,6 +116,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         int SelectSingleNumber(const char *sql, ...);
         unsigned long Command(const char *sql,...);
         unsigned long CommandPump(const char *sql,...);
+        void CommandPump(iQueryCallback* callback, const char *sql,...);
 
         uint64 GenericInsertWithID(const char *table,const char **fieldnames,psStringArray& fieldvalues);
         bool GenericUpdateWithID(const char *table,const char *idfield,const char *id,const char **fieldnames,psStringArray& fieldvalues);
@@ -97,7 +125,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         const char *GetLastError(void);
         const char *GetLastQuery(void)
         {
-            return lastquery;
+            return GetLastQueryString();
         };
         uint64 GetLastInsertID();
         
@@ -109,10 +137,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
         iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
 
-    #ifdef USE_DELAY_QUERY    
-        csRef<DelayedQueryManager> dqm;
-        csRef<Thread> dqmThread;
-    #endif    
+        virtual bool AttachThread();
+        virtual void DetachThread();
+
+        DBPipeline* pipeline;   ///< Runs CommandPump() in the background, NULL if disabled.
     };
 
 
@@ -20,18 +20,14 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/objreg.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
 
 #include "dal.h"
 
-
-//not implemented
-#ifdef USE_DELAY_QUERY
-#undef USE_DELAY_QUERY
-#endif
-
 // SCF definitions
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
@@ -46,6 +42,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
     {
         conn = NULL;
         stmtNum = 0;
+        objectReg = NULL;
+        pipeline = NULL;
     }
 
     psMysqlConnection::~psMysqlConnection()
@@ -80,18 +78,28 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
             return false;
 
         stmtNum = 0;
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        csRef<iConfigManager> config = objectReg ? csQueryRegistry<iConfigManager>(objectReg) : 0;
+        if(config && config->GetBool("Planeshift.Database.Pipeline", false))
+        {
+            pipeline = new DBPipeline(new PostgresPipelineBackend(dbConnectString),
+                                      config->GetInt("Planeshift.Database.PipelineBatch", 32));
+            if(!pipeline->Start())
+            {
+                CPrintf(CON_ERROR, "Couldn't connect the query pipeline, CommandPump() runs right away.\n");
+                delete pipeline;
+                pipeline = NULL;
+            }
+        }
 
         return true;
     }
 
     bool psMysqlConnection::Close()
     {
+        // Runs what is still queued.
+        delete pipeline;
+        pipeline = NULL;
+
         //waits for postgresql to complete and close.
         if(conn)
         {
@@ -129,18 +137,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
 
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
-        
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
-
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
-
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -149,6 +145,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         querystr.FormatV(sql, args);
         va_end(args);
 
+        if(pipeline)
+        {
+            pipeline->Push(querystr);
+            return 1;
+        }
+
         lastquery = querystr;
 
         timer.Start();
@@ -177,8 +179,26 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
             PQclear(res);
             return QUERY_FAILED;
         }
+    }
+
+    void psMysqlConnection::CommandPump(iQueryCallback* callback, const char *sql,...)
+    {
+        csString querystr;
+        va_list args;
+
+        va_start(args, sql);
+        querystr.FormatV(sql, args);
+        va_end(args);
+
+        if(pipeline)
+        {
+            pipeline->Push(querystr, callback);
+            return;
+        }
 
-    #endif
+        unsigned long result = Command("%s", querystr.GetData());
+        if(callback)
+            callback->QueryDone(result, result == QUERY_FAILED ? GetLastError() : NULL);
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -371,7 +391,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         command.Append(escape);
         command.Append("'");
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -417,7 +437,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         command.Append(escape);
         command.Append("'");
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -440,12 +460,16 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
     const char* psMysqlConnection::DumpProfile()
     {
         profileDump = profs.Dump();
+        if(pipeline)
+            profileDump += pipeline->DumpProfile();
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
         profs.Reset();
+        if(pipeline)
+            pipeline->ResetProfile();
         profileDump.Empty();
     }
 
@@ -459,6 +483,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         return new dbInsert(conn, &stmtNum, table, count, logcsv, file, line);
     }
 
+    bool psMysqlConnection::AttachThread()
+    {
+        return false;
+    }
+
+    void psMysqlConnection::DetachThread()
+    {
+    }
+
     psResultSet::psResultSet(PGresult *res)
     {
         rs = res;
@@ -787,82 +820,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         return prepared;
     }
 
-    //NOT IMPLEMENTED
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
-    {
-        /*start=end=0;
-        m_Close = false;
-        m_host = csString(host);
-        m_port = port;
-        m_db = csString(database);
-        m_user = csString(user);
-        m_pwd = csString(pwd);*/
-    }
-
-    void DelayedQueryManager::Stop()
+    PostgresPipelineBackend::PostgresPipelineBackend(const char *connectString)
+        : conn(NULL), connectString(connectString)
     {
-        /*m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();*/
     }
 
-    void DelayedQueryManager::Run()
+    bool PostgresPipelineBackend::Connect()
     {
-        /*mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
-        {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
-        }
-
-        my_bool my_true = true;
-
-    #if MYSQL_VERSION_ID >= 50000
-        mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
-    #endif
-
-        psStopWatch timer;
-        while(!m_Close)
+        conn = PQconnectdb(connectString);
+        if(!conn || (PQstatus(conn) == CONNECTION_BAD))
         {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
-            {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
-            }
+            CPrintf(CON_ERROR, "Failed to connect the query pipeline to the database: %s\n", conn ? PQerrorMessage(conn) : "");
+            PQfinish(conn);
+            conn = NULL;
+            return false;
         }
-        mysql_close(m_conn);
-        mysql_thread_end();*/
+        return true;
     }
 
-    void DelayedQueryManager::Push(csString query)
-    {/*
+    void PostgresPipelineBackend::Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error)
+    {
+        // No transaction around the batch, one failure would undo all of it.
+        for(size_t i = 0; i < statements.GetSize(); i++)
         {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
+            PGresult *res = PQexec(conn, statements[i]);
+            if(!res || PQresultStatus(res) == PGRES_FATAL_ERROR)
             {
+                PQclear(res);
+                results.Push(QUERY_FAILED);
+                error = PQerrorMessage(conn);
                 return;
             }
-            arr[start] = query;
-            start = tstart;
+
+            const char *const RowsStr = PQcmdTuples(res);
+            results.Push((unsigned long) (RowsStr[0] ? atoi(RowsStr) : 0));
+            PQclear(res);
         }
-        datacondition.NotifyOne();*/
     }
-    #endif
+
+    void PostgresPipelineBackend::Disconnect()
+    {
+        PQfinish(conn);
+        conn = NULL;
+    }
 }
 CS_PLUGIN_NAMESPACE_END(dbpostgresql)
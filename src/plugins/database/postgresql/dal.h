@@ -35,6 +35,7 @@
 #include <csutil/csstring.h>
 #include "util/stringarray.h"
 #include "util/dbprofile.h"
+#include "util/dbpipeline.h"
 
 using namespace CS::Threading;
 
@@ -42,32 +43,24 @@ struct iObjectRegistry;
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
 {
-    #ifdef USE_DELAY_QUERY
-    #define THREADED_BUFFER_SIZE 300
-    class DelayedQueryManager : public CS::Threading::Runnable
+    /**
+     * Runs pipelined commands on a connection of its own. PQexec() only
+     * reports the outcome of the last statement of a string, so the
+     * statements of a batch are sent one by one.
+     */
+    class PostgresPipelineBackend : public iDBPipelineBackend
     {
     public:
-        DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd);
+        PostgresPipelineBackend(const char *connectString);
+
+        virtual bool Connect();
+        virtual void Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error);
+        virtual void Disconnect();
 
-        virtual void Run ();
-        void Push(csString query);
-        void Stop();
     private:
-        csString arr[THREADED_BUFFER_SIZE];
-        size_t start, end;
-        CS::Threading::Mutex mutex;
-        CS::Threading::RecursiveMutex mutexArray;
-        CS::Threading::Condition datacondition;
-        bool m_Close;
-        psDBProfiles profs;
-        csString m_host;
-        unsigned int m_port;
-        csString m_db;
-        csString m_user;
-        csString m_pwd;
+        PGconn* conn;
+        csString connectString;
     };
-    #endif
 
     class psMysqlConnection : public scfImplementation2<psMysqlConnection, iComponent, iDataConnection>
     {
@@ -102,6 +95,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         int SelectSingleNumber(const char *sql, ...);
         unsigned long Command(const char *sql,...);
         unsigned long CommandPump(const char *sql,...);
+        void CommandPump(iQueryCallback* callback, const char *sql,...);
 
         uint64 GenericInsertWithID(const char *table,const char **fieldnames,psStringArray& fieldvalues);
         bool GenericUpdateWithID(const char *table,const char *idfield,const char *id,const char **fieldnames,psStringArray& fieldvalues);
@@ -122,10 +116,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
         iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
 
-    #ifdef USE_DELAY_QUERY    
-        csRef<DelayedQueryManager> dqm;
-        csRef<Thread> dqmThread;
-    #endif    
+        /// Not supported, all queries go over the one connection.
+        virtual bool AttachThread();
+        virtual void DetachThread();
+
+        DBPipeline* pipeline;   ///< Runs CommandPump() in the background, NULL if disabled.
     };
 
 
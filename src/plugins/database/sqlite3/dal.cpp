@@ -20,17 +20,14 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/objreg.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
 
 #include "dal.h"
 
-//not implemented
-#ifdef USE_DELAY_QUERY
-#undef USE_DELAY_QUERY
-#endif
-
 // SCF definitions
 CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 {
@@ -43,6 +40,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
     psMysqlConnection::psMysqlConnection(iBase *iParent) : scfImplementationType(this, iParent)
     {
         conn = NULL;
+        objectReg = NULL;
+        pipeline = NULL;
     }
 
     psMysqlConnection::~psMysqlConnection()
@@ -67,18 +66,28 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         if(sqlite3_open(database, &conn) != SQLITE_OK)
             return false;
 
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        csRef<iConfigManager> config = objectReg ? csQueryRegistry<iConfigManager>(objectReg) : 0;
+        if(config && config->GetBool("Planeshift.Database.Pipeline", false))
+        {
+            pipeline = new DBPipeline(new SqlitePipelineBackend(database),
+                                      config->GetInt("Planeshift.Database.PipelineBatch", 32));
+            if(!pipeline->Start())
+            {
+                CPrintf(CON_ERROR, "Couldn't connect the query pipeline, CommandPump() runs right away.\n");
+                delete pipeline;
+                pipeline = NULL;
+            }
+        }
 
         return true;
     }
 
     bool psMysqlConnection::Close()
     {
+        // Runs what is still queued.
+        delete pipeline;
+        pipeline = NULL;
+
         //waits for sqlite to complete and close.
         if(conn)
         {
@@ -109,18 +118,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
-        
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
-
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
-
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -129,6 +126,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         querystr.FormatV(sql, args);
         va_end(args);
 
+        if(pipeline)
+        {
+            pipeline->Push(querystr);
+            return 1;
+        }
+
         lastquery = querystr;
 
 
@@ -150,8 +153,26 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         }
         else
             return QUERY_FAILED;
+    }
+
+    void psMysqlConnection::CommandPump(iQueryCallback* callback, const char *sql,...)
+    {
+        csString querystr;
+        va_list args;
 
-    #endif
+        va_start(args, sql);
+        querystr.FormatV(sql, args);
+        va_end(args);
+
+        if(pipeline)
+        {
+            pipeline->Push(querystr, callback);
+            return;
+        }
+
+        unsigned long result = Command("%s", querystr.GetData());
+        if(callback)
+            callback->QueryDone(result, result == QUERY_FAILED ? GetLastError() : NULL);
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -333,7 +354,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         command.Append(escape);
         command.Append("'");
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -379,7 +400,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         command.Append(escape);
         command.Append("'");
 
-        if (CommandPump("%s", command.GetDataSafe())==QUERY_FAILED)
+        if (Command("%s", command.GetDataSafe())==QUERY_FAILED)
         {
             return false;
         }
@@ -402,12 +423,16 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
     const char* psMysqlConnection::DumpProfile()
     {
         profileDump = profs.Dump();
+        if(pipeline)
+            profileDump += pipeline->DumpProfile();
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
         profs.Reset();
+        if(pipeline)
+            pipeline->ResetProfile();
         profileDump.Empty();
     }
 
@@ -421,6 +446,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         return new dbInsert(conn, table, count, logcsv, file, line);
     }
 
+    bool psMysqlConnection::AttachThread()
+    {
+        return false;
+    }
+
+    void psMysqlConnection::DetachThread()
+    {
+    }
+
     psResultSet::psResultSet(char **result, int rowNum, int columns)
     {
         rs = result;
@@ -719,81 +753,46 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         return prepared;
     }
 
-    //NOT IMPLEMENTED
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
+    SqlitePipelineBackend::SqlitePipelineBackend(const char *database)
+        : conn(NULL), database(database)
     {
-        /*start=end=0;
-        m_Close = false;
-        m_host = csString(host);
-        m_port = port;
-        m_db = csString(database);
-        m_user = csString(user);
-        m_pwd = csString(pwd);*/
     }
 
-    void DelayedQueryManager::Stop()
+    bool SqlitePipelineBackend::Connect()
     {
-        /*m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();*/
-    }
-
-    void DelayedQueryManager::Run()
-    {
-        /*mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
+        if(sqlite3_open(database, &conn) != SQLITE_OK)
         {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
+            CPrintf(CON_ERROR, "Failed to open the database for the query pipeline: %s\n", sqlite3_errmsg(conn));
+            sqlite3_close(conn);
+            conn = NULL;
+            return false;
         }
 
-        my_bool my_true = true;
-
-    #if MYSQL_VERSION_ID >= 50000
-        mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
-    #endif
+        // The main connection may hold the lock for a while.
+        sqlite3_busy_timeout(conn, 5000);
+        return true;
+    }
 
-        psStopWatch timer;
-        while(!m_Close)
+    void SqlitePipelineBackend::Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error)
+    {
+        sqlite3_exec(conn, "BEGIN", NULL, NULL, NULL);
+        for(size_t i = 0; i < statements.GetSize(); i++)
         {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
+            // Stop at a failure, the rest comes again with the next batch.
+            if(sqlite3_exec(conn, statements[i], NULL, NULL, NULL) != SQLITE_OK)
             {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
+                results.Push(QUERY_FAILED);
+                error = sqlite3_errmsg(conn);
+                break;
             }
+            results.Push((unsigned long) sqlite3_changes(conn));
         }
-        mysql_close(m_conn);
-        mysql_thread_end();*/
+        sqlite3_exec(conn, "COMMIT", NULL, NULL, NULL);
     }
 
-    void DelayedQueryManager::Push(csString query)
-    {/*
-        {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
-            {
-                return;
-            }
-            arr[start] = query;
-            start = tstart;
-        }
-        datacondition.NotifyOne();*/
+    void SqlitePipelineBackend::Disconnect()
+    {
+        while(sqlite3_close(conn) != SQLITE_OK);
+        conn = NULL;
     }
-    #endif
 }CS_PLUGIN_NAMESPACE_END(dbsqlite3)
@@ -35,6 +35,7 @@
 #include <csutil/csstring.h>
 #include "util/stringarray.h"
 #include "util/dbprofile.h"
+#include "util/dbpipeline.h"
 
 using namespace CS::Threading;
 
@@ -42,33 +43,23 @@ struct iObjectRegistry;
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 {
-    #ifdef USE_DELAY_QUERY
-    #define THREADED_BUFFER_SIZE 300
-    class DelayedQueryManager : public CS::Threading::Runnable
+    /**
+     * Runs pipelined commands on a connection of its own. A batch is run in
+     * one transaction, so it is synced to disk once.
+     */
+    class SqlitePipelineBackend : public iDBPipelineBackend
     {
     public:
-        DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd);
+        SqlitePipelineBackend(const char *database);
+
+        virtual bool Connect();
+        virtual void Execute(const csArray<csString> &statements, csArray<unsigned long> &results, csString &error);
+        virtual void Disconnect();
 
-        virtual void Run ();
-        void Push(csString query);
-        void Stop();
     private:
-        sqlite3* m_conn;
-        csString arr[THREADED_BUFFER_SIZE];
-        size_t start, end;
-        CS::Threading::Mutex mutex;
-        CS::Threading::RecursiveMutex mutexArray;
-        CS::Threading::Condition datacondition;
-        bool m_Close;
-        psDBProfiles profs;
-        csString m_host;
-        unsigned int m_port;
-        csString m_db;
-        csString m_user;
-        csString m_pwd;
+        sqlite3* conn;
+        csString database;
     };
-    #endif
 
     class psMysqlConnection : public scfImplementation2<psMysqlConnection, iComponent, iDataConnection>
     {
@@ -101,6 +92,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         int SelectSingleNumber(const char *sql, ...);
         unsigned long Command(const char *sql,...);
         unsigned long CommandPump(const char *sql,...);
+        void CommandPump(iQueryCallback* callback, const char *sql,...);
 
         uint64 GenericInsertWithID(const char *table,const char **fieldnames,psStringArray& fieldvalues);
         bool GenericUpdateWithID(const char *table,const char *idfield,const char *id,const char **fieldnames,psStringArray& fieldvalues);
@@ -121,10 +113,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
         iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
 
-    #ifdef USE_DELAY_QUERY    
-        csRef<DelayedQueryManager> dqm;
-        csRef<Thread> dqmThread;
-    #endif    
+        /// Not supported, all queries go over the one connection.
+        virtual bool AttachThread();
+        virtual void DetachThread();
+
+        DBPipeline* pipeline;   ///< Runs CommandPump() in the background, NULL if disabled.
     };
 
 
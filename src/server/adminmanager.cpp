@@ -78,6 +78,7 @@
 #include "gmeventmanager.h"
 #include "guildmanager.h"
 #include "hiremanager.h"
+#include "itemsavequeue.h"
 #include "marriagemanager.h"
 #include "netmanager.h"
 #include "npcmanager.h"
@@ -6065,7 +6066,7 @@ void AdminManager::TeleportOfflineCharacter(Client* client, AdminCmdDataTeleport
     sql.AppendFmt("update characters set loc_x=%10.2f, loc_y=%10.2f, loc_z=%10.2f, loc_yrot=%10.2f, loc_sector_id=%u, loc_instance=%u where name=\"%s\"",
                   gmPoint.x, gmPoint.y, gmPoint.z, yRot, gmSectorInfo->uid, client->GetActor()->GetInstance(), escapedName.GetDataSafe());
 
-    if(db->CommandPump(sql) != 1)
+    if(db->Command(sql) != 1)
     {
         Error3("Couldn't save character's position to database.\nCommand was "
                "<%s>.\nError returned was <%s>\n",db->GetLastQuery(),db->GetLastError());
@@ -6754,7 +6755,9 @@ void AdminManager::HandlePath(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
 
         if(wp)
         {
-            if(wp->Adjust(db,myPos,mySectorName))
+            bool adjusted = wp->Adjust(db,myPos,mySectorName);
+            pathNetwork->Invalidate();
+            if(adjusted)
             {
                 psserver->npcmanager->WaypointAdjusted(wp);
 
@@ -6895,6 +6898,7 @@ void AdminManager::HandlePath(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
 
             if(wp->SetFlag(db, data->flagName, enable))
             {
+                pathNetwork->Invalidate();
                 psserver->npcmanager->WaypointSetFlag(wp,data->flagName,enable);
 
                 psserver->SendSystemInfo(me->clientnum, "Flag %s %s for %s.",
@@ -6953,6 +6957,7 @@ void AdminManager::HandlePath(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
 
         if(wp->SetRadius(db, data->newRadius))
         {
+            pathNetwork->Invalidate();
             psserver->npcmanager->WaypointRadius(wp);
 
             wp->RecalculateEdges(EntityManager::GetSingleton().GetWorld(),EntityManager::GetSingleton().GetEngine());
@@ -7323,7 +7328,9 @@ void AdminManager::HandlePath(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
 
             if(wp)
             {
-                if(wp->Adjust(db,myPos,mySectorName))
+                bool adjusted = wp->Adjust(db,myPos,mySectorName);
+                pathNetwork->Invalidate();
+                if(adjusted)
                 {
                     psserver->npcmanager->WaypointAdjusted(wp);
 
@@ -8794,6 +8801,8 @@ void AdminManager::ChangeLock(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
     buff.Format("%u", lockID);
 
     // Get psItem array of keys to check
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Checkpoint();
     Result items(db->Select("SELECT * from item_instances where flags like '%KEY%'"));
     if(items.IsValid())
     {
@@ -8816,8 +8825,8 @@ void AdminManager::ChangeLock(MsgEntry* me, psAdminCmdMessage &msg, AdminCmdData
                     lstr.Append(word);
 
                     // write back to database
-                    int result = db->CommandPump("UPDATE item_instances SET openable_locks='%s' WHERE id=%d",
-                                                 lstr.GetData(), keyID);
+                    int result = db->Command("UPDATE item_instances SET openable_locks='%s' WHERE id=%d",
+                                             lstr.GetData(), keyID);
                     if(result < 0)
                     {
                         Error4("Couldn't update item instance lockchange with lockID=%d keyID=%d openable_locks <%s>.",lockID, keyID, lstr.GetData());
@@ -9461,10 +9470,10 @@ void AdminManager::SendGMPlayerList(MsgEntry* me, psGMGuiMessage &msg,Client* cl
 
 bool AdminManager::EscalatePetition(PID gmID, int gmLevel, int petitionID)
 {
-    int result = db->CommandPump("UPDATE petitions SET status='Open',assigned_gm=-1,"
-                                 "escalation_level=(escalation_level+1) "
-                                 "WHERE id=%d AND escalation_level<=%d AND escalation_level<%d "
-                                 "AND (assigned_gm=%d OR status='Open')", petitionID, gmLevel, GM_DEVELOPER-20, gmID.Unbox());
+    int result = db->Command("UPDATE petitions SET status='Open',assigned_gm=-1,"
+                             "escalation_level=(escalation_level+1) "
+                             "WHERE id=%d AND escalation_level<=%d AND escalation_level<%d "
+                             "AND (assigned_gm=%d OR status='Open')", petitionID, gmLevel, GM_DEVELOPER-20, gmID.Unbox());
     // If this failed if means that there is a serious error
     if(result <= 0)
     {
@@ -9477,9 +9486,9 @@ bool AdminManager::EscalatePetition(PID gmID, int gmLevel, int petitionID)
 bool AdminManager::DescalatePetition(PID gmID, int gmLevel, int petitionID)
 {
 
-    int result = db->CommandPump("UPDATE petitions SET status='Open',assigned_gm=-1,"
-                                 "escalation_level=(escalation_level-1)"
-                                 "WHERE id=%d AND escalation_level<=%d AND (assigned_gm=%u OR status='Open' AND escalation_level != 0)", petitionID, gmLevel, gmID.Unbox());
+    int result = db->Command("UPDATE petitions SET status='Open',assigned_gm=-1,"
+                             "escalation_level=(escalation_level-1)"
+                             "WHERE id=%d AND escalation_level<=%d AND (assigned_gm=%u OR status='Open' AND escalation_level != 0)", petitionID, gmLevel, gmID.Unbox());
     // If this failed if means that there is a serious error
     if(result <= 0)
     {
@@ -9539,7 +9548,7 @@ bool AdminManager::CancelPetition(PID playerID, int petitionID, bool isGMrequest
     // If isGMrequest is true, just cancel the petition (a GM is requesting the change)
     if(isGMrequest)
     {
-        int result = db->CommandPump("UPDATE petitions SET status='Cancelled' WHERE id=%d AND assigned_gm=%u", petitionID,playerID.Unbox());
+        int result = db->Command("UPDATE petitions SET status='Cancelled' WHERE id=%d AND assigned_gm=%u", petitionID,playerID.Unbox());
         return (result > 0);
     }
 
@@ -9554,7 +9563,7 @@ bool AdminManager::CancelPetition(PID playerID, int petitionID, bool isGMrequest
     }
 
     // Update the petition status
-    result = db->CommandPump("UPDATE petitions SET status='Cancelled' WHERE id=%d AND player=%u", petitionID, playerID.Unbox());
+    result = db->Command("UPDATE petitions SET status='Cancelled' WHERE id=%d AND player=%u", petitionID, playerID.Unbox());
 
     return (result > 0);
 }
@@ -9585,7 +9594,7 @@ bool AdminManager::ChangePetition(PID playerID, int petitionID, const char* peti
     }
 
     // Update the petition status
-    result = db->CommandPump("UPDATE petitions SET petition=\"%s\" WHERE id=%d AND player=%u", escape.GetData(), petitionID, playerID.Unbox());
+    result = db->Command("UPDATE petitions SET petition=\"%s\" WHERE id=%d AND player=%u", escape.GetData(), petitionID, playerID.Unbox());
 
     return (result > 0);
 }
@@ -9594,8 +9603,8 @@ bool AdminManager::ClosePetition(PID gmID, int petitionID, const char* desc)
 {
     csString escape;
     db->Escape(escape, desc);
-    int result = db->CommandPump("UPDATE petitions SET status='Closed',closed_date=Now(),resolution='%s' "
-                                 "WHERE id=%d AND assigned_gm=%u", escape.GetData(), petitionID, gmID.Unbox());
+    int result = db->Command("UPDATE petitions SET status='Closed',closed_date=Now(),resolution='%s' "
+                             "WHERE id=%d AND assigned_gm=%u", escape.GetData(), petitionID, gmID.Unbox());
 
     // If this failed if means that there is a serious error, or the GM was not assigned
     if(result <= 0)
@@ -9613,11 +9622,11 @@ bool AdminManager::DeassignPetition(PID gmID, int gmLevel, int petitionID)
     int result;
     if(gmLevel > GM_LEVEL_5)  //allows to deassing without checks only to a gm lead or a developer
     {
-        result = db->CommandPump("UPDATE petitions SET assigned_gm=-1,status=\"Open\" WHERE id=%d", petitionID);
+        result = db->Command("UPDATE petitions SET assigned_gm=-1,status=\"Open\" WHERE id=%d", petitionID);
     }
     else
     {
-        result = db->CommandPump("UPDATE petitions SET assigned_gm=-1,status=\"Open\" WHERE id=%d AND assigned_gm=%u", petitionID, gmID.Unbox());
+        result = db->Command("UPDATE petitions SET assigned_gm=-1,status=\"Open\" WHERE id=%d AND assigned_gm=%u", petitionID, gmID.Unbox());
     }
 
     // If this failed if means that there is a serious error, or another GM was already assigned
@@ -9633,7 +9642,7 @@ bool AdminManager::DeassignPetition(PID gmID, int gmLevel, int petitionID)
 
 bool AdminManager::AssignPetition(PID gmID, int petitionID)
 {
-    int result = db->CommandPump("UPDATE petitions SET assigned_gm=%d,status='In Progress' WHERE id=%d AND assigned_gm=-1", gmID.Unbox(), petitionID);
+    int result = db->Command("UPDATE petitions SET assigned_gm=%d,status='In Progress' WHERE id=%d AND assigned_gm=-1", gmID.Unbox(), petitionID);
 
     // If this failed if means that there is a serious error, or another GM was already assigned
     if(result <= 0)
@@ -12336,7 +12345,7 @@ void AdminManager::HandleQuest(MsgEntry* me,psAdminCmdMessage &msg, AdminCmdData
         {
             if(!quest->GetParentQuest())  //only allow to complete main quest entries (no steps)
             {
-                int result = db->CommandPump("insert into character_quests "
+                int result = db->Command("insert into character_quests "
                                    "(player_id, assigner_id, quest_id, "
                                    "status, remaininglockout, last_response, last_response_npc_id) "
                                    "values (%d, %d, %d, '%c', %d, %d, %d) "
@@ -12387,7 +12396,7 @@ void AdminManager::HandleQuest(MsgEntry* me,psAdminCmdMessage &msg, AdminCmdData
         }
         else //the player is offline so we have to hit the database
         {
-            int result = db->CommandPump("DELETE FROM character_quests WHERE player_id=%u AND quest_id=%u",pid.Unbox(), quest->GetID());
+            int result = db->Command("DELETE FROM character_quests WHERE player_id=%u AND quest_id=%u",pid.Unbox(), quest->GetID());
             if(result > 0)
             {
                 psserver->SendSystemInfo(me->clientnum, "Quest %s discarded for %s!", data->questName.GetData(), name.GetData());
@@ -119,11 +119,18 @@ public:
     {
         if(advisor.IsValid()) advisor->GetActor()->UnregisterCallback(this);
         if(advisee.IsValid()) advisee->GetActor()->UnregisterCallback(this);
-        // Cancel any timeouts tied to this session
+        // Cancel any timeouts tied to this session. They are deleted later
+        // by the event manager, so they must not look back at the session.
         if(timeoutEvent)
-            timeoutEvent->valid = false;
+        {
+            timeoutEvent->adviceSession = NULL;
+            timeoutEvent->SetValid(false);
+        }
         if(requestEvent)
-            requestEvent->valid = false;
+        {
+            requestEvent->adviceSession = NULL;
+            requestEvent->SetValid(false);
+        }
     };
 
     Client* GetAdvisee()
@@ -226,7 +233,7 @@ psAdviceRequestTimeoutGameEvent::~psAdviceRequestTimeoutGameEvent()
     if(advisorActor != NULL) advisorActor->UnregisterCallback(this);
     advisorActor = NULL;
 
-    if(adviceSession->requestEvent == this) adviceSession->requestEvent = NULL;
+    if(adviceSession && adviceSession->requestEvent == this) adviceSession->requestEvent = NULL;
 }
 
 void psAdviceRequestTimeoutGameEvent::DeleteObjectCallback(iDeleteNotificationObject* object)
@@ -245,7 +252,7 @@ void psAdviceRequestTimeoutGameEvent::DeleteObjectCallback(iDeleteNotificationOb
         }
     }
 
-    if(advisorActor)
+    if(advisorActor && adviceSession)
     {
         if(sender == advisorActor)
         {
@@ -304,7 +311,7 @@ psAdviceSessionTimeoutGameEvent::~psAdviceSessionTimeoutGameEvent()
     if(advisorActor != NULL) advisorActor->UnregisterCallback(this);
     advisorActor = NULL;
 
-    if(adviceSession->timeoutEvent == this)adviceSession->timeoutEvent = NULL;
+    if(adviceSession && adviceSession->timeoutEvent == this)adviceSession->timeoutEvent = NULL;
 }
 
 void psAdviceSessionTimeoutGameEvent::DeleteObjectCallback(iDeleteNotificationObject* object)
@@ -586,7 +593,7 @@ void AdviceManager::HandleAdviceRequest(Client* advisee, csString message)
 
         if(activeSession->timeoutEvent)
         {
-            activeSession->timeoutEvent->valid = false;
+            activeSession->timeoutEvent->SetValid(false);
         }
         psAdviceSessionTimeoutGameEvent* ev = new psAdviceSessionTimeoutGameEvent(this, activeSession->answered?ADVICE_SESSION_TIMEOUT:ADVICE_SESSION_TIMEOUT/2, advisee->GetActor(), activeSession);
         activeSession->timeoutEvent = ev;
@@ -767,7 +774,7 @@ void AdviceManager::HandleAdviceResponse(Client* advisor, csString sAdvisee, csS
         }
 
         if(activeSession->requestEvent)
-            activeSession->requestEvent->valid = false;  // This keeps the cancellation timeout from firing.
+            activeSession->requestEvent->SetValid(false);  // This keeps the cancellation timeout from firing.
 
         activeSession->answered = true;
 
@@ -794,7 +801,7 @@ void AdviceManager::HandleAdviceResponse(Client* advisor, csString sAdvisee, csS
     // spreading the wealth and burden amongst all ;)
     if(activeSession->timeoutEvent)
     {
-        activeSession->timeoutEvent->valid = false;
+        activeSession->timeoutEvent->SetValid(false);
     }
     psAdviceSessionTimeoutGameEvent* ev = new psAdviceSessionTimeoutGameEvent(this, activeSession->answered?ADVICE_SESSION_TIMEOUT:ADVICE_SESSION_TIMEOUT/2, advisee->GetActor(), activeSession);
     activeSession->timeoutEvent = ev;
@@ -928,7 +935,7 @@ void AdviceManager::CancelAdvisorSession(gemActor* who, AdviceSession* adviceSes
                         psserver->SendSystemInfo(adviceSession->AdviseeClientNum,"Your next request may be handled by a different advisor.");
                         if(adviceSession->requestEvent)
                         {
-                            adviceSession->requestEvent->valid = false;
+                            adviceSession->requestEvent->SetValid(false);
                             adviceSession->requestEvent = NULL;
                         }
                         adviceSession->answered = true;
@@ -988,7 +995,8 @@ void AdviceManager::RemoveSession(AdviceSession* adviceSession)
 
     if(adviceSession->requestEvent)
     {
-        adviceSession->requestEvent->valid = false;
+        adviceSession->requestEvent->adviceSession = NULL;
+        adviceSession->requestEvent->SetValid(false);
         adviceSession->requestEvent = NULL;
     }
 
@@ -148,7 +148,7 @@ protected:
     gemActor* advisorActor;
 
 public:
-    AdviceSession* adviceSession;
+    AdviceSession* adviceSession;   ///< NULL once the session cancelled the event
 
     psAdviceSessionTimeoutGameEvent(AdviceManager* mgr,
                                     int delayticks,
@@ -170,7 +170,7 @@ protected:
     gemActor* advisorActor;
 
 public:
-    AdviceSession* adviceSession;
+    AdviceSession* adviceSession;   ///< NULL once the session cancelled the event
 
     psAdviceRequestTimeoutGameEvent(AdviceManager* mgr,
                                     int delayticks,
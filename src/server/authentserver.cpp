@@ -37,6 +37,7 @@
 
 #include "util/psdatabase.h"
 #include "util/log.h"
+#include "util/consoleout.h"
 #include "util/eventmanager.h"
 
 //=============================================================================
@@ -56,6 +57,7 @@
 #include "icachedobject.h"
 #include "advicemanager.h"
 #include "commandmanager.h"
+#include "loginpipeline.h"
 
 class CachedAuthMessage : public iCachedObject
 {
@@ -100,6 +102,7 @@ AuthenticationServer::AuthenticationServer(ClientConnectionSet* pCCS,
     clients      = pCCS;
     usermanager  = usermgr;
     guildmanager = gm;
+    loginPipeline = new LoginPipeline(this);
 
     Subscribe(&AuthenticationServer::HandlePreAuthent, MSGTYPE_PREAUTHENTICATE, REQUIRE_ANY_CLIENT);
     Subscribe(&AuthenticationServer::HandleAuthent, MSGTYPE_AUTHENTICATE, REQUIRE_ANY_CLIENT);
@@ -111,7 +114,7 @@ AuthenticationServer::AuthenticationServer(ClientConnectionSet* pCCS,
 
 AuthenticationServer::~AuthenticationServer()
 {
-    //do nothing
+    delete loginPipeline;
 }
 
 
@@ -216,10 +219,31 @@ void AuthenticationServer::HandlePreAuthent(MsgEntry* me, Client* notused)
     reply.SendMessage();
 }
 
-void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
+void AuthenticationServer::StartLoginWorkers(size_t threads)
+{
+    if(threads && !loginPipeline->Start(threads))
+    {
+        CPrintf(CON_WARNING, "The database has no connections for login workers, logins are handled in the main thread.\n");
+    }
+}
+
+void AuthenticationServer::StopLoginWorkers()
+{
+    loginPipeline->Stop();
+}
+
+csString AuthenticationServer::GetLoginStats()
 {
-    csTicks start = csGetTicks();
+    return loginPipeline->GetStats();
+}
 
+void AuthenticationServer::AppendLoginReport(csString &report)
+{
+    loginPipeline->AppendReport(report);
+}
+
+void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
+{
     psAuthenticationMessage msg(me); // This cracks message into members.
     if(!msg.valid)
     {
@@ -245,56 +269,100 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
 
     // Check if login was correct
     Notify2(LOG_CONNECTIONS,"Check Login for: '%s'\n", (const char*)msg.sUser);
-    psAccountInfo* acctinfo=psserver->GetCacheManager()->GetAccountInfoByUsername((const char*)msg.sUser);
 
+    LoginRequest* request = new LoginRequest;
+    request->clientnum    = me->clientnum;
+    request->capabilities = msg.capabilities;
+    request->user         = msg.sUser;
+    request->password     = msg.sPassword;
+    request->password256  = msg.sPassword256;
+    request->os           = msg.os_;
+    request->gfxcard      = msg.gfxcard_;
+    request->gfxversion   = msg.gfxversion_;
+
+    // Only the main game thread may use the cache, the account is loaded by the check stage otherwise.
+    iCachedObject* obj = psserver->GetCacheManager()->RemoveFromCache(msg.sUser);
+    if(obj)
+    {
+        Notify2(LOG_CACHE, "Found account for %s in cache!", (const char*)msg.sUser);
+        request->acctinfo = (psAccountInfo*)obj->RecoverObject();
+    }
+
+    loginPipeline->Queue(request);
+}
+
+void AuthenticationServer::CheckLogin(LoginRequest* request)
+{
+    if(!request->acctinfo)
+        request->acctinfo = psserver->GetCacheManager()->LoadAccountInfo(request->user);
+
+    psAccountInfo* acctinfo = request->acctinfo;
     if(!acctinfo)
     {
         // invalid
-        psserver->RemovePlayer(me->clientnum,"Incorrect password or username.");
-
-        Notify2(LOG_CONNECTIONS,"User '%s' authentication request rejected: No account found with that name.\n",
-                (const char*)msg.sUser);
+        request->rejectReason = "Incorrect password or username.";
+        request->rejectNote = "No account found with that name";
         return;
     }
 
-    // Add account to cache to optimize repeated login attempts
-    psserver->GetCacheManager()->AddToCache(acctinfo,msg.sUser,120);
-
     // Check if password was correct
     csString passwordhashandclientnum(acctinfo->password256);
     passwordhashandclientnum.Append(":");
-    passwordhashandclientnum.Append(me->clientnum);
+    passwordhashandclientnum.Append(request->clientnum);
 
     csString encoded_hash = CS::Utility::Checksum::SHA256::Encode(passwordhashandclientnum).HexString();
-    if(encoded_hash != msg.sPassword) // authentication error
+    if(encoded_hash != request->password) // authentication error
     {
         //sha256 autentication failed so we will try with the previous hash support (md5sum)
         //this is just transition code and should be removed with 0.6.0
         passwordhashandclientnum = acctinfo->password;
         passwordhashandclientnum.Append(":");
-        passwordhashandclientnum.Append(me->clientnum);
+        passwordhashandclientnum.Append(request->clientnum);
 
         encoded_hash = csMD5::Encode(passwordhashandclientnum).HexString();
-        if(strcmp(encoded_hash.GetData(), msg.sPassword.GetData())) // authentication error
+        if(strcmp(encoded_hash.GetData(), request->password.GetData())) // authentication error
         {
-            psserver->RemovePlayer(me->clientnum, "Incorrect password or username.");
-            Notify2(LOG_CONNECTIONS,"User '%s' authentication request rejected (Bad password).",(const char*)msg.sUser);
-            // No delete necessary because AddToCache will auto-delete
-            // delete acctinfo;
+            request->rejectReason = "Incorrect password or username.";
+            request->rejectNote = "Bad password";
             return;
         }
-        if(msg.sPassword256.Length() > 0) // save the newly  obtained sha256 password
+        if(request->password256.Length() > 0) // save the newly  obtained sha256 password
         {
             csString sanitized;
-            db->Escape(sanitized, msg.sPassword256);
-            db->CommandPump("UPDATE accounts set password256=\"%s\" where id=%d", sanitized.GetData(), acctinfo->accountid);
+            db->Escape(sanitized, request->password256);
+            db->Command("UPDATE accounts set password256=\"%s\" where id=%d", sanitized.GetData(), acctinfo->accountid);
         }
     }
 
+    /** Check to see if there are any players on that account.  All accounts should have
+    *    at least one player in this function. A list in the cache is preferred when attaching.
+    */
+    request->charlist = psserver->CharacterLoader.LoadCharacterListFromDatabase(acctinfo->accountid);
+}
+
+bool AuthenticationServer::AttachLogin(LoginRequest* request)
+{
+    psAccountInfo* acctinfo = request->acctinfo;
+    if(acctinfo)
+    {
+        // Add account to cache to optimize repeated login attempts
+        psserver->GetCacheManager()->AddToCache(acctinfo, request->user, 120);
+        request->acctinfo = NULL;
+    }
+
+    if(!request->rejectReason.IsEmpty())
+    {
+        psserver->RemovePlayer(request->clientnum, request->rejectReason);
+
+        Notify3(LOG_CONNECTIONS,"User '%s' authentication request rejected: %s.\n",
+                request->user.GetData(), request->rejectNote.GetData());
+        return false;
+    }
+
     /**
      * Check if the client is already logged in
      */
-    Client* existingClient = clients->FindAccount(acctinfo->accountid, me->clientnum);
+    Client* existingClient = clients->FindAccount(acctinfo->accountid, request->clientnum);
     if(existingClient)   // account already logged in
     {
         // invalid authent message from a different client
@@ -312,33 +380,21 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
 
         psserver->RemovePlayer(existingClient->GetClientNum(), reason);
         Notify2(LOG_CONNECTIONS,"User '%s' authentication request overrides an existing logged in user.\n",
-                (const char*)msg.sUser);
-
-        // No delete necessary because AddToCache will auto-delete
-        // delete acctinfo;
-    }
-
-
-    if(csGetTicks() - start > 500)
-    {
-        csString status;
-        status.Format("Warning: Spent %u time authenticating account ID %u, After password check",
-                      csGetTicks() - start, acctinfo->accountid);
-        psserver->GetLogCSV()->Write(CSV_STATUS, status);
+                request->user.GetData());
     }
 
-
-    Client* client = clients->FindAny(me->clientnum);
+    // The client may have gone while the account was checked.
+    Client* client = clients->FindAny(request->clientnum);
     if(!client)
     {
-        Bug2("Couldn't find client %d?!?",me->clientnum);
-        // No delete necessary because AddToCache will auto-delete
-        // delete acctinfo;
-        return;
+        Notify3(LOG_CONNECTIONS,"User '%s' (%d) disconnected before the login was done.\n",
+                request->user.GetData(), request->clientnum);
+        return false;
     }
 
-    client->SetName(msg.sUser);
+    client->SetName(request->user);
     client->SetAccountID(acctinfo->accountid);
+    client->SetNetCapabilities(request->capabilities);
 
 
     // Check to see if the client is banned
@@ -367,36 +423,30 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
                           timeinfo->tm_min,
                           ban->reason.GetData());
 
-            psserver->RemovePlayer(me->clientnum, banmsg);
+            psserver->RemovePlayer(request->clientnum, banmsg);
 
-            Notify2(LOG_CONNECTIONS,"User '%s' authentication request rejected (Banned).",(const char*)msg.sUser);
-            // No delete necessary because AddToCache will auto-delete
-            // delete acctinfo;
-            return;
+            Notify2(LOG_CONNECTIONS,"User '%s' authentication request rejected (Banned).",request->user.GetData());
+            return false;
         }
     }
 
     client->SetSecurityLevel(acctinfo->securitylevel);
 
-    if(csGetTicks() - start > 500)
+    // A list in the cache may have changed since the check stage read the database.
+    psCharacterList* charlist = request->charlist;
+    request->charlist = NULL;
+    iCachedObject* obj = psserver->GetCacheManager()->RemoveFromCache(psserver->GetCacheManager()->MakeCacheName("list", acctinfo->accountid));
+    if(obj)
     {
-        csString status;
-        status.Format("Warning: Spent %u time authenticating account ID %u, After ban check",
-                      csGetTicks() - start, acctinfo->accountid);
-        psserver->GetLogCSV()->Write(CSV_STATUS, status);
+        delete charlist;
+        charlist = (psCharacterList*)obj->RecoverObject();
     }
 
-    /** Check to see if there are any players on that account.  All accounts should have
-    *    at least one player in this function.
-    */
-    psCharacterList* charlist = psserver->CharacterLoader.LoadCharacterList(acctinfo->accountid);
-
     if(!charlist)
     {
-        Error2("Could not load Character List for account! Rejecting client %s!\n",(const char*)msg.sUser);
-        psserver->RemovePlayer(me->clientnum, "Could not load the list of characters for your account.  Please contact a PS Admin for help.");
-        delete acctinfo;
-        return;
+        Error2("Could not load Character List for account! Rejecting client %s!\n",request->user.GetData());
+        psserver->RemovePlayer(request->clientnum, "Could not load the list of characters for your account.  Please contact a PS Admin for help.");
+        return false;
     }
 
     // cache will auto-delete this ptr if it times out
@@ -412,17 +462,15 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
     if(psserver->IsFull(clients->Count(),client))
     {
         // invalid
-        psserver->RemovePlayer(me->clientnum, "The server is full right now.  Please try again in a few minutes.");
+        psserver->RemovePlayer(request->clientnum, "The server is full right now.  Please try again in a few minutes.");
 
-        Notify2(LOG_CONNECTIONS, "User '%s' authentication request rejected: Too many connections.\n", (const char*)msg.sUser);
-        // No delete necessary because AddToCache will auto-delete
-        // delete acctinfo;
-        status = "User limit hit!";
+        Notify2(LOG_CONNECTIONS, "User '%s' authentication request rejected: Too many connections.\n", request->user.GetData());
+        csString status = "User limit hit!";
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
-        return;
+        return false;
     }
 
-    Notify3(LOG_CONNECTIONS,"User '%s' (%d) added to active client list\n",(const char*) msg.sUser, me->clientnum);
+    Notify3(LOG_CONNECTIONS,"User '%s' (%d) added to active client list\n",request->user.GetData(), request->clientnum);
 
     // Get the struct to refresh
     // Update last login ip and time
@@ -440,26 +488,20 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
                    gmtm->tm_sec);
 
     acctinfo->lastlogintime = timeStr;
-    acctinfo->os = msg.os_;
-    acctinfo->gfxcard = msg.gfxcard_;
-    acctinfo->gfxversion = msg.gfxversion_;
-    psserver->GetCacheManager()->UpdateAccountInfo(acctinfo);
+    acctinfo->os = request->os;
+    acctinfo->gfxcard = request->gfxcard;
+    acctinfo->gfxversion = request->gfxversion;
 
-    iCachedObject* obj = psserver->GetCacheManager()->RemoveFromCache(psserver->GetCacheManager()->MakeCacheName("auth",acctinfo->accountid));
+    // Saved by the record stage, from a copy as the cache owns the account.
+    request->record = *acctinfo;
+
+    iCachedObject* authObj = psserver->GetCacheManager()->RemoveFromCache(psserver->GetCacheManager()->MakeCacheName("auth",acctinfo->accountid));
     CachedAuthMessage* cam;
 
-    if(!obj)
+    if(!authObj)
     {
         // Send approval message
-        psAuthApprovedMessage* message = new psAuthApprovedMessage(me->clientnum,client->GetPID(), charlist->GetValidCount());
-
-        if(csGetTicks() - start > 500)
-        {
-            csString status;
-            status.Format("Warning: Spent %u time authenticating account ID %u, After approval",
-                          csGetTicks() - start, acctinfo->accountid);
-            psserver->GetLogCSV()->Write(CSV_STATUS, status);
-        }
+        psAuthApprovedMessage* message = new psAuthApprovedMessage(request->clientnum,client->GetPID(), charlist->GetValidCount());
 
         // Send out the character list to the auth'd player
         for(int i=0; i<MAX_CHARACTERS_IN_LIST; i++)
@@ -474,7 +516,7 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
                     continue;
                 }
 
-                Notify3(LOG_CHARACTER, "Sending %s to client %d\n", character->GetCharName(), me->clientnum);
+                Notify3(LOG_CHARACTER, "Sending %s to client %d\n", character->GetCharName(), request->clientnum);
                 character->AppendCharacterSelectData(*message);
 
                 delete character;
@@ -486,22 +528,22 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
     else
     {
         // recover underlying object
-        cam = (CachedAuthMessage*)obj->RecoverObject();
+        cam = (CachedAuthMessage*)authObj->RecoverObject();
         // update client id since new connection here
-        cam->msg->msg->clientnum = me->clientnum;
+        cam->msg->msg->clientnum = request->clientnum;
     }
     // Send auth approved and char list in one message now
     cam->msg->SendMessage();
     psserver->GetCacheManager()->AddToCache(cam, psserver->GetCacheManager()->MakeCacheName("auth",acctinfo->accountid), 10);
 
-    SendMsgStrings(me->clientnum, true);
+    SendMsgStrings(request->clientnum, true);
 
     client->SetSpamPoints(acctinfo->spamPoints);
     client->SetAdvisorPoints(acctinfo->advisorPoints);
 
     if(acctinfo->securitylevel >= GM_TESTER)
     {
-        psserver->GetAdminManager()->Admin(me->clientnum, client);
+        psserver->GetAdminManager()->Admin(request->clientnum, client);
     }
 
     if(psserver->GetCacheManager()->GetCommandManager()->Validate(client->GetSecurityLevel(), "default advisor"))
@@ -514,18 +556,19 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
         client->SetBuddyListHide(true);
     }
 
-    psserver->GetWeatherManager()->SendClientGameTime(me->clientnum);
+    psserver->GetWeatherManager()->SendClientGameTime(request->clientnum);
 
-    if(csGetTicks() - start > 500)
-    {
-        csString status;
-        status.Format("Warning: Spent %u time authenticating account ID %u, After load",
-                      csGetTicks() - start, acctinfo->accountid);
-        psserver->GetLogCSV()->Write(CSV_STATUS, status);
-    }
-
-    status.Format("%s - %s, %u, Logged in", ipAddr.GetDataSafe(), (const char*) msg.sUser, me->clientnum);
+    csString status;
+    status.Format("%s - %s, %u, Logged in", ipAddr.GetDataSafe(), request->user.GetData(), request->clientnum);
     psserver->GetLogCSV()->Write(CSV_AUTHENT, status);
+    return true;
+}
+
+void AuthenticationServer::RecordLogin(LoginRequest* request)
+{
+    // Runs on a login worker, UpdateAccountInfo() sends the statement
+    // with Command() on its connection.
+    psserver->GetCacheManager()->UpdateAccountInfo(&request->record);
 }
 
 void AuthenticationServer::HandleDisconnect(MsgEntry* me,Client* client)
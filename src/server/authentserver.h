@@ -32,6 +32,8 @@
 
 class psMsgStringsMessage;
 class ClientConnectionSet;
+class LoginPipeline;
+struct LoginRequest;
 class UserManager;
 class GuildManager;
 class Client;
@@ -139,6 +141,40 @@ public:
         return &banmanager;
     }
 
+    /**
+     * Run the database work of logins on worker threads.
+     *
+     * @param threads The number of workers, 0 handles logins in the main game thread.
+     */
+    void StartLoginWorkers(size_t threads);
+
+    /// Stop the login workers, before the database goes away.
+    void StopLoginWorkers();
+
+    /// Queue depths and stage latencies of the logins, for the status command.
+    csString GetLoginStats();
+
+    /// Append the queue depths and stage latencies to the server status report.
+    void AppendLoginReport(csString &report);
+
+    /** @name Login stages
+     *  Run by the LoginPipeline, see LoginRequest::Stage.
+     */
+    ///@{
+    /// Load the account, check the password and load the characters. Doesn't use the cache.
+    void CheckLogin(LoginRequest* request);
+
+    /**
+     * Attach the client to the world, or turn it away. Main game thread only.
+     *
+     * @return True if the login is to be recorded.
+     */
+    bool AttachLogin(LoginRequest* request);
+
+    /// Save the login time and address of the account.
+    void RecordLogin(LoginRequest* request);
+    ///@}
+
 
 protected:
 
@@ -154,6 +190,9 @@ protected:
     /// Manages banned users and IP ranges
     BanManager banmanager;
 
+    /// Runs the stages of logins.
+    LoginPipeline* loginPipeline;
+
     /**
      * Common preconditions for HandlePreAuthent and HandleAuthent
      */
@@ -162,10 +201,9 @@ protected:
     /**
      * Handles an authenticate message from the message queue.
      *
-     * This method recieves a authenticate message. Uses the following steps to
-     * authenticate a client. Sends a psAuthMessageApproved message back to the
-     * client if it was successfully authenticated and adds the client to the
-     * current client list.
+     * This method recieves a authenticate message and queues it in the login
+     * pipeline, which checks the account and sends a psAuthMessageApproved
+     * message back to the client if it was successfully authenticated.
      *
      * @param me      Is a message entry that contains the authenticate message.
      * @param notused Not used.
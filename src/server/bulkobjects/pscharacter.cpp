@@ -837,11 +837,8 @@ void psCharacter::SetLastLoginTime()
     }
 
     //Store in database
-    if(!db->CommandPump("UPDATE characters SET last_login='%s' WHERE id='%d'", lastLoginTime.GetData(), pid.Unbox()))
-    {
-        Error2("Last login storage: DB Error: %s\n", db->GetLastError());
-        return;
-    }
+    db->CommandPump(new DBCommandCheck("Last login storage: DB Error.", 1),
+                    "UPDATE characters SET last_login='%s' WHERE id='%d'", lastLoginTime.GetData(), pid.Unbox());
 }
 
 csString psCharacter::GetLastLoginTime() const
@@ -860,11 +857,8 @@ void psCharacter::SetPetElapsedTime(double elapsedTime)
     {
         lastSavedPetElapsedTime = petElapsedTime;
         //Store in database
-        if(!db->CommandPump("UPDATE characters SET pet_elapsed_time='%.2f' WHERE id='%d'", petElapsedTime, pid.Unbox()))
-        {
-            Error2("Last login storage: DB Error: %s\n", db->GetLastError());
-            return;
-        }
+        db->CommandPump(new DBCommandCheck("Last login storage: DB Error.", 1),
+                        "UPDATE characters SET pet_elapsed_time='%.2f' WHERE id='%d'", petElapsedTime, pid.Unbox());
     }
 }
 
@@ -1135,11 +1129,9 @@ void psCharacter::UpdateRespawn(csVector3 pos, float yrot, psSectorInfo* sector,
 
     sql.AppendFmt("update characters set loc_x=%10.2f, loc_y=%10.2f, loc_z=%10.2f, loc_yrot=%10.2f, loc_sector_id=%u, loc_instance=%u where id=%u",
                   l.loc.x, l.loc.y, l.loc.z, l.loc_yrot, l.loc_sector->uid, l.worldInstance, pid.Unbox());
-    if(db->CommandPump(sql) != 1)
-    {
-        Error3("Couldn't save character's position to database.\nCommand was "
-               "<%s>.\nError returned was <%s>\n",db->GetLastQuery(),db->GetLastError());
-    }
+    csString error;
+    error.Format("Couldn't save character's position to database.\nCommand was <%s>.", sql.GetData());
+    db->CommandPump(new DBCommandCheck(error, 1), "%s", sql.GetData());
 }
 
 bool psCharacter::HasVariableDefined(const csString &name)
@@ -1337,10 +1329,9 @@ void psCharacter::SetProgressionPoints(unsigned int X,bool save)
         // Update the DB
         csString sql;
         sql.Format("UPDATE characters SET progression_points = '%u', experience_points = '%u' WHERE id ='%u'", X, exp, pid.Unbox());
-        if(!db->CommandPump(sql))
-        {
-            Error3("Couldn't execute SQL %s!, %s's PP points are NOT saved", sql.GetData(), ShowID(pid));
-        }
+        csString error;
+        error.Format("Couldn't execute SQL %s!, %s's PP points are NOT saved", sql.GetData(), ShowID(pid));
+        db->CommandPump(new DBCommandCheck(error, 1), "%s", sql.GetData());
     }
 
     vitals->SetPP(X);
@@ -1752,11 +1743,9 @@ void psCharacter::SaveMoney(bool bank)
                       money.GetCircles(), money.GetTrias(), money.GetHexas(), money.GetOctas(), pid.Unbox());
     }
 
-    if(db->CommandPump(sql) != 1)
-    {
-        Error3("Couldn't save character's money to database.\nCommand was "
-               "<%s>.\nError returned was <%s>\n",db->GetLastQuery(),db->GetLastError());
-    }
+    csString error;
+    error.Format("Couldn't save character's money to database.\nCommand was <%s>.", sql.GetData());
+    db->CommandPump(new DBCommandCheck(error, 1), "%s", sql.GetData());
 }
 
 void psCharacter::ResetStats()
@@ -1825,6 +1814,11 @@ bool psCharacter::UpdateStatDRData(csTicks now)
     return res;
 }
 
+bool psCharacter::NeedsStatDRUpdate()
+{
+    return vitals->NeedsUpdate();
+}
+
 bool psCharacter::SendStatDRMessage(uint32_t clientnum, EID eid, int flags, csRef<PlayerGroup> group)
 {
     return vitals->SendStatDRMessage(clientnum, eid, flags, group);
@@ -2269,11 +2263,9 @@ void psCharacter::SaveLocationInWorld()
 
     sql.AppendFmt("update characters set loc_x=%10.2f, loc_y=%10.2f, loc_z=%10.2f, loc_yrot=%10.2f, loc_sector_id=%u, loc_instance=%u where id=%u",
                   l.loc.x, l.loc.y, l.loc.z, l.loc_yrot, l.loc_sector->uid, l.worldInstance, pid.Unbox());
-    if(db->CommandPump(sql) != 1)
-    {
-        Error3("Couldn't save character's position to database.\nCommand was "
-               "<%s>.\nError returned was <%s>\n",db->GetLastQuery(),db->GetLastError());
-    }
+    csString error;
+    error.Format("Couldn't save character's position to database.\nCommand was <%s>.", sql.GetData());
+    db->CommandPump(new DBCommandCheck(error, 1), "%s", sql.GetData());
 }
 
 
@@ -2477,144 +2469,102 @@ bool psCharacter::HasExploredArea(PID explored)
     return false;
 }
 
+// Properties scripts can read, see GetPropertyByID().
+#define PSCHARACTER_PROPERTIES(PROPERTY) \
+    PROPERTY(AttackerTargeted) PROPERTY(TotalTargetedBlockValue) PROPERTY(TotalUntargetedBlockValue) \
+    PROPERTY(DodgeValue) PROPERTY(KillExp) PROPERTY(GetAttackValueModifier) PROPERTY(GetDefenseValueModifier) \
+    PROPERTY(HP) PROPERTY(MaxHP) PROPERTY(BaseHP) PROPERTY(Mana) PROPERTY(MaxMana) PROPERTY(BaseMana) \
+    PROPERTY(PStamina) PROPERTY(MStamina) PROPERTY(MaxPStamina) PROPERTY(MaxMStamina) \
+    PROPERTY(BasePStamina) PROPERTY(BaseMStamina) PROPERTY(AllArmorStrMalus) PROPERTY(AllArmorAgiMalus) \
+    PROPERTY(PID) PROPERTY(loc_x) PROPERTY(loc_y) PROPERTY(loc_z) PROPERTY(loc_yrot) PROPERTY(sector) \
+    PROPERTY(owner) PROPERTY(IsNPC) PROPERTY(IsPet) PROPERTY(Race) PROPERTY(RaceUID)
+
+enum { PSCHARACTER_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* psCharacterProperties[] = { PSCHARACTER_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double psCharacter::GetProperty(MathEnvironment* env, const char* ptr)
 {
-    csString property(ptr);
-    if(property == "AttackerTargeted")
-    {
-        return true;
-        // return (attacker_targeted) ? 1 : 0;
-    }
-    else if(property == "TotalTargetedBlockValue")
-    {
-        return GetTotalTargetedBlockValue();
-    }
-    else if(property == "TotalUntargetedBlockValue")
-    {
-        return GetTotalUntargetedBlockValue();
-    }
-    else if(property == "DodgeValue")
-    {
-        return GetDodgeValue();
-    }
-    else if(property == "KillExp")
-    {
-        return killExp;
-    }
-    else if(property == "GetAttackValueModifier")
-    {
-        return attackModifier.Value();
-    }
-    else if(property == "GetDefenseValueModifier")
-    {
-        return defenseModifier.Value();
-    }
-    else if(property == "HP")
-    {
-        return GetHP();
-    }
-    else if(property == "MaxHP")
-    {
-        return GetMaxHP().Current();
-    }
-    else if(property == "BaseHP")
-    {
-        return GetMaxHP().Base();
-    }
-    else if(property == "Mana")
-    {
-        return GetMana();
-    }
-    else if(property == "MaxMana")
-    {
-        return GetMaxMana().Current();
-    }
-    else if(property == "BaseMana")
-    {
-        return GetMaxMana().Base();
-    }
-    else if(property == "PStamina")
-    {
-        return GetStamina(true);
-    }
-    else if(property == "MStamina")
-    {
-        return GetStamina(false);
-    }
-    else if(property == "MaxPStamina")
-    {
-        return GetMaxPStamina().Current();
-    }
-    else if(property == "MaxMStamina")
-    {
-        return GetMaxMStamina().Current();
-    }
-    else if(property == "BasePStamina")
-    {
-        return GetMaxPStamina().Base();
-    }
-    else if(property == "BaseMStamina")
-    {
-        return GetMaxMStamina().Base();
-    }
-    else if(property == "AllArmorStrMalus")
-    {
-        return modifiers[PSITEMSTATS_STAT_STRENGTH].Current();
-    }
-    else if(property == "AllArmorAgiMalus")
-    {
-        return modifiers[PSITEMSTATS_STAT_AGILITY].Current();
-    }
-    else if(property == "PID")
-    {
-        return (double) pid.Unbox();
-    }
-    else if(property == "loc_x")
-    {
-        return location.loc.x;
-    }
-    else if(property == "loc_y")
-    {
-        return location.loc.y;
-    }
-    else if(property == "loc_z")
-    {
-        return location.loc.z;
-    }
-    else if(property == "loc_yrot")
-    {
-        return location.loc_yrot;
-    }
-    else if(property == "sector")
-    {
-        return env->GetValue(location.loc_sector);
-    }
-    else if(property == "owner")
-    {
-        return (double) ownerId.Unbox();
-    }
-    else if(property == "IsNPC")
-    {
-        return (double)IsNPC();
-    }
-    else if(property == "IsPet")
-    {
-        return (double)IsPet();
-    }
-    else if(property == "Race")
-    {
-        if(!GetRaceInfo())
-            return 0;
-        return (double)GetRaceInfo()->GetRaceID();
-    }
-    else if(property == "RaceUID")
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(ptr));
+}
+
+double psCharacter::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(psCharacterProperties, sizeof(psCharacterProperties)/sizeof(psCharacterProperties[0]));
+
+    switch(properties.Find(id))
     {
-        if(!GetRaceInfo())
-            return 0;
-        return (double)GetRaceInfo()->GetUID();
+        case PROP_AttackerTargeted:
+            return true;
+            // return (attacker_targeted) ? 1 : 0;
+        case PROP_TotalTargetedBlockValue:
+            return GetTotalTargetedBlockValue();
+        case PROP_TotalUntargetedBlockValue:
+            return GetTotalUntargetedBlockValue();
+        case PROP_DodgeValue:
+            return GetDodgeValue();
+        case PROP_KillExp:
+            return killExp;
+        case PROP_GetAttackValueModifier:
+            return attackModifier.Value();
+        case PROP_GetDefenseValueModifier:
+            return defenseModifier.Value();
+        case PROP_HP:
+            return GetHP();
+        case PROP_MaxHP:
+            return GetMaxHP().Current();
+        case PROP_BaseHP:
+            return GetMaxHP().Base();
+        case PROP_Mana:
+            return GetMana();
+        case PROP_MaxMana:
+            return GetMaxMana().Current();
+        case PROP_BaseMana:
+            return GetMaxMana().Base();
+        case PROP_PStamina:
+            return GetStamina(true);
+        case PROP_MStamina:
+            return GetStamina(false);
+        case PROP_MaxPStamina:
+            return GetMaxPStamina().Current();
+        case PROP_MaxMStamina:
+            return GetMaxMStamina().Current();
+        case PROP_BasePStamina:
+            return GetMaxPStamina().Base();
+        case PROP_BaseMStamina:
+            return GetMaxMStamina().Base();
+        case PROP_AllArmorStrMalus:
+            return modifiers[PSITEMSTATS_STAT_STRENGTH].Current();
+        case PROP_AllArmorAgiMalus:
+            return modifiers[PSITEMSTATS_STAT_AGILITY].Current();
+        case PROP_PID:
+            return (double) pid.Unbox();
+        case PROP_loc_x:
+            return location.loc.x;
+        case PROP_loc_y:
+            return location.loc.y;
+        case PROP_loc_z:
+            return location.loc.z;
+        case PROP_loc_yrot:
+            return location.loc_yrot;
+        case PROP_sector:
+            return env->GetValue(location.loc_sector);
+        case PROP_owner:
+            return (double) ownerId.Unbox();
+        case PROP_IsNPC:
+            return (double)IsNPC();
+        case PROP_IsPet:
+            return (double)IsPet();
+        case PROP_Race:
+            if(!GetRaceInfo())
+                return 0;
+            return (double)GetRaceInfo()->GetRaceID();
+        case PROP_RaceUID:
+            if(!GetRaceInfo())
+                return 0;
+            return (double)GetRaceInfo()->GetUID();
     }
 
-    Error2("Requested psCharacter property not found '%s'", ptr);
+    Error2("Requested psCharacter property not found '%s'", MathScriptEngine::GetPropertyName(id));
     return 0;
 }
 
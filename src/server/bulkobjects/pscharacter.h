@@ -1380,6 +1380,8 @@ public:
     }
 
     bool UpdateStatDRData(csTicks now);
+    /// True if UpdateStatDRData() has anything to do, the vitals regenerate on their own.
+    bool NeedsStatDRUpdate();
     bool SendStatDRMessage(uint32_t clientnum, EID eid, int flags, csRef<PlayerGroup> group = NULL);
 
     /**
@@ -1596,6 +1598,7 @@ public:
 
     /// This is used by the math scripting engine to get various values.
     double GetProperty(MathEnvironment* env, const char* ptr);
+    double GetPropertyByID(MathEnvironment* env, PropertyID id);
     double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     const char* ToString()
     {
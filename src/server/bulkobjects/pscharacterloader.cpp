@@ -43,6 +43,7 @@
 #include "../cachemanager.h"
 #include "../progressionmanager.h"
 #include "../globals.h"
+#include "../itemsavequeue.h"
 
 //=============================================================================
 // Local Includes
@@ -96,6 +97,11 @@ psCharacterList* psCharacterLoader::LoadCharacterList(AccountID accountid)
         return (psCharacterList*)obj->RecoverObject();
     }
 
+    return LoadCharacterListFromDatabase(accountid);
+}
+
+psCharacterList* psCharacterLoader::LoadCharacterListFromDatabase(AccountID accountid)
+{
     Notify1(LOG_CACHE,"******LOADING CHARACTER LIST*******");
     // Load if not in cache
     Result result(db->Select("SELECT id,name,lastname FROM characters WHERE account_id=%u ORDER BY id", accountid.Unbox()));
@@ -426,7 +432,7 @@ bool psCharacterLoader::UpdateQuestAssignments(psCharacter* chr)
 
 bool psCharacterLoader::ClearCharacterSpell(psCharacter* character)
 {
-    unsigned long result=db->CommandPump("DELETE FROM player_spells WHERE player_id='%u'", character->GetPID().Unbox());
+    unsigned long result=db->Command("DELETE FROM player_spells WHERE player_id='%u'", character->GetPID().Unbox());
     if(result==QUERY_FAILED)
         return false;
 
@@ -438,8 +444,8 @@ bool psCharacterLoader::SaveCharacterSpell(psCharacter* character)
     int index = 0;
     while(psSpell* spell = character->GetSpellByIdx(index))
     {
-        unsigned long result=db->CommandPump("INSERT INTO player_spells (player_id,spell_id,spell_slot) VALUES('%u','%u','%u')",
-                                             character->GetPID().Unbox(), spell->GetID(), index);
+        unsigned long result=db->Command("INSERT INTO player_spells (player_id,spell_id,spell_slot) VALUES('%u','%u','%u')",
+                                         character->GetPID().Unbox(), spell->GetID(), index);
         if(result==QUERY_FAILED)
             return false;
         index++;
@@ -451,7 +457,7 @@ bool psCharacterLoader::SaveCharacterSpell(psCharacter* character)
 
 bool psCharacterLoader::ClearCharacterTraits(PID pid)
 {
-    unsigned long result=db->CommandPump("DELETE FROM character_traits WHERE character_id='%u'", pid.Unbox());
+    unsigned long result=db->Command("DELETE FROM character_traits WHERE character_id='%u'", pid.Unbox());
     if(result==QUERY_FAILED)
         return false;
 
@@ -460,7 +466,7 @@ bool psCharacterLoader::ClearCharacterTraits(PID pid)
 
 bool psCharacterLoader::SaveCharacterTrait(PID pid, unsigned int trait_id)
 {
-    unsigned long result=db->CommandPump("INSERT INTO character_traits (character_id,trait_id) VALUES('%u','%u')", pid.Unbox(), trait_id);
+    unsigned long result=db->Command("INSERT INTO character_traits (character_id,trait_id) VALUES('%u','%u')", pid.Unbox(), trait_id);
     if(result==QUERY_FAILED)
         return false;
 
@@ -469,7 +475,7 @@ bool psCharacterLoader::SaveCharacterTrait(PID pid, unsigned int trait_id)
 
 bool psCharacterLoader::ClearCharacterSkills(PID pid)
 {
-    unsigned long result=db->CommandPump("DELETE FROM character_skills WHERE character_id='%u'", pid.Unbox());
+    unsigned long result=db->Command("DELETE FROM character_skills WHERE character_id='%u'", pid.Unbox());
     if(result==QUERY_FAILED)
         return false;
 
@@ -510,8 +516,8 @@ bool psCharacterLoader::SaveCharacterSkill(PID pid, unsigned int skill_id,
     if(skill_z == 0 && skill_y == 0 && skill_rank == 0)
         return true;
 
-    unsigned long result=db->CommandPump("INSERT INTO character_skills (character_id,skill_id,skill_y,skill_z,skill_rank) VALUES('%u','%u','%u','%u','%u')",
-                                         pid.Unbox(), skill_id, skill_y, skill_z, skill_rank);
+    unsigned long result=db->Command("INSERT INTO character_skills (character_id,skill_id,skill_y,skill_z,skill_rank) VALUES('%u','%u','%u','%u','%u')",
+                                     pid.Unbox(), skill_id, skill_y, skill_z, skill_rank);
     if(result==QUERY_FAILED)
         return false;
 
@@ -605,6 +611,10 @@ bool psCharacterLoader::DeleteCharacterData(PID pid, csString &error)
         psserver->entitymanager->GetGEM()->RemoveEntity(list[x]);
     }
 
+    // Queued saves of the items would bring them back.
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Checkpoint();
+
     query.Format("DELETE from item_instances WHERE char_id_owner=%u", pid.Unbox());
     db->CommandPump(query);
 
@@ -106,6 +106,13 @@ public:
      */
     psCharacterList* LoadCharacterList(AccountID accountid);
 
+    /**
+     * Loads the names of characters for a given account from the database,
+     * without looking in the cache. Threads with a database connection of
+     * their own can call it.
+     */
+    psCharacterList* LoadCharacterListFromDatabase(AccountID accountid);
+
 
     psCharacter** LoadAllNPCCharacterData(psSectorInfo* sector,int &count);
 
@@ -42,6 +42,7 @@
 #include "../client.h"
 #include "../cachemanager.h"
 #include "../globals.h"
+#include "../itemsavequeue.h"
 #include "../exchangemanager.h"
 
 //=============================================================================
@@ -278,6 +279,10 @@ bool psCharacterInventory::Load(PID use_id)
         doRestrictions = false;
     }
 
+    // Items of the last session may still be queued for saving.
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Checkpoint();
+
     Result items(db->Select("SELECT * FROM item_instances WHERE char_id_owner=%u AND location_in_parent != -1", use_id.Unbox()));
     if(items.IsValid())
     {
@@ -335,6 +340,9 @@ bool psCharacterInventory::Load(PID use_id)
 
 bool psCharacterInventory::QuickLoad(PID use_id)
 {
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Checkpoint();
+
     Result items(db->Select("SELECT id, item_stats_id_standard, location_in_parent FROM item_instances WHERE char_id_owner = %u AND location_in_parent > -1 AND location_in_parent < %d AND (parent_item_id IS NULL OR parent_item_id = 0)" , use_id.Unbox(), PSCHARACTER_SLOT_BULK1));
 
     if(items.IsValid())
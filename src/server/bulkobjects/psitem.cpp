@@ -48,6 +48,7 @@
 #include "../scripting.h"
 #include "../globals.h"
 #include "../adminmanager.h"
+#include "../itemsavequeue.h"
 
 //=============================================================================
 // Local Includes
@@ -249,11 +250,13 @@ void psItem::UpdateItemQuality(uint32 id, float qual)
         return;
 
     Debug3(LOG_USER,id,"UpdateItemQuality(%u,%1.2f)\n",id, qual);
-    int ret = db->CommandPump("update item_instances set item_quality=%1.2f where id=%u",qual, id);
-    if(ret == 0 && strlen(db->GetLastError()))  // 0 updates could mean the value was the same, not an error
-    {
-        Error3("Could not update item quality.  SQL was <%s> and error was <%s>",db->GetLastQuery(),db->GetLastError());
-    }
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Sync(id);
+
+    // 0 updates could mean the value was the same, not an error
+    csString error;
+    error.Format("Could not update item quality of item %u.", id);
+    db->CommandPump(new DBCommandCheck(error), "update item_instances set item_quality=%1.2f where id=%u", qual, id);
 }
 
 const char* psItem::GetQualityString()
@@ -625,6 +628,10 @@ bool psItem::SetCreation(PSITEMSTATS_CREATIVETYPE creativeType, const csString &
     if(creativeStats.creativeType == PSITEMSTATS_CREATIVETYPE_NONE)
         return current_stats->SetCreation(creativeType, newCreation, creatorName);
 
+    // The creation is updated in place, the row has to be there.
+    if(psserver->GetItemSaveQueue())
+        psserver->GetItemSaveQueue()->Sync(uid);
+
     if(creativeStats.SetCreativeContent(creativeType, newCreation, uid))
     {
         newDescription = creativeStats.UpdateDescription(creativeType, GetName(), creatorName);
@@ -650,8 +657,13 @@ void psItem::Commit(bool children)
     static iRecord* insertQuery;
 
     iRecord* targetQuery;
+    ItemSaveQueue* saveQueue = psserver->GetItemSaveQueue();
 
-    if(GetUID()==0)
+    if(saveQueue)
+    {
+        targetQuery = saveQueue->GetRecord(GetUID()==0);
+    }
+    else if(GetUID()==0)
     {
         if(insertQuery == NULL)
             insertQuery = db->NewInsertPreparedStatement("item_instances", 29, __FILE__, __LINE__); // 26 fields
@@ -863,7 +875,23 @@ void psItem::Commit(bool children)
     targetQuery->AddField("suffix",modifierIds.Get(psGMSpawnMods::ITEM_SUFFIX));
     targetQuery->AddField("adjective",modifierIds.Get(psGMSpawnMods::ITEM_ADJECTIVE));
 
-    if(GetUID()==0)
+    if(saveQueue)
+    {
+        // Written later by the queue, new items take an id from its range.
+        bool insert = GetUID()==0;
+        if(insert)
+            SetUID(saveQueue->AllocateUID());
+
+        if(targetQuery->Execute(GetUID()))
+            item_quality_original = item_quality;
+
+        if(insert && creativeStats.creativeType != PSITEMSTATS_CREATIVETYPE_NONE)
+        {
+            saveQueue->Sync(uid);
+            creativeStats.SaveCreation(uid);
+        }
+    }
+    else if(GetUID()==0)
     {
         //printf("Saving item %s through SQL Insert\n",GetName() );
 
@@ -2111,192 +2139,136 @@ int psItem::GetMaxCharges() const
     return base_stats->GetMaxCharges();
 }
 
+// Properties scripts can read, see GetPropertyByID().
+#define PSITEM_PROPERTIES(PROPERTY) \
+    PROPERTY(Skill1) PROPERTY(Skill2) PROPERTY(Skill3) PROPERTY(Quality) PROPERTY(ArmQuality) PROPERTY(MaxQuality) \
+    PROPERTY(WeaponCBV) PROPERTY(Latency) PROPERTY(UntargetedBlockValue) PROPERTY(TargetedBlockValue) \
+    PROPERTY(Hardness) PROPERTY(DecayRate) PROPERTY(DecayResistance) PROPERTY(Penetration) \
+    PROPERTY(DamageSlash) PROPERTY(ProtectSlash) PROPERTY(DamageBlunt) PROPERTY(ProtectBlunt) \
+    PROPERTY(DamagePierce) PROPERTY(ProtectPierce) PROPERTY(StrMalus) PROPERTY(AgiMalus) PROPERTY(Weight) \
+    PROPERTY(MentalFactor) PROPERTY(RequiredRepairSkill) PROPERTY(RepairDifficultyPct) PROPERTY(SalePrice) \
+    PROPERTY(Charges) PROPERTY(MaxCharges) PROPERTY(Range) PROPERTY(Slot) PROPERTY(Owner) PROPERTY(ArmorType) \
+    PROPERTY(IsMeleeWeapon) PROPERTY(IsBothHandsWeapon) PROPERTY(IsRangeWeapon) PROPERTY(IsAmmo) \
+    PROPERTY(IsArmor) PROPERTY(IsShield) PROPERTY(StackCount) PROPERTY(Id)
+
+enum { PSITEM_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* psItemProperties[] = { PSITEM_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double psItem::GetProperty(MathEnvironment* env, const char* ptr)
 {
-    csString property(ptr);
-    if(property == "Skill1")
-    {
-        return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)0);
-    }
-    else if(property == "Skill2")
-    {
-        return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)1);
-    }
-    else if(property == "Skill3")
-    {
-        return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)2);
-    }
-    else if(property == "Quality")
-    {
-        return GetItemQuality();
-    }
-    else if(property == "ArmQuality")
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(ptr));
+}
+
+double psItem::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(psItemProperties, sizeof(psItemProperties)/sizeof(psItemProperties[0]));
+
+    switch(properties.Find(id))
     {
-        // For natural armour quality
-        if(useNat)
-        {
-            psItemStats* naturalArmour = psserver->GetCacheManager()->GetBasicItemStatsByID(owning_character->GetRaceInfo()->natural_armor_id);
-            if (naturalArmour)
+        case PROP_Skill1:
+            return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)0);
+        case PROP_Skill2:
+            return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)1);
+        case PROP_Skill3:
+            return GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)2);
+        case PROP_Quality:
+            return GetItemQuality();
+        case PROP_ArmQuality:
+            // For natural armour quality
+            if(useNat)
             {
-                return naturalArmour->GetQuality();
+                psItemStats* naturalArmour = psserver->GetCacheManager()->GetBasicItemStatsByID(owning_character->GetRaceInfo()->natural_armor_id);
+                if (naturalArmour)
+                {
+                    return naturalArmour->GetQuality();
+                }
             }
+            return GetItemQuality();
+        case PROP_MaxQuality:
+            return GetMaxItemQuality();
+        case PROP_WeaponCBV:
+            return GetCounterBlockValue();
+        case PROP_Latency:
+            return GetLatency();
+        case PROP_UntargetedBlockValue:
+            return GetUntargetedBlockValue();
+        case PROP_TargetedBlockValue:
+            return GetTargetedBlockValue();
+        case PROP_Hardness:
+            return GetHardness();
+        case PROP_DecayRate:
+            return base_stats->GetDecayRate();
+        case PROP_DecayResistance:
+            return decay_resistance;
+        case PROP_Penetration:
+            return GetPenetration();
+        case PROP_DamageSlash:
+            return GetDamage(PSITEMSTATS_DAMAGETYPE_SLASH);
+        case PROP_ProtectSlash:
+            return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_SLASH);
+        case PROP_DamageBlunt:
+            return GetDamage(PSITEMSTATS_DAMAGETYPE_BLUNT);
+        case PROP_ProtectBlunt:
+            return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_BLUNT);
+        case PROP_DamagePierce:
+            return GetDamage(PSITEMSTATS_DAMAGETYPE_PIERCE);
+        case PROP_ProtectPierce:
+            return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_PIERCE);
+        case PROP_StrMalus:
+            return GetWeaponAttributeBonus(PSITEMSTATS_STAT_STRENGTH);
+        case PROP_AgiMalus:
+            return GetWeaponAttributeBonus(PSITEMSTATS_STAT_AGILITY);
+        case PROP_Weight:
+            return GetWeight();
+        case PROP_MentalFactor:
+        {
+            int temp = GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)0);
+            return ((double)psserver->GetCacheManager()->GetSkillByID((temp<0)?0:temp)->mental_factor / 100.0);
         }
-        return GetItemQuality();
-    }
-    else if(property == "MaxQuality")
-    {
-        return GetMaxItemQuality();
-    }
-    else if(property == "WeaponCBV")
-    {
-        return GetCounterBlockValue();
-    }
-    else if(property == "Latency")
-    {
-        return GetLatency();
-    }
-    else if(property == "UntargetedBlockValue")
-    {
-        return GetUntargetedBlockValue();
-    }
-    else if(property == "TargetedBlockValue")
-    {
-        return GetTargetedBlockValue();
-    }
-    else if(property == "Hardness")
-    {
-        return GetHardness();
-    }
-    else if(property == "DecayRate")
-    {
-        return base_stats->GetDecayRate();
-    }
-    else if(property == "DecayResistance")
-    {
-        return decay_resistance;
-    }
-    else if(property == "Penetration")
-    {
-        return GetPenetration();
-    }
-    else if(property == "DamageSlash")
-    {
-        return GetDamage(PSITEMSTATS_DAMAGETYPE_SLASH);
-    }
-    else if(property == "ProtectSlash")
-    {
-        return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_SLASH);
-    }
-    else if(property.StartsWith("ExtraDamagePct"))
+        case PROP_RequiredRepairSkill:
+            return base_stats->GetCategory()->repairSkillId;
+        case PROP_RepairDifficultyPct:
+            return base_stats->GetCategory()->repairDifficultyPct;
+        case PROP_SalePrice:
+            return base_stats->GetPrice().GetTotal();
+        case PROP_Charges:
+            return (double)GetCharges();
+        case PROP_MaxCharges:
+            return (double)GetMaxCharges();
+        case PROP_Range:
+            return (double)GetRange();
+        case PROP_Slot:
+            return (double)GetLocInParent();
+        case PROP_Owner:
+            return env->GetValue(owning_character);
+        case PROP_ArmorType:
+            return (double)GetArmorType();
+        case PROP_IsMeleeWeapon:
+            return (double)GetIsMeleeWeapon();
+        case PROP_IsBothHandsWeapon:
+            return (double)GetIsBothHandsWeapon();
+        case PROP_IsRangeWeapon:
+            return (double)GetIsRangeWeapon();
+        case PROP_IsAmmo:
+            return (double)GetIsAmmo();
+        case PROP_IsArmor:
+            return (double)GetIsArmor();
+        case PROP_IsShield:
+            return (double)GetIsShield();
+        case PROP_StackCount:
+            return (double)GetStackCount();
+        case PROP_Id:
+            return (double)GetUID();
+    }
+
+    const char* name = MathScriptEngine::GetPropertyName(id);
+    if(!strncmp(name, "ExtraDamagePct", 14))
     {
         return 0; // in the future, this should be read from weapon/armor XML
     }
-    else if(property == "DamageBlunt")
-    {
-        return GetDamage(PSITEMSTATS_DAMAGETYPE_BLUNT);
-    }
-    else if(property == "ProtectBlunt")
-    {
-        return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_BLUNT);
-    }
-    else if(property == "DamagePierce")
-    {
-        return GetDamage(PSITEMSTATS_DAMAGETYPE_PIERCE);
-    }
-    else if(property == "ProtectPierce")
-    {
-        return GetDamageProtection(PSITEMSTATS_DAMAGETYPE_PIERCE);
-    }
-    else if(property == "StrMalus")
-    {
-        return GetWeaponAttributeBonus(PSITEMSTATS_STAT_STRENGTH);
-    }
-    else if(property == "AgiMalus")
-    {
-        return GetWeaponAttributeBonus(PSITEMSTATS_STAT_AGILITY);
-    }
-    else if(property == "Weight")
-    {
-        return GetWeight();
-    }
-    else if(property == "MentalFactor")
-    {
-        int temp = GetWeaponSkill((PSITEMSTATS_WEAPONSKILL_INDEX)0);
-        return ((double)psserver->GetCacheManager()->GetSkillByID((temp<0)?0:temp)->mental_factor / 100.0);
-    }
-    else if(property == "RequiredRepairSkill")
-    {
-        return base_stats->GetCategory()->repairSkillId;
-    }
-    else if(property == "RepairDifficultyPct")
-    {
-        return base_stats->GetCategory()->repairDifficultyPct;
-    }
-    else if(property == "SalePrice")
-    {
-        return base_stats->GetPrice().GetTotal();
-    }
-    else if(property == "Charges")
-    {
-        return (double)GetCharges();
-    }
-    else if(property == "MaxCharges")
-    {
-        return (double)GetMaxCharges();
-    }
-    else if(property == "Range")
-    {
-        return (double)GetRange();
-    }
-    else if(property == "Slot")
-    {
-        return (double)GetLocInParent();
-    }
-    else if(property == "Owner")
-    {
-        return env->GetValue(owning_character);
-    }
-    else if(property == "ArmorType")
-    {
-        return (double)GetArmorType();
-    }
-    else if(property == "IsMeleeWeapon")
-    {
-        return (double)GetIsMeleeWeapon();
-    }
-    else if(property == "IsBothHandsWeapon")
-    {
-        return (double)GetIsBothHandsWeapon();
-    }
-    else if(property == "IsRangeWeapon")
-    {
-        return (double)GetIsRangeWeapon();
-    }
-    else if(property == "IsAmmo")
-    {
-        return (double)GetIsAmmo();
-    }
-    else if(property == "IsArmor")
-    {
-        return (double)GetIsArmor();
-    }
-    else if(property == "IsShield")
-    {
-        return (double)GetIsShield();
-    }
-    else if(property == "StackCount")
-    {
-        return (double)GetStackCount();
-    }
-    else if(property == "Id")
-    {
-        return (double)GetUID();
-    }
-    else
-    {
-        CPrintf(CON_ERROR, "psItem::GetProperty(%s) failed\n",ptr);
-        return 0;
-    }
+
+    CPrintf(CON_ERROR, "psItem::GetProperty(%s) failed\n", name);
+    return 0;
 }
 
 double psItem::CalcFunction(MathEnvironment* env, const char* functionName, const double* params)
@@ -2856,7 +2828,14 @@ bool psItem::Destroy()
 
 bool psItem::DeleteFromDatabase()
 {
-    if(db->CommandPump("DELETE FROM item_instances where id='%u'",this->uid)!=1)
+    // A queued insert that wasn't written yet leaves nothing to delete.
+    if(psserver->GetItemSaveQueue() && psserver->GetItemSaveQueue()->Discard(uid))
+    {
+        uid = ID_DONT_SAVE_ITEM;
+        return true;
+    }
+
+    if(db->Command("DELETE FROM item_instances where id='%u'",this->uid)!=1)
         return false;
 
     uid = ID_DONT_SAVE_ITEM;  // prevent update attempts when key is -1 unsigned
@@ -999,6 +999,7 @@ public:
 
     /// This is used by the math scripting engine to get various values.
     double GetProperty(MathEnvironment* env, const char* ptr);
+    double GetPropertyByID(MathEnvironment* env, PropertyID id);
     double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     const char* ToString()
     {
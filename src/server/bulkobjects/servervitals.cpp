@@ -29,6 +29,8 @@
 #include "net/netbase.h"
 
 #include "../gem.h"
+#include "../entitymanager.h"
+#include "../globals.h"
 
 //=============================================================================
 // Local Includes
@@ -36,31 +38,39 @@
 #include "servervitals.h"
 #include "pscharacter.h"
 
+void VitalBuffable::OnChange()
+{
+    if(vitals)
+        vitals->OnBuffableChange(vital, dirtyFlag);
+}
+
 psServerVitals::psServerVitals(psCharacter* character)
 {
     this->character = character;
     statsDirty = 0;
     version    = 0;
 
-    // Set up callbacks for updating the dirty flag.
-    vitals[VITAL_HITPOINTS].drRate.Initialize(&statsDirty,  DIRTY_VITAL_HP_RATE);
-    vitals[VITAL_HITPOINTS].max.Initialize(&statsDirty,     DIRTY_VITAL_HP_MAX);
-    vitals[VITAL_MANA].drRate.Initialize(&statsDirty,       DIRTY_VITAL_MANA_RATE);
-    vitals[VITAL_MANA].max.Initialize(&statsDirty,          DIRTY_VITAL_MANA_MAX);
-    vitals[VITAL_PYSSTAMINA].drRate.Initialize(&statsDirty, DIRTY_VITAL_PYSSTAMINA_RATE);
-    vitals[VITAL_PYSSTAMINA].max.Initialize(&statsDirty,    DIRTY_VITAL_PYSSTAMINA_MAX);
-    vitals[VITAL_MENSTAMINA].drRate.Initialize(&statsDirty, DIRTY_VITAL_MENSTAMINA_RATE);
-    vitals[VITAL_MENSTAMINA].max.Initialize(&statsDirty,    DIRTY_VITAL_MENSTAMINA_MAX);
-
     //initialize values to a safe value:
     vitals[VITAL_HITPOINTS].value = 0;
     vitals[VITAL_MANA].value = 0;
     vitals[VITAL_PYSSTAMINA].value = 0;
     vitals[VITAL_MENSTAMINA].value = 0;
 
+    // Before the callbacks are set up, the character isn't constructed yet.
+    // The first update dirties all vitals anyway.
     vitals[VITAL_HITPOINTS].drRate.SetBase(HP_REGEN_RATE);
     vitals[VITAL_MANA].drRate.SetBase(MANA_REGEN_RATE);
 
+    // Set up callbacks for updating the dirty flag.
+    vitals[VITAL_HITPOINTS].drRate.Initialize(this,  VITAL_HITPOINTS,  DIRTY_VITAL_HP_RATE);
+    vitals[VITAL_HITPOINTS].max.Initialize(this,     VITAL_HITPOINTS,  DIRTY_VITAL_HP_MAX);
+    vitals[VITAL_MANA].drRate.Initialize(this,       VITAL_MANA,       DIRTY_VITAL_MANA_RATE);
+    vitals[VITAL_MANA].max.Initialize(this,          VITAL_MANA,       DIRTY_VITAL_MANA_MAX);
+    vitals[VITAL_PYSSTAMINA].drRate.Initialize(this, VITAL_PYSSTAMINA, DIRTY_VITAL_PYSSTAMINA_RATE);
+    vitals[VITAL_PYSSTAMINA].max.Initialize(this,    VITAL_PYSSTAMINA, DIRTY_VITAL_PYSSTAMINA_MAX);
+    vitals[VITAL_MENSTAMINA].drRate.Initialize(this, VITAL_MENSTAMINA, DIRTY_VITAL_MENSTAMINA_RATE);
+    vitals[VITAL_MENSTAMINA].max.Initialize(this,    VITAL_MENSTAMINA, DIRTY_VITAL_MENSTAMINA_MAX);
+
     SetOrigVitals();
 }
 
@@ -68,6 +78,8 @@ psServerVitals::psServerVitals(psCharacter* character)
 #define PERCENT_RATE(v)  vitals[v].max.Current() ? vitals[v].drRate.Current() / vitals[v].max.Current() : 0
 bool psServerVitals::SendStatDRMessage(uint32_t clientnum, EID eid, unsigned int flags, csRef<PlayerGroup> group)
 {
+    Settle(csGetTicks());
+
     bool backup=0;
     if(flags)
     {
@@ -129,54 +141,130 @@ bool psServerVitals::SendStatDRMessage(uint32_t clientnum, EID eid, unsigned int
 
 bool psServerVitals::Update(csTicks now)
 {
-    float delta;
+    Settle(now);
+
+    gemActor* actor = character->GetActor();
+    if(vitals[VITAL_HITPOINTS].value == 0 && vitals[VITAL_HITPOINTS].drRate.Current() < 0 &&
+       actor && actor->IsAlive())
+    {
+        actor->Kill(NULL);
+    }
+
+    // Return true if there are dirty vitals
+    return (statsDirty) ? true : false;
+}
+
+bool psServerVitals::NeedsUpdate()
+{
+    if(statsDirty)
+        return true;
+
+    gemActor* actor = character->GetActor();
+    return vitals[VITAL_HITPOINTS].drRate.Current() < 0 && actor && actor->IsAlive();
+}
+
+void psServerVitals::Settle(csTicks now)
+{
     /* It is necessary to check when lastDRUpdate is 0 because, if not when a character login his stats
-    are significantly incremented, which is instead unnecessary. As tested, delta cannot be 0 or the actors
-    with 0 HP and negative drRate will enter a loop of death, but it has to be really small in order to guarantee
-    a smooth increment of the stats. Dirty all vitals to force a stats update.*/
+    are significantly incremented, which is instead unnecessary. The first update only starts the clock.
+    Dirty all vitals to force a stats update.*/
     if(!lastDRUpdate)
     {
-        delta = 0.1f; //The value can be adjusted but it has to be really small.
-        statsDirty = DIRTY_VITAL_ALL;
+        Dirty(DIRTY_VITAL_ALL);
+        lastDRUpdate = now;
     }
-    else
+    else if(now > lastDRUpdate)
     {
-        delta = (now-lastDRUpdate)/1000.0;
+        float delta = (now-lastDRUpdate)/1000.0;
+
+        // predict the values of all fields based on the recharge rate they had
+        for(int i = 0; i < VITAL_COUNT; i++)
+        {
+            if(vitals[i].rate != 0)
+            {
+                vitals[i].value += vitals[i].rate * delta;
+                ClampVital(i);
+            }
+        }
+        lastDRUpdate = now;
     }
-    lastDRUpdate = now;
 
-    // iterate over all fields and predict their values based on their recharge rate
     for(int i = 0; i < VITAL_COUNT; i++)
     {
-        vitals[i].value += vitals[i].drRate.Current() * delta;
-        ClampVital(i);
+        vitals[i].rate = vitals[i].drRate.Current();
     }
+}
+
+float psServerVitals::GetHP()
+{
+    Settle(csGetTicks());
+    return vitals[VITAL_HITPOINTS].value;
+}
+
+float psServerVitals::GetMana()
+{
+    Settle(csGetTicks());
+    return vitals[VITAL_MANA].value;
+}
+
+float psServerVitals::GetPStamina()
+{
+    Settle(csGetTicks());
+    return vitals[VITAL_PYSSTAMINA].value;
+}
 
-    if(vitals[VITAL_HITPOINTS].value == 0 && vitals[VITAL_HITPOINTS].drRate.Current() < 0)
+float psServerVitals::GetMStamina()
+{
+    Settle(csGetTicks());
+    return vitals[VITAL_MENSTAMINA].value;
+}
+
+void psServerVitals::ResetVitals()
+{
+    psVitalManager<Vital>::ResetVitals();
+
+    // The saved values are the ones to regenerate from, not what they would have become.
+    if(lastDRUpdate)
+        lastDRUpdate = csGetTicks();
+    for(int i = 0; i < VITAL_COUNT; i++)
     {
-        character->GetActor()->Kill(NULL);
+        vitals[i].rate = vitals[i].drRate.Current();
     }
+}
 
-    // Return true if there are dirty vitals
-    return (statsDirty) ? true : false;
+void psServerVitals::OnBuffableChange(int vital, int dirtyFlag)
+{
+    // Settling takes the new rate, after adding what the old one regenerated.
+    Settle(csGetTicks());
+    Dirty(dirtyFlag);
 }
 
+void psServerVitals::Dirty(unsigned int dirtyFlags)
+{
+    statsDirty |= dirtyFlags;
+
+    gemActor* actor = character->GetActor();
+    if(actor)
+        psserver->entitymanager->GetGEM()->QueueStatsUpdate(actor);
+}
 
 void psServerVitals::SetExp(unsigned int W)
 {
     experiencePoints = W;
-    statsDirty |= DIRTY_VITAL_EXPERIENCE;
+    Dirty(DIRTY_VITAL_EXPERIENCE);
 }
 
 void psServerVitals::SetPP(unsigned int pp)
 {
     progressionPoints = pp;
-    statsDirty |= DIRTY_VITAL_PROGRESSION;
+    Dirty(DIRTY_VITAL_PROGRESSION);
 }
 
 Vital &psServerVitals::DirtyVital(int vital, int dirtyFlag)
 {
-    statsDirty |= dirtyFlag;
+    // Changes are made to the current value.
+    Settle(csGetTicks());
+    Dirty(dirtyFlag);
     return GetVital(vital);
 }
 
@@ -199,7 +287,7 @@ unsigned int psServerVitals::GetStatsDirtyFlags() const
 
 void psServerVitals::SetAllStatsDirty()
 {
-    statsDirty = DIRTY_VITAL_ALL;
+    Dirty(DIRTY_VITAL_ALL);
 }
 
 
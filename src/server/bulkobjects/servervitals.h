@@ -39,34 +39,37 @@
 class MsgEntry;
 class psCharacter;
 
-/// Buffables for vitals, which automatically update the dirty flag as necessary.
+class psServerVitals;
+
+/// Buffables for vitals, which tell the psServerVitals they belong to when they change.
 class VitalBuffable : public Buffable<float>
 {
 public:
+    VitalBuffable() : vitals(NULL), vital(0), dirtyFlag(0) { }
     virtual ~VitalBuffable() { }
 
-    void Initialize(unsigned int* sDirty, int dirtyF)
+    void Initialize(psServerVitals* owner, int vitalName, int dirtyF)
     {
-        statsDirty = sDirty;
+        vitals = owner;
+        vital = vitalName;
         dirtyFlag = dirtyF;
     }
 
 protected:
-    virtual void OnChange()
-    {
-        *statsDirty |= dirtyFlag;
-    }
+    virtual void OnChange();
 
-    int dirtyFlag; ///< The bit value we should set when this becomes dirty.
-    unsigned int* statsDirty; ///< Pointer to the psServerVitals dirty bitfield.
+    psServerVitals* vitals; ///< The vitals this buffable belongs to.
+    int vital;              ///< @see PS_VITALS
+    int dirtyFlag;          ///< The bit value we should set when this becomes dirty.
 };
 
 /// A character vital (such as HP or Mana) - server side.
 struct Vital
 {
-    Vital() : value(0.0) {}
+    Vital() : value(0.0), rate(0.0) {}
 
-    float value;
+    float value;          ///< Value at the last update of the vitals
+    float rate;           ///< drRate since the last update of the vitals
     VitalBuffable drRate; ///< Amount added to this vital each second
     VitalBuffable max;
 };
@@ -76,6 +79,11 @@ struct Vital
 /** Server side of the character vitals manager.  Does a lot more accessing
   * of the data to set particular things.  Also does construction of data to
   * send to a client.
+  *
+  * Values regenerate lazily: each vital keeps its value and rate as of the
+  * last update, and is brought up to date whenever it is read or changed.
+  * Characters only need Update() called when they have dirty stats to
+  * publish or are losing hit points, see NeedsUpdate().
   */
 class psServerVitals : public psVitalManager<Vital>
 {
@@ -86,8 +94,34 @@ public:
      */
     bool SendStatDRMessage(uint32_t clientnum, EID eid, unsigned int flags, csRef<PlayerGroup> group = NULL);
 
+    /** Bring the vitals up to date and kill the actor if draining hit
+     *  points ran out.
+     *
+     *  @return True if there are dirty vitals to publish.
+     */
     bool Update(csTicks now);
 
+    /** True if Update() has work to do: there are dirty vitals, or the
+     *  hit points drain and the actor will have to be killed.
+     */
+    bool NeedsUpdate();
+
+    /** @name Current values
+     *  Hide the ones of psVitalManager, which don't regenerate.
+     */
+    ///@{
+    float GetHP();
+    float GetMana();
+    float GetPStamina();
+    float GetMStamina();
+    ///@}
+
+    /// Reset to the "original" vitals, which regenerate from now on.
+    void ResetVitals();
+
+    /// Called by the VitalBuffables after they changed.
+    void OnBuffableChange(int vitalName, int dirtyFlag);
+
     void SetExp(unsigned int exp);
     void SetPP(unsigned int pp);
 
@@ -107,6 +141,14 @@ public:
     void ClearStatsDirtyFlags(unsigned int dirtyFlags);
 
 private:
+    /** Add what the vitals regenerated since the last update with the rates
+     *  they had, and take the current rates from now on.
+     */
+    void Settle(csTicks now);
+
+    /// Set dirty flags and have the actor published with the next stats update.
+    void Dirty(unsigned int dirtyFlags);
+
     /// Clamps the vital's current value to be in the interval [0, max].
     void ClampVital(int vital);
 
@@ -23,6 +23,7 @@
 //=============================================================================
 #include <zlib.h>
 #include <csutil/stringarray.h>
+#include <iutil/cfgmgr.h>
 
 //=============================================================================
 // Project Space Includes
@@ -55,11 +56,13 @@
 // Local Space Includes
 //=============================================================================
 #include "cachemanager.h"
+#include "cachepreloader.h"
 #include "commandmanager.h"
 #include "questmanager.h"
 #include "combatmanager.h"
 #include "client.h"
 #include "globals.h"
+#include "itemsavequeue.h"
 #include "scripting.h"
 
 CacheManager::CacheManager()
@@ -141,6 +144,7 @@ CacheManager::CacheManager()
     effectID = 0;
 
     commandManager = NULL;
+    preloadEntities = NULL;
 
     lootRandomizer = new LootRandomizer(this);
 
@@ -159,76 +163,68 @@ CacheManager::~CacheManager()
 
 bool CacheManager::PreloadAll(EntityManager* entitymanager)
 {
-    if(!PreloadSectors())
-        return false;
-    if(!PreloadSkills())
-        return false;
-    if(!PreloadLimitations())
-        return false;
-    if(!PreloadRaceInfo())
-        return false;
-    if(!PreloadTraits())
-        return false; // Need RaceInfo
-    if(!PreloadWeaponTypes())
-        return false;
-    if (!PreloadItemCategories())
-        return false;
-    if(!PreloadItemAnimList())
-        return false;
-    if(!PreloadItemStatsDatabase())
-        return false;
-    if(!PreloadWays())
-        return false;
-    if(!PreloadFactions())
-        return false;
-    if(!PreloadScripts(entitymanager))
-        return false;
-    if(!PreloadMathScripts())
-        return false;
-    if(!PreloadSpells())
-        return false;
-    if(!PreloadQuests())
-        return false;
-    if(!PreloadAttackTypes())
-        return false;
-    if (!PreloadAttacks())
-        return false;
-    if (!PreloadTradeCombinations())
-        return false;
-    if(!PreloadTradeTransformations())
-        return false;
-    if(!PreloadUniqueTradeTransformations())
-        return false;
-    if(!PreloadTradeProcesses())
-        return false;
-    if(!PreloadTradePatterns())
-        return false;
-    if(!PreloadCraftMessages())
-        return false;
-    if(!PreloadTips())
-        return false;
-    if(!PreloadBadNames())
-        return false;
-    if(!PreloadArmorVsWeapon())
-        return false;
-    if(!PreloadMovement())
-        return false;
-    if(!PreloadStances())
-        return false;
-    if(!PreloadOptions())
-        return false;
-    if(!PreloadLootModifiers())
-        return false;
-
-    PreloadCommandGroups();
-
-    return true;
-}
-
-void CacheManager::PreloadCommandGroups()
+    // Steps on the main thread use the common strings, the loader or parse
+    // scripts that are not safe to parse on several threads. Any step that
+    // registers names in msg_strings must run there, the hash isn't locked.
+    CachePreloader preloader(this);
+    preloader.Add("Sectors", &CacheManager::PreloadSectors, "", true);
+    preloader.Add("Skills", &CacheManager::PreloadSkills, "", true);
+    preloader.Add("Limitations", &CacheManager::PreloadLimitations);
+    preloader.Add("RaceInfo", &CacheManager::PreloadRaceInfo, "Sectors", true);
+    preloader.Add("Traits", &CacheManager::PreloadTraits, "RaceInfo", true);
+    preloader.Add("WeaponTypes", &CacheManager::PreloadWeaponTypes);
+    preloader.Add("ItemCategories", &CacheManager::PreloadItemCategories);
+    preloader.Add("ItemAnimList", &CacheManager::PreloadItemAnimList, "", true);
+    preloader.Add("ItemStatsDatabase", &CacheManager::PreloadItemStatsDatabase,
+                  "Skills ItemCategories WeaponTypes ItemAnimList", true);
+    preloader.Add("Ways", &CacheManager::PreloadWays);
+    preloader.Add("Factions", &CacheManager::PreloadFactions);
+    // Scripts may refer to anything loaded so far.
+    preloader.Add("Scripts", &CacheManager::PreloadProgressionScripts,
+                  "Sectors Skills Limitations RaceInfo Traits WeaponTypes ItemCategories "
+                  "ItemAnimList ItemStatsDatabase Ways Factions", true);
+    preloader.Add("MathScripts", &CacheManager::PreloadMathScripts);
+    preloader.Add("Spells", &CacheManager::PreloadSpells, "Scripts MathScripts Ways ItemStatsDatabase", true);
+    preloader.Add("Quests", &CacheManager::PreloadQuests, "Factions Skills Spells", true);
+    preloader.Add("AttackTypes", &CacheManager::PreloadAttackTypes, "WeaponTypes");
+    preloader.Add("Attacks", &CacheManager::PreloadAttacks, "AttackTypes Scripts MathScripts", true);
+    preloader.Add("TradeCombinations", &CacheManager::PreloadTradeCombinations);
+    preloader.Add("TradeTransformations", &CacheManager::PreloadTradeTransformations);
+    preloader.Add("UniqueTradeTransformations", &CacheManager::PreloadUniqueTradeTransformations);
+    preloader.Add("TradeProcesses", &CacheManager::PreloadTradeProcesses);
+    preloader.Add("TradePatterns", &CacheManager::PreloadTradePatterns);
+    preloader.Add("CraftMessages", &CacheManager::PreloadCraftMessages,
+                  "ItemStatsDatabase TradeCombinations TradeTransformations "
+                  "UniqueTradeTransformations TradeProcesses TradePatterns");
+    preloader.Add("Tips", &CacheManager::PreloadTips);
+    preloader.Add("BadNames", &CacheManager::PreloadBadNames);
+    preloader.Add("ArmorVsWeapon", &CacheManager::PreloadArmorVsWeapon);
+    preloader.Add("Movement", &CacheManager::PreloadMovement);
+    preloader.Add("Stances", &CacheManager::PreloadStances, "", true);
+    preloader.Add("Options", &CacheManager::PreloadOptions);
+    preloader.Add("LootModifiers", &CacheManager::PreloadLootModifiers);
+    preloader.Add("CommandGroups", &CacheManager::PreloadCommandGroups);
+
+    int threads = psserver->GetConfig()->GetInt("PlaneShift.Server.Preload.Threads", 0);
+
+    preloadEntities = entitymanager;
+    bool success = preloader.Run(threads > 0 ? threads : 0);
+    preloadEntities = NULL;
+
+    preloader.Report();
+    return success;
+}
+
+bool CacheManager::PreloadProgressionScripts()
+{
+    return PreloadScripts(preloadEntities);
+}
+
+bool CacheManager::PreloadCommandGroups()
 {
     commandManager = new psCommandManager;
     commandManager->LoadFromDatabase();
+    return true;
 }
 
 void CacheManager::UnloadAll()
@@ -437,7 +433,9 @@ void CacheManager::RemoveInstance(psItem* &item)
     Notify2(LOG_CACHE, "Removing Instance of item: %u", item->GetUID());
     if(item->GetUID() != 0)
     {
-        db->Command("DELETE from item_instances where id='%u'", item->GetUID());
+        ItemSaveQueue* saveQueue = psserver->GetItemSaveQueue();
+        if(!saveQueue || !saveQueue->Discard(item->GetUID()))
+            db->Command("DELETE from item_instances where id='%u'", item->GetUID());
     }
     delete item;
     item = NULL;
@@ -3885,6 +3883,11 @@ psAccountInfo* CacheManager::GetAccountInfoByUsername(const char* username)
         return (psAccountInfo*)obj->RecoverObject();
     }
 
+    return LoadAccountInfo(username);
+}
+
+psAccountInfo* CacheManager::LoadAccountInfo(const char* username)
+{
     csString escape;
     db->Escape(escape, username);
     Result result(db->Select("SELECT * from accounts where username='%s'",escape.GetData()));
@@ -3907,28 +3910,17 @@ psAccountInfo* CacheManager::GetAccountInfoByUsername(const char* username)
 
 bool CacheManager::UpdateAccountInfo(psAccountInfo* ainfo)
 {
-    const char* fieldnames[]=
-    {
-        "last_login_ip",
-        "security_level",
-        "last_login",
-        "operating_system",
-        "graphics_card",
-        "graphics_version"
-    };
-    char accountidstring[11];
-    psStringArray fields;
-
-    fields.Push(ainfo->lastloginip);
-    fields.FormatPush("%d",ainfo->securitylevel);
-    fields.Push(ainfo->lastlogintime);
-    fields.Push(ainfo->os);
-    fields.Push(ainfo->gfxcard);
-    fields.Push(ainfo->gfxversion);
-    snprintf(accountidstring,11,"%u",ainfo->accountid);
-    accountidstring[10]=0x00;
-
-    if(!db->GenericUpdateWithID("accounts","id",accountidstring,fieldnames,fields))
+    csString ip, lastLogin, os, gfxcard, gfxversion;
+    db->Escape(ip, ainfo->lastloginip);
+    db->Escape(lastLogin, ainfo->lastlogintime);
+    db->Escape(os, ainfo->os);
+    db->Escape(gfxcard, ainfo->gfxcard);
+    db->Escape(gfxversion, ainfo->gfxversion);
+
+    if(db->Command("UPDATE accounts SET last_login_ip='%s',security_level='%d',last_login='%s',"
+                   "operating_system='%s',graphics_card='%s',graphics_version='%s' WHERE id='%u'",
+                   ip.GetData(), ainfo->securitylevel, lastLogin.GetData(), os.GetData(),
+                   gfxcard.GetData(), gfxversion.GetData(), ainfo->accountid) == QUERY_FAILED)
     {
         Error3("Failed to update account %u. Error %s",ainfo->accountid,db->GetLastError());
         return false;
@@ -388,7 +388,18 @@ public:
      */
     psAccountInfo* GetAccountInfoByUsername(const char* username);
 
+    /** Look up the account information in the database, without looking in the cache.
+     *
+     *  Doesn't touch the cache, so threads with a database connection of their own can call it.
+     *
+     *  @param username - The unique username associated with the account.
+     *  @return NULL if no account information was found. The returned pointer must be deleted when no longer needed.
+     */
+    psAccountInfo* LoadAccountInfo(const char* username);
+
     /** Call to store modified account information back to the database. Updates IP, security level, last login time, os, graphics card and graphics driver version.
+     *
+     *  Runs the statement with Command() on the connection of the calling thread, so login workers can call it.
      *
      * @param ainfo - A pointer to account data to store.
      * @return true - success  false - failed
@@ -403,7 +414,13 @@ public:
     unsigned int NewAccountInfo(psAccountInfo* ainfo);
     //@}
 
-    /// Convenience function to preload all of the above in an appropriate order
+    /**
+     * Convenience function to preload all of the above in an appropriate order.
+     *
+     * Steps that don't depend on each other are loaded on
+     * PlaneShift.Server.Preload.Threads threads, if the database supports
+     * a connection per thread.
+     */
     bool PreloadAll(EntityManager* entitymanager);
     void UnloadAll();
 
@@ -694,6 +711,8 @@ protected:
     void PreloadFactionCharacterEvents(const char* script, Faction* faction);
     bool PreloadFactions();
     bool PreloadScripts(EntityManager* entitymanager);
+    /// PreloadScripts with the entity manager given to PreloadAll.
+    bool PreloadProgressionScripts();
     bool PreloadMathScripts();
     bool PreloadSpells();
     bool PreloadItemStatsDatabase();
@@ -706,7 +725,7 @@ protected:
     bool PreloadArmorVsWeapon();
     bool PreloadMovement();
     bool PreloadStances();
-    void PreloadCommandGroups();
+    bool PreloadCommandGroups();
 
 
     /**
@@ -936,6 +955,7 @@ protected:
     csPDelArray<psMovement> movements;
     csPDelArray<psCharacterLimitation> limits;  ///< All the limitations based on scores for characters.
     psCommandManager* commandManager;
+    EntityManager* preloadEntities;  ///< Only set while PreloadAll runs
     optionEntry rootOptionEntry;
 
     LootRandomizer* lootRandomizer; ///< A pointer to the lootrandomizer mantained by the cachemanager.
@@ -0,0 +1,227 @@
+/*
+ * cachepreloader.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/stringarray.h>
+#include <csutil/sysfunc.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>
+#include "util/consoleout.h"
+#include "util/log.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "cachepreloader.h"
+#include "globals.h"
+
+CachePreloader::CachePreloader(CacheManager* cache)
+    : cache(cache), done(0), failed(false), threadCount(0), totalTime(0)
+{
+}
+
+CachePreloader::~CachePreloader()
+{
+}
+
+void CachePreloader::Add(const char* name, StepFunction function, const char* dependencies, bool mainThread)
+{
+    Step step;
+    step.name = name;
+    step.function = function;
+    step.mainThread = mainThread;
+    step.state = STEP_WAITING;
+    step.time = 0;
+    step.thread = 0;
+
+    csStringArray names;
+    names.SplitString(dependencies, " ", csStringArray::delimIgnore);
+    for(size_t i = 0; i < names.GetSize(); i++)
+    {
+        size_t dependency = SIZET_NOT_FOUND;
+        for(size_t j = 0; j < steps.GetSize(); j++)
+        {
+            if(steps[j].name == names[i])
+            {
+                dependency = j;
+                break;
+            }
+        }
+
+        if(dependency == SIZET_NOT_FOUND)
+        {
+            Bug3("Preload step %s depends on %s, which isn't added before it.", name, names[i]);
+            continue;
+        }
+        step.dependencies.Push(dependency);
+    }
+
+    steps.Push(step);
+}
+
+size_t CachePreloader::FindReady(bool mainThread)
+{
+    size_t ready = SIZET_NOT_FOUND;
+    for(size_t i = 0; i < steps.GetSize(); i++)
+    {
+        const Step &step = steps[i];
+        if(step.state != STEP_WAITING || (step.mainThread && !mainThread))
+            continue;
+
+        bool blocked = false;
+        for(size_t j = 0; j < step.dependencies.GetSize(); j++)
+        {
+            if(steps[step.dependencies[j]].state != STEP_DONE)
+            {
+                blocked = true;
+                break;
+            }
+        }
+        if(blocked)
+            continue;
+
+        // Nobody else can take the steps of the calling thread.
+        if(step.mainThread || !mainThread || !threadCount)
+            return i;
+        if(ready == SIZET_NOT_FOUND)
+            ready = i;
+    }
+    return ready;
+}
+
+bool CachePreloader::WorkerStepsWaiting()
+{
+    for(size_t i = 0; i < steps.GetSize(); i++)
+    {
+        if(steps[i].state == STEP_WAITING && !steps[i].mainThread)
+            return true;
+    }
+    return false;
+}
+
+void CachePreloader::RunSteps(size_t thread)
+{
+    bool mainThread = (thread == 0);
+
+    mutex.Lock();
+    while(!failed && done < steps.GetSize())
+    {
+        size_t index = FindReady(mainThread);
+        if(index == SIZET_NOT_FOUND)
+        {
+            if(!mainThread && !WorkerStepsWaiting())
+                break;
+
+            // Until a running step is done.
+            condition.Wait(mutex);
+            continue;
+        }
+
+        steps[index].state = STEP_RUNNING;
+        steps[index].thread = thread;
+        StepFunction function = steps[index].function;
+        mutex.Unlock();
+
+        csTicks start = csGetTicks();
+        bool success = (cache->*function)();
+        csTicks time = csGetTicks() - start;
+
+        mutex.Lock();
+        steps[index].state = STEP_DONE;
+        steps[index].time = time;
+        done++;
+        if(!success)
+        {
+            Error2("Preload step %s failed.", steps[index].name.GetData());
+            failed = true;
+        }
+        condition.NotifyAll();
+    }
+    mutex.Unlock();
+}
+
+void CachePreloader::Worker::Run()
+{
+    if(!db->AttachThread())
+    {
+        CPrintf(CON_WARNING, "Preload thread %zu has no database connection of its own, "
+                "its steps run in the main thread.\n", thread);
+        return;
+    }
+
+    preloader->RunSteps(thread);
+    db->DetachThread();
+}
+
+bool CachePreloader::Run(size_t threads)
+{
+    threadCount = threads;
+    csTicks start = csGetTicks();
+
+    csArray<csRef<CS::Threading::Thread> > workers;
+    for(size_t i = 1; i <= threads; i++)
+    {
+        csRef<Worker> worker;
+        worker.AttachNew(new Worker(this, i));
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        workers.Push(thread);
+    }
+
+    RunSteps(0);
+
+    // The steps still running when one failed finish first.
+    for(size_t i = 0; i < workers.GetSize(); i++)
+    {
+        workers[i]->Wait();
+    }
+
+    totalTime = csGetTicks() - start;
+    return !failed;
+}
+
+void CachePreloader::Report()
+{
+    csTicks stepTime = 0;
+    for(size_t i = 0; i < steps.GetSize(); i++)
+    {
+        stepTime += steps[i].time;
+    }
+
+    CPrintf(CON_CMDOUTPUT, "Preloaded the caches in %u ms on %zu threads, the steps took %u ms:\n",
+            totalTime, threadCount + 1, stepTime);
+    for(size_t i = 0; i < steps.GetSize(); i++)
+    {
+        const Step &step = steps[i];
+        if(step.state != STEP_DONE)
+            continue;
+
+        if(step.thread)
+            CPrintf(CON_CMDOUTPUT, "  %-32s %6u ms  thread %zu\n", step.name.GetData(), step.time, step.thread);
+        else
+            CPrintf(CON_CMDOUTPUT, "  %-32s %6u ms  main\n", step.name.GetData(), step.time);
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * cachepreloader.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __CACHEPRELOADER_H__
+#define __CACHEPRELOADER_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+class CacheManager;
+
+/**
+ * \addtogroup server
+ * @{ */
+
+/**
+ * Runs the preload steps of the cache manager on a pool of threads.
+ *
+ * Each step names the steps it needs to be done first. Steps that use
+ * state that is not safe to touch from several threads, like the common
+ * strings, are kept on the thread that calls Run. All others may run on
+ * a worker, which queries the database over a connection of its own.
+ * Workers that can't get one leave their steps to the calling thread.
+ */
+class CachePreloader
+{
+public:
+    typedef bool (CacheManager::*StepFunction)();
+
+    CachePreloader(CacheManager* cache);
+    ~CachePreloader();
+
+    /**
+     * Add a step.
+     *
+     * @param name The name in the report.
+     * @param function The preload function of the cache manager.
+     * @param dependencies The names of the steps that must be done before
+     *   this one, separated by spaces. They must have been added already.
+     * @param mainThread Run the step on the thread that calls Run.
+     */
+    void Add(const char* name, StepFunction function, const char* dependencies = "", bool mainThread = false);
+
+    /**
+     * Run all steps. Stops starting new ones once a step failed.
+     *
+     * @param threads The number of workers. 0 runs all steps on the calling
+     *   thread, in the order they were added.
+     * @return false if any step failed.
+     */
+    bool Run(size_t threads);
+
+    /// Print how long each step took and on which thread.
+    void Report();
+
+private:
+    enum StepState
+    {
+        STEP_WAITING,
+        STEP_RUNNING,
+        STEP_DONE
+    };
+
+    struct Step
+    {
+        csString name;
+        StepFunction function;
+        csArray<size_t> dependencies;
+        bool mainThread;
+        StepState state;
+        csTicks time;
+        size_t thread;      ///< 0 is the thread that calls Run
+    };
+
+    class Worker : public CS::Threading::Runnable
+    {
+    public:
+        Worker(CachePreloader* preloader, size_t thread) : preloader(preloader), thread(thread) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "CachePreloader";
+        }
+
+    private:
+        CachePreloader* preloader;
+        size_t thread;
+    };
+
+    /**
+     * The first waiting step a thread may take whose dependencies are done.
+     * The calling thread takes the steps only it may run first.
+     *
+     * @return SIZET_NOT_FOUND if there is none. Called with the mutex held.
+     */
+    size_t FindReady(bool mainThread);
+
+    /// True if a step a worker may take is still waiting. Called with the mutex held.
+    bool WorkerStepsWaiting();
+
+    /// Run steps until none are left for the thread or one failed.
+    void RunSteps(size_t thread);
+
+    CacheManager* cache;
+    csArray<Step> steps;
+    size_t done;
+    bool failed;
+    size_t threadCount;
+    csTicks totalTime;
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+};
+
+/** @} */
+
+#endif
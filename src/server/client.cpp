@@ -41,6 +41,7 @@
 //=============================================================================
 #include "usermanager.h"
 #include "client.h"
+#include "clients.h"
 #include "psserver.h"
 #include "playergroup.h"
 #include "globals.h"
@@ -56,7 +57,7 @@ Client::Client()
     : accumulatedLag(0), zombie(false), zombietimeout(0), 
       allowedToDisconnect(true), ready(false),
       accountID(0), playerID(0), securityLevel(0), superclient(false),
-      name(""), waypointPathIndex(0), pathPath(NULL), selectedLocationID(0),
+      name(""), connections(NULL), waypointPathIndex(0), pathPath(NULL), selectedLocationID(0),
       cheatMask(NO_CHEAT)
 {
     actor           = 0;
@@ -66,6 +67,7 @@ Client::Client()
     spamPoints      = 0;
     clientnum       = 0;
     detectedCheatCount = 0;
+    netCapabilities = 0;
 
     nextFloodHistoryIndex = 0;
 
@@ -269,6 +271,22 @@ bool Client::IsMyPet(gemActor* other) const
 void Client::SetName(const char* n)
 {
     name = n;
+    if(connections)
+        connections->Reindex(this);
+}
+
+void Client::SetAccountID(AccountID id)
+{
+    accountID = id;
+    if(connections)
+        connections->Reindex(this);
+}
+
+void Client::SetPID(PID id)
+{
+    playerID = id;
+    if(connections)
+        connections->Reindex(this);
 }
 
 const char* Client::GetName()
@@ -291,6 +309,10 @@ void Client::SetActor(gemActor* myactor)
     {
         allowedToDisconnect = true;
     }
+
+    // The name comes from the character while there is one.
+    if(connections)
+        connections->Reindex(this);
 }
 
 psCharacter* Client::GetCharacterData()
@@ -38,6 +38,7 @@
 //=============================================================================
 
 class Client;
+class ClientConnectionSet;
 class psCharacter;
 class gemObject;
 class gemActor;
@@ -213,19 +214,22 @@ public:
     {
         return accountID;
     }
-    void SetAccountID(AccountID id)
-    {
-        accountID = id;
-    }
+    void SetAccountID(AccountID id);
 
     /// The player number for this client.
     PID GetPID()
     {
         return playerID;
     }
-    void SetPID(PID id)
+    void SetPID(PID id);
+
+    /**
+     * Set the connection set that finds this client by its name, player and
+     * account, to be told when they change. NULL when it is taken out.
+     */
+    void SetConnectionSet(ClientConnectionSet* set)
     {
-        playerID = id;
+        connections = set;
     }
 
     int GetExchangeID()
@@ -500,6 +504,16 @@ public:
         return isBuddyListHiding;
     }
 
+    /// The NetCapabilities the client announced when it authenticated.
+    void SetNetCapabilities(uint32_t caps)
+    {
+        netCapabilities = caps;
+    }
+    bool HasNetCapability(uint32_t cap) const
+    {
+        return (netCapabilities & cap) != 0;
+    }
+
 protected:
 
     /**
@@ -541,6 +555,9 @@ protected:
     csArray<gemNPC*> listeningNpc;
     csString name;
 
+    /// Indexes this client by name, player and account.
+    ClientConnectionSet* connections;
+
     csArray<uint32_t> duel_clients;
 
     // Flood control
@@ -583,6 +600,8 @@ private:
 
     /// This flag makes them hide from player (not GM/Dev) buddylists
     bool isBuddyListHiding;
+
+    uint32_t netCapabilities;
 };
 
 #endif
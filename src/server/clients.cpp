@@ -56,7 +56,8 @@ bool SockAddress::operator< (const SockAddress &other) const
 }
 
 
-ClientConnectionSet::ClientConnectionSet():addrHash(307),hash(307)
+ClientConnectionSet::ClientConnectionSet():addrHash(307),hash(307),
+    nameIndex(307),pidIndex(307),accountIndex(307),indexedKeys(307)
 {
 }
 
@@ -76,18 +77,22 @@ bool ClientConnectionSet::Initialize()
     return true;
 }
 
-Client* ClientConnectionSet::Add(LPSOCKADDR_IN addr)
+Client* ClientConnectionSet::Add(LPSOCKADDR_IN addr, uint32_t shard, uint32_t shardCount)
 {
     int newclientnum;
 
-    // Get a random uniq client number
+    // Get a random uniq client number, one that belongs to the shard
     Client* testclient;
-    do
     {
-        newclientnum = psserver->rng->Get(0x8fffff); //make clientnum random
-        testclient = FindAny(newclientnum);
+        // Network shards add clients at the same time
+        CS::Threading::RecursiveMutexScopedLock lock(mutex);
+        do
+        {
+            newclientnum = psserver->rng->Get(0x8fffff / shardCount) * shardCount + shard; //make clientnum random
+            testclient = FindAny(newclientnum);
+        }
+        while(testclient != NULL);
     }
-    while(testclient != NULL);
 
     // Have uniq client number, create the new client
     Client* client = new Client();
@@ -98,9 +103,13 @@ Client* ClientConnectionSet::Add(LPSOCKADDR_IN addr)
         return NULL;
     }
 
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    addrHash.PutUnique(SockAddress(client->GetAddress()), client);
-    hash.Put(client->GetClientNum(), client);
+    {
+        CS::Threading::RecursiveMutexScopedLock lock(mutex);
+        addrHash.PutUnique(SockAddress(client->GetAddress()), client);
+        hash.Put(client->GetClientNum(), client);
+    }
+    client->SetConnectionSet(this);
+    Reindex(client);
     return client;
 }
 
@@ -114,6 +123,42 @@ void ClientConnectionSet::MarkDelete(Client* client)
 
     hash.DeleteAll(clientid);
     toDelete.Push(client);
+
+    client->SetConnectionSet(NULL);
+    CS::Threading::ScopedWriteLock indexLock(indexMutex);
+    Unindex(client);
+}
+
+void ClientConnectionSet::Reindex(Client* client)
+{
+    IndexKeys keys;
+    keys.name = client->GetName();
+    keys.name.Downcase();
+    keys.pid = client->GetPID();
+    keys.account = client->GetAccountID();
+
+    CS::Threading::ScopedWriteLock lock(indexMutex);
+    Unindex(client);
+
+    if(!keys.name.IsEmpty())
+        nameIndex.Put(keys.name, client);
+    if(keys.pid.IsValid())
+        pidIndex.Put(keys.pid, client);
+    if(keys.account.IsValid())
+        accountIndex.Put(keys.account, client);
+    indexedKeys.Put(client->GetClientNum(), keys);
+}
+
+void ClientConnectionSet::Unindex(Client* client)
+{
+    IndexKeys* keys = indexedKeys.GetElementPointer(client->GetClientNum());
+    if(!keys)
+        return;
+
+    nameIndex.Delete(keys->name, client);
+    pidIndex.Delete(keys->pid, client);
+    accountIndex.Delete(keys->account, client);
+    indexedKeys.DeleteAll(client->GetClientNum());
 }
 
 void ClientConnectionSet::SweepDelete()
@@ -184,50 +229,36 @@ Client* ClientConnectionSet::Find(const char* name)
         return NULL;
     }
 
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
-    Client* p = NULL;
-    while(it.HasNext())
-    {
-        p = it.Next();
-        if(!p->GetName())
-            continue;
-
-        if(!strcasecmp(p->GetName(), name))
-            break;
-        p = NULL;
-    }
-
-    if(p && p->IsReady())
-        return p;
-    else
-        return NULL;
-}
-
-Client* ClientConnectionSet::FindPlayer(PID playerID)
-{
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
+    csString key(name);
+    key.Downcase();
 
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    csHash<Client*, csString>::Iterator it(nameIndex.GetIterator(key));
     while(it.HasNext())
     {
         Client* p = it.Next();
-        if(p->GetPID() == playerID)
+        if(p->IsReady())
             return p;
     }
 
     return NULL;
 }
 
+Client* ClientConnectionSet::FindPlayer(PID playerID)
+{
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    return pidIndex.Get(playerID, NULL);
+}
+
 Client* ClientConnectionSet::FindAccount(AccountID accountID, uint32_t excludeClient)
 {
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    csHash<Client*, AccountID>::Iterator it(accountIndex.GetIterator(accountID));
 
     while(it.HasNext())
     {
         Client* p = it.Next();
-        if(p->GetAccountID() == accountID && p->GetClientNum() != excludeClient)
+        if(p->GetClientNum() != excludeClient)
             return p;
     }
 
@@ -21,6 +21,7 @@
 
 #include <csutil/hash.h>
 #include <csutil/threading/thread.h>
+#include <csutil/threading/rwmutex.h>
 
 #include "client.h"
 
@@ -52,7 +53,8 @@ template<> class csHashComputer<SockAddress> :
 
 /**
  * This class is a list of several CLient objects, it's designed for finding
- * clients very fast based on their clientnum or their IP address.
+ * clients very fast based on their clientnum, their IP address, their name,
+ * player or account.
  * This class is also threadsafe now
  */
 class ClientConnectionSet
@@ -67,13 +69,46 @@ protected:
     csPDelArray<Client> toDelete;
     CS::Threading::RecursiveMutex mutex;
 
+    /// What a client was last indexed by.
+    struct IndexKeys
+    {
+        csString name;  ///< Lower case
+        PID pid;
+        AccountID account;
+    };
+
+    /**
+     * Clients by lower case name, player and account. A key may have
+     * several clients, as the same account logging in twice does.
+     */
+    csHash<Client*, csString> nameIndex;
+    csHash<Client*, PID> pidIndex;
+    csHash<Client*, AccountID> accountIndex;
+    csHash<IndexKeys, uint32_t> indexedKeys;
+
+    /**
+     * Protects the indexes. Lookups only take a read lock, so the network
+     * and game threads find clients at the same time, and never wait for
+     * the iterators holding \ref mutex.
+     */
+    CS::Threading::ReadWriteMutex indexMutex;
+
+    /// Take a client out of the indexes. Called with indexMutex write locked.
+    void Unindex(Client* client);
+
 public:
     ClientConnectionSet();
     ~ClientConnectionSet();
 
     bool Initialize();
 
-    Client* Add(LPSOCKADDR_IN addr);
+    /**
+     * Add a client with a new random client number.
+     *
+     * @param shard The client number modulo shardCount is this.
+     * @param shardCount Number of network shards.
+     */
+    Client* Add(LPSOCKADDR_IN addr, uint32_t shard = 0, uint32_t shardCount = 1);
 
     // Delete all clients marked to be deleted
     void SweepDelete();
@@ -81,6 +116,12 @@ public:
     // Mark this client as ready to be deleted
     void MarkDelete(Client* client);
 
+    /**
+     * Index a client by its current name, player and account. Called by
+     * the client when one of them changes.
+     */
+    void Reindex(Client* client);
+
     /// Count the number of clients connected, including superclients
     size_t Count(void) const;
 
@@ -91,7 +132,7 @@ public:
     Client* FindAny(uint32_t id);
     ///  Find by 32bit id value, used in UDP messages.  Returns NULL if found but not ready.
     Client* Find(uint32_t id);
-    /// Find by player name, used for Chat and other purposes. Returns NULL if found but not ready.
+    /// Find by player name, case insensitive, used for Chat and other purposes. Returns NULL if found but not ready.
     Client* Find(const char* name);
     /// Find by player id
     Client* FindPlayer(PID playerID);
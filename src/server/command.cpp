@@ -29,15 +29,18 @@
 #include <memory.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <math.h>
 
 #include <iutil/object.h>
 #include <iutil/objreg.h>
 #include <iutil/cfgmgr.h>
 #include <csutil/csstring.h>
 #include <csutil/md5.h>
+#include <csutil/sysfunc.h>
 #include <iutil/stringarray.h>
 #include <iengine/collection.h>
 #include <iengine/engine.h>
+#include <iengine/mesh.h>
 
 #include "util/command.h"
 #include "util/serverconsole.h"
@@ -52,6 +55,7 @@
 #include "gem.h"
 #include "invitemanager.h"
 #include "entitymanager.h"
+#include "npcmanager.h"
 #include "util/psdatabase.h"
 #include "spawnmanager.h"
 #include "actionmanager.h"
@@ -66,6 +70,8 @@
 #include "economymanager.h"
 #include "questmanager.h"
 #include "chatmanager.h"
+#include "itemsavequeue.h"
+#include "authentserver.h"
 #include "engine/psworld.h"
 #include "bulkobjects/dictionary.h"
 #include "bulkobjects/psnpcdialog.h"
@@ -286,6 +292,278 @@ int com_dbprofile(const char*)
     return 0;
 }
 
+/**
+ * Runs a console command on the main thread. The console reads commands on
+ * a thread of its own, so commands that change the world queue themselves
+ * with this instead of running beside the game loop.
+ */
+class psConsoleCommandEvent : public psGameEvent
+{
+public:
+    psConsoleCommandEvent(int (*func)(const char*), const char* arg)
+        : psGameEvent(0, 0, "psConsoleCommandEvent"), func(func), arg(arg) { }
+
+    virtual void Trigger()
+    {
+        func(arg);
+    }
+
+private:
+    int (*func)(const char*);
+    csString arg;
+};
+
+/// Benchmarks that add entities only run while nobody is connected.
+static bool IsWorldLive()
+{
+    if(psserver->GetNetManager()->GetConnections()->Count() > 0)
+    {
+        CPrintf(CON_CMDOUTPUT, "Clients or superclients are connected, only run this on an empty test server.\n");
+        return true;
+    }
+    return false;
+}
+
+/// The work of com_gembench, on the main thread.
+static int RunGEMBench(const char* arg)
+{
+    WordArray words(arg);
+    PID pid = words.GetInt(0);
+    size_t copies = words.GetCount() > 1 ? words.GetInt(1) : 20000;
+    size_t rounds = words.GetCount() > 2 ? words.GetInt(2) : 200;
+    if(IsWorldLive())
+        return 0;
+
+    EntityManager* entitymanager = psserver->entitymanager;
+    GEMSupervisor* gem = entitymanager->GetGEM();
+
+    // Out of the proximity lists, so neither clients nor superclients see them.
+    csArray<EID> added;
+    csTicks start = csGetTicks();
+    for(size_t i = 0; i < copies; i++)
+    {
+        psCharacter* chardata = psserver->CharacterLoader.LoadCharacterData(pid, false);
+        if(!chardata)
+        {
+            CPrintf(CON_CMDOUTPUT, "Couldn't load the character of NPC %s.\n", ShowID(pid));
+            break;
+        }
+        EID eid = entitymanager->CreateNPC(chardata, false);
+        if(!eid.IsValid())
+            break;
+        added.Push(eid);
+    }
+    CPrintf(CON_CMDOUTPUT, "Added %zu copies of %s in %u ms, %zu entities.\n",
+            added.GetSize(), ShowID(pid), csGetTicks() - start, gem->GetAllGEMS().GetSize());
+
+    // The loop UpdateAllStats had before the actor tables.
+    csMicroTicks begin = csGetMicroTicks();
+    for(size_t r = 0; r < rounds; r++)
+    {
+        csHash<gemObject*, EID>::GlobalIterator iter(gem->GetAllGEMS().GetIterator());
+        while(iter.HasNext())
+        {
+            gemActor* actor = dynamic_cast<gemActor*>(iter.Next());
+            if(actor)
+                actor->UpdateStats();
+        }
+    }
+    csMicroTicks byHash = csGetMicroTicks() - begin;
+
+    // The same updates through the actor tables.
+    GEMActorTable* tables[] = { gem->GetActorTable(GEM_LIST_PLAYERS), gem->GetActorTable(GEM_LIST_NPCS) };
+    begin = csGetMicroTicks();
+    for(size_t r = 0; r < rounds; r++)
+    {
+        for(size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
+        {
+            for(size_t i = 0; i < tables[t]->GetSize(); i++)
+            {
+                tables[t]->GetActor(i)->UpdateStats();
+            }
+        }
+    }
+    csMicroTicks byTable = csGetMicroTicks() - begin;
+
+    CPrintf(CON_CMDOUTPUT, "Entity hash:  %8.1f us per round\n", (double)byHash / rounds);
+    CPrintf(CON_CMDOUTPUT, "Actor tables: %8.1f us per round, %.1fx\n", (double)byTable / rounds,
+            byTable ? (double)byHash / byTable : 0.0);
+
+    // Stats may have killed some, only remove those still there.
+    for(size_t i = 0; i < added.GetSize(); i++)
+    {
+        gemObject* obj = gem->FindObject(added[i]);
+        if(obj)
+            entitymanager->RemoveActor(obj);
+    }
+    return 0;
+}
+
+/**
+ * Times a stat update of every actor of the world with copies of an NPC
+ * added to it, looping over the entity hash as UpdateAllStats did before
+ * and over the actor tables of the GEM. The copies share the PID of the
+ * NPC while they exist, so it refuses to run while anyone is connected.
+ */
+int com_gembench(const char* arg)
+{
+    WordArray words(arg);
+    PID pid = words.GetInt(0);
+    size_t rounds = words.GetCount() > 2 ? words.GetInt(2) : 200;
+    if(!pid.IsValid() || rounds == 0)
+    {
+        CPrintf(CON_CMDOUTPUT, "Usage: gembench <npc pid> [copies=20000] [rounds=200]\n");
+        return 0;
+    }
+    if(IsWorldLive())
+        return 0;
+
+    psConsoleCommandEvent* event = new psConsoleCommandEvent(RunGEMBench, arg);
+    event->QueueEvent();
+    CPrintf(CON_CMDOUTPUT, "Queued, the results follow when the main thread runs it.\n");
+    return 0;
+}
+
+/// The work of com_gridbench, on the main thread.
+static int RunGridBench(const char* arg)
+{
+    WordArray words(arg);
+    PID pid = words.GetInt(0);
+    size_t actors = words.GetCount() > 1 ? words.GetInt(1) : 1000;
+    float radius = words.GetCount() > 2 ? atof(words[2]) : 100.0f;
+    size_t rounds = words.GetCount() > 3 ? words.GetInt(3) : 10;
+    if(IsWorldLive())
+        return 0;
+
+    EntityManager* entitymanager = psserver->entitymanager;
+    GEMSupervisor* gem = entitymanager->GetGEM();
+    csRef<iEngine> engine = csQueryRegistry<iEngine> (psserver->GetObjectReg());
+
+    // Copies of the NPC on a square around it, 5 m apart, out of the proximity lists.
+    size_t side = (size_t)ceil(sqrt((double)actors));
+    csArray<EID> added;
+    for(size_t i = 0; i < actors; i++)
+    {
+        psCharacter* chardata = psserver->CharacterLoader.LoadCharacterData(pid, false);
+        if(!chardata)
+        {
+            CPrintf(CON_CMDOUTPUT, "Couldn't load the character of NPC %s.\n", ShowID(pid));
+            break;
+        }
+
+        InstanceID instance;
+        psSectorInfo* sectorinfo;
+        csVector3 pos;
+        float yrot;
+        chardata->GetLocationInWorld(instance, sectorinfo, pos.x, pos.y, pos.z, yrot);
+        iSector* sector = entitymanager->FindSector(sectorinfo->name);
+        if(!sector)
+        {
+            CPrintf(CON_CMDOUTPUT, "Couldn't find the sector of NPC %s.\n", ShowID(pid));
+            delete chardata;
+            break;
+        }
+
+        pos.x += 5.0f * ((float)(i % side) - side / 2.0f);
+        pos.z += 5.0f * ((float)(i / side) - side / 2.0f);
+        EID eid = entitymanager->CreateNPC(chardata, instance, pos, sector, yrot, false);
+        if(!eid.IsValid())
+            break;
+        added.Push(eid);
+    }
+
+    // The positions to query around.
+    csArray<gemObject*> centers;
+    for(size_t i = 0; i < added.GetSize(); i++)
+    {
+        gemObject* obj = gem->FindObject(added[i]);
+        if(obj && obj->GetMeshWrapper() && obj->GetSector())
+            centers.Push(obj);
+    }
+
+    size_t meshFound = 0;
+    csMicroTicks begin = csGetMicroTicks();
+    for(size_t r = 0; r < rounds; r++)
+    {
+        for(size_t i = 0; i < centers.GetSize(); i++)
+        {
+            InstanceID instance = centers[i]->GetInstance();
+            csRef<iMeshWrapperIterator> obj_it = engine->GetNearbyMeshes(centers[i]->GetSector(), centers[i]->GetPosition(), radius);
+            while(obj_it->HasNext())
+            {
+                gemObject* object = gem->FindAttachedObject(obj_it->Next()->QueryObject());
+                if(object && (object->GetInstance() == instance ||
+                              object->GetInstance() == INSTANCE_ALL || instance == INSTANCE_ALL))
+                {
+                    meshFound++;
+                }
+            }
+        }
+    }
+    csMicroTicks byMeshes = csGetMicroTicks() - begin;
+
+    size_t gridFound = 0;
+    begin = csGetMicroTicks();
+    for(size_t r = 0; r < rounds; r++)
+    {
+        for(size_t i = 0; i < centers.GetSize(); i++)
+        {
+            gridFound += gem->FindNearbyEntities(centers[i]->GetSector(), centers[i]->GetPosition(),
+                                                 centers[i]->GetInstance(), radius, true).GetSize();
+        }
+    }
+    csMicroTicks byGrid = csGetMicroTicks() - begin;
+
+    for(size_t i = 0; i < added.GetSize(); i++)
+    {
+        gemObject* obj = gem->FindObject(added[i]);
+        if(obj)
+            entitymanager->RemoveActor(obj);
+    }
+
+    size_t queries = centers.GetSize() * rounds;
+    if(!queries)
+    {
+        CPrintf(CON_CMDOUTPUT, "No actors to query around.\n");
+        return 0;
+    }
+
+    CPrintf(CON_CMDOUTPUT, "%zu actors in one sector, %zu queries of radius %.1f\n", centers.GetSize(), queries, radius);
+    CPrintf(CON_CMDOUTPUT, "Engine meshes: %10.0f queries/s, %8.2f us per query, %.1f entities found\n",
+            byMeshes ? queries * 1000000.0 / byMeshes : 0.0, (double)byMeshes / queries, (float)meshFound / queries);
+    CPrintf(CON_CMDOUTPUT, "Spatial grid:  %10.0f queries/s, %8.2f us per query, %.1f entities found, %.1fx\n",
+            byGrid ? queries * 1000000.0 / byGrid : 0.0, (double)byGrid / queries, (float)gridFound / queries,
+            byGrid ? (double)byMeshes / byGrid : 0.0);
+    return 0;
+}
+
+/**
+ * Times proximity queries around copies of an NPC placed in its sector,
+ * through the spatial grid of the GEM and through the meshes of the engine
+ * as FindNearbyEntities did before the grid. Like gembench it adds actors,
+ * so it runs on the main thread and only while nobody is connected.
+ */
+int com_gridbench(const char* arg)
+{
+    WordArray words(arg);
+    PID pid = words.GetInt(0);
+    size_t actors = words.GetCount() > 1 ? words.GetInt(1) : 1000;
+    float radius = words.GetCount() > 2 ? atof(words[2]) : 100.0f;
+    size_t rounds = words.GetCount() > 3 ? words.GetInt(3) : 10;
+    if(!pid.IsValid() || actors == 0 || radius <= 0.0f || rounds == 0)
+    {
+        CPrintf(CON_CMDOUTPUT, "Usage: gridbench <npc pid> [actors=1000] [radius=100] [rounds=10]\n");
+        return 0;
+    }
+    if(IsWorldLive())
+        return 0;
+
+    psConsoleCommandEvent* event = new psConsoleCommandEvent(RunGridBench, arg);
+    event->QueueEvent();
+    CPrintf(CON_CMDOUTPUT, "Queued, the results follow when the main thread runs it.\n");
+    return 0;
+}
+
 int com_queue(const char* player)
 {
     int playernum = atoi(player);
@@ -323,6 +601,27 @@ int com_status(const char*)
             hasBeenReady ? "loaded and running." : "not loaded.");
     CPrintf(CON_CMDOUTPUT ,"Connection Count : " COL_CYAN "%d\n" COL_NORMAL,
             psserver->GetNetManager()->GetConnections()->Count());
+    CPrintf(CON_CMDOUTPUT ,"Event queue      : " COL_CYAN "%s\n" COL_NORMAL,
+            psserver->GetEventManager()->GetQueueStats().GetData());
+    CPrintf(CON_CMDOUTPUT ,"Event workers    : " COL_CYAN "%s\n" COL_NORMAL,
+            psserver->GetEventManager()->GetWorkerStats().GetData());
+    if(psserver->GetAuthServer())
+    {
+        CPrintf(CON_CMDOUTPUT ,"Logins           : " COL_CYAN "%s\n" COL_NORMAL,
+                psserver->GetAuthServer()->GetLoginStats().GetData());
+    }
+    if(hasBeenReady)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Spatial grid     : " COL_CYAN "%s\n" COL_NORMAL,
+                psserver->entitymanager->GetGEM()->GetSpatialGridStats().GetData());
+        CPrintf(CON_CMDOUTPUT ,"Superclient sync : " COL_CYAN "%s\n" COL_NORMAL,
+                psserver->GetNPCManager()->GetWorldPositionStats().GetData());
+    }
+    if(psserver->GetItemSaveQueue())
+    {
+        CPrintf(CON_CMDOUTPUT ,"Item saves       : " COL_CYAN "%s\n" COL_NORMAL,
+                psserver->GetItemSaveQueue()->GetStats().GetData());
+    }
     CPrintf(CON_CMDOUTPUT ,COL_GREEN "%-5s %-7s %-25s %14s %10s %9s %s %s %s %s\n" COL_NORMAL,"EID","PID","Name","CNum","Ready","Time con.", "RTT", "Window filled", "Est. packet loss", "Packets sent");
 
     ClientConnectionSet* clients = psserver->GetNetManager()->GetConnections();
@@ -2545,6 +2844,8 @@ const COMMAND commands[] =
     { "-- Server commands",  true, NULL, "------------------------------------------------" },
     { "dbprofile",  true, com_dbprofile, "shows database profile info" },
     { "exec",      true, com_exec,      "Executes a script file" },
+    { "gembench",  false, com_gembench, "Times the stat updates of the GEM with copies of an NPC: gembench <npc pid> [copies] [rounds]" },
+    { "gridbench", false, com_gridbench, "Times proximity queries around copies of an NPC in its sector: gridbench <npc pid> [actors] [radius] [rounds]" },
     { "help",      true, com_help,      "Show help information" },
     { "kick",      true, com_kick,      "Kick player from the server"},
     { "queue",     true, com_queue,      "Get the size of a player queue"},
@@ -0,0 +1,124 @@
+/*
+ * drinterest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <iutil/cfgmgr.h>
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "drinterest.h"
+
+unsigned int DRInterest::sent[DR_TIER_COUNT];
+unsigned int DRInterest::folded[DR_TIER_COUNT];
+unsigned int DRInterest::flushed[DR_TIER_COUNT];
+
+// Watchers up to this distance are in the tier. The last tier takes the rest.
+float DRInterest::ranges[DR_TIER_COUNT] = { 25.0f, 50.0f, 0.0f };
+csTicks DRInterest::intervals[DR_TIER_COUNT] = { 0, 250, 1000 };
+
+DRInterest::DRInterest() : active(0), nextDue(0), anyPending(false)
+{
+}
+
+void DRInterest::Configure(iConfigManager* config)
+{
+    ranges[DR_TIER_NEAR] = config->GetFloat("PlaneShift.Server.DRTiers.NearRange", ranges[DR_TIER_NEAR]);
+    ranges[DR_TIER_MID] = config->GetFloat("PlaneShift.Server.DRTiers.MidRange", ranges[DR_TIER_MID]);
+    intervals[DR_TIER_MID] = config->GetInt("PlaneShift.Server.DRTiers.MidInterval", intervals[DR_TIER_MID]);
+    intervals[DR_TIER_FAR] = config->GetInt("PlaneShift.Server.DRTiers.FarInterval", intervals[DR_TIER_FAR]);
+}
+
+DRTier DRInterest::GetTier(float dist)
+{
+    if(dist <= ranges[DR_TIER_NEAR])
+        return DR_TIER_NEAR;
+    if(dist <= ranges[DR_TIER_MID])
+        return DR_TIER_MID;
+    return DR_TIER_FAR;
+}
+
+const char* DRInterest::GetTierName(DRTier tier)
+{
+    static const char* names[DR_TIER_COUNT] = { "near", "mid", "far" };
+    return names[tier];
+}
+
+void DRInterest::NextUpdate()
+{
+    active ^= 1;
+    watchers[active].DeleteAll();
+    anyPending = false;
+}
+
+bool DRInterest::Select(uint32_t client, DRTier tier, csTicks now, bool flush)
+{
+    Watcher watcher;
+    const Watcher* known = watchers[active ^ 1].GetElementPointer(client);
+    if(known)
+    {
+        watcher = *known;
+    }
+    else
+    {
+        // New watchers got the actor with its position just now.
+        watcher.lastSent = now - intervals[tier];
+        watcher.pending = false;
+    }
+
+    bool send = false;
+    if(flush && !watcher.pending)
+    {
+        // Up to date already.
+    }
+    else if(now - watcher.lastSent >= intervals[tier])
+    {
+        if(watcher.pending && flush)
+            flushed[tier]++;
+        else
+            sent[tier]++;
+        watcher.lastSent = now;
+        watcher.pending = false;
+        send = true;
+    }
+    else
+    {
+        if(!flush)
+            folded[tier]++;
+        watcher.pending = true;
+
+        csTicks due = watcher.lastSent + intervals[tier];
+        if(!anyPending || (int)(due - nextDue) < 0)
+            nextDue = due;
+        anyPending = true;
+    }
+
+    watchers[active].PutUnique(client, watcher);
+    return send;
+}
+
+csTicks DRInterest::GetFlushDelay(csTicks now) const
+{
+    if(!anyPending)
+        return 0;
+    // At least one tick, 0 means nothing is pending.
+    return csMax((int)(nextDue - now), 1);
+}
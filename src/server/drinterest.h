@@ -0,0 +1,114 @@
+/*
+ * drinterest.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __DRINTEREST_H__
+#define __DRINTEREST_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/hash.h>
+
+struct iConfigManager;
+
+/**
+ * \addtogroup server
+ * @{ */
+
+/// How often a watcher gets the DR updates of an actor.
+enum DRTier
+{
+    DR_TIER_NEAR,   ///< Every update
+    DR_TIER_MID,
+    DR_TIER_FAR,
+    DR_TIER_COUNT
+};
+
+/**
+ * Decides which watchers of an actor get a DR update.
+ *
+ * Watchers are put in tiers by distance and by how much the actor matters
+ * to them. Each tier has a shortest interval between two updates a watcher
+ * gets. An update a watcher can't get yet is folded into the next one it
+ * gets: DR updates carry the full state, so the watcher is marked pending
+ * and the actor sends it the latest state once the interval is over, even
+ * if the actor didn't move since.
+ */
+class DRInterest
+{
+public:
+    DRInterest();
+
+    /**
+     * Decide whether a watcher gets the update the actor is sending.
+     * Watchers that aren't asked about an update are forgotten.
+     *
+     * @param client The watcher.
+     * @param tier The tier of the watcher.
+     * @param now The current ticks.
+     * @param flush Only send to watchers with an update pending.
+     */
+    bool Select(uint32_t client, DRTier tier, csTicks now, bool flush);
+
+    /// Start the next update. Called before the watchers are selected.
+    void NextUpdate();
+
+    /**
+     * Ticks until the earliest pending watcher may get an update, 0 if
+     * none is pending. Valid after all watchers of an update were selected.
+     */
+    csTicks GetFlushDelay(csTicks now) const;
+
+    /// Read the tiers from the configuration.
+    static void Configure(iConfigManager* config);
+
+    /// The tier for a watcher at dist that the actor doesn't otherwise matter to.
+    static DRTier GetTier(float dist);
+
+    /// The names of the tiers for reports.
+    static const char* GetTierName(DRTier tier);
+
+    /// Updates sent per tier.
+    static unsigned int sent[DR_TIER_COUNT];
+    /// Updates folded into a later one per tier.
+    static unsigned int folded[DR_TIER_COUNT];
+    /// Pending updates sent by a flush per tier.
+    static unsigned int flushed[DR_TIER_COUNT];
+
+private:
+    struct Watcher
+    {
+        csTicks lastSent;
+        bool pending;
+    };
+
+    /// Watchers by update, swapped with each update.
+    csHash<Watcher, uint32_t> watchers[2];
+    size_t active;
+
+    /// Earliest time a pending watcher may get an update, if any is pending.
+    csTicks nextDue;
+    bool anyPending;
+
+    static float ranges[DR_TIER_COUNT];
+    static csTicks intervals[DR_TIER_COUNT];
+};
+
+/** @} */
+
+#endif
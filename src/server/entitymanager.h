@@ -164,6 +164,10 @@ public:
         return engine;
     }
 
+    psServerDR* GetServerDR()
+    {
+        return serverdr;
+    }
     ClientConnectionSet* GetClients()
     {
         return clients;
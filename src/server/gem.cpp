@@ -140,6 +140,7 @@ GEMSupervisor::GEMSupervisor(iObjectRegistry* objreg,
     // Default celID scope has max of 100000 IDs so to support more than
     // 90000 enties another scope should be added to cel
     nextEID = 10000;
+    superclientSectorsChanged = true;
 
     Subscribe(&GEMSupervisor::HandleDamageMessage,MSGTYPE_DAMAGE_EVENT,NO_VALIDATION);
     Subscribe(&GEMSupervisor::HandleStatDRUpdateMessage,MSGTYPE_STATDRUPDATE, REQUIRE_READY_CLIENT);
@@ -148,6 +149,24 @@ GEMSupervisor::GEMSupervisor(iObjectRegistry* objreg,
     engine = csQueryRegistry<iEngine> (psserver->GetObjectReg());
 }
 
+size_t GEMActorTable::Add(gemActor* actor)
+{
+    moving.Push(false);
+    // The first update sends all stats.
+    statsDue.Push(true);
+    return actors.Push(actor);
+}
+
+gemActor* GEMActorTable::Remove(size_t index)
+{
+    actors.DeleteIndexFast(index);
+    moving.DeleteIndexFast(index);
+    statsDue.DeleteIndexFast(index);
+    return index < actors.GetSize() ? actors[index] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+
 GEMSupervisor::~GEMSupervisor()
 {
     // Slow but safe method of deleting.
@@ -222,21 +241,26 @@ void GEMSupervisor::AddEntity(gemObject* obj, EID objEid)
     Debug3(LOG_CELPERSIST,0,"Entity <%s> added to supervisor as %s\n", obj->GetName(), ShowID(objEid));
 }
 
-void GEMSupervisor::AddActorEntity(gemActor* actor)
+void GEMSupervisor::AddActorEntity(gemActor* actor, bool player)
 {
     actors_by_pid.Put(actor->GetPID(), actor);
+    GEMListType type = player ? GEM_LIST_PLAYERS : GEM_LIST_NPCS;
+    actor->SetGEMListEntry(type, GetActorTable(type)->Add(actor));
     Debug3(LOG_CELPERSIST,0,"Actor added to supervisor with %s and %s.\n", ShowID(actor->GetEID()), ShowID(actor->GetPID()));
 }
 
 void GEMSupervisor::RemoveActorEntity(gemActor* actor)
 {
     actors_by_pid.Delete(actor->GetPID(), actor);
+    RemoveFromList(actor);
     Debug3(LOG_CELPERSIST,0,"Actor <%s, %s> removed from supervisor.\n", ShowID(actor->GetEID()), ShowID(actor->GetPID()));
 }
 
 void GEMSupervisor::AddItemEntity(gemItem* item)
 {
     items_by_uid.Put(item->GetItem()->GetUID(), item);
+    if(item->GetGEMListType() == GEM_LIST_NONE)
+        item->SetGEMListEntry(GEM_LIST_ITEMS, itemList.Push(item));
     Debug3(LOG_CELPERSIST,0,"Item added to supervisor with %s and UID:%u.\n", ShowID(item->GetEID()), item->GetItem()->GetUID());
 }
 
@@ -246,23 +270,64 @@ void GEMSupervisor::RemoveItemEntity(gemItem* item, uint32 uid)
     Debug3(LOG_CELPERSIST,0,"Item <%s, %u> removed from supervisor.\n", ShowID(item->GetEID()), uid);
 }
 
+void GEMSupervisor::RemoveFromList(gemObject* obj)
+{
+    size_t index = obj->GetGEMListIndex();
+    gemObject* moved = NULL;
+    switch(obj->GetGEMListType())
+    {
+        case GEM_LIST_NONE:
+            return;
+        case GEM_LIST_PLAYERS:
+        case GEM_LIST_NPCS:
+            moved = GetActorTable(obj->GetGEMListType())->Remove(index);
+            break;
+        case GEM_LIST_ITEMS:
+            itemList.DeleteIndexFast(index);
+            if(index < itemList.GetSize())
+                moved = itemList[index];
+            break;
+    }
+
+    // The last one of the list took its place.
+    if(moved)
+        moved->SetGEMListEntry(moved->GetGEMListType(), index);
+    obj->SetGEMListEntry(GEM_LIST_NONE, 0);
+}
+
+GEMActorTable* GEMSupervisor::GetActorTable(GEMListType type)
+{
+    switch(type)
+    {
+        case GEM_LIST_PLAYERS:
+            return &players;
+        case GEM_LIST_NPCS:
+            return &npcActors;
+        default:
+            return NULL;
+    }
+}
+
 void GEMSupervisor::RemoveEntity(gemObject* which)
 {
     if(!which)
         return;
 
     entities_by_eid.Delete(which->GetEID(), which);
+    spatialGrid.Remove(which);
+    RemoveFromList(which);
+    unsyncedActors.DeleteAll(which->GetEID());
+    if(which->GetSuperclientID().IsValid())
+        superclientSectorsChanged = true;
     Debug3(LOG_CELPERSIST,0,"Entity <%s, %s> removed from supervisor.\n", which->GetName(), ShowID(which->GetEID()));
 
 }
 
 void GEMSupervisor::RemovePlayerFromLootables(PID playerID)
 {
-    csHash<gemObject*, EID>::GlobalIterator i(entities_by_eid.GetIterator());
-    while(i.HasNext())
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
     {
-        gemObject* obj = i.Next();
-        gemNPC* npc = obj->GetNPCPtr();
+        gemNPC* npc = npcActors.GetActor(i)->GetNPCPtr();
 
         if(npc)
             npc->RemoveLootablePlayer(playerID);
@@ -320,12 +385,10 @@ gemItem* GEMSupervisor::FindItemEntity(uint32 item_id)
 
 int GEMSupervisor::CountManagedNPCs(AccountID superclientID)
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
     int count=0;
-    while(iter.HasNext())
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
     {
-        gemObject* obj = iter.Next();
+        gemActor* obj = npcActors.GetActor(i);
         if(obj->GetSuperclientID() == superclientID)
         {
             count++;
@@ -336,11 +399,9 @@ int GEMSupervisor::CountManagedNPCs(AccountID superclientID)
 
 void GEMSupervisor::FillNPCList(MsgEntry* msg, AccountID superclientID)
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
-    while(iter.HasNext())
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
     {
-        gemObject* obj = iter.Next();
+        gemActor* obj = npcActors.GetActor(i);
         if(obj->GetSuperclientID() == superclientID)
         {
             msg->Add(obj->GetPID().Unbox());
@@ -363,11 +424,9 @@ void GEMSupervisor::SendAllNPCStats(AccountID superclientID)
 
 void GEMSupervisor::ActivateNPCs(AccountID superclientID)
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
-    while(iter.HasNext())
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
     {
-        gemObject* obj = iter.Next();
+        gemActor* obj = npcActors.GetActor(i);
         if(obj->GetSuperclientID() == superclientID)
         {
             // Turn off any npcs about to be managed from being temporarily impervious
@@ -380,15 +439,12 @@ void GEMSupervisor::StopAllNPCs(AccountID superclientID)
 {
     CPrintf(CON_NOTIFY, "Shutting down entities managed by superclient %s.\n", ShowID(superclientID));
 
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
-    while(iter.HasNext())
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
     {
-        gemObject* obj = iter.Next();
-        if(obj->GetSuperclientID() == superclientID && obj->IsAlive())
+        gemActor* actor = npcActors.GetActor(i);
+        if(actor->GetSuperclientID() == superclientID && actor->IsAlive())
         {
-            // CPrintf(CON_DEBUG, "  Deactivating %s...\n",obj->GetName() );
-            gemActor* actor = obj->GetActorPtr();
+            // CPrintf(CON_DEBUG, "  Deactivating %s...\n",actor->GetName() );
             actor->pcmove->SetVelocity(csVector3(0,0,0));
             actor->pcmove->SetAngularVelocity(csVector3(0,0,0));
             actor->pcmove->SetOnGround(true);
@@ -407,41 +463,80 @@ void GEMSupervisor::StopAllNPCs(AccountID superclientID)
 
 void GEMSupervisor::UpdateAllDR()
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
-    while(iter.HasNext())
+    GEMActorTable* tables[] = { &players, &npcActors };
+    for(size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
     {
-        gemObject* obj = iter.Next();
-        if(obj->GetPID().IsValid())
+        GEMActorTable &table = *tables[t];
+        for(size_t i = 0; i < table.GetSize(); i++)
         {
-            obj->UpdateDR();
+            if(!table.IsMoving(i))
+                continue;
+
+            gemActor* actor = table.GetActor(i);
+            actor->UpdateDR();
+            table.SetMoving(i, actor->pcmove->IsMoving());
         }
     }
 }
 
+void GEMSupervisor::MarkMoving(gemActor* actor)
+{
+    GEMActorTable* table = GetActorTable(actor->GetGEMListType());
+    if(table && actor->pcmove->IsMoving())
+    {
+        table->SetMoving(actor->GetGEMListIndex(), true);
+    }
+}
+
 void GEMSupervisor::UpdateAllStats()
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
+    csTicks now = csGetTicks();
 
-    while(iter.HasNext())
+    GEMActorTable* tables[] = { &players, &npcActors };
+    for(size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
     {
-        gemObject* obj = iter.Next();
-        gemActor* actor = dynamic_cast<gemActor*>(obj);
-        if(actor)
+        GEMActorTable &table = *tables[t];
+
+        // Backwards, as killing an actor may remove others and the last
+        // actors take their places.
+        for(size_t i = table.GetSize(); i-- > 0;)
         {
-            actor->UpdateStats();
+            if(i >= table.GetSize() || !table.IsStatsDue(i))
+                continue;
+
+            gemActor* actor = table.GetActor(i);
+            psCharacter* character = actor->GetCharacterData();
+            if(character && character->UpdateStatDRData(now))
+            {
+                // There are dirty stats that need to be published
+                actor->SendGroupStats();
+            }
+
+            if(character && character->NeedsStatDRUpdate())
+                continue;
+
+            GEMActorTable* current = GetActorTable(actor->GetGEMListType());
+            if(current)
+                current->SetStatsDue(actor->GetGEMListIndex(), false);
         }
     }
 }
 
+void GEMSupervisor::QueueStatsUpdate(gemActor* actor)
+{
+    GEMActorTable* table = GetActorTable(actor->GetGEMListType());
+    if(table)
+    {
+        table->SetStatsDue(actor->GetGEMListIndex(), true);
+    }
+}
+
 void GEMSupervisor::GetPlayerObjects(PID playerID, csArray<gemObject*> &list)
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-    while(iter.HasNext())
+    for(size_t i = 0; i < itemList.GetSize(); i++)
     {
-        gemObject* obj = iter.Next();
-        gemItem* item = dynamic_cast<gemItem*>(obj);
-        if(item && item->GetItem()->GetOwningCharacterID() == playerID)
+        gemItem* item = itemList[i];
+        if(item->GetItem()->GetOwningCharacterID() == playerID)
         {
             list.Push(item);
         }
@@ -449,68 +544,89 @@ void GEMSupervisor::GetPlayerObjects(PID playerID, csArray<gemObject*> &list)
 }
 
 
-void GEMSupervisor::GetAllEntityPos(csArray<psAllEntityPosMessage> &update)
+void GEMSupervisor::GetChangedEntityPos(csArray<SuperclientPos> &changed)
 {
-    csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
-
     csTicks now = csGetTicks();
+    csArray<EID> synced;
 
-    // Loop as long as we need to send more messages.
+    csHash<gemActor*, EID>::GlobalIterator iter(unsyncedActors.GetIterator());
     while(iter.HasNext())
     {
-        psAllEntityPosMessage msg;
-        msg.SetLength(ALLENTITYPOS_MAX_AMOUNT,0); // Set a message length limit
+        EID eid;
+        gemActor* actor = iter.Next(eid);
+
+        SuperclientPos entry;
+        csVector3 lastPos;
+        InstanceID lastInstance;
+        csTicks last;
+        float yrot;
+        actor->GetPosition(entry.pos, yrot, entry.sector);
+        entry.instance = actor->GetInstance();
+        entry.eid = eid;
+        actor->GetLastSuperclientPos(lastPos, entry.oldSector, lastInstance, last);
 
-        // Fill the message
-        int count_actual = 0;
-        while(iter.HasNext())
+        float dist2 = (entry.pos - lastPos).SquaredNorm();
+        bool relocated = entry.instance != lastInstance || entry.sector != entry.oldSector;
+
+        // We need to filter some to prevent overloading the network
+        if((dist2 > 1.0) || (dist2 > .04 && now - last > 2000) || relocated)
         {
-            gemObject* obj = iter.Next();
-            if(obj->GetPID().IsValid())
-            {
-                gemActor* actor = dynamic_cast<gemActor*>(obj);
-                // FIXME: Now only distribute players, this should
-                //        be modify to send all actors exepct
-                //        NPCs controlled by the receving superclient.
-                if(actor && actor->GetClient())
-                {
-                    csVector3 pos,pos2;
-                    float yrot;
-                    InstanceID instance,oldInstance;
-                    iSector* sector;
-                    csTicks last;
-                    obj->GetPosition(pos,yrot,sector);
-                    instance = obj->GetInstance();
-                    obj->GetLastSuperclientPos(pos2,oldInstance,last);
-
-                    float dist2 = (pos.x - pos2.x) * (pos.x - pos2.x) +
-                                  (pos.y - pos2.y) * (pos.y - pos2.y) +
-                                  (pos.z - pos2.z) * (pos.z - pos2.z);
-
-                    csTicks time = now - last;
-
-                    // We need to filter some to prevent overloading the network
-                    if((dist2 > 1.0) || (dist2 > .04 && time > 2000) || (instance != oldInstance))
-                    {
-                        count_actual++;
-                        msg.Add(obj->GetEID(), pos, sector, obj->GetInstance(),
-                                cacheManager->GetMsgStrings());
-                        obj->SetLastSuperclientPos(pos,instance,now);
-                    }
-                }
-            }
-            if(count_actual == ALLENTITYPOS_MAX_AMOUNT) //we reached message limit so we break out of here
-                break;
+            changed.Push(entry);
+            actor->SetLastSuperclientPos(entry.pos, entry.sector, entry.instance, now);
+            if(!actor->pcmove->IsMoving())
+                synced.Push(eid);
         }
-        msg.msg->ClipToCurrentSize();  // Actual Data size
-        msg.msg->Reset();
-        // Now correct the first value, which is the count of following entities
-        // SetLength has allready allocated the int16_t for this.
-        msg.msg->Add((int16_t)count_actual);
-        update.Push(msg);
+        else if(dist2 <= .04 && !actor->pcmove->IsMoving())
+        {
+            // Close enough to what the superclients have, until it moves again.
+            synced.Push(eid);
+        }
+    }
+
+    for(size_t i = 0; i < synced.GetSize(); i++)
+    {
+        unsyncedActors.DeleteAll(synced[i]);
     }
 }
 
+bool GEMSupervisor::GetSuperclientSectors(csHash<csSet<csPtrKey<iSector> >, AccountID> &sectors)
+{
+    if(!superclientSectorsChanged)
+        return false;
+    superclientSectorsChanged = false;
+
+    sectors.DeleteAll();
+    for(size_t i = 0; i < npcActors.GetSize(); i++)
+    {
+        gemActor* obj = npcActors.GetActor(i);
+        AccountID superclientID = obj->GetSuperclientID();
+        if(!superclientID.IsValid())
+            continue;
+
+        iSector* sector = obj->GetSector();
+        if(!sector)
+            continue;
+
+        csSet<csPtrKey<iSector> >* set = sectors.GetElementPointer(superclientID);
+        if(!set)
+        {
+            sectors.Put(superclientID, csSet<csPtrKey<iSector> >());
+            set = sectors.GetElementPointer(superclientID);
+        }
+        if(set->Contains(sector))
+            continue;
+
+        set->Add(sector);
+        csArray<iSector*> neighbours;
+        spatialGrid.FindNeighbours(sector, neighbours);
+        for(size_t j = 0; j < neighbours.GetSize(); j++)
+        {
+            set->Add(neighbours[j]);
+        }
+    }
+    return true;
+}
+
 void GEMSupervisor::AttachObject(iObject* object, gemObject* gobject)
 {
     csRef<psGemServerMeshAttach> attacher;
@@ -551,29 +667,49 @@ csArray<gemObject*> GEMSupervisor::FindNearbyEntities(iSector* sector, const csV
 {
     csArray<gemObject*> list;
 
-    csRef<iMeshWrapperIterator> obj_it =  engine->GetNearbyMeshes(sector, pos, radius);
-    while(obj_it->HasNext())
+    // The grid already filters by instance and distance.
+    spatialGrid.FindNearby(sector, pos, instance, radius, list);
+
+    if(!doInvisible)
     {
-        iMeshWrapper* m = obj_it->Next();
-        if(!doInvisible)
+        size_t i = 0;
+        while(i < list.GetSize())
         {
-            bool invisible = m->GetFlags().Check(CS_ENTITY_INVISIBLE);
-            if(invisible)
+            iMeshWrapper* m = list[i]->GetMeshWrapper();
+            if(!m || m->GetFlags().Check(CS_ENTITY_INVISIBLE))
+            {
+                list.DeleteIndexFast(i);
                 continue;
-        }
-
-        gemObject* object = FindAttachedObject(m->QueryObject());
-
-        if(object && (object->GetInstance() == instance ||
-           object->GetInstance() == INSTANCE_ALL || instance == INSTANCE_ALL))
-        {
-            list.Push(object);
+            }
+            i++;
         }
     }
 
     return list;
 }
 
+void GEMSupervisor::UpdateEntityPosition(gemObject* obj)
+{
+    if(!obj->GetEID().IsValid() || !obj->GetMeshWrapper())
+        return;
+
+    csVector3 pos;
+    iSector* sector;
+    obj->GetPosition(pos, sector);
+    bool sectorChanged = spatialGrid.Update(obj, sector, obj->GetInstance(), pos);
+
+    if(obj->GetClient())
+    {
+        gemActor* actor = obj->GetActorPtr();
+        if(actor)
+            unsyncedActors.PutUnique(obj->GetEID(), actor);
+    }
+    else if(sectorChanged && obj->GetSuperclientID().IsValid())
+    {
+        superclientSectorsChanged = true;
+    }
+}
+
 csArray<gemObject*> GEMSupervisor::FindSectorEntities(iSector* sector, bool doInvisible)
 {
     csArray<gemObject*> list;
@@ -636,6 +772,8 @@ gemObject::gemObject(GEMSupervisor* gemsupervisor,
     proxlist = NULL;
     is_alive = false;
     alwaysWatching = false;
+    gemListType = GEM_LIST_NONE;
+    gemListIndex = 0;
 
     eid = cel->CreateEntity(this);
 
@@ -794,6 +932,7 @@ iMeshWrapper* gemObject::GetMeshWrapper()
 void gemObject::Move(const csVector3 &pos,float rotangle, iSector* room)
 {
     pcmesh->MoveMesh(room, rotangle, pos);
+    cel->UpdateEntityPosition(this);
 }
 
 bool gemObject::IsNear(gemObject* obj, float radius, bool ignoreY)
@@ -960,41 +1099,32 @@ void gemObject::UpdateProxList(bool force)
         }
     }
 
-    // Now remove those that should be no more connected to out object
-
-    gemObject* obj;
+    // Now remove those that should be no more connected to out object.
+    // Both lists are collected in one sweep before any relation is ended.
+    csArray<gemObject*> watched;
+    csArray<gemObject*> watchers;
+    proxlist->GetUntouched(watched, watchers);
 
-    size_t debug_count = 0;
+    size_t debug_count = watched.GetSize();
     if(GetClientID() != 0)
     {
-        while(proxlist->GetUntouched_ObjectThatIWatch(obj))
+        for(size_t i = 0; i < watched.GetSize(); i++)
         {
-            debug_count++;
+            gemObject* obj = watched[i];
 #ifdef PSPROXDEBUG
             log.AppendFmt("-removing %s from client %s\n",obj->GetName(),GetName());
 #endif
             CS_ASSERT(obj != this);
 
-            //               csVector3 pos; float yrot; iSector *sector;
-            //               obj->GetPosition(pos,yrot,sector);
-            //                CPrintf(CON_SPAM, "Removing %s at (%1.2f, %1.2f, %1.2f) in sector %s.\n",obj->GetName(),pos.x,pos.y,pos.z,sector->QueryObject()->GetName() );
-
             psRemoveObject remove(GetClientID(), obj->GetEID());
             remove.SendMessage();
             proxlist->EndWatching(obj);
         }
     }
 
-    if(csGetTicks() - time > 500 || player_count > 100)
-    {
-        csString status;
-        status.Format("Warning: Spent %u time getting untouched objects in proxlist for %s, %zu nearby entities, distance %g, location: %g %g %g %s!",
-                      csGetTicks() - time, GetName(), player_count, prox_distance_current, pos.x, pos.y, pos.z, (const char*)sector->QueryObject()->GetName());
-        psserver->GetLogCSV()->Write(CSV_STATUS, status);
-    }
-
-    while(proxlist->GetUntouched_ObjectThatWatchesMe(obj))
+    for(size_t i = 0; i < watchers.GetSize(); i++)
     {
+        gemObject* obj = watchers[i];
         if(obj->GetClientID() != 0)
         {
 #ifdef PSPROXDEBUG
@@ -1268,6 +1398,12 @@ double gemItem::GetProperty(MathEnvironment* env, const char* prop)
     return itemdata->GetProperty(env, prop);
 }
 
+double gemItem::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    CS_ASSERT(itemdata);
+    return itemdata->GetPropertyByID(env, id);
+}
+
 double gemItem::CalcFunction(MathEnvironment* env, const char* f, const double* params)
 {
     CS_ASSERT(itemdata);
@@ -2177,8 +2313,8 @@ gemActor::gemActor(GEMSupervisor* gemsupervisor, CacheManager* cachemanager, Ent
                    float rotangle,
                    int clientnum) :
     gemObject(gemsupervisor,entitymanager,cachemanager,chardata->GetCharFullName(),factname,myInstance,room,pos,rotangle,clientnum),
-    psChar(chardata), mount(NULL), attack_cnt(0), DRcounter(0), forceDRcounter(0), lastDR(0), lastV(0), lastSentSuperclientPos(0, 0, 0),
-    lastSentSuperclientInstance(-1), activeReports(0), isFalling(false), invincible(false), visible(true), viewAllObjects(false),
+    psChar(chardata), mount(NULL), attack_cnt(0), DRcounter(0), forceDRcounter(0), drFlushQueued(false), lastDR(0), lastV(0), lastSentSuperclientPos(0, 0, 0),
+    lastSentSuperclientSector(NULL), lastSentSuperclientInstance(-1), activeReports(0), isFalling(false), invincible(false), visible(true), viewAllObjects(false),
     movementMode(0), isAllowedToMove(true), atRest(true), player_mode(PSCHARACTER_MODE_PEACE), spellCasting(NULL), workEvent(NULL),
     activeMagic_seq(0), pcmove(NULL), nevertired(false), infinitemana(false), instantcast(false), safefall(false), givekillexp(false),
     attackable(false)
@@ -2188,7 +2324,7 @@ gemActor::gemActor(GEMSupervisor* gemsupervisor, CacheManager* cachemanager, Ent
 
     pid = chardata->GetPID();
 
-    cel->AddActorEntity(this);
+    cel->AddActorEntity(this, clientnum != 0);
     isFrozen.Initialize(this);
     SetFrozen(false);
 
@@ -2264,36 +2400,49 @@ gemActor::~gemActor()
     delete pcmove;
 }
 
+// Properties scripts can read, see GetPropertyByID(). Matched case insensitive.
+#define GEMACTOR_PROPERTIES(PROPERTY) \
+    PROPERTY(stamina_drain_p) PROPERTY(stamina_drain_m) PROPERTY(attack_speed_mod) PROPERTY(attack_damage_mod) \
+    PROPERTY(defense_avoid_mod) PROPERTY(defense_absorb_mod) PROPERTY(combatstance) PROPERTY(isadvisorbanned) \
+    PROPERTY(advisorpoints)
+
+enum { GEMACTOR_PROPERTIES(MATH_PROPERTY_ENUM) };
+static const char* gemActorProperties[] = { GEMACTOR_PROPERTIES(MATH_PROPERTY_NAME) };
+
 double gemActor::GetProperty(MathEnvironment* env, const char* prop)
 {
-    if(!strcasecmp(prop, "stamina_drain_p"))
-        return combat_stance.stamina_drain_P;
-    if(!strcasecmp(prop, "stamina_drain_m"))
-        return combat_stance.stamina_drain_M;
-    if(!strcasecmp(prop, "attack_speed_mod"))
-        return combat_stance.attack_speed_mod;
-    if(!strcasecmp(prop, "attack_damage_mod"))
-        return combat_stance.attack_damage_mod;
-    if(!strcasecmp(prop, "defense_avoid_mod"))
-        return combat_stance.defense_avoid_mod;
-    if(!strcasecmp(prop, "defense_absorb_mod"))
-        return combat_stance.defense_absorb_mod;
-    if(!strcasecmp(prop, "combatstance"))
-    {
-        // Backwards compatibility.
-        return combat_stance.stance_id;
-    }
-    if(!strcasecmp(prop, "isadvisorbanned"))
-    {
-        return (double)(GetClient() ? GetClient()->IsAdvisorBanned() : true);
-    }
-    if(!strcasecmp(prop, "advisorpoints"))
+    return GetPropertyByID(env, MathScriptEngine::GetPropertyID(prop));
+}
+
+double gemActor::GetPropertyByID(MathEnvironment* env, PropertyID id)
+{
+    static MathPropertyIndex properties(gemActorProperties, sizeof(gemActorProperties)/sizeof(gemActorProperties[0]), false);
+
+    switch(properties.Find(id))
     {
-        return (double)(GetClient() ? GetClient()->GetAdvisorPoints() : 0);
+        case PROP_stamina_drain_p:
+            return combat_stance.stamina_drain_P;
+        case PROP_stamina_drain_m:
+            return combat_stance.stamina_drain_M;
+        case PROP_attack_speed_mod:
+            return combat_stance.attack_speed_mod;
+        case PROP_attack_damage_mod:
+            return combat_stance.attack_damage_mod;
+        case PROP_defense_avoid_mod:
+            return combat_stance.defense_avoid_mod;
+        case PROP_defense_absorb_mod:
+            return combat_stance.defense_absorb_mod;
+        case PROP_combatstance:
+            // Backwards compatibility.
+            return combat_stance.stance_id;
+        case PROP_isadvisorbanned:
+            return (double)(GetClient() ? GetClient()->IsAdvisorBanned() : true);
+        case PROP_advisorpoints:
+            return (double)(GetClient() ? GetClient()->GetAdvisorPoints() : 0);
     }
 
     CS_ASSERT(psChar);
-    return psChar->GetProperty(env, prop);
+    return psChar->GetPropertyByID(env, id);
 }
 
 double gemActor::CalcFunction(MathEnvironment* env, const char* f, const double* params)
@@ -3166,6 +3315,10 @@ bool gemActor::Send(int clientnum, bool control, bool to_superclients, psPersist
         }
     }
 
+    // The client creates the entity anew, without a keyframe to decode deltas against.
+    if(clientnum && !to_superclients)
+        drEncoder.Forget(clientnum);
+
     psPersistActor mesg(clientnum,
                         securityLevel,
                         masqueradeLevel,
@@ -3760,6 +3913,7 @@ void gemActor::SetDefaults(bool player)
 void gemActor::SetInstance(InstanceID worldInstance)
 {
     this->worldInstance = worldInstance;
+    cel->UpdateEntityPosition(this);
 }
 
 void gemActor::Teleport(const char* sectorName, const csVector3 &pos, float yrot, InstanceID instance, int32_t loadDelay, csString background, csVector2 point1, csVector2 point2, csString widget)
@@ -3994,7 +4148,10 @@ bool gemActor::SetDRData(psDRMessage &drmsg)
         }
     }
     pcmove->SetDRData(drmsg.on_ground,drmsg.pos,drmsg.yrot,drmsg.sector,drmsg.vel,drmsg.worldVel,drmsg.ang_vel);
+    cel->UpdateEntityPosition(this);
+    cel->MarkMoving(this);
     DRcounter = drmsg.counter;
+    movementMode = drmsg.mode;
 
 
     // Apply stamina only on PCs
@@ -4070,17 +4227,106 @@ void gemActor::GetPrevTeleportLocation(csVector3 &pos, float &yrot, iSector* &se
     instance = prev_teleport_location.instance;
 }
 
-void gemActor::MulticastDRUpdate()
+void gemActor::MulticastDRUpdate(uint32_t except)
 {
-    bool on_ground;
-    float yrot,ang_vel;
-    csVector3 pos,vel,worldVel;
-    iSector* sector;
-    pcmove->GetDRData(on_ground,pos,yrot,sector,vel,worldVel,ang_vel);
-    psDRMessage drmsg(0, eid, on_ground, movementMode, DRcounter,
-                      pos,yrot,sector, "", vel,worldVel,ang_vel,
-                      psserver->GetNetManager()->GetAccessPointers());
-    drmsg.Multicast(GetMulticastClients(),0,PROX_LIST_ANY_RANGE);
+    SendDRUpdate(false, except);
+}
+
+void gemActor::FlushDRUpdate()
+{
+    drFlushQueued = false;
+    SendDRUpdate(true);
+}
+
+DRTier gemActor::GetDRTier(Client* watcher, float dist)
+{
+    gemActor* watcherActor = watcher->GetActor();
+    if(!watcherActor || watcherActor == this)
+        return DR_TIER_NEAR;
+
+    // Whoever the actor deals with follows it closely, wherever it is.
+    if(watcherActor->GetTargetObject() == this || GetTargetObject() == watcherActor ||
+            IsGroupedWith(watcherActor))
+        return DR_TIER_NEAR;
+
+    DRTier tier = DRInterest::GetTier(dist);
+    if(tier != DR_TIER_NEAR &&
+            (GetMode() == PSCHARACTER_MODE_COMBAT || watcherActor->GetMode() == PSCHARACTER_MODE_COMBAT))
+        tier = (DRTier)(tier - 1);
+    return tier;
+}
+
+void gemActor::SendDRUpdate(bool flush, uint32_t except)
+{
+    psDRUpdate update;
+    pcmove->GetDRData(update.on_ground,update.pos,update.yrot,update.sector,update.vel,update.worldVel,update.ang_vel);
+    update.mode = movementMode;
+    drEncoder.Update(update);
+    if(!flush)
+        psserver->entitymanager->GetServerDR()->Record(eid, DRcounter, update);
+
+    // Clients that take compact updates get the keyframe or a delta against
+    // it, older ones the full update. Watchers in the slower tiers only get
+    // it if their last one is long enough ago.
+    csTicks now = csGetTicks();
+    drInterest.NextUpdate();
+    csArray<PublishDestination> &multi = GetMulticastClients();
+    csArray<PublishDestination> full, keyframes, deltas;
+    for(size_t i = 0; i < multi.GetSize(); i++)
+    {
+        Client* client = psserver->GetConnections()->Find(multi[i].client);
+        if(!client || !client->IsReady())
+            continue;
+
+        if(!drInterest.Select(multi[i].client, GetDRTier(client, multi[i].dist), now, flush))
+        {
+            drEncoder.Keep(multi[i].client);
+            continue;
+        }
+
+        // The client the update came from has it already.
+        if(multi[i].client == except)
+        {
+            drEncoder.Keep(multi[i].client);
+            continue;
+        }
+
+        if(!client->HasNetCapability(NETCAP_COMPACT_DR))
+            full.Push(multi[i]);
+        else if(drEncoder.NeedsKeyframe(multi[i].client))
+            keyframes.Push(multi[i]);
+        else
+            deltas.Push(multi[i]);
+    }
+
+    NetBase::AccessPointers* accessPointers = psserver->GetNetManager()->GetAccessPointers();
+    if(full.GetSize())
+    {
+        psDRMessage drmsg(0, eid, update.on_ground, movementMode, DRcounter,
+                          update.pos,update.yrot,update.sector, "", update.vel,update.worldVel,update.ang_vel,
+                          accessPointers);
+        drmsg.Multicast(full,0,PROX_LIST_ANY_RANGE);
+    }
+    if(keyframes.GetSize())
+    {
+        psDRCompactMessage drmsg(0, eid, DRcounter, drEncoder, true, accessPointers);
+        drmsg.Multicast(keyframes,0,PROX_LIST_ANY_RANGE);
+    }
+    if(deltas.GetSize())
+    {
+        psDRCompactMessage drmsg(0, eid, DRcounter, drEncoder, false, accessPointers);
+        drmsg.Multicast(deltas,0,PROX_LIST_ANY_RANGE);
+    }
+
+    // The folded updates go out with the next one, or with a flush if the
+    // actor stays put until then.
+    csTicks delay = drInterest.GetFlushDelay(now);
+    if(delay && !drFlushQueued)
+    {
+        psDRFlushEvent* event = new psDRFlushEvent(delay, this);
+        event->QueueEvent();
+        drFlushQueued = true;
+    }
 }
 
 void gemActor::ForcePositionUpdate(int32_t loadDelay, csString background, csVector2 point1, csVector2 point2, csString widget)
@@ -4100,19 +4346,22 @@ bool gemActor::UpdateDR()
     pcmove->SetOnGround(true);
     pcmove->UpdateDR();
     pcmove->SetOnGround(on_ground);
+    cel->UpdateEntityPosition(this);
     return true;
 }
 
-void gemActor::GetLastSuperclientPos(csVector3 &pos, InstanceID &instance, csTicks &last) const
+void gemActor::GetLastSuperclientPos(csVector3 &pos, iSector* &sector, InstanceID &instance, csTicks &last) const
 {
     pos = lastSentSuperclientPos;
+    sector = lastSentSuperclientSector;
     instance = lastSentSuperclientInstance;
     last = lastSentSuperclientTick;
 }
 
-void gemActor::SetLastSuperclientPos(const csVector3 &pos, InstanceID instance, const csTicks &now)
+void gemActor::SetLastSuperclientPos(const csVector3 &pos, iSector* sector, InstanceID instance, const csTicks &now)
 {
     lastSentSuperclientPos = pos;
+    lastSentSuperclientSector = sector;
     lastSentSuperclientInstance = instance;
     lastSentSuperclientTick = now;
 }
@@ -5245,6 +5494,10 @@ bool gemNPC::Send(int clientnum, bool control, bool to_superclients, psPersistAl
                                                              flags |= psPersistActor::NAMEKNOWN;*/
     }
 
+    // The client creates the entity anew, without a keyframe to decode deltas against.
+    if(clientnum && !to_superclients)
+        drEncoder.Forget(clientnum);
+
     psPersistActor mesg(
         clientnum,
         securityLevel,
@@ -31,6 +31,7 @@
 #include <csutil/csobject.h>
 #include <csutil/csstring.h>
 #include <csutil/hash.h>
+#include <csutil/set.h>
 #include <csutil/weakreferenced.h>
 
 //=============================================================================
@@ -44,12 +45,15 @@
 #include "util/consoleout.h"
 
 #include "net/npcmessages.h"  // required for psNPCCommandsMessage::PerceptionType
+#include "net/drmessages.h"
 
 //=============================================================================
 // Local Space Includes
 //=============================================================================
 #include "msgmanager.h"
 #include "deathcallback.h"
+#include "spatialgrid.h"
+#include "drinterest.h"
 
 struct iMeshWrapper;
 
@@ -120,6 +124,76 @@ private:
     gemObject* object;          ///< The object that is attached to a iMeshWrapper object.
 };
 
+/// A player position the superclients don't have yet.
+struct SuperclientPos
+{
+    EID eid;
+    csVector3 pos;
+    iSector* sector;
+    InstanceID instance;
+    iSector* oldSector;     ///< Where the superclients saw the player last
+};
+
+/// The lists by type the GEM keeps entities in.
+enum GEMListType
+{
+    GEM_LIST_NONE,
+    GEM_LIST_PLAYERS,
+    GEM_LIST_NPCS,              ///< Actors without a client
+    GEM_LIST_ITEMS
+};
+
+/**
+ * Actors of one list type, kept densely so the GEM can loop over them
+ * without going through the entity hash and casting. The flags the
+ * UpdateAllDR() and UpdateAllStats() loops scan are columns of their own,
+ * so they only reach the actors that have something to do. The vitals
+ * themselves stay with the character, see psServerVitals. Actors are
+ * removed by moving the last one into their place.
+ */
+class GEMActorTable
+{
+public:
+    size_t GetSize() const
+    {
+        return actors.GetSize();
+    }
+    gemActor* GetActor(size_t index) const
+    {
+        return actors[index];
+    }
+    /// Whether DR moves the actor, see GEMSupervisor::MarkMoving().
+    bool IsMoving(size_t index) const
+    {
+        return moving[index];
+    }
+    void SetMoving(size_t index, bool isMoving)
+    {
+        moving[index] = isMoving;
+    }
+
+    /// Whether the vitals need an update, see GEMSupervisor::QueueStatsUpdate().
+    bool IsStatsDue(size_t index) const
+    {
+        return statsDue[index];
+    }
+    void SetStatsDue(size_t index, bool isDue)
+    {
+        statsDue[index] = isDue;
+    }
+
+    /// @return The index of the actor.
+    size_t Add(gemActor* actor);
+
+    /// @return The actor that was moved to index, or NULL if it was the last.
+    gemActor* Remove(size_t index);
+
+private:
+    csArray<gemActor*> actors;
+    csArray<bool> moving;
+    csArray<bool> statsDue;
+};
+
 /**
 * This class holds the refs to the core factories, etc in CEL.
 */
@@ -186,17 +260,59 @@ public:
     EID  CreateEntity(gemObject* obj);
     void AddEntity(gemObject* obj, EID objEid); ///< Ugly function, used for gemAL
     void RemoveEntity(gemObject* which);
-    void AddActorEntity(gemActor* actor);
+    void AddActorEntity(gemActor* actor, bool player);
     void RemoveActorEntity(gemActor* actor);
     void AddItemEntity(gemItem* item);
     void RemoveItemEntity(gemItem* item, uint32 uid);
 
     void RemovePlayerFromLootables(PID playerID);
 
+    /**
+     * Extrapolate the positions of the actors DR is moving.
+     */
     void UpdateAllDR();
+
+    /**
+     * Update the vitals of the actors marked with QueueStatsUpdate() and
+     * publish the dirty ones. Vitals regenerate as they are read, so actors
+     * are only queued while they have dirty stats or lose hit points.
+     */
     void UpdateAllStats();
 
-    void GetAllEntityPos(csArray<psAllEntityPosMessage> &msgs);
+    /// Have UpdateAllStats() look at the actor until its vitals need nothing more.
+    void QueueStatsUpdate(gemActor* actor);
+
+    /**
+     * Note that DR may move the actor, so UpdateAllDR() extrapolates it
+     * until it comes to rest.
+     */
+    void MarkMoving(gemActor* actor);
+
+    /// The table an actor of the list type is in, NULL for other types.
+    GEMActorTable* GetActorTable(GEMListType type);
+
+    /**
+     * Get the positions of the players that moved far enough since the
+     * superclients got them last, and note them as sent. Only players that
+     * moved since are looked at.
+     */
+    void GetChangedEntityPos(csArray<SuperclientPos> &changed);
+
+    /**
+     * Get the sectors each superclient needs player positions in: the
+     * sectors of its NPCs and the sectors their portals lead to.
+     *
+     * @return false if no NPC changed sector since the last call. Sectors is
+     *         left alone then.
+     */
+    bool GetSuperclientSectors(csHash<csSet<csPtrKey<iSector> >, AccountID> &sectors);
+
+    /// Have the next GetSuperclientSectors() look again.
+    void InvalidateSuperclientSectors()
+    {
+        superclientSectorsChanged = true;
+    }
+
     int  CountManagedNPCs(AccountID superclientID);
     void FillNPCList(MsgEntry* msg, AccountID superclientID);
     void SendAllNPCStats(AccountID superclientID);
@@ -283,6 +399,23 @@ public:
      */
     csArray<gemObject*> FindSectorEntities(iSector* sector, bool doInvisible = false);
 
+    /**
+     * Update the location of an entity in the spatial grid.
+     *
+     * Must be called whenever the entity has moved or changed sector or instance.
+     *
+     * @param obj The entity that moved.
+     */
+    void UpdateEntityPosition(gemObject* obj);
+
+    /**
+     * Get statistics of the spatial grid used for proximity queries.
+     */
+    csString GetSpatialGridStats() const
+    {
+        return spatialGrid.GetStats();
+    }
+
 protected:
     /**
      * Get the next ID for an object.
@@ -297,6 +430,23 @@ protected:
 
     uint32              nextEID;             ///< The next ID available for an object.
 
+    /// Take an entity out of the list of its type.
+    void RemoveFromList(gemObject* obj);
+
+    SpatialGrid         spatialGrid;         ///< All entities by location, used for proximity queries.
+
+    /** @name Entities by type
+     * Kept in step with entities_by_eid, see gemObject::GetGEMListType().
+     */
+    ///@{
+    GEMActorTable players;
+    GEMActorTable npcActors;
+    csArray<gemItem*> itemList;
+    ///@}
+
+    csHash<gemActor*, EID> unsyncedActors;   ///< Players that moved since the superclients got their position.
+    bool superclientSectorsChanged;          ///< An NPC changed sector since GetSuperclientSectors().
+
 
     csRef<iEngine> engine;                   ///< Stored here to save expensive csQueryRegistry calls
 };
@@ -318,6 +468,22 @@ public:
         return eid;
     }
 
+    /// The list of the GEM the object is in by its type.
+    GEMListType GetGEMListType() const
+    {
+        return gemListType;
+    }
+    /// Where in the list of its type the object is.
+    size_t GetGEMListIndex() const
+    {
+        return gemListIndex;
+    }
+    void SetGEMListEntry(GEMListType type, size_t index)
+    {
+        gemListType = type;
+        gemListIndex = index;
+    }
+
     /** @name iScriptableVar implementation
      * Functions that implement the iScriptableVar interface.
      */
@@ -388,6 +554,7 @@ public:
     void SetInstance(InstanceID newInstance)
     {
         worldInstance = newInstance;
+        cel->UpdateEntityPosition(this);
     }
     InstanceID  GetInstance()
     {
@@ -606,8 +773,8 @@ public:
     {
         return 0;
     }
-    virtual void GetLastSuperclientPos(csVector3 &pos, InstanceID &instance, csTicks &last) const { }
-    virtual void SetLastSuperclientPos(const csVector3 &pos, InstanceID instance, const csTicks &now) { }
+    virtual void GetLastSuperclientPos(csVector3 &pos, iSector* &sector, InstanceID &instance, csTicks &last) const { }
+    virtual void SetLastSuperclientPos(const csVector3 &pos, iSector* sector, InstanceID instance, const csTicks &now) { }
     virtual void AddLootablePlayer(PID playerID) { }
     virtual void RemoveLootablePlayer(PID playerID) { }
     virtual bool IsLootablePlayer(PID playerID)
@@ -671,6 +838,8 @@ protected:
     EID eid;                                    ///< Entity ID (unique identifier for object)
     csRef<iMeshFactoryWrapper> nullfact;        ///< Null factory for our mesh instances.
     bool alwaysWatching;                           ///< True if this object always watches (proxlists) regardless of owner.
+    GEMListType gemListType;                    ///< The list of the GEM the object is in by type
+    size_t gemListIndex;                        ///< Where in that list the object is
 
     csArray<iDeleteObjectCallback*> receivers;  ///< List of objects which are to be notified when this object is deleted.
 
@@ -818,6 +987,7 @@ public:
      */
     ///@{
     virtual double GetProperty(MathEnvironment* env, const char* ptr);
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     ///@}
 
@@ -1181,6 +1351,20 @@ protected:
 
     uint8_t DRcounter;  ///< increments in loop to prevent out of order packet overwrites of better data
     uint8_t forceDRcounter; ///< sequence number for forced position updates
+    psDREncoder drEncoder;  ///< Delta codes the DR updates for clients that take compact ones
+    DRInterest drInterest;  ///< Which watchers get the DR updates
+    bool drFlushQueued;     ///< A psDRFlushEvent will send the pending DR updates
+
+    /// The tier of a watcher of this actor.
+    DRTier GetDRTier(Client* watcher, float dist);
+
+    /**
+     * Send the DR data to the watchers that are due for it.
+     *
+     * @param flush  Only send to the watchers with an update pending.
+     * @param except Client that isn't sent the update.
+     */
+    void SendDRUpdate(bool flush, uint32_t except = 0);
     csTicks lastDR;
     csVector3 lastV;
 
@@ -1188,6 +1372,7 @@ protected:
     csVector3 productionStartPos;
 
     csVector3 lastSentSuperclientPos;
+    iSector* lastSentSuperclientSector;
     unsigned int lastSentSuperclientInstance;
     csTicks      lastSentSuperclientTick;
 
@@ -1332,6 +1517,7 @@ public:
      */
     ///@{
     virtual double GetProperty(MathEnvironment* env, const char* ptr);
+    virtual double GetPropertyByID(MathEnvironment* env, PropertyID id);
     virtual double CalcFunction(MathEnvironment* env, const char* functionName, const double* params);
     ///@}
 
@@ -1565,7 +1751,16 @@ public:
     void UpdateValidLocation(const csVector3 &pos, float yrot, iSector* sector, InstanceID instance, bool force = false);
 
     bool SetDRData(psDRMessage &drmsg);
-    void MulticastDRUpdate();
+
+    /**
+     * Send the current DR data to the watchers.
+     *
+     * @param except Client that isn't sent the update, as the player whose DR is relayed.
+     */
+    void MulticastDRUpdate(uint32_t except = 0);
+
+    /// Send the current position to the watchers that had DR updates folded.
+    void FlushDRUpdate();
     virtual void ForcePositionUpdate(int32_t loadDelay = 0, csString background = "", csVector2 point1 = 0, csVector2 point2 = 0, csString widget = "");
 
     using gemObject::RegisterCallback;
@@ -1641,8 +1836,8 @@ public:
     void Resurrect();
 
     virtual bool UpdateDR();
-    virtual void GetLastSuperclientPos(csVector3 &pos, InstanceID &instance, csTicks &last) const;
-    virtual void SetLastSuperclientPos(const csVector3 &pos, InstanceID instance, const csTicks &now);
+    virtual void GetLastSuperclientPos(csVector3 &pos, iSector* &sector, InstanceID &instance, csTicks &last) const;
+    virtual void SetLastSuperclientPos(const csVector3 &pos, iSector* sector, InstanceID instance, const csTicks &now);
 
     virtual void BroadcastTargetStatDR(ClientConnectionSet* clients);
     virtual void SendTargetStatDR(Client* client);
@@ -1954,6 +2149,7 @@ public:
     virtual void SetSuperclientID(AccountID id)
     {
         superClientID = id;
+        cel->InvalidateSuperclientSectors();
     }
 
     void SetupDialog(PID npcID, PID masterNpcID, bool force=false);
@@ -2177,6 +2373,31 @@ public:
 
 //-----------------------------------------------------------------------------
 
+/**
+ * Sends the DR updates that an actor folded for watchers in the slower tiers.
+ */
+class psDRFlushEvent : public psGameEvent
+{
+protected:
+    csWeakRef<gemObject> who;
+
+public:
+    psDRFlushEvent(int offsetticks, gemActor* actor)
+        : psGameEvent(0,offsetticks,"psDRFlushEvent")
+    {
+        who = actor;
+    }
+
+    void Trigger()
+    {
+        if(who.IsValid())
+        {
+            gemActor* actor = dynamic_cast<gemActor*>((gemObject*) who);
+            actor->FlushDRUpdate();
+        }
+    }
+};
+
 class psResurrectEvent : public psGameEvent // psGEMEvent
 {
 protected:
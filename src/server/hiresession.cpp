@@ -78,18 +78,18 @@ bool HireSession::Save(bool newSession)
 
     if(newSession)
     {
-        result = db->CommandPump("INSERT INTO npc_hired_npcs"
-                                 " (owner_id,hired_npc_id,guild,work_location_id,script)"
-                                 " VALUES ('%u','%u','%s','%u','%s')",
-                                 ownerPID.Unbox(), hiredPID.Unbox(), guild?"Y":"N", workLocationID,
-                                 script.GetDataSafe());
+        result = db->Command("INSERT INTO npc_hired_npcs"
+                             " (owner_id,hired_npc_id,guild,work_location_id,script)"
+                             " VALUES ('%u','%u','%s','%u','%s')",
+                             ownerPID.Unbox(), hiredPID.Unbox(), guild?"Y":"N", workLocationID,
+                             script.GetDataSafe());
     }
     else
     {
-        result = db->CommandPump("UPDATE npc_hired_npcs SET guild='%s', work_location_id='%u', script='%s'"
-                                 " WHERE owner_id=%u AND hired_npc_id=%u",
-                                 guild?"Y":"N", workLocationID,script.GetDataSafe(),
-                                 ownerPID.Unbox(), hiredPID.Unbox());
+        result = db->Command("UPDATE npc_hired_npcs SET guild='%s', work_location_id='%u', script='%s'"
+                             " WHERE owner_id=%u AND hired_npc_id=%u",
+                             guild?"Y":"N", workLocationID,script.GetDataSafe(),
+                             ownerPID.Unbox(), hiredPID.Unbox());
     }
 
     if(result==QUERY_FAILED)
@@ -102,8 +102,8 @@ bool HireSession::Delete()
 {
     unsigned long result = 0;
 
-    result = db->CommandPump("DELETE FROM npc_hired_npcs WHERE owner_id=%u AND hired_npc_id=%u",
-                             ownerPID.Unbox(), hiredPID.Unbox());
+    result = db->Command("DELETE FROM npc_hired_npcs WHERE owner_id=%u AND hired_npc_id=%u",
+                         ownerPID.Unbox(), hiredPID.Unbox());
 
     if(result==QUERY_FAILED)
         return false;
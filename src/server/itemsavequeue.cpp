@@ -0,0 +1,529 @@
+/*
+ * itemsavequeue.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <iutil/objreg.h>
+#include <iutil/plugin.h>
+#include <iutil/cfgmgr.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/log.h"
+#include "util/psdatabase.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "itemsavequeue.h"
+#include "globals.h"
+
+
+void ItemSaveQueue::Record::AddValue(const char* fname, const char* value)
+{
+    names.Push(fname);
+    values.Push(value);
+}
+
+void ItemSaveQueue::Record::AddField(const char* fname, float fValue)
+{
+    csString value;
+    value.Format("%.9g", fValue);
+    AddValue(fname, value);
+}
+
+void ItemSaveQueue::Record::AddField(const char* fname, int iValue)
+{
+    csString value;
+    value.Format("%d", iValue);
+    AddValue(fname, value);
+}
+
+void ItemSaveQueue::Record::AddField(const char* fname, unsigned int uiValue)
+{
+    csString value;
+    value.Format("%u", uiValue);
+    AddValue(fname, value);
+}
+
+void ItemSaveQueue::Record::AddField(const char* fname, unsigned short usValue)
+{
+    csString value;
+    value.Format("%u", (unsigned int)usValue);
+    AddValue(fname, value);
+}
+
+void ItemSaveQueue::Record::AddField(const char* fname, const char* sValue)
+{
+    if(!sValue)
+    {
+        AddFieldNull(fname);
+        return;
+    }
+
+    // Escaped with the main connection, this runs in the main thread.
+    db->Escape(escaped, sValue);
+    csString value;
+    value.Format("'%s'", escaped.GetData());
+    AddValue(fname, value);
+}
+
+void ItemSaveQueue::Record::AddFieldNull(const char* fname)
+{
+    AddValue(fname, "NULL");
+}
+
+bool ItemSaveQueue::Record::Execute(uint32 uid)
+{
+    return queue->Store(uid, *this);
+}
+
+void ItemSaveQueue::Record::Reset()
+{
+    names.Empty();
+    values.Empty();
+}
+
+void ItemSaveQueue::Writer::Run()
+{
+    queue->RunWriter();
+}
+
+ItemSaveQueue::ItemSaveQueue(iObjectRegistry* objreg, size_t batchSize, csTicks interval, uint32 uidRange)
+    : objreg(objreg), record(this), batchSize(csMax(batchSize, (size_t)1)), interval(interval),
+      uidRange(csMax(uidRange, (uint32)1)), nextUID(0), lastUID(0), upsert(false), oldestQueued(0), waiting(0),
+      stop(false), connecting(false), connected(false), dbPort(0), queued(0), collapsed(0), written(0),
+      statements(0), failed(0), retried(0), totalWriteTime(0), maxWriteTime(0)
+{
+}
+
+ItemSaveQueue::~ItemSaveQueue()
+{
+    if(!thread)
+        return;
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        condition.NotifyAll();
+    }
+    thread->Wait();
+}
+
+bool ItemSaveQueue::Initialize(const char* host, unsigned int port, const char* user,
+                               const char* password, const char* database)
+{
+    // The same plugin the main connection uses, but a new instance of it.
+    csRef<iConfigManager> configmanager = csQueryRegistry<iConfigManager>(objreg);
+    csRef<iPluginManager> plugmgr = csQueryRegistry<iPluginManager>(objreg);
+    const char* plugin = configmanager->GetStr("System.Plugins.iDataConnection", "planeshift.database.mysql");
+
+    connection = csLoadPlugin<iDataConnection>(plugmgr, plugin);
+    if(!connection)
+    {
+        Error2("Couldn't load database plugin %s for the item save queue.", plugin);
+        return false;
+    }
+    upsert = strstr(plugin, "mysql") != NULL;
+
+    dbHost = host;
+    dbPort = port;
+    dbUser = user;
+    dbPassword = password;
+    dbName = database;
+
+    // The connection is made in the writer thread as the client library
+    // keeps per thread state.
+    csRef<Writer> writer;
+    writer.AttachNew(new Writer(this));
+    thread.AttachNew(new CS::Threading::Thread(writer));
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    connecting = true;
+    thread->Start();
+    while(connecting)
+    {
+        condition.Wait(mutex);
+    }
+
+    if(!connected)
+    {
+        thread->Wait();
+        thread.Invalidate();
+        return false;
+    }
+    return true;
+}
+
+iRecord* ItemSaveQueue::GetRecord(bool insert)
+{
+    record.Reset();
+    record.insert = insert;
+    return &record;
+}
+
+uint32 ItemSaveQueue::AllocateUID()
+{
+    if(nextUID == lastUID)
+    {
+        // Nothing else inserts item instances, so the range past the highest
+        // id in the database and past what we handed out so far is ours.
+        Result result(db->Select("SELECT COALESCE(MAX(id), 0) AS max_id FROM item_instances"));
+        uint32 first = 1;
+        if(result.IsValid() && result.Count())
+            first = result[0].GetUInt32("max_id") + 1;
+
+        nextUID = csMax(nextUID, first);
+        lastUID = nextUID + uidRange;
+        Debug3(LOG_ITEM, 0, "Reserved item ids %u to %u.", nextUID, lastUID - 1);
+    }
+    return nextUID++;
+}
+
+bool ItemSaveQueue::Store(uint32 uid, const Record &record)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    if(columns.IsEmpty())
+    {
+        columns = record.names;
+        for(size_t i = 0; i < columns.GetSize(); i++)
+        {
+            updateClause.AppendFmt("%s%s=VALUES(%s)", i ? "," : "", columns[i], columns[i]);
+        }
+    }
+    else if(columns.GetSize() != record.names.GetSize())
+    {
+        Error4("Item %u has %zu columns instead of %zu, not saved.", uid, record.names.GetSize(), columns.GetSize());
+        return false;
+    }
+
+    queued++;
+
+    Row* row = pending.GetElementPointer(uid);
+    if(row)
+    {
+        // Only the latest image of the row is written.
+        row->values = record.values;
+        collapsed++;
+        return true;
+    }
+
+    Row newRow;
+    newRow.uid = uid;
+    newRow.insert = record.insert;
+    newRow.values = record.values;
+    newRow.attempts = 0;
+    pending.Put(uid, newRow);
+
+    if(pending.GetSize() == 1)
+    {
+        oldestQueued = csGetTicks();
+    }
+    if(pending.GetSize() >= batchSize)
+    {
+        condition.NotifyAll();
+    }
+    return true;
+}
+
+void ItemSaveQueue::Sync(uint32 uid)
+{
+    csArray<Row> rows;
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        while(writing.Contains(uid))
+        {
+            condition.Wait(mutex);
+        }
+
+        Row* row = pending.GetElementPointer(uid);
+        if(!row)
+            return;
+
+        rows.Push(*row);
+        pending.DeleteAll(uid);
+    }
+
+    bool ok = WriteRow(db, rows[0]);
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    statements++;
+    if(ok)
+    {
+        written++;
+    }
+    else
+    {
+        // The writer tries again later, the caller's own statement may fail too.
+        Requeue(rows);
+    }
+}
+
+bool ItemSaveQueue::Discard(uint32 uid)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    while(writing.Contains(uid))
+    {
+        condition.Wait(mutex);
+    }
+
+    Row* row = pending.GetElementPointer(uid);
+    if(!row)
+        return false;
+
+    bool insert = row->insert;
+    pending.DeleteAll(uid);
+    return insert;
+}
+
+void ItemSaveQueue::Checkpoint()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(pending.IsEmpty() && writing.IsEmpty())
+        return;
+
+    waiting++;
+    condition.NotifyAll();
+    while(!pending.IsEmpty() || !writing.IsEmpty())
+    {
+        condition.Wait(mutex);
+    }
+    waiting--;
+}
+
+void ItemSaveQueue::TakeBatch(csArray<Row> &batch)
+{
+    csHash<Row, uint32>::GlobalIterator it(pending.GetIterator());
+    while(it.HasNext() && batch.GetSize() < batchSize)
+    {
+        const Row &row = it.Next();
+        batch.Push(row);
+        writing.AddNoTest(row.uid);
+    }
+
+    if(batch.GetSize() == pending.GetSize())
+    {
+        pending.DeleteAll();
+    }
+    else
+    {
+        for(size_t i = 0; i < batch.GetSize(); i++)
+        {
+            pending.DeleteAll(batch[i].uid);
+        }
+    }
+
+    // What is left has waited long enough already.
+    if(!pending.IsEmpty())
+    {
+        oldestQueued = csGetTicks() - interval;
+    }
+}
+
+bool ItemSaveQueue::WriteRows(iDataConnection* connection, const csArray<Row> &rows)
+{
+    // Inserts and updates go into the same statement. An update of a row that
+    // was deleted in the meantime would bring it back, so deleting an item
+    // must Discard() it first.
+    csString sql("INSERT INTO item_instances (id");
+    for(size_t i = 0; i < columns.GetSize(); i++)
+    {
+        sql.AppendFmt(",%s", columns[i]);
+    }
+    sql.Append(") VALUES ");
+    for(size_t i = 0; i < rows.GetSize(); i++)
+    {
+        sql.AppendFmt("%s(%u", i ? "," : "", rows[i].uid);
+        for(size_t j = 0; j < rows[i].values.GetSize(); j++)
+        {
+            sql.AppendFmt(",%s", rows[i].values[j]);
+        }
+        sql.Append(")");
+    }
+    sql.Append(" ON DUPLICATE KEY UPDATE ");
+    sql.Append(updateClause);
+
+    if(connection->Command("%s", sql.GetData()) == QUERY_FAILED)
+    {
+        Error3("Failed to save %zu item instances!\nError: %s", rows.GetSize(), connection->GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool ItemSaveQueue::WriteRow(iDataConnection* connection, const Row &row)
+{
+    if(upsert)
+    {
+        csArray<Row> rows;
+        rows.Push(row);
+        return WriteRows(connection, rows);
+    }
+
+    csString sql;
+    if(row.insert)
+    {
+        sql.Format("INSERT INTO item_instances (id");
+        for(size_t i = 0; i < columns.GetSize(); i++)
+        {
+            sql.AppendFmt(",%s", columns[i]);
+        }
+        sql.AppendFmt(") VALUES (%u", row.uid);
+        for(size_t i = 0; i < row.values.GetSize(); i++)
+        {
+            sql.AppendFmt(",%s", row.values[i]);
+        }
+        sql.Append(")");
+    }
+    else
+    {
+        sql.Format("UPDATE item_instances SET ");
+        for(size_t i = 0; i < columns.GetSize(); i++)
+        {
+            sql.AppendFmt("%s%s=%s", i ? "," : "", columns[i], row.values[i]);
+        }
+        sql.AppendFmt(" WHERE id=%u", row.uid);
+    }
+
+    if(connection->Command("%s", sql.GetData()) == QUERY_FAILED)
+    {
+        Error3("Failed to save item instance %u!\nError: %s", row.uid, connection->GetLastError());
+        return false;
+    }
+    return true;
+}
+
+void ItemSaveQueue::WriteBatch(iDataConnection* connection, const csArray<Row> &batch, csArray<Row> &failedRows)
+{
+    if(upsert && batch.GetSize() > 1 && WriteRows(connection, batch))
+        return;
+
+    // One bad row fails the whole statement, so the others are written alone.
+    for(size_t i = 0; i < batch.GetSize(); i++)
+    {
+        if(!WriteRow(connection, batch[i]))
+            failedRows.Push(batch[i]);
+    }
+}
+
+void ItemSaveQueue::Requeue(csArray<Row> &rows)
+{
+    for(size_t i = 0; i < rows.GetSize(); i++)
+    {
+        Row &row = rows[i];
+        failed++;
+
+        // A newer image of the row was queued meanwhile and replaces it.
+        Row* newer = pending.GetElementPointer(row.uid);
+        if(newer)
+        {
+            newer->insert = newer->insert || row.insert;
+            continue;
+        }
+
+        if(++row.attempts >= ITEM_SAVE_ATTEMPTS)
+        {
+            Error3("Gave up saving item instance %u after %d attempts!", row.uid, row.attempts);
+            continue;
+        }
+
+        if(pending.IsEmpty())
+            oldestQueued = csGetTicks();
+        pending.Put(row.uid, row);
+        retried++;
+    }
+}
+
+void ItemSaveQueue::RunWriter()
+{
+    bool ok = connection->Initialize(dbHost, dbPort, dbName, dbUser, dbPassword, NULL) && connection->IsValid();
+    if(!ok)
+    {
+        Error2("Item save queue couldn't connect to the database: %s", connection->GetLastError());
+        connection.Invalidate();
+    }
+
+    mutex.Lock();
+    connecting = false;
+    connected = ok;
+    condition.NotifyAll();
+
+    csArray<Row> batch;
+    while(ok)
+    {
+        if(pending.IsEmpty())
+        {
+            if(stop)
+                break;
+
+            condition.Wait(mutex);
+            continue;
+        }
+
+        // Give further saves of the same items a chance to collapse into the
+        // queued rows, unless the batch is full or someone waits for it.
+        if(!stop && !waiting && pending.GetSize() < batchSize)
+        {
+            csTicks age = csGetTicks() - oldestQueued;
+            if(age < interval)
+            {
+                condition.Wait(mutex, interval - age);
+                continue;
+            }
+        }
+
+        TakeBatch(batch);
+        mutex.Unlock();
+
+        csArray<Row> failedRows;
+        csTicks start = csGetTicks();
+        WriteBatch(connection, batch, failedRows);
+        csTicks time = csGetTicks() - start;
+
+        mutex.Lock();
+        statements++;
+        written += batch.GetSize() - failedRows.GetSize();
+        totalWriteTime += time;
+        maxWriteTime = csMax(maxWriteTime, time);
+
+        // Tried again after the flush interval.
+        Requeue(failedRows);
+        batch.Empty();
+        writing.DeleteAll();
+        condition.NotifyAll();
+    }
+    mutex.Unlock();
+
+    // Closed in this thread, where it was opened.
+    connection.Invalidate();
+}
+
+csString ItemSaveQueue::GetStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    csString stats;
+    stats.Format("%zu pending, %zu saves collapsed to %zu rows in %zu batches, %zu writes failed, %zu retried, write avg %.1f max %u ms",
+                 pending.GetSize() + writing.GetSize(), queued, queued - collapsed, statements, failed, retried,
+                 statements ? (float)totalWriteTime / (float)statements : 0.0f, maxWriteTime);
+    return stats;
+}
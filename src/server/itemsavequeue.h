@@ -0,0 +1,256 @@
+/*
+ * itemsavequeue.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __ITEMSAVEQUEUE_H__
+#define __ITEMSAVEQUEUE_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/hash.h>
+#include <csutil/set.h>
+#include <csutil/csstring.h>
+#include <csutil/stringarray.h>
+#include <csutil/threading/thread.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/condition.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>
+
+struct iObjectRegistry;
+
+/**
+ * \addtogroup server
+ * @{ */
+
+/// Times a row is written before the queue gives up on it.
+#define ITEM_SAVE_ATTEMPTS 3
+
+/**
+ * Writes item_instances rows in the background.
+ *
+ * psItem::Commit() hands its row to the queue instead of running the
+ * statement itself. Saves of the same item are collapsed into the latest row
+ * until a thread with its own database connection writes them out. With MySQL
+ * many rows go in one INSERT ... ON DUPLICATE KEY UPDATE, the other databases
+ * get an INSERT or UPDATE per row. Rows are written when a batch is full or
+ * the oldest row waited for the flush interval, which bounds what is lost
+ * when the server dies. Everything left is written when the queue is deleted.
+ *
+ * If a batch fails its rows are written one by one, and the rows failing on
+ * their own are queued again, up to ITEM_SAVE_ATTEMPTS times.
+ *
+ * New items get their id from a range handed out by the queue, so they can be
+ * queued like any other row.
+ *
+ * Code that reads or changes item_instances rows directly has to call Sync(),
+ * Discard() or Checkpoint() first so it doesn't race the queued rows.
+ */
+class ItemSaveQueue
+{
+public:
+    /**
+     * Load a second database connection and start the writer thread.
+     *
+     * @param objreg Registry to load the database plugin from.
+     * @param batchSize Most rows written by one statement.
+     * @param interval Longest time in ms a row is kept back to collapse saves.
+     * @param uidRange Number of item ids reserved at once.
+     */
+    ItemSaveQueue(iObjectRegistry* objreg, size_t batchSize, csTicks interval, uint32 uidRange);
+
+    /// Writes all queued rows before the writer thread ends.
+    ~ItemSaveQueue();
+
+    /**
+     * Connect the writer thread to the database.
+     *
+     * @return false if the writer couldn't connect, the queue can't be used then.
+     */
+    bool Initialize(const char* host, unsigned int port, const char* user,
+                    const char* password, const char* database);
+
+    /**
+     * Get a record to fill with the columns of an item. Execute() on the
+     * record queues the row for the given item id.
+     *
+     * @param insert True if the item has no row yet.
+     */
+    iRecord* GetRecord(bool insert);
+
+    /// Get an unused item id for a new item.
+    uint32 AllocateUID();
+
+    /**
+     * Make sure the queued row of an item is in the database. Call this
+     * before changing the row with a statement of your own.
+     */
+    void Sync(uint32 uid);
+
+    /**
+     * Drop the queued row of an item that is about to be deleted.
+     *
+     * @return True if the item never made it to the database.
+     */
+    bool Discard(uint32 uid);
+
+    /// Wait until every queued row is in the database.
+    void Checkpoint();
+
+    /// Queue depth, collapsed saves and write times for the server console.
+    csString GetStats();
+
+private:
+    /// The latest image of a row.
+    struct Row
+    {
+        uint32 uid;
+        bool insert;            ///< The row isn't in the database yet.
+        csStringArray values;   ///< SQL values of the columns.
+        int attempts;           ///< Failed writes so far.
+    };
+
+    /// Collects the columns of a row as SQL values.
+    class Record : public iRecord
+    {
+    public:
+        Record(ItemSaveQueue* queue) : queue(queue), insert(false) {}
+
+        virtual void AddField(const char* fname, float fValue);
+        virtual void AddField(const char* fname, int iValue);
+        virtual void AddField(const char* fname, unsigned int uiValue);
+        virtual void AddField(const char* fname, unsigned short usValue);
+        virtual void AddField(const char* fname, const char* sValue);
+        virtual void AddFieldNull(const char* fname);
+
+        virtual bool Execute(uint32 uid);
+        virtual void Reset();
+
+    private:
+        friend class ItemSaveQueue;
+
+        void AddValue(const char* fname, const char* value);
+
+        ItemSaveQueue* queue;
+        bool insert;
+        csStringArray names;
+        csStringArray values;
+        csString escaped;
+    };
+
+    class Writer : public CS::Threading::Runnable
+    {
+    public:
+        Writer(ItemSaveQueue* queue) : queue(queue) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "ItemSaveWriter";
+        }
+
+    private:
+        ItemSaveQueue* queue;
+    };
+
+    /// Queue the row collected by the record.
+    bool Store(uint32 uid, const Record &record);
+
+    /// Move the next batch of rows to writing. Called with the mutex locked.
+    void TakeBatch(csArray<Row> &batch);
+
+    /**
+     * Write rows with one INSERT ... ON DUPLICATE KEY UPDATE. MySQL only.
+     *
+     * @return False if the statement failed.
+     */
+    bool WriteRows(iDataConnection* connection, const csArray<Row> &rows);
+
+    /**
+     * Write one row, with a plain INSERT or UPDATE unless the database
+     * has INSERT ... ON DUPLICATE KEY UPDATE.
+     *
+     * @return False if the statement failed.
+     */
+    bool WriteRow(iDataConnection* connection, const Row &row);
+
+    /**
+     * Write a batch, falling back to one row at a time if it fails.
+     *
+     * @param failedRows Gets the rows that couldn't be written.
+     */
+    void WriteBatch(iDataConnection* connection, const csArray<Row> &batch, csArray<Row> &failedRows);
+
+    /**
+     * Queue rows that failed again, unless newer images are queued or they
+     * failed too often. Called with the mutex locked.
+     */
+    void Requeue(csArray<Row> &rows);
+
+    /// Body of the writer thread.
+    void RunWriter();
+
+    iObjectRegistry* objreg;
+    csRef<iDataConnection> connection;  ///< Only used by the writer thread.
+    csRef<CS::Threading::Thread> thread;
+    Record record;
+
+    size_t batchSize;
+    csTicks interval;
+
+    uint32 uidRange;
+    uint32 nextUID;
+    uint32 lastUID;                     ///< End of the reserved id range.
+
+    bool upsert;                        ///< The database has INSERT ... ON DUPLICATE KEY UPDATE.
+    csStringArray columns;              ///< Column names, taken from the first record.
+    csString updateClause;              ///< The ON DUPLICATE KEY UPDATE part of the statement.
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+    csHash<Row, uint32> pending;
+    csSet<uint32> writing;              ///< Ids of the batch that is being written.
+    csTicks oldestQueued;               ///< When the oldest pending row was queued.
+    size_t waiting;                     ///< Threads waiting in Checkpoint().
+    bool stop;
+
+    // Connection handshake with the writer thread.
+    bool connecting;
+    bool connected;
+    csString dbHost, dbUser, dbPassword, dbName;
+    unsigned int dbPort;
+
+    // Statistics.
+    size_t queued;
+    size_t collapsed;
+    size_t written;
+    size_t statements;
+    size_t failed;
+    size_t retried;
+    uint64 totalWriteTime;
+    csTicks maxWriteTime;
+};
+
+/** @} */
+
+#endif
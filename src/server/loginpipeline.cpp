@@ -0,0 +1,313 @@
+/*
+ * loginpipeline.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/sysfunc.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>
+#include "bulkobjects/pscharacterlist.h"
+#include "util/consoleout.h"
+#include "util/eventmanager.h"
+#include "util/gameevent.h"
+#include "util/log.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "loginpipeline.h"
+#include "authentserver.h"
+#include "globals.h"
+
+static const char* stageNames[LoginRequest::STAGE_COUNT] = { "check", "attach", "record" };
+
+/**
+ * Hands a login back to the main game thread to attach it to the world.
+ */
+class psLoginEvent : public psGameEvent
+{
+public:
+    psLoginEvent(LoginPipeline* pipeline, LoginRequest* request)
+        : psGameEvent(0, 0, "psLoginEvent"), pipeline(pipeline), request(request)
+    {
+    }
+
+    virtual ~psLoginEvent()
+    {
+        delete request;
+    }
+
+    virtual void Trigger()
+    {
+        LoginRequest* attach = request;
+        request = NULL;
+        pipeline->Run(attach);
+    }
+
+private:
+    LoginPipeline* pipeline;
+    LoginRequest* request;
+};
+
+//-----------------------------------------------------------------------------
+
+LoginRequest::LoginRequest()
+    : stage(CHECK), queued(0), clientnum(0), capabilities(0), acctinfo(NULL), charlist(NULL)
+{
+}
+
+LoginRequest::~LoginRequest()
+{
+    delete acctinfo;
+    delete charlist;
+}
+
+//-----------------------------------------------------------------------------
+
+LoginPipeline::LoginPipeline(AuthenticationServer* authserver)
+    : authserver(authserver), starting(0), workers(0), stop(false), attaching(0)
+{
+    memset(stats, 0, sizeof(stats));
+}
+
+LoginPipeline::~LoginPipeline()
+{
+    Stop();
+}
+
+bool LoginPipeline::Start(size_t count)
+{
+    CS_ASSERT(threads.IsEmpty());
+
+    mutex.Lock();
+    stop = false;
+    starting = count;
+    for(size_t i = 0; i < count; i++)
+    {
+        csRef<Worker> worker;
+        worker.AttachNew(new Worker(this));
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        threads.Push(thread);
+    }
+
+    // Wait for the workers to get their connections.
+    while(starting)
+    {
+        condition.Wait(mutex);
+    }
+    bool started = workers != 0;
+    stop = !started;
+    mutex.Unlock();
+
+    if(!started)
+    {
+        for(size_t i = 0; i < threads.GetSize(); i++)
+        {
+            threads[i]->Wait();
+        }
+        threads.Empty();
+    }
+    return started;
+}
+
+void LoginPipeline::Stop()
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        condition.NotifyAll();
+    }
+
+    for(size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+    threads.Empty();
+    workers = 0;
+
+    for(size_t i = 0; i < pending.GetSize(); i++)
+    {
+        delete pending[i];
+    }
+    pending.Empty();
+}
+
+void LoginPipeline::Queue(LoginRequest* request)
+{
+    request->queued = csGetTicks();
+
+    if(request->stage == LoginRequest::DONE)
+    {
+        delete request;
+        return;
+    }
+
+    if(request->stage == LoginRequest::ATTACH)
+    {
+        if(!workers)
+        {
+            // Already in the main game thread.
+            Run(request);
+            return;
+        }
+
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            attaching++;
+        }
+        psserver->GetEventManager()->Push(new psLoginEvent(this, request));
+        return;
+    }
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        if(workers)
+        {
+            pending.Push(request);
+            condition.NotifyOne();
+            return;
+        }
+    }
+    Run(request);
+}
+
+void LoginPipeline::Run(LoginRequest* request)
+{
+    LoginRequest::Stage stage = request->stage;
+    csTicks start = csGetTicks();
+
+    switch(stage)
+    {
+        case LoginRequest::CHECK:
+            authserver->CheckLogin(request);
+            request->stage = LoginRequest::ATTACH;
+            break;
+        case LoginRequest::ATTACH:
+            request->stage = authserver->AttachLogin(request) ? LoginRequest::RECORD : LoginRequest::DONE;
+            break;
+        case LoginRequest::RECORD:
+            authserver->RecordLogin(request);
+            request->stage = LoginRequest::DONE;
+            break;
+        default:
+            break;
+    }
+
+    csTicks end = csGetTicks();
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        if(stage == LoginRequest::ATTACH && workers)
+            attaching--;
+
+        StageStats &s = stats[stage];
+        s.count++;
+        s.totalWait += start - request->queued;
+        s.maxWait = csMax(s.maxWait, start - request->queued);
+        s.totalRun += end - start;
+        s.maxRun = csMax(s.maxRun, end - start);
+    }
+
+    Queue(request);
+}
+
+void LoginPipeline::Worker::Run()
+{
+    pipeline->RunWorker();
+}
+
+void LoginPipeline::RunWorker()
+{
+    bool attached = db->AttachThread();
+
+    mutex.Lock();
+    starting--;
+    if(attached)
+        workers++;
+    condition.NotifyAll();
+
+    if(!attached)
+    {
+        mutex.Unlock();
+        CPrintf(CON_WARNING, "Login worker has no database connection of its own.\n");
+        return;
+    }
+
+    while(!stop)
+    {
+        if(pending.IsEmpty())
+        {
+            condition.Wait(mutex);
+            continue;
+        }
+
+        LoginRequest* request = pending[0];
+        pending.DeleteIndex(0);
+        mutex.Unlock();
+
+        Run(request);
+
+        mutex.Lock();
+    }
+    mutex.Unlock();
+
+    db->DetachThread();
+}
+
+csString LoginPipeline::GetStats()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    csString result;
+    if(workers)
+        result.Format("%zu waiting for %zu workers, %zu for the game thread", pending.GetSize(), workers, attaching);
+    else
+        result = "all stages in the game thread";
+
+    for(int i = 0; i < LoginRequest::STAGE_COUNT; i++)
+    {
+        const StageStats &s = stats[i];
+        result.AppendFmt("; %s %zu, wait avg %.1f max %u, run avg %.1f max %u ms", stageNames[i], s.count,
+                         s.count ? (float)s.totalWait / (float)s.count : 0.0f, s.maxWait,
+                         s.count ? (float)s.totalRun / (float)s.count : 0.0f, s.maxRun);
+    }
+    return result;
+}
+
+void LoginPipeline::AppendReport(csString &report)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    report.AppendFmt("<login_queue waiting=\"%zu\" workers=\"%zu\" attaching=\"%zu\" />\n",
+                     pending.GetSize(), workers, attaching);
+    for(int i = 0; i < LoginRequest::STAGE_COUNT; i++)
+    {
+        const StageStats &s = stats[i];
+        report.AppendFmt("<login_stage name=\"%s\" count=\"%zu\" wait_avg=\"%.1f\" wait_max=\"%u\" run_avg=\"%.1f\" run_max=\"%u\" />\n",
+                         stageNames[i], s.count,
+                         s.count ? (float)s.totalWait / (float)s.count : 0.0f, s.maxWait,
+                         s.count ? (float)s.totalRun / (float)s.count : 0.0f, s.maxRun);
+    }
+}
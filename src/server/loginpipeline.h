@@ -0,0 +1,173 @@
+/*
+ * loginpipeline.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __LOGINPIPELINE_H__
+#define __LOGINPIPELINE_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "bulkobjects/psaccountinfo.h"
+
+class AuthenticationServer;
+class psCharacterList;
+
+/**
+ * \addtogroup server
+ * @{ */
+
+/**
+ * A login on its way through the LoginPipeline.
+ */
+struct LoginRequest
+{
+    /// The stages of a login, in the order they run.
+    enum Stage
+    {
+        CHECK,      ///< Load the account, check the password, load the characters. Any thread.
+        ATTACH,     ///< Attach the client to the world. Main game thread.
+        RECORD,     ///< Save the login time and address of the account. Any thread.
+        DONE,
+        STAGE_COUNT = DONE
+    };
+
+    LoginRequest();
+
+    /// Deletes the account and character list it still holds.
+    ~LoginRequest();
+
+    Stage stage;
+    csTicks queued;              ///< When the current stage was queued
+
+    uint32_t clientnum;
+    uint32_t capabilities;
+    csString user;
+    csString password;
+    csString password256;
+    csString os;
+    csString gfxcard;
+    csString gfxversion;
+
+    psAccountInfo* acctinfo;     ///< Taken from the cache or loaded by CHECK
+    psCharacterList* charlist;   ///< Loaded by CHECK
+
+    csString rejectReason;       ///< Set by CHECK to turn the client away, sent to it
+    csString rejectNote;         ///< Why, for the log
+
+    psAccountInfo record;        ///< What RECORD saves
+};
+
+/**
+ * Runs the stages of logins.
+ *
+ * The stages that mostly wait for the database run on worker threads, each
+ * with a database connection of its own, so a storm of logins doesn't stall
+ * the game. Attaching the client to the world is handed back to the main
+ * game thread with an event. Without workers, or when the database can't
+ * give them connections of their own, all stages run in the main game
+ * thread right away.
+ */
+class LoginPipeline
+{
+public:
+    LoginPipeline(AuthenticationServer* authserver);
+
+    /// Stops the workers, logins that didn't get through are dropped.
+    ~LoginPipeline();
+
+    /**
+     * Start the workers.
+     *
+     * @param threads The number of workers.
+     * @return false if none of them got a database connection.
+     */
+    bool Start(size_t threads);
+
+    /// Stop the workers. Logins queued after this run in the main game thread.
+    void Stop();
+
+    /**
+     * Queue a request for its current stage. Called by the main game thread
+     * for new logins and by whichever thread ran the previous stage, so any
+     * thread may call it.
+     */
+    void Queue(LoginRequest* request);
+
+    /// Run the current stage of a request and queue it for the next one.
+    void Run(LoginRequest* request);
+
+    /// Queue depths and the wait and run times of each stage.
+    csString GetStats();
+
+    /// Append the same as elements of the server status report.
+    void AppendReport(csString &report);
+
+private:
+    class Worker : public CS::Threading::Runnable
+    {
+    public:
+        Worker(LoginPipeline* pipeline) : pipeline(pipeline) {}
+
+        virtual void Run();
+        virtual const char* GetName() const
+        {
+            return "LoginWorker";
+        }
+
+    private:
+        LoginPipeline* pipeline;
+    };
+
+    struct StageStats
+    {
+        size_t count;
+        csTicks totalWait;
+        csTicks maxWait;
+        csTicks totalRun;
+        csTicks maxRun;
+    };
+
+    /// Body of the worker threads.
+    void RunWorker();
+
+    AuthenticationServer* authserver;
+
+    csArray<csRef<CS::Threading::Thread> > threads;
+    size_t starting;                     ///< Workers that didn't try to connect yet.
+    size_t workers;                      ///< Workers with a connection.
+    bool stop;
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition condition;
+    csArray<LoginRequest*> pending;      ///< Waiting for a worker.
+    size_t attaching;                    ///< Waiting for the main game thread.
+    StageStats stats[LoginRequest::STAGE_COUNT];
+};
+
+/** @} */
+
+#endif
@@ -29,6 +29,7 @@
 #include "net/subscriber.h"         // Subscriber class
 #include "net/message.h"            // For msgtype typedef
 #include "util/eventmanager.h"
+#include "util/dispatchtable.h"
 #include "globals.h"
 
 //=============================================================================
@@ -140,9 +141,8 @@ public:
     inline bool Unsubscribe(msgtype type)
     {
         CS::Threading::RecursiveMutexScopedLock lock(mutex);
-        if(handlers.Contains(type))
+        if(handlers.DeleteKey(type))
         {
-            handlers.DeleteAll(type);
             return GetEventManager()->Unsubscribe(this, type);
         }
         return false;
@@ -158,9 +158,8 @@ public:
     inline bool Unsubscribe(FunctionPointer handler, msgtype type)
     {
         CS::Threading::RecursiveMutexScopedLock lock(mutex);
-        if(handlers.Contains(type))
+        if(handlers.Delete(type, handler))
         {
-            handlers.Delete(type, handler);
             if(!handlers.Contains(type))
             {
                 return GetEventManager()->Unsubscribe(this, type);
@@ -193,17 +192,15 @@ public:
     /**
      * Transfers the message to the manager specific function.
      *
+     * The handlers are read from a snapshot without locking, they may
+     * subscribe and unsubscribe while they run.
+     *
      * @note DO NOT OVERRIDE
      * @param msg Message that is forwarded to the manager's function
      * @param client Client that is forwarded to the manager's function
      */
     void HandleMessage(MsgEntry* msg, Client* client)
     {
-        csArray<FunctionPointer> msgHandlers;
-        {
-            CS::Threading::RecursiveMutexScopedLock lock(mutex);
-            msgHandlers = handlers.GetAll(msg->GetType());
-        }
         SubClass* self = dynamic_cast<SubClass*>(this);
         if(!self)
         {
@@ -211,6 +208,7 @@ public:
             return;
         }
 
+        typename DispatchTable<FunctionPointer>::Snapshot msgHandlers(handlers, msg->GetType());
         for(size_t i = 0; i < msgHandlers.GetSize(); ++i)
         {
             (self->*msgHandlers[i])(msg, client);
@@ -218,8 +216,9 @@ public:
     }
 
 private:
+    /// Keeps the handlers in step with the subscriptions to the event manager.
     CS::Threading::RecursiveMutex mutex;
-    csHash<FunctionPointer, msgtype> handlers;
+    DispatchTable<FunctionPointer> handlers;
 
     /**
      * Gets the event manager from the server.
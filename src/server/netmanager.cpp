@@ -21,6 +21,7 @@
 // Crystal Space Includes
 //=============================================================================
 #include <csutil/sysfunc.h>
+#include <csutil/set.h>
 
 //=============================================================================
 // Project Includes
@@ -80,6 +81,31 @@ public:
             psserver->GetNetManager()->SendMessage(myMsg);
         }
     }
+    virtual uint32 GetAffinity() const
+    {
+        // Queueing is thread-safe, keep the messages of a client in order.
+        return myMsg->clientnum;
+    }
+};
+
+
+/// Runs the network loop of a shard other than the first.
+class NetShardRunner : public CS::Threading::Runnable
+{
+public:
+    NetShardRunner(NetManager* shard) : shard(shard) {}
+
+    virtual void Run()
+    {
+        shard->Run();
+    }
+    virtual const char* GetName() const
+    {
+        return "NetShard";
+    }
+
+private:
+    NetManager* shard;
 };
 
 
@@ -87,10 +113,49 @@ NetManager::NetManager()
     : NetBase(1000),stop_network(false)
 {
     port=0;
+    clients = new ClientConnectionSet;
+    owner = this;
+    shard = 0;
+}
+
+NetManager::NetManager(NetManager* owner, size_t shard)
+    : NetBase(1000),stop_network(false)
+{
+    port=0;
+    clients = owner->clients;
+    this->owner = owner;
+    this->shard = shard;
+
+    client_firstmsg = owner->client_firstmsg;
+    npcclient_firstmsg = owner->npcclient_firstmsg;
+    timeout = owner->timeout;
+
+    // One message profile for all shards.
+    delete profs;
+    profs = owner->GetProfs();
 }
 
 NetManager::~NetManager()
 {
+    if(owner != this)
+    {
+        profs = NULL;
+        return;
+    }
+
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        shards[i]->stop_network = true;
+    }
+    for(size_t i = 0; i < shardThreads.GetSize(); i++)
+    {
+        shardThreads[i]->Wait();
+    }
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        delete shards[i];
+    }
+    delete clients;
 }
 
 bool NetManager::Initialize(CacheManager* cachemanager, int client_firstmsg, int npcclient_firstmsg, int timeout)
@@ -102,7 +167,7 @@ bool NetManager::Initialize(CacheManager* cachemanager, int client_firstmsg, int
     NetManager::npcclient_firstmsg = npcclient_firstmsg;
     NetManager::timeout = timeout;
 
-    if(!clients.Initialize())
+    if(!clients->Initialize())
         return false;
 
     SetMsgStrings(cachemanager->GetMsgStrings(), 0);
@@ -177,6 +242,89 @@ NetManager* NetManager::Create(CacheManager* cacheManager, int client_firstmsg,
     return netManagerStarter->netManager;
 }
 
+bool NetManager::SetShardCount(size_t count)
+{
+    if(count <= 1 || !shards.IsEmpty())
+        return true;
+
+    if(!SetReusePort())
+        return false;
+
+    shards.Push(this);
+    for(size_t i = 1; i < count; i++)
+    {
+        NetManager* netManager = new NetManager(this, i);
+        if(!netManager->Init(false) || !netManager->SetReusePort())
+        {
+            Error2("Failed to create network shard %zu.", i);
+            delete netManager;
+            break;
+        }
+        netManager->inqueues = inqueues;
+        shards.Push(netManager);
+    }
+    return true;
+}
+
+bool NetManager::Bind(const char* addr, int port)
+{
+    if(!NetBase::Bind(addr, port))
+        return false;
+
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        if(!shards[i]->NetBase::Bind(addr, port))
+        {
+            Error2("Failed to bind network shard %zu.", i);
+            return false;
+        }
+    }
+
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        csRef<NetShardRunner> runner;
+        runner.AttachNew(new NetShardRunner(shards[i]));
+        shardThreads.Push(csPtr<CS::Threading::Thread>(new CS::Threading::Thread(runner)));
+        shardThreads.Top()->Start();
+    }
+    return true;
+}
+
+bool NetManager::SetBatchedIO(size_t batchSize)
+{
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        if(!shards[i]->NetBase::SetBatchedIO(batchSize))
+            return false;
+    }
+    return NetBase::SetBatchedIO(batchSize);
+}
+
+bool NetManager::AddMsgQueue(MsgQueue* q, objID minID, objID maxID)
+{
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        shards[i]->NetBase::AddMsgQueue(q, minID, maxID);
+    }
+    return NetBase::AddMsgQueue(q, minID, maxID);
+}
+
+void NetManager::RemoveMsgQueue(MsgQueue* q)
+{
+    for(size_t i = 1; i < shards.GetSize(); i++)
+    {
+        shards[i]->NetBase::RemoveMsgQueue(q);
+    }
+    NetBase::RemoveMsgQueue(q);
+}
+
+NetManager* NetManager::GetShard(uint32_t clientnum)
+{
+    if(owner->shards.IsEmpty())
+        return owner;
+    return owner->shards[clientnum % owner->shards.GetSize()];
+}
+
 void NetManager::Destroy()
 {
     // Handle stopping and destroying the network thread in the main thread.
@@ -193,6 +341,10 @@ bool NetManager::HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* me)
 {
     psMessageBytes* msg = me->bytes;
 
+    // A client of another shard, its datagrams are handled there.
+    if(clients->Find(addr))
+        return false;
+
     // The first msg from client must be "firstmsg", "alt_first_msg" or "PING"
     if(msg->type!=client_firstmsg && msg->type!=npcclient_firstmsg && msg->type!=MSGTYPE_PING)
         return false;
@@ -207,7 +359,7 @@ bool NetManager::HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* me)
         int flags = 0;
         if(psserver->IsReady()) flags |= PINGFLAG_READY;
         if(psserver->HasBeenReady()) flags |= PINGFLAG_HASBEENREADY;
-        if(psserver->IsFull(clients.Count(),NULL)) flags |= PINGFLAG_SERVERFULL;
+        if(psserver->IsFull(clients->Count(),NULL)) flags |= PINGFLAG_SERVERFULL;
 
         // Create the reply to the ping
         psPingMsg pong(0,ping.id,flags);
@@ -228,7 +380,7 @@ bool NetManager::HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* me)
         return false;
 
     // Create and add the client object to client list
-    Client* client = clients.Add(addr);
+    Client* client = clients->Add(addr, (uint32_t)shard, (uint32_t)GetShardCount());
     if(!client)
         return false;
 
@@ -243,25 +395,19 @@ bool NetManager::HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* me)
 
 void NetManager::CheckResendPkts()
 {
-    // NOTE: Globaliterators on csHash do not retrieve keys contiguously.
-    csHash<csRef<psNetPacketEntry>, PacketKey>::GlobalIterator it(awaitingack.GetIterator());
     csRef<psNetPacketEntry> pkt;
     csArray<csRef<psNetPacketEntry> > pkts;
-    csArray<Connection*> resentConnections;
+    csSet<csPtrKey<Connection> > resentConnections;
+    Connection* sampleConnection = NULL;
 
     // Connections that should be avoided because we know they are full
-    csArray<Connection*> fullConnections;
+    csSet<csPtrKey<Connection> > fullConnections;
 
     csTicks currenttime = csGetTicks();
     unsigned int resentCount = 0;
 
-    while(it.HasNext())
-    {
-        pkt = it.Next();
-        // Check the connection packet timeout
-        if(pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO) < currenttime)
-            pkts.Push(pkt);
-    }
+    // Only the packets whose timeout expired come out of the resend wheel.
+    GetExpiredPackets(currenttime, pkts);
     for(size_t i = 0; i < pkts.GetSize(); i++)
     {
 #ifdef PACKETDEBUG
@@ -270,20 +416,25 @@ void NetManager::CheckResendPkts()
         pkt = pkts.Get(i);
 
         // re-add to send queue
-        csRef<NetPacketQueueRefCount> outqueue = clients.FindQueueAny(pkt->clientnum);
+        csRef<NetPacketQueueRefCount> outqueue = clients->FindQueueAny(pkt->clientnum);
         if(!outqueue)
         {
-            awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+            RemoveAwaitingAck(pkt);
             continue;
         }
 
         Connection* connection = GetConnByNum(pkt->clientnum);
         if(connection)
         {
-            if(resentConnections.Find(connection) == csArrayItemNotFound)
-                resentConnections.Push(connection);
-            if(fullConnections.Find(connection) != csArrayItemNotFound)
+            resentConnections.Add(connection);
+            if(!sampleConnection)
+                sampleConnection = connection;
+            if(fullConnections.Contains(connection))
+            {
+                // Still expired, so it comes up again with the next check.
+                ScheduleResend(pkt);
                 continue;
+            }
             // This indicates a bug in the netcode.
             if(pkt->RTO == 0)
             {
@@ -314,11 +465,12 @@ void NetManager::CheckResendPkts()
 
             if(packet->offset == 0)
             {
-                psMessageBytes* msg = (psMessageBytes*) packet->data;
+                const psMessageBytes* msg = (const psMessageBytes*) pkt->GetPayload();
                 type = msg->type;
             }
             Error4("Queue full. Could not add packet with clientnum %d type %s ID %d.\n", pkt->clientnum, type == 0 ? "Fragment" : (const char*)  GetMsgTypeName(type), pkt->packet->pktid);
-            fullConnections.Push(connection);
+            fullConnections.Add(connection);
+            ScheduleResend(pkt);
             continue;
         }
 
@@ -334,7 +486,7 @@ void NetManager::CheckResendPkts()
         //printf("pkt=%p, pkt->packet=%p\n",pkt,pkt->packet);
         // take out of awaiting ack pool.
         // This does NOT delete the pkt mem block itself.
-        if(!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt))
+        if(!RemoveAwaitingAck(pkt))
         {
 #ifdef PACKETDEBUG
             Debug2(LOG_NET,"No packet in ack queue :%d\n", pkt->packet->pktid);
@@ -361,9 +513,9 @@ void NetManager::CheckResendPkts()
             }
             resendAvg /= RESENDAVGCOUNT;
             csString status;
-            if(timeTaken > 50 || pkts.GetSize() > 300)
+            if((timeTaken > 50 || pkts.GetSize() > 300) && sampleConnection)
             {
-                status.Format("Resending high priority packets has taken %u time to process, for %u packets on %zu unique connections %zu full connections (Sample clientnum %u/RTO %u. ", timeTaken, resentCount, resentConnections.GetSize(),fullConnections.GetSize(), resentConnections[0]->clientnum, resentConnections[0]->RTO);
+                status.Format("Resending high priority packets has taken %u time to process, for %u packets on %zu unique connections %zu full connections (Sample clientnum %u/RTO %u. ", timeTaken, resentCount, resentConnections.GetSize(),fullConnections.GetSize(), sampleConnection->clientnum, sampleConnection->RTO);
                 CPrintf(CON_WARNING, "%s\n", (const char*) status.GetData());
             }
             status.AppendFmt("Resending non-acked packet statistics: %g average resends, peak of %zu resent packets", resendAvg, peakResend);
@@ -378,9 +530,10 @@ void NetManager::CheckResendPkts()
 
 NetManager::Connection* NetManager::GetConnByIP(LPSOCKADDR_IN addr)
 {
-    Client* client = clients.Find(addr);
+    Client* client = clients->Find(addr);
 
-    if(!client)
+    // Only the shard of the client may touch its connection.
+    if(!client || GetShard(client->GetClientNum()) != this)
         return NULL;
 
     return client->GetConnection();
@@ -388,7 +541,7 @@ NetManager::Connection* NetManager::GetConnByIP(LPSOCKADDR_IN addr)
 
 NetManager::Connection* NetManager::GetConnByNum(uint32_t clientnum)
 {
-    Client* client = clients.FindAny(clientnum);
+    Client* client = clients->FindAny(clientnum);
 
     if(!client)
         return NULL;
@@ -413,7 +566,7 @@ bool NetManager::SendMessageDelayed(MsgEntry* me, csTicks delay)
 bool NetManager::SendMessage(MsgEntry* me)
 {
     bool sendresult;
-    csRef<NetPacketQueueRefCount> outqueue = clients.FindQueueAny(me->clientnum);
+    csRef<NetPacketQueueRefCount> outqueue = clients->FindQueueAny(me->clientnum);
     if(!outqueue)
         return false;
 
@@ -437,7 +590,24 @@ bool NetManager::SendMessage(MsgEntry* me)
     /*  The senders queue does not hold a reference itself, so we have to manually add one before pushing
      *  this queue on.  The queue is decref'd in the network thread when it's taken out of the senders queue.
      */
-    if(!senders.Add(outqueue))
+    if(!GetShard(me->clientnum)->senders.Add(outqueue))
+    {
+        Error1("Senderlist Full!");
+    }
+
+    return sendresult;
+}
+
+bool NetManager::SendSharedMessage(MsgEntry* me)
+{
+    csRef<NetPacketQueueRefCount> outqueue = clients->FindQueueAny(me->clientnum);
+    if(!outqueue)
+        return false;
+
+    // Same ordering as in SendMessage: first the queue, then the senders.
+    bool sendresult = NetBase::SendSharedMessage(me,outqueue);
+
+    if(!GetShard(me->clientnum)->senders.Add(outqueue))
     {
         Error1("Senderlist Full!");
     }
@@ -464,6 +634,12 @@ void NetManager::Run()
     long    lasttotalcountin=0;
     long    lasttotalcountout=0;
 
+    long    lastsyscalls=0;
+
+    long    lastcopiedbytes=0;
+    long    lastcopies=0;
+    long    lastsharedbytes=0;
+
     float   kbpsout = 0;
     float   kbpsin = 0;
 
@@ -522,12 +698,23 @@ void NetManager::Run()
 
             laststatdisplay = currentticks;
 
-            if(clients.Count() > clientCountMax)
+            if(clients->Count() > clientCountMax)
             {
-                clientCountMax = clients.Count();
+                clientCountMax = clients->Count();
             }
             csString status;
-            status.Format("Currently using %1.2fKbps out, %1.2fkbps in. Packets: %ld out, %ld in", kbpsout, kbpsin, totalcountout-lasttotalcountout,totalcountin-lasttotalcountin);
+            if(GetShardCount() > 1)
+                status.Format("Shard %zu: ", shard);
+            status.AppendFmt("Currently using %1.2fKbps out, %1.2fkbps in. Packets: %ld out, %ld in", kbpsout, kbpsin, totalcountout-lasttotalcountout,totalcountin-lasttotalcountin);
+            status.AppendFmt(". Payload: %ld bytes copied in %ld packets, %ld bytes shared",
+                             payloadStats.copiedBytes-lastcopiedbytes, payloadStats.copies-lastcopies,
+                             payloadStats.sharedBytes-lastsharedbytes);
+
+            long syscalls = syscallsin + syscallsout - lastsyscalls;
+            long packets = totalcountin - lasttotalcountin + totalcountout - lasttotalcountout;
+            float syscallsPerSec = (float)syscalls * 1000.0f / (float)STATDISPLAYCHECK;
+            float packetsPerSyscall = syscalls ? (float)packets / (float)syscalls : 0.0f;
+            status.AppendFmt(". Syscalls: %1.2f/s, %1.2f packets per syscall", syscallsPerSec, packetsPerSyscall);
 
             if(LogCSV::GetSingletonPtr())
                 LogCSV::GetSingleton().Write(CSV_STATUS, status);
@@ -536,14 +723,24 @@ void NetManager::Run()
             {
                 CPrintf(CON_DEBUG, "Currently %d (Max: %d) clients using %1.2fKbps (Max: %1.2fKbps) outbound, "
                         "%1.2fkbps (Max: %1.2fKbps) inbound...\n",
-                        clients.Count(),clientCountMax, kbpsout, kbpsOutMax,
+                        clients->Count(),clientCountMax, kbpsout, kbpsOutMax,
                         kbpsin, kbpsInMax);
                 CPrintf(CON_DEBUG, "Packets inbound %ld , outbound %ld...\n",
                         totalcountin-lasttotalcountin,totalcountout-lasttotalcountout);
+                CPrintf(CON_DEBUG, "Payload bytes copied %ld (%ld packets), shared %ld...\n",
+                        payloadStats.copiedBytes-lastcopiedbytes, payloadStats.copies-lastcopies,
+                        payloadStats.sharedBytes-lastsharedbytes);
+                CPrintf(CON_DEBUG, "Syscalls %1.2f/s, %1.2f packets per syscall...\n",
+                        syscallsPerSec, packetsPerSyscall);
             }
 
             lasttotalcountout = totalcountout;
             lasttotalcountin = totalcountin;
+            lastsyscalls = syscallsin + syscallsout;
+
+            lastcopiedbytes = payloadStats.copiedBytes;
+            lastcopies = payloadStats.copies;
+            lastsharedbytes = payloadStats.sharedBytes;
         }
     }
     printf("Network thread stopped!\n");
@@ -564,8 +761,8 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
             newmsg.AttachNew(new MsgEntry(me));
             newmsg->msgid = GetRandomID();
 
-            // Message is copied again into packet sections, so we can reuse same one.
-            ClientIterator i(clients);
+            // The packets of all clients reference this copy, so it must not change anymore.
+            ClientIterator i(*clients);
 
             while(i.HasNext())
             {
@@ -588,10 +785,10 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
                     continue;
 
                 newmsg->clientnum = p->GetClientNum();
-                SendMessage(newmsg);
+                SendSharedMessage(newmsg);
             }
 
-            CHECK_FINAL_DECREF(newmsg, "BroadcastMsg");
+            // No final decref check, the queued packets still reference newmsg.
             break;
         }
         // TODO: NetBase::BC_GROUP
@@ -608,8 +805,8 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
             newmsg.AttachNew(new MsgEntry(me));
             newmsg->msgid = GetRandomID();
 
-            // Message is copied again into packet sections, so we can reuse same one.
-            ClientIterator i(clients);
+            // The packets of all clients reference this copy, so it must not change anymore.
+            ClientIterator i(*clients);
 
             while(i.HasNext())
             {
@@ -617,11 +814,11 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
                 if(p->GetGuildID() == guildID)
                 {
                     newmsg->clientnum = p->GetClientNum();
-                    SendMessage(newmsg);
+                    SendSharedMessage(newmsg);
                 }
             }
 
-            CHECK_FINAL_DECREF(newmsg, "GuildMsg");
+            // No final decref check, the queued packets still reference newmsg.
             break;
         }
         case NetBase::BC_FINALPACKET:
@@ -640,7 +837,7 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
                                                0, 0, (uint32_t) newmsg->bytes->GetTotalSize(),
                                                (uint16_t) newmsg->bytes->GetTotalSize(), newmsg->bytes));
             // this will also delete the pkt
-            SendFinalPacket(pkt);
+            GetShard(newmsg->clientnum)->SendFinalPacket(pkt);
 
             CHECK_FINAL_DECREF(newmsg, "FinalPacket");
             break;
@@ -653,29 +850,42 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
 
 Client* NetManager::GetClient(int cnum)
 {
-    return clients.Find(cnum);
+    return clients->Find(cnum);
 }
 
 Client* NetManager::GetAnyClient(int cnum)
 {
-    return clients.FindAny(cnum);
+    return clients->FindAny(cnum);
 }
 
 
 void NetManager::Multicast(MsgEntry* me, const csArray<PublishDestination> &multi, uint32_t except, float range)
 {
+    if(me->overrun)
+    {
+        CS_ASSERT(!"NetManager::Multicast() Failed to send message in overrun state!\n");
+        return;
+    }
+
+    // The caller may reuse me after this call, so the packets of all
+    // recipients share one private copy of the payload instead.
+    csRef<MsgEntry> shared;
+
     for(size_t i=0; i<multi.GetSize(); i++)
     {
         if(multi[i].client==except)   // skip the exception client to avoid circularity
             continue;
 
-        Client* c = clients.Find(multi[i].client);
+        Client* c = clients->Find(multi[i].client);
         if(c && c->IsReady())
         {
             if(range == 0 || multi[i].dist < range)
             {
-                me->clientnum = multi[i].client;
-                SendMessage(me);      // This copies the mem block, so we can reuse.
+                if(!shared)
+                    shared.AttachNew(new MsgEntry(me));
+
+                shared->clientnum = multi[i].client;
+                SendSharedMessage(shared);
             }
         }
     }
@@ -691,7 +901,8 @@ void NetManager::CheckLinkDead()
     Client* pClient = NULL;
 
     // Delete all clients marked for deletion already
-    clients.SweepDelete();
+    if(owner == this)
+        clients->SweepDelete();
 
     while(true)
     {
@@ -699,12 +910,16 @@ void NetManager::CheckLinkDead()
 
         // Put the iterator in a limited scope so we don't hold on to the lock which may cause deadlock
         {
-            ClientIterator i(clients);
+            ClientIterator i(*clients);
 
             while(i.HasNext())
             {
                 Client* candidate = i.Next();
 
+                // Clients of other shards are checked there
+                if(GetShard(candidate->GetClientNum()) != this)
+                    continue;
+
                 // Skip if already seen
                 if(checkedClients.FindSortedKey(csArrayCmp<uint32_t, uint32_t> (candidate->GetClientNum())) != csArrayItemNotFound)
                     continue;
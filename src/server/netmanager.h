@@ -24,6 +24,7 @@
 // Crystal Space Includes
 //=============================================================================
 #include <csutil/threading/thread.h>
+#include <csutil/array.h>
 
 //=============================================================================
 // Project Includes
@@ -74,6 +75,39 @@ public:
 
     static void Destroy();
 
+    /**
+     * Spread the clients over several network threads.
+     *
+     * Every shard has a socket of its own on the server port. The kernel keeps
+     * the datagrams of an address on the same socket, and a client gets a
+     * client number that belongs to the shard it first reached
+     * (clientnum % count). The shard runs receiving, acks, merging, resends and
+     * link dead checks of its clients with its own awaiting ack table and
+     * sender queues. Completed messages of all shards go to the same message
+     * queues. Call this before Bind().
+     *
+     * @param count Number of network threads, including this one.
+     * @return False if sockets can't share a port on this platform, there is
+     *     one network thread then.
+     */
+    bool SetShardCount(size_t count);
+
+    /// Number of network threads.
+    size_t GetShardCount() const
+    {
+        return csMax(owner->shards.GetSize(), (size_t)1);
+    }
+
+    /// Bind the sockets of all shards to the server address and start them.
+    bool Bind(const char* addr, int port);
+
+    /// NetBase::SetBatchedIO() for all shards.
+    bool SetBatchedIO(size_t batchSize);
+
+    /// Messages of the clients of all shards go to the queue.
+    virtual bool AddMsgQueue(MsgQueue* q, objID minID=0, objID maxID=0xffffffff);
+    virtual void RemoveMsgQueue(MsgQueue* q);
+
     /**
      * This broadcasts the same msg out to a bunch of Clients.
      *
@@ -130,7 +164,7 @@ public:
      */
     ClientConnectionSet* GetConnections()
     {
-        return &clients;
+        return clients;
     }
 
     /**
@@ -160,6 +194,19 @@ public:
      */
     virtual bool SendMessage(MsgEntry* me);
 
+    /**
+     * Sends the given message to the client listed in the message without
+     * copying its payload.
+     *
+     * The queued packets reference the message, so it must not be changed
+     * after this call. Used to fan out one message to many clients.
+     *
+     * @param me Is a message MsgEntry which contains the message and the
+     *     client number to send the message to.
+     * @return Returns success or faliure.
+     */
+    bool SendSharedMessage(MsgEntry* me);
+
     /**
      * Queues the message for sending later, so the calling classes don't have
      * to all manage this themselves.
@@ -216,13 +263,29 @@ protected:
     virtual bool HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* msg);
 
 private:
+    /// Create another shard of owner.
+    NetManager(NetManager* owner, size_t shard);
+
+    /// The shard that handles the given client.
+    NetManager* GetShard(uint32_t clientnum);
+
     /**
      * This cycles through set of pkts awaiting ack and resends old ones.
      */
     void CheckResendPkts(void);
 
-    /// list of connected clients
-    ClientConnectionSet clients;
+    /// list of connected clients, shared by all shards
+    ClientConnectionSet* clients;
+
+    /// The first shard, which owns the clients and the other shards.
+    NetManager* owner;
+
+    /// Index of this shard.
+    size_t shard;
+
+    /// All shards, this one first. Only set in the owner, empty if there is one.
+    csArray<NetManager*> shards;
+    csArray<csRef<CS::Threading::Thread> > shardThreads;
 
     /// UDP port the server binds to
     int port;
@@ -547,6 +547,10 @@ NPCManager::NPCManager(ClientConnectionSet* pCCS,
     gemSupervisor = gemsupervisor;
     cacheManager = cachemanager;
     entityManager = entitymanager;
+    positionsSent = 0;
+    positionEntities = 0;
+    totalPositionsSent = 0;
+    positionTicks = 0;
 
     Subscribe(&NPCManager::HandleAuthentRequest,MSGTYPE_NPCAUTHENT,REQUIRE_ANY_CLIENT);
     Subscribe(&NPCManager::HandleCommandList,MSGTYPE_NPCCOMMANDLIST,REQUIRE_ANY_CLIENT);
@@ -611,6 +615,7 @@ void NPCManager::HandleNPCReady(MsgEntry* me,Client* client)
     // NPC Client is now ready so add onto superclients list
     client->SetReady(true);
     superclients.Push(PublishDestination(client->GetClientNum(), client, 0, 0));
+    gemSupervisor->InvalidateSuperclientSectors();
 
     // TODO: Consider move this to a earlier stage in the load process
     // Update the superclient with entity stats
@@ -839,6 +844,7 @@ void NPCManager::Disconnect(Client* client)
         if((Client*)pd.object == client)
         {
             superclients.DeleteIndex(i);
+            gemSupervisor->InvalidateSuperclientSectors();
             Debug1(LOG_SUPERCLIENT, 0,"Deleted superclient from NPCManager.\n");
             return;
         }
@@ -1987,20 +1993,131 @@ void NPCManager::RemoveEntity(MsgEntry* me)
 
 void NPCManager::UpdateWorldPositions()
 {
-    if(superclients.GetSize())
+    if(!superclients.GetSize())
+        return;
+
+    gemSupervisor->UpdateAllDR();
+
+    csArray<SuperclientPos> changed;
+    gemSupervisor->GetChangedEntityPos(changed);
+
+    csHash<csSet<csPtrKey<iSector> >, AccountID> sectors;
+    bool sectorsChanged = gemSupervisor->GetSuperclientSectors(sectors);
+
+    positionsSent = 0;
+    for(size_t i = 0; i < superclients.GetSize(); i++)
+    {
+        Client* superclient = (Client*)superclients[i].object;
+        AccountID account = superclient->GetAccountID();
+
+        // Players in sectors new to the superclient go first, the
+        // changed positions may update them.
+        csArray<SuperclientPos> added;
+        if(sectorsChanged)
+        {
+            csSet<csPtrKey<iSector> >* newSectors = sectors.GetElementPointer(account);
+            if(newSectors)
+                GetPositionsInNewSectors(account, *newSectors, added);
+        }
+
+        csArray<const SuperclientPos*> positions;
+        for(size_t j = 0; j < added.GetSize(); j++)
+        {
+            positions.Push(&added[j]);
+        }
+
+        csSet<csPtrKey<iSector> >* wanted = sectorsChanged ? sectors.GetElementPointer(account) :
+                                            superclientSectors.GetElementPointer(account);
+        if(wanted)
+        {
+            for(size_t j = 0; j < changed.GetSize(); j++)
+            {
+                const SuperclientPos &pos = changed[j];
+                if(wanted->Contains(pos.sector) || (pos.oldSector && wanted->Contains(pos.oldSector)))
+                    positions.Push(&pos);
+            }
+        }
+
+        if(positions.GetSize())
+            SendWorldPositions(superclient, positions);
+        positionsSent += positions.GetSize();
+    }
+
+    if(sectorsChanged)
     {
-        gemSupervisor->UpdateAllDR();
+        superclientSectors.DeleteAll();
+        csHash<csSet<csPtrKey<iSector> >, AccountID>::GlobalIterator iter(sectors.GetIterator());
+        while(iter.HasNext())
+        {
+            AccountID account;
+            const csSet<csPtrKey<iSector> > &set = iter.Next(account);
+            superclientSectors.Put(account, set);
+        }
+    }
+
+    positionEntities = gemSupervisor->GetAllGEMS().GetSize();
+    totalPositionsSent += positionsSent;
+    positionTicks++;
+}
+
+void NPCManager::GetPositionsInNewSectors(AccountID superclient, const csSet<csPtrKey<iSector> > &sectors,
+        csArray<SuperclientPos> &positions)
+{
+    csSet<csPtrKey<iSector> >* oldSectors = superclientSectors.GetElementPointer(superclient);
+
+    csSet<csPtrKey<iSector> >::GlobalIterator iter(sectors.GetIterator());
+    while(iter.HasNext())
+    {
+        iSector* sector = iter.Next();
+        if(oldSectors && oldSectors->Contains(sector))
+            continue;
 
-        csArray<psAllEntityPosMessage> msgs;
-        gemSupervisor->GetAllEntityPos(msgs);
+        csArray<gemObject*> entities = gemSupervisor->FindSectorEntities(sector, true);
+        for(size_t i = 0; i < entities.GetSize(); i++)
+        {
+            gemObject* obj = entities[i];
+            if(!obj->GetClient() || !obj->GetActorPtr())
+                continue;
+
+            SuperclientPos pos;
+            float yrot;
+            pos.eid = obj->GetEID();
+            obj->GetPosition(pos.pos, yrot, pos.sector);
+            pos.instance = obj->GetInstance();
+            pos.oldSector = NULL;
+            positions.Push(pos);
+        }
+    }
+}
+
+void NPCManager::SendWorldPositions(Client* superclient, const csArray<const SuperclientPos*> &positions)
+{
+    size_t next = 0;
+    while(next < positions.GetSize())
+    {
+        size_t count = csMin(positions.GetSize() - next, (size_t)ALLENTITYPOS_MAX_AMOUNT);
 
-        for(size_t i = 0; i < msgs.GetSize(); i++)
+        psAllEntityPosMessage msg;
+        msg.SetLength((int)count, superclient->GetClientNum());
+        for(size_t i = 0; i < count; i++)
         {
-            msgs.Get(i).Multicast(superclients,-1,PROX_LIST_ANY_RANGE);
+            SuperclientPos pos = *positions[next++];
+            msg.Add(pos.eid, pos.pos, pos.sector, pos.instance, cacheManager->GetMsgStrings());
         }
+        msg.msg->ClipToCurrentSize();  // Actual Data size
+        msg.SendMessage();
     }
 }
 
+csString NPCManager::GetWorldPositionStats() const
+{
+    csString stats;
+    stats.Format("%zu positions of %zu entities sent last tick, %.1f per tick",
+                 positionsSent, positionEntities,
+                 positionTicks ? (float)totalPositionsSent / positionTicks : 0.0f);
+    return stats;
+}
+
 bool NPCManager::CanPetHearYou(int clientnum, Client* owner, gemNPC* pet, const char* type)
 {
     MathEnvironment env;
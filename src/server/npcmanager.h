@@ -22,7 +22,9 @@
 //=============================================================================
 // Crystal Space Includes
 //=============================================================================
+#include <csutil/hash.h>
 #include <csutil/ref.h>
+#include <csutil/set.h>
 
 //=============================================================================
 // Project Includes
@@ -56,6 +58,7 @@ class Waypoint;
 class psPath;
 class Location;
 class LocationType;
+struct SuperclientPos;
 
 class NPCManager : public MessageManager<NPCManager>
 {
@@ -87,9 +90,15 @@ public:
     /// Communicate a entity going away to connected superclients.
     void RemoveEntity(MsgEntry* me);
 
-    /// Build a message with all changed world positions for superclients to get.
+    /**
+     * Send the player positions that changed to the superclients, each only
+     * in the sectors it has NPCs in or next to.
+     */
     void UpdateWorldPositions();
 
+    /// Get statistics about the positions sent to superclients for the server console.
+    csString GetWorldPositionStats() const;
+
     /// Let the superclient know the result of an assessment
     void QueueAssessPerception(EID entityEID, EID targetEID, const csString &physicalAssessmentPerception,
                                const csString &physicalAssessmentDifferencePerception,
@@ -415,9 +424,28 @@ protected:
      */
     void CheckSendPerceptionQueue(size_t expectedAddSize);
 
+    /// Send positions to a superclient, in as many messages as needed.
+    void SendWorldPositions(Client* superclient, const csArray<const SuperclientPos*> &positions);
+
+    /**
+     * Add the players in the sectors superclient didn't need positions in
+     * before to positions, as it doesn't know where they are.
+     */
+    void GetPositionsInNewSectors(AccountID superclient, const csSet<csPtrKey<iSector> > &sectors,
+                                  csArray<SuperclientPos> &positions);
+
     /// List of active superclients.
     csArray<PublishDestination> superclients;
 
+    /// Sectors each superclient gets player positions in.
+    csHash<csSet<csPtrKey<iSector> >, AccountID> superclientSectors;
+
+    /// Statistics of UpdateWorldPositions()
+    size_t positionsSent;        ///< Positions sent last tick, counted per superclient
+    size_t positionEntities;     ///< Entities in the world last tick
+    uint64 totalPositionsSent;
+    uint64 positionTicks;
+
     psDatabase*  database;
     EventManager* eventmanager;
     GEMSupervisor* gemSupervisor;
@@ -75,6 +75,11 @@ ProximityList::ProximityList(iObjectRegistry* object_reg, gemObject* parent, Ent
     self = parent;
 
     clientnum = 0;
+    touchGeneration = 1;
+    comparisons = 0;
+    lastComparisons = 0;
+    totalComparisons = 0;
+    updates = 0;
     float rot;
     iSector* sector;
     firstFrame = true;
@@ -91,17 +96,15 @@ ProximityList::~ProximityList()
     while(objectsThatIWatch.GetSize())
     {
 #ifdef PSPROXDEBUG
-        CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n", objectsThatIWatch[0]->GetName(), this);
+        CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n", objectsThatIWatch.Top()->GetName(), this);
 #endif
 
-        objectsThatIWatch[0]->GetProxList()->RemoveWatcher(self);
-        objectsThatIWatch.DeleteIndex(0);
-        objectsThatIWatch_touched.DeleteIndex(0);
+        EndWatching(objectsThatIWatch.Top());
     }
 
     while(objectsThatWatchMe.GetSize())
     {
-        gemObject* obj = (gemObject*)objectsThatWatchMe.Get(0).object;
+        gemObject* obj = (gemObject*)objectsThatWatchMe.Top().object;
 #ifdef PSPROXDEBUG
         CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n",obj->GetName(), this);
 #endif
@@ -170,8 +173,16 @@ void ProximityList::AddWatcher(gemObject* interestedObject, float range)
 
     destRangeTimer.Push(0);
     size_t i = objectsThatWatchMe.Push(PublishDestination(interestedObject->GetClientID(), interestedObject, 0, 100));
+    objectsThatWatchMe_touched.Push(touchGeneration);
+    watchMeIndex.Put(interestedObject, i);
+
+    size_t* watchers = clientWatchers.GetElementPointer(objectsThatWatchMe[i].client);
+    if(watchers)
+        (*watchers)++;
+    else
+        clientWatchers.Put(objectsThatWatchMe[i].client, 1);
+
     UpdatePublishDestRange(&objectsThatWatchMe[i], self, interestedObject, i, range);
-    objectsThatWatchMe_touched.Push(true);
 }
 
 bool ProximityList::EndMutualWatching(gemObject* fromobject)
@@ -192,89 +203,94 @@ bool ProximityList::StartWatching(gemObject* object, float range)
         return false;
     }
 
-    objectsThatIWatch.Push(object);
-    objectsThatIWatch_touched.Push(true);
+    size_t i = objectsThatIWatch.Push(object);
+    objectsThatIWatch_touched.Push(touchGeneration);
+    iWatchIndex.Put(object, i);
     object->GetProxList()->AddWatcher(self, range);
     return true;
 }
 
 void ProximityList::EndWatching(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatIWatch.GetSize(); x++)
-    {
-        if(objectsThatIWatch[x] == object)
-        {
-            objectsThatIWatch[x]->GetProxList()->RemoveWatcher(self);
-            objectsThatIWatch.DeleteIndex(x);
-            objectsThatIWatch_touched.DeleteIndex(x);
-            return;
-        }
-    }
+    comparisons++;
+    size_t x = iWatchIndex.Get(object, csArrayItemNotFound);
+    if(x == csArrayItemNotFound)
+        return;
+
+    object->GetProxList()->RemoveWatcher(self);
+    RemoveWatchedAt(x);
+}
+
+void ProximityList::RemoveWatchedAt(size_t index)
+{
+    iWatchIndex.DeleteAll(objectsThatIWatch[index]);
+    objectsThatIWatch.DeleteIndexFast(index);
+    objectsThatIWatch_touched.DeleteIndexFast(index);
+
+    // The last entry was moved into the hole.
+    if(index < objectsThatIWatch.GetSize())
+        iWatchIndex.PutUnique(objectsThatIWatch[index], index);
 }
 
 void ProximityList::RemoveWatcher(gemObject* object)
 {
     // Remove the target's entity/client from our list
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe.DeleteIndex(x);
-            objectsThatWatchMe_touched.DeleteIndex(x);
-            destRangeTimer.DeleteIndex(x);
-            return;
-        }
-    }
+    comparisons++;
+    size_t x = watchMeIndex.Get(object, csArrayItemNotFound);
+    if(x != csArrayItemNotFound)
+        RemoveWatcherAt(x);
+}
+
+void ProximityList::RemoveWatcherAt(size_t index)
+{
+    uint32_t client = objectsThatWatchMe[index].client;
+    size_t* watchers = clientWatchers.GetElementPointer(client);
+    if(watchers && --(*watchers) == 0)
+        clientWatchers.DeleteAll(client);
+
+    watchMeIndex.DeleteAll((gemObject*)objectsThatWatchMe[index].object);
+    objectsThatWatchMe.DeleteIndexFast(index);
+    objectsThatWatchMe_touched.DeleteIndexFast(index);
+    destRangeTimer.DeleteIndexFast(index);
+
+    // The last entry was moved into the hole.
+    if(index < objectsThatWatchMe.GetSize())
+        watchMeIndex.PutUnique((gemObject*)objectsThatWatchMe[index].object, index);
 }
 
 bool ProximityList::FindClient(uint32_t cnum)
 {
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].client == cnum)
-        {
-            return true;
-        }
-    }
-    return false;
+    comparisons++;
+    return clientWatchers.Contains(cnum);
 }
 
 bool ProximityList::FindObject(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            return true;
-        }
-    }
-    return false;
+    comparisons++;
+    return watchMeIndex.Contains(object);
 }
 
 PublishDestination* ProximityList::FindObjectThatWatchesMe(gemObject* object, uint &x)
 {
-    for(x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe_touched[x] = true;
-            return &objectsThatWatchMe[x];
-        }
-    }
-    return NULL;
+    comparisons++;
+    size_t index = watchMeIndex.Get(object, csArrayItemNotFound);
+    if(index == csArrayItemNotFound)
+        return NULL;
+
+    x = (uint)index;
+    objectsThatWatchMe_touched[index] = touchGeneration;
+    return &objectsThatWatchMe[index];
 }
 
 bool ProximityList::FindObjectThatIWatch(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatIWatch.GetSize(); x++)
-    {
-        if(objectsThatIWatch[x] == object)
-        {
-            objectsThatIWatch_touched[x] = true;
-            return true;
-        }
-    }
-    return false;
+    comparisons++;
+    size_t index = iWatchIndex.Get(object, csArrayItemNotFound);
+    if(index == csArrayItemNotFound)
+        return false;
+
+    objectsThatIWatch_touched[index] = touchGeneration;
+    return true;
 }
 
 gemObject* ProximityList::FindObjectName(const char* name)
@@ -367,14 +383,11 @@ void ProximityList::UpdatePublishDestRange(PublishDestination* pd, gemObject* my
 
 void ProximityList::TouchObjectThatWatchesMe(gemObject* object,float newrange)
 {
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
+    uint x;
+    PublishDestination* pd = FindObjectThatWatchesMe(object, x);
+    if(pd)
     {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe_touched[x] = true;
-            UpdatePublishDestRange(&objectsThatWatchMe[x], self, object, x, newrange);
-            return;
-        }
+        UpdatePublishDestRange(pd, self, object, x, newrange);
     }
 }
 
@@ -400,40 +413,30 @@ bool ProximityList::CheckUpdateRequired()
 
 void ProximityList::ClearTouched()
 {
-    size_t objNum;
+    // Bumping the generation leaves every entry untouched without visiting it.
+    touchGeneration++;
 
-    for(objNum = 0; objNum < objectsThatWatchMe_touched.GetSize(); objNum++)
-        objectsThatWatchMe_touched[objNum] = false;
-    for(objNum = 0; objNum < objectsThatIWatch_touched.GetSize(); objNum++)
-        objectsThatIWatch_touched[objNum]  = false;
+    updates++;
+    lastComparisons = comparisons;
+    totalComparisons += comparisons;
+    comparisons = 0;
 }
 
-bool ProximityList::GetUntouched_ObjectThatWatchesMe(gemObject* &object)
+void ProximityList::GetUntouched(csArray<gemObject*> &watched, csArray<gemObject*> &watchers)
 {
-    for(size_t x = 0; x < objectsThatWatchMe_touched.GetSize(); x++)
+    size_t x;
+
+    for(x = 0; x < objectsThatIWatch_touched.GetSize(); x++)
     {
-        if(!objectsThatWatchMe_touched[x])
-        {
-            object = (gemObject*)objectsThatWatchMe[x].object;
-            objectsThatWatchMe_touched[x] = true;
-            return true;
-        }
+        if(objectsThatIWatch_touched[x] != touchGeneration)
+            watched.Push(objectsThatIWatch[x]);
     }
-    return false;
-}
-
-bool ProximityList::GetUntouched_ObjectThatIWatch(gemObject* &object)
-{
-    for(size_t x = 0; x < objectsThatIWatch_touched.GetSize(); x++)
+    for(x = 0; x < objectsThatWatchMe_touched.GetSize(); x++)
     {
-        if(!objectsThatIWatch_touched[x])
-        {
-            object = objectsThatIWatch[x];
-            objectsThatIWatch_touched[x] = true;
-            return true;
-        }
+        if(objectsThatWatchMe_touched[x] != touchGeneration)
+            watchers.Push((gemObject*)objectsThatWatchMe[x].object);
     }
-    return false;
+    comparisons += objectsThatIWatch_touched.GetSize() + objectsThatWatchMe_touched.GetSize();
 }
 
 
@@ -497,6 +500,8 @@ void ProximityList::DebugDumpContents(csString &out)
     csString temp;
 
     temp.AppendFmt("I represent client %d\n",clientnum);
+    temp.AppendFmt("Comparisons per update: %zu last, %.1f average over %zu updates\n",
+                   lastComparisons, updates ? (float)totalComparisons / (float)updates : 0.0f, updates);
     temp.AppendFmt("I am publishing updates to:\n");
 
     for(x = 0; x < objectsThatWatchMe.GetSize(); x++)
@@ -47,8 +47,9 @@ class EntityManager;
  *    - values in objectsThatIWatch  are unique
  *    - object X is in objectsThatWatchMe of object Y <===> object Y must be in objectsThatIWatch of X
  *    - objects with GetClientID()==0 have empty objectsThatIWatch
- *    - correspondence between objectsThatWatchMe and objectsThatWatchMe_touched
+ *    - correspondence between objectsThatWatchMe, objectsThatWatchMe_touched and destRangeTimer
  *                             objectsThatIWatch  and objectsThatIWatch_touched
+ *    - watchMeIndex and iWatchIndex hold the position of every object in the arrays above
  */
 
 class ProximityList
@@ -60,8 +61,21 @@ protected:
     csArray<gemObject*>  objectsThatIWatch;           ///< What objects am I subscribed to myself?
     csArray<csTicks> destRangeTimer;       ///< Per-object timeout on dest range checks.
 
-    csArray<bool> objectsThatWatchMe_touched;
-    csArray<bool> objectsThatIWatch_touched;
+    /// Generation in which each entry was last touched, see ClearTouched().
+    csArray<uint> objectsThatWatchMe_touched;
+    csArray<uint> objectsThatIWatch_touched;
+
+    csHash<size_t, csPtrKey<gemObject> > watchMeIndex;  ///< Position of each object in objectsThatWatchMe.
+    csHash<size_t, csPtrKey<gemObject> > iWatchIndex;   ///< Position of each object in objectsThatIWatch.
+    csHash<size_t, uint32_t> clientWatchers;            ///< Number of objects in objectsThatWatchMe per client.
+
+    uint touchGeneration;
+
+    /// Statistics
+    size_t comparisons;         ///< Lookups and compares done since the last update started.
+    size_t lastComparisons;     ///< Lookups and compares done during the previous update.
+    size_t totalComparisons;
+    size_t updates;
 
     int          clientnum;
     bool         firstFrame;
@@ -76,6 +90,12 @@ protected:
     /** Removes 'interestedobject' from 'objectsThatWatchMe' */
     void RemoveWatcher(gemObject* object);
 
+    /** Removes the entry at index from 'objectsThatWatchMe', moving the last entry into its place */
+    void RemoveWatcherAt(size_t index);
+
+    /** Removes the entry at index from 'objectsThatIWatch', moving the last entry into its place */
+    void RemoveWatchedAt(size_t index);
+
     bool IsNear(iSector* sector,csVector3 &pos,gemObject* object,float radius);
     bool FindObject(gemObject* object);
     PublishDestination* FindObjectThatWatchesMe(gemObject* object, uint &x);
@@ -128,9 +148,21 @@ public:
     float RangeTo(gemObject* object, bool ignoreY = false, bool ignoreInstance = false);
     void DebugDumpContents(csString &out);
 
+    /**
+     * Start a new update. Every entry is untouched until it is found again
+     * by StartWatching() or AddWatcher().
+     */
     void ClearTouched();
-    bool GetUntouched_ObjectThatWatchesMe(gemObject* &object);
-    bool GetUntouched_ObjectThatIWatch(gemObject* &object);
+
+    /**
+     * Collect all entries that weren't touched since ClearTouched() in one sweep.
+     *
+     * The lists aren't changed, so the caller can end the relations afterwards.
+     *
+     * @param watched  Receives the objects we watch that left our range.
+     * @param watchers Receives the objects watching us that left their range.
+     */
+    void GetUntouched(csArray<gemObject*> &watched, csArray<gemObject*> &watchers);
 };
 
 #endif
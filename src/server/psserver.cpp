@@ -73,6 +73,7 @@
 #include "guildmanager.h"
 #include "hiremanager.h"
 #include "introductionmanager.h"
+#include "itemsavequeue.h"
 #include "serversongmngr.h"
 #include "marriagemanager.h"
 #include "minigamemanager.h"
@@ -128,6 +129,7 @@ psServer::psServer()
     npcmanager          = NULL;
     spellmanager        = NULL;
     rng                 = NULL;
+    itemSaveQueue       = NULL;
     questmanager        = NULL;
     gmeventManager      = NULL;
     bankmanager         = NULL;
@@ -148,6 +150,10 @@ psServer::psServer()
 
 psServer::~psServer()
 {
+    // The login workers use the cache manager and the database.
+    if(authserver)
+        authserver->StopLoginWorkers();
+
     // Kick players from server
     if(netmanager)
     {
@@ -196,6 +202,9 @@ psServer::~psServer()
     delete minigamemanager;
     delete cachemanager;
     delete questmanager;
+    // Writes the items that are still queued, needs the database.
+    delete itemSaveQueue;
+    itemSaveQueue = NULL;
     delete database;
     delete logcsv;
     delete rng;
@@ -324,6 +333,20 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
 
     Debug1(LOG_STARTUP,0,"Started Database");
 
+    if(configmanager->GetBool("PlaneShift.Server.ItemSave.WriteBehind", false))
+    {
+        itemSaveQueue = new ItemSaveQueue(object_reg,
+                                          configmanager->GetInt("PlaneShift.Server.ItemSave.BatchSize", 100),
+                                          configmanager->GetInt("PlaneShift.Server.ItemSave.Interval", 1000),
+                                          configmanager->GetInt("PlaneShift.Server.ItemSave.UIDRange", 1000));
+        if(!itemSaveQueue->Initialize(db_host, db_port, db_user, db_pass, db_name))
+        {
+            CPrintf(CON_WARNING, "Could not start the item save queue, items are saved right away.\n");
+            delete itemSaveQueue;
+            itemSaveQueue = NULL;
+        }
+    }
+
     Debug1(LOG_STARTUP,0,"Filling loader cache");
 
     csRef<iBgLoader> loader = csQueryRegistry<iBgLoader>(object_reg);
@@ -414,6 +437,21 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
         configmanager->GetInt("PlaneShift.Server.Port", 1243);
     Debug3(LOG_STARTUP,0,COL_BLUE "Listening on '%s' Port %d." COL_NORMAL,
            (const char*) serveraddr, port);
+
+    int shards = configmanager->GetInt("PlaneShift.Server.Network.Shards", 1);
+    if(shards > 1 && !netmanager->SetShardCount(shards))
+    {
+        CPrintf(CON_WARNING, "Network threads can't share the server port on this platform, using one network thread.\n");
+    }
+
+    if(configmanager->GetBool("PlaneShift.Server.Network.BatchedIO", false))
+    {
+        int batchSize = configmanager->GetInt("PlaneShift.Server.Network.BatchSize", 32);
+        if(!netmanager->SetBatchedIO(csMax(batchSize, 1)))
+        {
+            CPrintf(CON_WARNING, "Batched network I/O isn't available on this platform, sending one packet per call.\n");
+        }
+    }
     if(!netmanager->Bind(serveraddr, port))
     {
         Error1("Failed to bind");
@@ -430,13 +468,15 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
     // both messages and events. For backward compablility
     // we still store two points. But they are one object
     // and one thread.
-    eventmanager.AttachNew(new EventManager);
+    eventmanager.AttachNew(new EventManager(configmanager->GetBool("PlaneShift.Server.Events.TimingWheel", false)));
     if(!eventmanager)
         return false;
 
     // This gives access to msghandler to all message types
     psMessageCracker::msghandler = eventmanager;
 
+    eventmanager->StartWorkers(configmanager->GetInt("PlaneShift.Server.Events.Workers", 0));
+
     if(!eventmanager->Initialize(netmanager, 1000))
         return false;
 
@@ -534,6 +574,7 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
     Debug1(LOG_STARTUP,0,"Started Action Manager");
 
     authserver.AttachNew(new AuthenticationServer(GetConnections(), usermanager, guildmanager));
+    authserver->StartLoginWorkers(configmanager->GetInt("PlaneShift.Server.Login.Workers", 0));
     Debug1(LOG_STARTUP,0,"Started Authentication Server");
 
     exchangemanager = new ExchangeManager(GetConnections());
@@ -89,6 +89,7 @@ class  BankManager;
 class  HireManager;
 class  ServerConsole;
 class  psQuitEvent;
+class  ItemSaveQueue;
 
 /**
  * \addtogroup server
@@ -561,6 +562,16 @@ public:
         return tutorialmanager;
     }
 
+    /**
+     * Returns the queue that writes item instances in the background.
+     *
+     * @return The queue, or NULL if items are saved right away.
+     */
+    ItemSaveQueue* GetItemSaveQueue()
+    {
+        return itemSaveQueue;
+    }
+
     /**
      * Returns a pointer to the AuthenticationServer.
      */
@@ -836,6 +847,7 @@ protected:
     GMEventManager*                 gmeventManager;
     BankManager*                    bankmanager;
     HireManager*                    hiremanager;
+    ItemSaveQueue*                  itemSaveQueue;
 
     psQuitEvent* server_quit_event; ///< Used to keep track of the shut down event
 
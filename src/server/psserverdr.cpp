@@ -31,6 +31,7 @@
 //=============================================================================
 #include "net/message.h"
 #include "net/msghandler.h"
+#include "net/drmessages.h"
 
 #include "engine/linmove.h"
 
@@ -68,12 +69,15 @@ psServerDR::psServerDR(CacheManager* cachemanager, EntityManager* entitymanager)
     cacheManager = cachemanager;
     entityManager = entitymanager;
     paladin = NULL;
+    record = NULL;
     calc_damage = psserver->GetMathScriptEngine()->FindScript("Calculate Fall Damage");
 }
 
 psServerDR::~psServerDR()
 {
     delete paladin;
+    if(record)
+        fclose(record);
 }
 
 bool psServerDR::Initialize()
@@ -90,6 +94,16 @@ bool psServerDR::Initialize()
     paladin = new PaladinJr;
     paladin->Initialize(entityManager, cacheManager);
 
+    csString recordFile = psserver->GetConfig()->GetStr("PlaneShift.Server.DRRecord", "");
+    if(!recordFile.IsEmpty())
+    {
+        record = fopen(recordFile, "a");
+        if(!record)
+            CPrintf(CON_WARNING, "Couldn't open %s to record DR updates.\n", recordFile.GetData());
+    }
+
+    DRInterest::Configure(psserver->GetConfig());
+
     return true;
 }
 
@@ -100,6 +114,14 @@ void psServerDR::SendPersist()
     return;
 }
 
+void psServerDR::Record(EID eid, uint8_t counter, const psDRUpdate &update)
+{
+    if(!record)
+        return;
+
+    fprintf(record, "%s\n", update.Record(csGetTicks(), eid, counter).GetData());
+}
+
 void psServerDR::HandleFallDamage(gemActor* actor,int clientnum, const csVector3 &pos, iSector* sector)
 {
     float fallHeight = actor->FallEnded(pos,sector);
@@ -173,6 +195,7 @@ void psServerDR::HandleDeadReckoning(MsgEntry* me,Client* client)
             client->CountDetectedCheat();  // This DR data may be an exploit but may also be valid from lag.
             actor->pcmove->AddVelocity(csVector3(0,-1,0));
             actor->UpdateDR();
+            entityManager->GetGEM()->MarkMoving(actor);
             actor->MulticastDRUpdate();
             return;
         }
@@ -274,10 +297,9 @@ void psServerDR::HandleDeadReckoning(MsgEntry* me,Client* client)
     }
     */
 
-    // Now multicast to other clients
-    psserver->GetEventManager()->Multicast(me,
-                                           actor->GetMulticastClients(),
-                                           me->clientnum,PROX_LIST_ANY_RANGE);
+    // Now multicast to other clients, through the encoder of the actor so
+    // they get compact updates and the interest tiers apply.
+    actor->MulticastDRUpdate(me->clientnum);
 
     paladin->CheckCollDetection(client, actor);
 
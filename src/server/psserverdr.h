@@ -38,6 +38,7 @@ class MathScript;
 class PaladinJr;
 class CacheManager;
 class EntityManager;
+struct psDRUpdate;
 
 class psServerDR : public MessageManager<psServerDR>
 {
@@ -49,6 +50,13 @@ public:
 
     void SendPersist();
 
+    /**
+     * Append an update sent to the clients to the recording, if
+     * PlaneShift.Server.DRRecord names a file. The drbench tool replays
+     * recordings to compare the DR message formats.
+     */
+    void Record(EID eid, uint8_t counter, const psDRUpdate &update);
+
 protected:
 
     void HandleDeadReckoning(MsgEntry* me,Client* client);
@@ -62,6 +70,8 @@ protected:
 
     CacheManager* cacheManager;
     EntityManager* entityManager;
+
+    FILE* record;
 };
 
 #endif
@@ -46,6 +46,8 @@
 #include "clientstatuslogger.h"
 #include "bulkobjects/pssectorinfo.h"
 #include "economymanager.h"
+#include "drinterest.h"
+#include "authentserver.h"
 
 
 /*****************************************************************
@@ -112,6 +114,15 @@ void psServerStatusRunEvent::Trigger()
         if(!obj->GetClient() && obj->GetCharacterData())
             ReportNPC(obj->GetCharacterData(), reportString);
     }
+    // Record how the DR updates were spread over the tiers
+    for(int tier = 0; tier < DR_TIER_COUNT; tier++)
+    {
+        reportString.AppendFmt("<dr_tier name=\"%s\" sent=\"%u\" folded=\"%u\" flushed=\"%u\" />\n",
+                               DRInterest::GetTierName((DRTier)tier), DRInterest::sent[tier],
+                               DRInterest::folded[tier], DRInterest::flushed[tier]);
+    }
+    // Record the login queue and how long the login stages took
+    psserver->GetAuthServer()->AppendLoginReport(reportString);
     reportString.Append("</server_report>");
 
     csRef<iFile> logFile = psserver->vfs->Open(ServerStatus::reportFile, VFS_FILE_WRITE);
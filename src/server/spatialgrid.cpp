@@ -0,0 +1,350 @@
+/*
+ * spatialgrid.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <iengine/sector.h>
+#include <iengine/mesh.h>
+#include <iengine/portal.h>
+#include <iengine/portalcontainer.h>
+#include <csutil/csstring.h>
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "spatialgrid.h"
+#include "gem.h"
+
+
+SpatialGrid::SectorGrid::~SectorGrid()
+{
+    csHash<Cell*, SpatialGridCellKey>::GlobalIterator it(cells.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
+}
+
+SpatialGrid::SpatialGrid(float cellSize)
+    : cellSize(cellSize), queries(0), slotsTested(0), found(0)
+{
+}
+
+SpatialGrid::~SpatialGrid()
+{
+    csHash<SectorGrid*, csPtrKey<iSector> >::GlobalIterator it(sectors.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
+}
+
+SpatialGridCellKey SpatialGrid::GetKey(InstanceID instance, const csVector3 &pos) const
+{
+    return SpatialGridCellKey(instance, (int)floorf(pos.x / cellSize), (int)floorf(pos.z / cellSize));
+}
+
+SpatialGrid::SectorGrid* SpatialGrid::GetSectorGrid(iSector* sector, bool create)
+{
+    SectorGrid* grid = sectors.Get(sector, NULL);
+    if(!grid && create)
+    {
+        grid = new SectorGrid;
+        sectors.Put(sector, grid);
+    }
+    return grid;
+}
+
+bool SpatialGrid::Update(gemObject* obj, iSector* sector, InstanceID instance, const csVector3 &pos)
+{
+    if(!sector)
+    {
+        Remove(obj);
+        return true;
+    }
+
+    SpatialGridCellKey key = GetKey(instance, pos);
+    Entry* entry = entries.GetElementPointer(obj->GetEID());
+    if(entry)
+    {
+        // Still in the same cell, only the position changes.
+        if(entry->sector == sector && entry->key == key)
+        {
+            GetSectorGrid(sector, false)->cells.Get(key, NULL)->slots[entry->index].pos = pos;
+            return false;
+        }
+        bool sectorChanged = entry->sector != sector;
+        RemoveSlot(*entry);
+        Insert(obj, sector, key, pos, *entry);
+        return sectorChanged;
+    }
+
+    Entry newEntry;
+    Insert(obj, sector, key, pos, newEntry);
+    entries.Put(obj->GetEID(), newEntry);
+    return true;
+}
+
+void SpatialGrid::Insert(gemObject* obj, iSector* sector, const SpatialGridCellKey &key, const csVector3 &pos, Entry &entry)
+{
+    SectorGrid* grid = GetSectorGrid(sector, true);
+    Cell* cell = grid->cells.Get(key, NULL);
+    if(!cell)
+    {
+        cell = new Cell;
+        grid->cells.Put(key, cell);
+    }
+
+    Slot slot;
+    slot.obj = obj;
+    slot.pos = pos;
+
+    entry.sector = sector;
+    entry.key = key;
+    entry.index = cell->slots.Push(slot);
+
+    size_t* count = grid->instances.GetElementPointer(key.instance);
+    if(count)
+        (*count)++;
+    else
+        grid->instances.Put(key.instance, 1);
+}
+
+void SpatialGrid::Remove(gemObject* obj)
+{
+    Entry* entry = entries.GetElementPointer(obj->GetEID());
+    if(!entry)
+        return;
+
+    RemoveSlot(*entry);
+    entries.DeleteAll(obj->GetEID());
+}
+
+void SpatialGrid::RemoveSlot(const Entry &entry)
+{
+    SectorGrid* grid = GetSectorGrid(entry.sector, false);
+    Cell* cell = grid->cells.Get(entry.key, NULL);
+
+    // Swap the last slot into the hole so the cell stays dense.
+    size_t last = cell->slots.GetSize() - 1;
+    if(entry.index != last)
+    {
+        cell->slots[entry.index] = cell->slots[last];
+        entries.GetElementPointer(cell->slots[entry.index].obj->GetEID())->index = entry.index;
+    }
+    cell->slots.Truncate(last);
+
+    if(cell->slots.IsEmpty())
+    {
+        grid->cells.DeleteAll(entry.key);
+        delete cell;
+    }
+
+    size_t* count = grid->instances.GetElementPointer(entry.key.instance);
+    if(count && --(*count) == 0)
+    {
+        grid->instances.DeleteAll(entry.key.instance);
+    }
+}
+
+void SpatialGrid::LoadPortals(iSector* sector, SectorGrid* grid)
+{
+    grid->portalsLoaded = true;
+
+    const csSet<csPtrKey<iMeshWrapper> > &portalMeshes = sector->GetPortalMeshes();
+    csSet<csPtrKey<iMeshWrapper> >::GlobalIterator it = portalMeshes.GetIterator();
+    while(it.HasNext())
+    {
+        iMeshWrapper* portalMesh = it.Next();
+        iPortalContainer* pc = portalMesh->GetPortalContainer();
+        for(int i = 0; i < pc->GetPortalCount(); i++)
+        {
+            iPortal* portal = pc->GetPortal(i);
+            if(!portal->CompleteSector(0) || !portal->GetSector())
+                continue;
+
+            // Bounding sphere of the portal polygon in world space.
+            const csVector3* vertices = portal->GetWorldVertices();
+            const int* indices = portal->GetVertexIndices();
+            int count = portal->GetVertexIndicesCount();
+            if(!count)
+                continue;
+
+            csVector3 center(0.0f);
+            for(int v = 0; v < count; v++)
+                center += vertices[indices[v]];
+            center /= (float)count;
+
+            float radius = 0.0f;
+            for(int v = 0; v < count; v++)
+                radius = csMax(radius, (vertices[indices[v]] - center).Norm());
+
+            Portal p;
+            p.target = portal->GetSector();
+            p.center = center;
+            p.radius = radius;
+            p.warp = portal->GetWarp();
+            grid->portals.Push(p);
+        }
+    }
+}
+
+void SpatialGrid::FindNearby(iSector* sector, const csVector3 &pos, InstanceID instance, float radius, csArray<gemObject*> &list)
+{
+    csArray<iSector*> visited;
+    queries++;
+    FindNearby(sector, pos, instance, radius, list, visited);
+}
+
+void SpatialGrid::FindNearby(iSector* sector, const csVector3 &pos, InstanceID instance, float radius,
+                             csArray<gemObject*> &list, csArray<iSector*> &visited)
+{
+    visited.Push(sector);
+
+    SectorGrid* grid = GetSectorGrid(sector, true);
+    if(!grid->portalsLoaded)
+        LoadPortals(sector, grid);
+
+    if(instance == INSTANCE_ALL)
+    {
+        csHash<size_t, InstanceID>::GlobalIterator it(grid->instances.GetIterator());
+        while(it.HasNext())
+        {
+            InstanceID inst;
+            it.Next(inst);
+            CollectCells(grid, inst, pos, radius, list);
+        }
+    }
+    else
+    {
+        CollectCells(grid, instance, pos, radius, list);
+        CollectCells(grid, INSTANCE_ALL, pos, radius, list);
+    }
+
+    // Continue into neighbouring sectors through portals within reach.
+    for(size_t i = 0; i < grid->portals.GetSize(); i++)
+    {
+        const Portal &portal = grid->portals[i];
+        if(visited.Find(portal.target) != csArrayItemNotFound)
+            continue;
+
+        if((portal.center - pos).Norm() - portal.radius > radius)
+            continue;
+
+        csVector3 warped = portal.warp * pos;
+        FindNearby(portal.target, warped, instance, radius, list, visited);
+    }
+}
+
+void SpatialGrid::CollectCells(SectorGrid* grid, InstanceID instance, const csVector3 &pos, float radius,
+                               csArray<gemObject*> &list)
+{
+    if(!grid->instances.Contains(instance))
+        return;
+
+    float radiusSquared = radius * radius;
+    SpatialGridCellKey min = GetKey(instance, pos - csVector3(radius));
+    SpatialGridCellKey max = GetKey(instance, pos + csVector3(radius));
+
+    size_t cellCount = (size_t)(max.x - min.x + 1) * (size_t)(max.z - min.z + 1);
+    if(cellCount > SPATIAL_GRID_MAX_QUERY_CELLS || cellCount > grid->cells.GetSize())
+    {
+        // Cheaper to look at every cell of the sector than probe them one by one.
+        csHash<Cell*, SpatialGridCellKey>::GlobalIterator it(grid->cells.GetIterator());
+        while(it.HasNext())
+        {
+            SpatialGridCellKey key;
+            Cell* cell = it.Next(key);
+            if(key.instance == instance)
+                CollectCell(cell, pos, radiusSquared, list);
+        }
+        return;
+    }
+
+    for(int x = min.x; x <= max.x; x++)
+    {
+        for(int z = min.z; z <= max.z; z++)
+        {
+            Cell* cell = grid->cells.Get(SpatialGridCellKey(instance, x, z), NULL);
+            if(cell)
+                CollectCell(cell, pos, radiusSquared, list);
+        }
+    }
+}
+
+void SpatialGrid::CollectCell(const Cell* cell, const csVector3 &pos, float radiusSquared, csArray<gemObject*> &list)
+{
+    size_t count = cell->slots.GetSize();
+    slotsTested += count;
+    for(size_t i = 0; i < count; i++)
+    {
+        const Slot &slot = cell->slots[i];
+        if((slot.pos - pos).SquaredNorm() <= radiusSquared)
+        {
+            list.Push(slot.obj);
+            found++;
+        }
+    }
+}
+
+void SpatialGrid::FindInSector(iSector* sector, csArray<gemObject*> &list)
+{
+    SectorGrid* grid = GetSectorGrid(sector, false);
+    if(!grid)
+        return;
+
+    csHash<Cell*, SpatialGridCellKey>::GlobalIterator it(grid->cells.GetIterator());
+    while(it.HasNext())
+    {
+        Cell* cell = it.Next();
+        for(size_t i = 0; i < cell->slots.GetSize(); i++)
+        {
+            list.Push(cell->slots[i].obj);
+        }
+    }
+}
+
+void SpatialGrid::FindNeighbours(iSector* sector, csArray<iSector*> &list)
+{
+    SectorGrid* grid = GetSectorGrid(sector, true);
+    if(!grid->portalsLoaded)
+        LoadPortals(sector, grid);
+
+    for(size_t i = 0; i < grid->portals.GetSize(); i++)
+    {
+        list.PushSmart(grid->portals[i].target);
+    }
+}
+
+csString SpatialGrid::GetStats() const
+{
+    size_t cellCount = 0;
+    csHash<SectorGrid*, csPtrKey<iSector> >::ConstGlobalIterator it(sectors.GetIterator());
+    while(it.HasNext())
+    {
+        cellCount += it.Next()->cells.GetSize();
+    }
+
+    csString stats;
+    stats.Format("%zu entities in %zu cells of %zu sectors. %zu queries tested %zu entities (%.1f per query) and found %zu.",
+                 entries.GetSize(), cellCount, sectors.GetSize(), queries, slotsTested,
+                 queries ? (float)slotsTested / (float)queries : 0.0f, found);
+    return stats;
+}
@@ -0,0 +1,214 @@
+/*
+ * spatialgrid.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __SPATIALGRID_H__
+#define __SPATIALGRID_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csgeom/vector3.h>
+#include <csgeom/transfrm.h>
+#include <csutil/array.h>
+#include <csutil/hash.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/psconst.h"
+
+struct iSector;
+class gemObject;
+
+/**
+ * \addtogroup server
+ * @{ */
+
+/// Edge length of one grid cell in meters.
+#define SPATIAL_GRID_CELL_SIZE 16.0f
+
+/**
+ * Queries covering more cells than this walk all cells of the sector instead.
+ */
+#define SPATIAL_GRID_MAX_QUERY_CELLS 256
+
+/**
+ * Key of one cell inside the grid of a sector.
+ */
+struct SpatialGridCellKey
+{
+    InstanceID instance;
+    int x;
+    int z;
+
+    SpatialGridCellKey() : instance(0), x(0), z(0) {}
+    SpatialGridCellKey(InstanceID instance, int x, int z) : instance(instance), x(x), z(z) {}
+
+    bool operator == (const SpatialGridCellKey &other) const
+    {
+        return instance == other.instance && x == other.x && z == other.z;
+    }
+
+    bool operator < (const SpatialGridCellKey &other) const
+    {
+        if(instance != other.instance)
+            return instance < other.instance;
+        if(x != other.x)
+            return x < other.x;
+        return z < other.z;
+    }
+};
+
+template<> class csHashComputer<SpatialGridCellKey>
+{
+public:
+    static uint ComputeHash(const SpatialGridCellKey &key)
+    {
+        return (uint)(key.x * 73856093) ^ (uint)(key.z * 19349663) ^ (uint)(key.instance * 83492791);
+    }
+};
+
+/**
+ * Uniform grid of all entities, kept per sector and instance.
+ *
+ * The grid is kept up to date by the GEM whenever an entity moves, so
+ * proximity queries don't have to go through the mesh lists of the engine.
+ * Cells are laid out in the x/z plane; height is only checked against the
+ * query radius. Queries follow portals into neighbouring sectors the same way
+ * iEngine::GetNearbyMeshes does.
+ */
+class SpatialGrid
+{
+public:
+    SpatialGrid(float cellSize = SPATIAL_GRID_CELL_SIZE);
+    ~SpatialGrid();
+
+    /**
+     * Insert an entity or move it to its new location.
+     *
+     * @param obj      The entity.
+     * @param sector   The sector the entity is in, NULL removes it from the grid.
+     * @param instance The instance the entity is in.
+     * @param pos      The position of the entity.
+     * @return true if the entity is new to the grid or changed sector.
+     */
+    bool Update(gemObject* obj, iSector* sector, InstanceID instance, const csVector3 &pos);
+
+    /**
+     * Remove an entity from the grid.
+     */
+    void Remove(gemObject* obj);
+
+    /**
+     * Add all entities within radius of pos to list.
+     *
+     * @param sector   The sector to search in.
+     * @param pos      The center of the search.
+     * @param instance The instance to search in, INSTANCE_ALL for all of them.
+     * @param radius   The distance around pos to search.
+     * @param list     The found entities are appended here.
+     */
+    void FindNearby(iSector* sector, const csVector3 &pos, InstanceID instance, float radius, csArray<gemObject*> &list);
+
+    /**
+     * Add all entities of a sector to list.
+     */
+    void FindInSector(iSector* sector, csArray<gemObject*> &list);
+
+    /**
+     * Add the sectors the portals of a sector lead to to list.
+     */
+    void FindNeighbours(iSector* sector, csArray<iSector*> &list);
+
+    /// Number of entities in the grid.
+    size_t GetEntityCount() const
+    {
+        return entries.GetSize();
+    }
+
+    /// Get statistics about the grid for the server console.
+    csString GetStats() const;
+
+private:
+    /// One entity in a cell.
+    struct Slot
+    {
+        gemObject* obj;
+        csVector3 pos;
+    };
+
+    /// A cell, entities are swap-removed so the array stays dense.
+    struct Cell
+    {
+        csArray<Slot> slots;
+    };
+
+    /// A portal that queries may follow into another sector.
+    struct Portal
+    {
+        iSector* target;
+        csVector3 center;
+        float radius;
+        csReversibleTransform warp;
+    };
+
+    /// All cells of one sector.
+    struct SectorGrid
+    {
+        csHash<Cell*, SpatialGridCellKey> cells;
+        csHash<size_t, InstanceID> instances;   ///< Number of entities per instance.
+        csArray<Portal> portals;
+        bool portalsLoaded;
+
+        SectorGrid() : portalsLoaded(false) {}
+        ~SectorGrid();
+    };
+
+    /// Where an entity is stored.
+    struct Entry
+    {
+        iSector* sector;
+        SpatialGridCellKey key;
+        size_t index;
+    };
+
+    SpatialGridCellKey GetKey(InstanceID instance, const csVector3 &pos) const;
+    SectorGrid* GetSectorGrid(iSector* sector, bool create);
+    void LoadPortals(iSector* sector, SectorGrid* grid);
+    void Insert(gemObject* obj, iSector* sector, const SpatialGridCellKey &key, const csVector3 &pos, Entry &entry);
+    void RemoveSlot(const Entry &entry);
+
+    void FindNearby(iSector* sector, const csVector3 &pos, InstanceID instance, float radius,
+                    csArray<gemObject*> &list, csArray<iSector*> &visited);
+    void CollectCells(SectorGrid* grid, InstanceID instance, const csVector3 &pos, float radius,
+                      csArray<gemObject*> &list);
+    void CollectCell(const Cell* cell, const csVector3 &pos, float radiusSquared, csArray<gemObject*> &list);
+
+    float cellSize;
+    csHash<Entry, EID> entries;
+    csHash<SectorGrid*, csPtrKey<iSector> > sectors;
+
+    /// Statistics
+    mutable size_t queries;
+    mutable size_t slotsTested;
+    mutable size_t found;
+};
+
+/** @} */
+
+#endif
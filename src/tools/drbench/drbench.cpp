@@ -0,0 +1,165 @@
+/*
+ *  drbench.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+#include <cstool/initapp.h>
+#include <csutil/cmdhelp.h>
+#include <iutil/cmdline.h>
+
+#include "drbench.h"
+
+CS_IMPLEMENT_APPLICATION
+
+/// The client every update is sent to.
+#define DRBENCH_CLIENT 1
+
+DRBench::DRBench(iObjectRegistry* object_reg) : object_reg(object_reg),
+    updates(0), fullBytes(0), compactBytes(0), keyframes(0), lost(0), maxPosError(0), maxVelError(0)
+{
+    // Sector names go by string id, as with the server's message strings.
+    accessPointers.msgstrings = &msgstrings;
+    accessPointers.msgstringshash = NULL;
+    accessPointers.engine = NULL;
+}
+
+DRBench::~DRBench()
+{
+    csHash<Entity*, EID>::GlobalIterator it(entities.GetIterator());
+    while(it.HasNext())
+    {
+        delete it.Next();
+    }
+}
+
+void DRBench::PrintHelp()
+{
+    printf("This application compares the size of the DR message formats on recorded DR traffic.\n\n");
+
+    printf("Options:\n");
+    printf("-in The file recorded with PlaneShift.Server.DRRecord.\n\n");
+    printf("Usage: drbench -in=drrecord.txt\n");
+}
+
+void DRBench::Replay(EID eid, uint8_t counter, psDRUpdate &update)
+{
+    Entity* entity = entities.Get(eid, NULL);
+    if(!entity)
+    {
+        entity = new Entity;
+        entities.Put(eid, entity);
+    }
+
+    psDRMessage full(0, eid, update.on_ground, update.mode, counter,
+                     update.pos, update.yrot, NULL, update.sectorName,
+                     update.vel, update.worldVel, update.ang_vel, &accessPointers);
+    fullBytes += full.msg->bytes->GetTotalSize();
+
+    entity->encoder.Update(update);
+    bool keyframe = entity->encoder.NeedsKeyframe(DRBENCH_CLIENT);
+    psDRCompactMessage compact(0, eid, counter, entity->encoder, keyframe, &accessPointers);
+    compactBytes += compact.msg->bytes->GetTotalSize();
+    if(keyframe)
+        keyframes++;
+    updates++;
+
+    // Read it back as the client does.
+    csRef<MsgEntry> received;
+    received.AttachNew(new MsgEntry(compact.msg));
+    psDRCompactMessage decoded(received, &accessPointers, entity->keyframe);
+    if(!decoded.valid)
+    {
+        lost++;
+        return;
+    }
+
+    maxPosError = csMax(maxPosError, (decoded.pos - update.pos).Norm());
+    maxVelError = csMax(maxVelError, (decoded.vel - update.vel).Norm());
+    maxVelError = csMax(maxVelError, (decoded.worldVel - update.worldVel).Norm());
+}
+
+void DRBench::Run()
+{
+    csRef<iCommandLineParser> cmdline = csQueryRegistry<iCommandLineParser>(object_reg);
+    const char* in = cmdline->GetOption("in");
+    if(!in || csCommandLineHelper::CheckHelp(object_reg))
+    {
+        PrintHelp();
+        return;
+    }
+
+    FILE* file = fopen(in, "r");
+    if(!file)
+    {
+        printf("Couldn't open %s.\n", in);
+        return;
+    }
+
+    char line[512];
+    size_t bad = 0;
+    while(fgets(line, sizeof(line), file))
+    {
+        csTicks ticks;
+        EID eid;
+        uint8_t counter;
+        psDRUpdate update;
+        if(!update.Parse(line, ticks, eid, counter))
+        {
+            bad++;
+            continue;
+        }
+        msgstrings.Request(update.sectorName);
+        Replay(eid, counter, update);
+    }
+    fclose(file);
+
+    if(bad)
+        printf("Skipped %zu lines that weren't DR updates.\n", bad);
+    if(!updates)
+    {
+        printf("No updates in %s.\n", in);
+        return;
+    }
+
+    printf("%zu updates of %zu entities\n", updates, entities.GetSize());
+    printf("psDRMessage:        %zu bytes, %.1f per update\n", fullBytes, (float)fullBytes / updates);
+    printf("psDRCompactMessage: %zu bytes, %.1f per update, %.1f%% of psDRMessage\n",
+           compactBytes, (float)compactBytes / updates, 100.0f * compactBytes / fullBytes);
+    printf("Keyframes: %zu (%.1f%%), updates the client couldn't decode: %zu\n",
+           keyframes, 100.0f * keyframes / updates, lost);
+    printf("Largest error: position %.3f, velocity %.3f\n", maxPosError, maxVelError);
+}
+
+int main(int argc, char** argv)
+{
+    iObjectRegistry* object_reg = csInitializer::CreateEnvironment(argc, argv);
+    if(!object_reg)
+    {
+        printf("Object Reg failed to Init!\n");
+        return 1;
+    }
+
+    DRBench* drbench = new DRBench(object_reg);
+    drbench->Run();
+    delete drbench;
+
+    CS_STATIC_VARIABLE_CLEANUP
+    csInitializer::DestroyApplication(object_reg);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ *  drbench.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __DRBENCH_H__
+#define __DRBENCH_H__
+
+#include <csutil/hash.h>
+#include <csutil/strset.h>
+
+#include "net/drmessages.h"
+
+/**
+ * Replays DR traffic recorded with PlaneShift.Server.DRRecord through the
+ * psDRMessage and the psDRCompactMessage encoder, as if one client watched
+ * every entity in the recording, and compares the bytes they take. The
+ * compact updates are decoded again to check how far quantizing moved them.
+ */
+class DRBench
+{
+public:
+    DRBench(iObjectRegistry* object_reg);
+    ~DRBench();
+
+    void Run();
+
+private:
+    /// What a watching client knows of an entity.
+    struct Entity
+    {
+        psDREncoder encoder;
+        psDRKeyframe keyframe;
+    };
+
+    void PrintHelp();
+
+    /// Send one update both ways.
+    void Replay(EID eid, uint8_t counter, psDRUpdate &update);
+
+    iObjectRegistry* object_reg;
+    csStringSet msgstrings;
+    NetBase::AccessPointers accessPointers;
+    csHash<Entity*, EID> entities;
+
+    size_t updates;
+    size_t fullBytes;
+    size_t compactBytes;
+    size_t keyframes;
+    size_t lost;
+    float maxPosError;
+    float maxVelError;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ *  mathbench.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+#include <ctype.h>
+
+#include <cstool/initapp.h>
+#include <csutil/cmdhelp.h>
+#include <csutil/sysfunc.h>
+#include <iutil/cmdline.h>
+
+#include "mathbench.h"
+
+CS_IMPLEMENT_APPLICATION
+
+MathBench::MathBench(iObjectRegistry* object_reg) : object_reg(object_reg)
+{
+}
+
+MathBench::~MathBench()
+{
+}
+
+void MathBench::PrintHelp()
+{
+    printf("This application times the scripts of the math_scripts dump, with names looked up and resolved to slots.\n\n");
+
+    printf("Options:\n");
+    printf("-file       The dump to read, src/server/database/mysql/math_scripts.sql by default.\n");
+    printf("-iterations Evaluations of every script per path, 200 by default.\n\n");
+    printf("Usage: mathbench -file=src/server/database/mysql/math_scripts.sql -iterations=200\n");
+}
+
+bool MathBench::LoadScripts(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if(!file)
+        return false;
+
+    csString sql;
+    char buf[4096];
+    size_t read;
+    while((read = fread(buf, 1, sizeof(buf), file)) > 0)
+        sql.Append(buf, read);
+    fclose(file);
+
+    size_t pos = 0;
+    while((pos = sql.Find("INSERT INTO math_scripts VALUES", pos)) != SIZET_NOT_FOUND)
+    {
+        csString fields[2];
+        for(int field = 0; field < 2; field++)
+        {
+            while(pos < sql.Length() && sql[pos] != '"' && sql[pos] != '\'')
+                pos++;
+            if(pos == sql.Length())
+                return false;
+
+            char quote = sql[pos++];
+            while(pos < sql.Length() && sql[pos] != quote)
+            {
+                if(sql[pos] == '\\' && pos+1 < sql.Length())
+                    pos++;
+                fields[field].Append(sql[pos++]);
+            }
+            pos++;
+        }
+        names.Push(fields[0]);
+        scripts.Push(fields[1]);
+    }
+    return true;
+}
+
+void MathBench::DefineVariables(const csString &script, MathEnvironment &env)
+{
+    for(size_t i = 0; i < script.Length(); i++)
+    {
+        if(!isupper(script[i]) || (i && (isalnum(script[i-1]) || script[i-1] == '_')))
+            continue;
+
+        size_t end = i;
+        while(end < script.Length() && (isalnum(script[end]) || script[end] == '_'))
+            end++;
+
+        csString var(script.GetData() + i, end - i);
+        if(end < script.Length() && script[end] == ':')
+            env.Define(var, &object);
+        else if(!env.Lookup(var))
+            env.Define(var, 1.0);
+        i = end;
+    }
+}
+
+void MathBench::Run()
+{
+    csRef<iCommandLineParser> cmdline = csQueryRegistry<iCommandLineParser>(object_reg);
+    if(csCommandLineHelper::CheckHelp(object_reg))
+    {
+        PrintHelp();
+        return;
+    }
+
+    const char* filename = cmdline->GetOption("file");
+    if(!filename)
+        filename = "src/server/database/mysql/math_scripts.sql";
+    int iterations = 200;
+    const char* option = cmdline->GetOption("iterations");
+    if(option)
+        iterations = csMax(atoi(option), 1);
+
+    if(!LoadScripts(filename))
+    {
+        printf("Couldn't read the scripts from %s.\n", filename);
+        return;
+    }
+
+    printf("%-40s %10s %10s\n", "Script", "By name", "Slots");
+    csMicroTicks totalByName = 0;
+    csMicroTicks totalBySlot = 0;
+    for(size_t i = 0; i < scripts.GetSize(); i++)
+    {
+        MathScript* script = MathScript::Create(names[i], scripts[i]);
+        if(!script)
+        {
+            printf("%-40s doesn't parse\n", names[i].GetData());
+            continue;
+        }
+
+        // Both paths run in the same environment, so they see the same values.
+        MathEnvironment env;
+        DefineVariables(scripts[i], env);
+
+        csMicroTicks start = csGetMicroTicks();
+        for(int n = 0; n < iterations; n++)
+            script->EvaluateByName(&env);
+        csMicroTicks byName = csGetMicroTicks() - start;
+
+        start = csGetMicroTicks();
+        for(int n = 0; n < iterations; n++)
+            script->Evaluate(&env);
+        csMicroTicks bySlot = csGetMicroTicks() - start;
+
+        totalByName += byName;
+        totalBySlot += bySlot;
+        printf("%-40s %7.2f us %7.2f us\n", names[i].GetData(),
+               (double)byName / iterations, (double)bySlot / iterations);
+        MathScript::Destroy(script);
+    }
+
+    printf("%-40s %7.2f us %7.2f us, %.1fx\n", "All scripts", (double)totalByName / iterations,
+           (double)totalBySlot / iterations, totalBySlot ? (double)totalByName / totalBySlot : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    iObjectRegistry* object_reg = csInitializer::CreateEnvironment(argc, argv);
+    if(!object_reg)
+    {
+        printf("Object Reg failed to Init!\n");
+        return 1;
+    }
+
+    MathBench* mathbench = new MathBench(object_reg);
+    mathbench->Run();
+    delete mathbench;
+
+    CS_STATIC_VARIABLE_CLEANUP
+    csInitializer::DestroyApplication(object_reg);
+    return 0;
+}
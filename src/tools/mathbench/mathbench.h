@@ -0,0 +1,75 @@
+/*
+ *  mathbench.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __MATHBENCH_H__
+#define __MATHBENCH_H__
+
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+
+#include "util/mathscript.h"
+#include "util/scriptvar.h"
+
+/**
+ * Times every script of the math_scripts dump, looking names up as
+ * MathExpression::EvaluateByName() does and through the slots the
+ * expressions resolve when they are parsed.
+ */
+class MathBench
+{
+public:
+    MathBench(iObjectRegistry* object_reg);
+    ~MathBench();
+
+    void Run();
+
+private:
+    /// Returns itself for every property and method, so the scripts run without a game.
+    class BenchObject : public iScriptableVar
+    {
+    public:
+        virtual double GetProperty(MathEnvironment* env, const char* /*prop*/)
+        {
+            return env->GetValue(this);
+        }
+        virtual double CalcFunction(MathEnvironment* env, const char* /*function*/, const double* /*params*/)
+        {
+            return env->GetValue(this);
+        }
+        virtual const char* ToString()
+        {
+            return "BenchObject";
+        }
+    };
+
+    void PrintHelp();
+
+    /// Read the name and script of every row of the dump.
+    bool LoadScripts(const char* filename);
+
+    /// Define every capitalized name of a script, as an object if it is followed by ':'.
+    void DefineVariables(const csString &script, MathEnvironment &env);
+
+    iObjectRegistry* object_reg;
+    BenchObject object;
+    csArray<csString> names;
+    csArray<csString> scripts;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ *  mcastbench.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+#include <cstool/initapp.h>
+#include <csutil/cmdhelp.h>
+#include <csutil/sysfunc.h>
+#include <iutil/cmdline.h>
+
+#include "net/messages.h"
+#include "net/netpacket.h"
+
+#include "mcastbench.h"
+
+CS_IMPLEMENT_APPLICATION
+
+MulticastBench::MulticastBench(iObjectRegistry* object_reg) : object_reg(object_reg)
+{
+    memset(&counts, 0, sizeof(counts));
+}
+
+MulticastBench::~MulticastBench()
+{
+}
+
+void MulticastBench::PrintHelp()
+{
+    printf("This application times queueing a multicast with a payload copied per client and shared.\n\n");
+
+    printf("Options:\n");
+    printf("-clients Number of recipients, 500 by default.\n");
+    printf("-size    Payload bytes of the message, 1000 by default.\n");
+    printf("-rounds  Number of multicasts to time, 1000 by default.\n\n");
+    printf("Usage: mcastbench -clients=500 -size=1000 -rounds=1000\n");
+}
+
+void MulticastBench::Queue(MsgEntry* me, bool shared)
+{
+    // As NetManager::Multicast, which makes the one copy the clients share.
+    csRef<MsgEntry> msg;
+    if(shared)
+    {
+        msg.AttachNew(new MsgEntry(me));
+        counts.msgEntries++;
+        counts.queueBytes += me->bytes->GetTotalSize();
+    }
+    else
+    {
+        msg = me;
+    }
+
+    long copiedBytes = net.GetCopiedBytes();
+    long copies = net.GetCopies();
+    for(size_t i = 0; i < queues.GetSize(); i++)
+    {
+        msg->clientnum = (uint32_t)(i + 1);
+        if(shared)
+            net.SendSharedMessage(msg, queues[i]);
+        else
+            net.SendMessage(msg, queues[i]);
+    }
+    counts.queueBytes += net.GetCopiedBytes() - copiedBytes;
+    counts.packetBuffers += net.GetCopies() - copies;
+}
+
+void MulticastBench::Drain()
+{
+    char datagram[MAXPACKETSIZE];
+    for(size_t i = 0; i < queues.GetSize(); i++)
+    {
+        csRef<psNetPacketEntry> pkt;
+        while((pkt = queues[i]->Get()))
+        {
+            counts.sendBytes += pkt->CopyMarshalled(datagram) - sizeof(psNetPacket);
+            counts.packets++;
+        }
+    }
+}
+
+void MulticastBench::Run()
+{
+    csRef<iCommandLineParser> cmdline = csQueryRegistry<iCommandLineParser>(object_reg);
+    if(csCommandLineHelper::CheckHelp(object_reg))
+    {
+        PrintHelp();
+        return;
+    }
+
+    size_t clients = 500;
+    size_t size = 1000;
+    size_t rounds = 1000;
+    const char* option = cmdline->GetOption("clients");
+    if(option)
+        clients = csMax(atoi(option), 1);
+    option = cmdline->GetOption("size");
+    if(option)
+        size = csMax(atoi(option), 1);
+    option = cmdline->GetOption("rounds");
+    if(option)
+        rounds = csMax(atoi(option), 1);
+
+    // Room for the fragments of the largest message.
+    size_t fragments = size / (MAXPACKETSIZE - sizeof(psNetPacket)) + 1;
+    for(size_t i = 0; i < clients; i++)
+    {
+        csRef<NetPacketQueueRefCount> queue;
+        queue.AttachNew(new NetPacketQueueRefCount((int)fragments + 1));
+        queues.Push(queue);
+    }
+
+    csRef<MsgEntry> me;
+    me.AttachNew(new MsgEntry(size));
+    memset(me->bytes->payload, 'x', size);
+    me->SetType(MSGTYPE_CHAT);
+
+    printf("%zu clients, %zu payload bytes, %zu rounds\n", clients, size, rounds);
+
+    for(int shared = 0; shared < 2; shared++)
+    {
+        csMicroTicks queueTime = 0;
+        csMicroTicks drainTime = 0;
+        memset(&counts, 0, sizeof(counts));
+        for(size_t r = 0; r < rounds; r++)
+        {
+            csMicroTicks start = csGetMicroTicks();
+            Queue(me, shared != 0);
+            queueTime += csGetMicroTicks() - start;
+
+            start = csGetMicroTicks();
+            Drain();
+            drainTime += csGetMicroTicks() - start;
+        }
+
+        // Every MsgEntry copy and packet buffer is one more allocation.
+        size_t allocations = counts.msgEntries * 2 + counts.packets + counts.packetBuffers;
+        printf("%s, per multicast:\n", shared ? "Shared" : "Copied");
+        printf("  %8.1f us queueing, %8.1f us sending\n", (double)queueTime / rounds, (double)drainTime / rounds);
+        printf("  %8.1f payload bytes copied, %.1f queueing and %.1f into datagrams\n",
+               (double)(counts.queueBytes + counts.sendBytes) / rounds,
+               (double)counts.queueBytes / rounds, (double)counts.sendBytes / rounds);
+        printf("  %8.1f allocations, %.1f MsgEntry copies with their buffers, %.1f packet entries, %.1f packet buffers\n",
+               (double)allocations / rounds, (double)counts.msgEntries / rounds,
+               (double)counts.packets / rounds, (double)counts.packetBuffers / rounds);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    iObjectRegistry* object_reg = csInitializer::CreateEnvironment(argc, argv);
+    if(!object_reg)
+    {
+        printf("Object Reg failed to Init!\n");
+        return 1;
+    }
+
+    MulticastBench* mcastbench = new MulticastBench(object_reg);
+    mcastbench->Run();
+    delete mcastbench;
+
+    CS_STATIC_VARIABLE_CLEANUP
+    csInitializer::DestroyApplication(object_reg);
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ *  mcastbench.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __MCASTBENCH_H__
+#define __MCASTBENCH_H__
+
+#include <csutil/array.h>
+#include <csutil/ref.h>
+
+#include "net/netbase.h"
+
+/**
+ * Times queueing a multicast for many clients, once with a copy of the
+ * payload per client as NetBase::SendMessage() makes and once with the
+ * payload shared as NetBase::SendSharedMessage() does. The queues are then
+ * drained the way the network thread puts packets into datagrams, so the
+ * cost moved there shows too. Besides the time, the payload bytes copied
+ * and the buffers allocated are counted for both.
+ */
+class MulticastBench
+{
+public:
+    MulticastBench(iObjectRegistry* object_reg);
+    ~MulticastBench();
+
+    void Run();
+
+private:
+    /// Queues packets without a socket, nothing is ever received.
+    class QueueNet : public NetBase
+    {
+    public:
+        virtual void Broadcast(MsgEntry* /*me*/, int /*scope*/, int /*guildID*/) {}
+        virtual void Multicast(MsgEntry* /*me*/, const csArray<PublishDestination> & /*multi*/,
+                               uint32_t /*except*/, float /*range*/) {}
+
+        /// Payload bytes copied into packet buffers while queueing.
+        long GetCopiedBytes() const
+        {
+            return payloadStats.copiedBytes;
+        }
+        /// Packet buffers allocated for the copies.
+        long GetCopies() const
+        {
+            return payloadStats.copies;
+        }
+
+    protected:
+        virtual Connection* GetConnByIP(LPSOCKADDR_IN /*addr*/)
+        {
+            return NULL;
+        }
+        virtual Connection* GetConnByNum(uint32_t /*clientnum*/)
+        {
+            return NULL;
+        }
+        virtual bool HandleUnknownClient(LPSOCKADDR_IN /*addr*/, MsgEntry* /*data*/)
+        {
+            return false;
+        }
+    };
+
+    /// What the multicasts of one way of queueing cost, summed over the rounds.
+    struct Counts
+    {
+        size_t queueBytes;     ///< Payload bytes copied while queueing
+        size_t sendBytes;      ///< Payload bytes copied into datagrams
+        size_t msgEntries;     ///< MsgEntry copies, each with a buffer of its own
+        size_t packets;        ///< Packet entries, one per packet
+        size_t packetBuffers;  ///< Packet buffers holding a copy of the payload
+    };
+
+    void PrintHelp();
+
+    /**
+     * Queue the message for every client.
+     *
+     * @param shared Reference one copy of the payload instead of copying it.
+     */
+    void Queue(MsgEntry* me, bool shared);
+
+    /// Take all packets out of the queues as the network thread sends them.
+    void Drain();
+
+    iObjectRegistry* object_reg;
+    QueueNet net;
+    csArray<csRef<NetPacketQueueRefCount> > queues;
+    Counts counts;
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ *  netload.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+#include <cstool/initapp.h>
+#include <csutil/cmdhelp.h>
+#include <csutil/sysfunc.h>
+#include <iutil/cmdline.h>
+
+#include <poll.h>
+
+#include "net/message.h"
+#include "net/messages.h"
+#include "net/netpacket.h"
+
+#include "netload.h"
+
+CS_IMPLEMENT_APPLICATION
+
+NetLoad::NetLoad(iObjectRegistry* object_reg) : object_reg(object_reg),
+    sent(0), received(0), sendErrors(0), rttSum(0), rttMax(0)
+{
+}
+
+NetLoad::~NetLoad()
+{
+    for(size_t i = 0; i < clients.GetSize(); i++)
+    {
+        SOCK_CLOSE(clients[i].sock);
+    }
+}
+
+void NetLoad::PrintHelp()
+{
+    printf("This application simulates many clients pinging a server to measure its network throughput.\n\n");
+
+    printf("Options:\n");
+    printf("-server The address of the server. Defaults to 127.0.0.1\n\n");
+    printf("-port The port of the server. Defaults to 13331\n\n");
+    printf("-clients Number of simulated clients, each with its own socket. Defaults to 2000\n\n");
+    printf("-rate Pings per second sent by each client. Defaults to 10\n\n");
+    printf("-time Seconds to run. Defaults to 30\n\n");
+    printf("Usage: netload -clients=5000 -rate=20\n");
+}
+
+bool NetLoad::Open(const char* host, int port, size_t count)
+{
+    SOCKADDR_IN addr;
+    memset(&addr, 0, sizeof(SOCKADDR_IN));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(host);
+    addr.sin_port = htons(port);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        LoadClient client;
+        client.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if(client.sock == INVALID_SOCKET)
+        {
+            printf("Could only open %zu sockets, raise the open file limit for more.\n", i);
+            break;
+        }
+
+        unsigned long arg = 1;
+        if(SOCK_IOCTL(client.sock, FIONBIO, &arg) < 0 ||
+           connect(client.sock, (LPSOCKADDR) &addr, sizeof(SOCKADDR_IN)) < 0)
+        {
+            printf("Failed to set up socket %zu.\n", i);
+            SOCK_CLOSE(client.sock);
+            break;
+        }
+
+        client.nextID = 0;
+        client.nextPing = 0;
+        memset(client.sent, 0, sizeof(client.sent));
+        clients.Push(client);
+    }
+    return !clients.IsEmpty();
+}
+
+void NetLoad::SendPing(LoadClient &client, csTicks now)
+{
+    uint32_t id = client.nextID++;
+    psPingMsg ping(0, id, PINGFLAG_REQUESTFLAGS);
+
+    csRef<psNetPacketEntry> pkt;
+    pkt.AttachNew(new psNetPacketEntry(ping.msg->priority, 0, 0, 0,
+                                       (uint32_t) ping.msg->bytes->GetTotalSize(),
+                                       (uint16_t) ping.msg->bytes->GetTotalSize(), ping.msg->bytes));
+
+    char buffer[MAXPACKETSIZE];
+    size_t size = pkt->CopyMarshalled(buffer);
+    if(send(client.sock, buffer, size, 0) == (int)size)
+    {
+        client.sent[id % PINGWINDOW] = now;
+        sent++;
+    }
+    else
+    {
+        sendErrors++;
+    }
+}
+
+void NetLoad::Receive(LoadClient &client, csTicks now)
+{
+    char buffer[MAXPACKETSIZE];
+    int len;
+    while((len = recv(client.sock, buffer, MAXPACKETSIZE, 0)) > 0)
+    {
+        psNetPacket* packet = psNetPacket::NetPacketFromBuffer(buffer, len);
+        if(!packet)
+            continue;
+
+        packet->UnmarshallEndian();
+        if(packet->offset != 0 || packet->pktsize < sizeof(psMessageBytes))
+            continue;
+
+        psMessageBytes* bytes = (psMessageBytes*) packet->data;
+        if(bytes->GetTotalSize() > packet->pktsize)
+            continue;
+
+        csRef<MsgEntry> me;
+        me.AttachNew(new MsgEntry(bytes));
+        if(me->GetType() != MSGTYPE_PING)
+            continue;
+
+        psPingMsg pong(me);
+        csTicks rtt = now - client.sent[pong.id % PINGWINDOW];
+        rttSum += rtt;
+        rttMax = csMax(rttMax, rtt);
+        received++;
+    }
+}
+
+void NetLoad::Run()
+{
+    csRef<iCommandLineParser> cmdline = csQueryRegistry<iCommandLineParser>(object_reg);
+    if(csCommandLineHelper::CheckHelp(object_reg))
+    {
+        PrintHelp();
+        return;
+    }
+
+    csString host = cmdline->GetOption("server");
+    if(host.IsEmpty())
+        host = "127.0.0.1";
+
+    const char* option = cmdline->GetOption("port");
+    int port = option ? atoi(option) : 13331;
+    option = cmdline->GetOption("clients");
+    size_t count = option ? (size_t)atoi(option) : 2000;
+    option = cmdline->GetOption("rate");
+    int rate = option ? csMin(csMax(atoi(option), 1), 1000) : 10;
+    option = cmdline->GetOption("time");
+    csTicks duration = (option ? atoi(option) : 30) * 1000;
+
+    if(!Open(host, port, count))
+    {
+        printf("No sockets, nothing to do.\n");
+        return;
+    }
+    count = clients.GetSize();
+    printf("%zu clients pinging %s:%d %d times per second for %u seconds.\n",
+           count, host.GetData(), port, rate, duration / 1000);
+
+    csArray<struct pollfd> fds;
+    fds.SetSize(count);
+    for(size_t i = 0; i < count; i++)
+    {
+        fds[i].fd = clients[i].sock;
+        fds[i].events = POLLIN;
+    }
+
+    // Spread the pings of the clients over the interval.
+    csTicks interval = 1000 / rate;
+    csTicks start = csGetTicks();
+    for(size_t i = 0; i < count; i++)
+    {
+        clients[i].nextPing = start + (csTicks)(i * interval / count);
+    }
+
+    size_t totalSent = 0;
+    size_t totalReceived = 0;
+    csTicks lastReport = start;
+    csTicks now = start;
+    while(now - start < duration)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            if(clients[i].nextPing <= now)
+            {
+                SendPing(clients[i], now);
+                clients[i].nextPing += interval;
+            }
+        }
+
+        if(poll(fds.GetArray(), count, 1) > 0)
+        {
+            now = csGetTicks();
+            for(size_t i = 0; i < count; i++)
+            {
+                if(fds[i].revents & POLLIN)
+                    Receive(clients[i], now);
+            }
+        }
+
+        now = csGetTicks();
+        if(now - lastReport >= 1000)
+        {
+            float seconds = (float)(now - lastReport) / 1000.0f;
+            printf("%3u s: %.0f pings/s sent, %.0f replies/s, rtt avg %.1f ms max %u ms, %zu send errors\n",
+                   (now - start) / 1000, (float)sent / seconds, (float)received / seconds,
+                   received ? (float)rttSum / (float)received : 0.0f, rttMax, sendErrors);
+
+            totalSent += sent;
+            totalReceived += received;
+            sent = received = sendErrors = 0;
+            rttSum = rttMax = 0;
+            lastReport = now;
+        }
+    }
+
+    // Replies still on the way count as lost.
+    totalSent += sent;
+    totalReceived += received;
+    printf("Total: %zu pings sent, %zu replies (%.1f%% lost), %.0f replies/s\n",
+           totalSent, totalReceived,
+           totalSent ? 100.0f * (float)(totalSent - totalReceived) / (float)totalSent : 0.0f,
+           (float)totalReceived * 1000.0f / (float)(now - start));
+}
+
+int main(int argc, char** argv)
+{
+    iObjectRegistry* object_reg = csInitializer::CreateEnvironment(argc, argv);
+    if(!object_reg)
+    {
+        printf("Object Reg failed to Init!\n");
+        return 1;
+    }
+
+    NetLoad* netload = new NetLoad(object_reg);
+    netload->Run();
+    delete netload;
+
+    CS_STATIC_VARIABLE_CLEANUP
+    csInitializer::DestroyApplication(object_reg);
+    return 0;
+}
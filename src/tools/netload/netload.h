@@ -0,0 +1,77 @@
+/*
+ *  netload.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __NETLOAD_H__
+#define __NETLOAD_H__
+
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+
+#include "net/netbase.h"
+
+/// Pings of a client that can be in flight before their send times are reused.
+#define PINGWINDOW 64
+
+/**
+ * Puts load on the network threads of a server. Every simulated client has a
+ * socket of its own, so the server sees thousands of addresses, and pings the
+ * server at a fixed rate. The server answers pings in its network threads,
+ * so the replies per second show how the network throughput scales with the
+ * number of shards.
+ */
+class NetLoad
+{
+public:
+    NetLoad(iObjectRegistry* object_reg);
+    ~NetLoad();
+
+    void Run();
+
+private:
+    /// A simulated client.
+    struct LoadClient
+    {
+        SOCKET sock;
+        uint32_t nextID;
+        csTicks nextPing;
+        csTicks sent[PINGWINDOW];
+    };
+
+    void PrintHelp();
+
+    /// Open count sockets connected to the server.
+    bool Open(const char* host, int port, size_t count);
+
+    void SendPing(LoadClient &client, csTicks now);
+
+    /// Read all replies waiting for the client.
+    void Receive(LoadClient &client, csTicks now);
+
+    iObjectRegistry* object_reg;
+    csArray<LoadClient> clients;
+
+    // Counters since the last report.
+    size_t sent;
+    size_t received;
+    size_t sendErrors;
+    csTicks rttSum;
+    csTicks rttMax;
+};
+
+#endif